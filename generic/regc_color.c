@@ -62,6 +62,7 @@ initcm(
     cd->sub = NOSUB;
     cd->arcs = NULL;
     cd->flags = 0;
+    cd->lastchr = 0;
     cd->nchrs = CHR_MAX - CHR_MIN + 1;
 
     /*
@@ -280,6 +281,7 @@ newcolor(
     cd->sub = NOSUB;
     cd->arcs = NULL;
     cd->flags = 0;
+    cd->lastchr = 0;
     cd->block = NULL;
 
     return (color) (cd - cm->cd);
@@ -387,9 +389,35 @@ subcolor(
     }
     cm->cd[co].nchrs--;
     cm->cd[sco].nchrs++;
+    cm->cd[sco].lastchr = (chr) c;
     setcolor(cm, c, sco);
     return sco;
 }
+
+/*
+ - singlechr - find the only chr of a color, if it has exactly one
+ * The colormap has no inverse, so this relies on subcolor() having recorded
+ * the last chr it gave each color, and verifies that it is still there.
+ ^ static int singlechr(struct colormap *, pcolor, chr *);
+ */
+static int			/* 1 if the color has exactly one chr */
+singlechr(
+    struct colormap *cm,
+    pcolor co,
+    chr *cp)			/* where to put the chr */
+{
+    struct colordesc *cd = &cm->cd[co];
+    chr c = cd->lastchr;
+
+    if (co == COLORLESS || (cd->flags&(FREECOL|PSEUDO)) || cd->nchrs != 1) {
+	return 0;
+    }
+    if (GETCOLOR(cm, c) != co) {
+	return 0;
+    }
+    *cp = c;
+    return 1;
+}
 
 /*
  - newsub - allocate a new subcolor (if necessary) for a color
@@ -1057,12 +1057,22 @@ pushfwd(
 	return;
     }
 
-    for (a = nfa->post->ins; a != NULL; a = nexta) {
-	nexta = a->inchain;
-	if (a->type == '$') {
-	    assert(a->co == 0 || a->co == 1);
-	    newarc(nfa, PLAIN, nfa->eos[a->co], a->from, a->to);
-	    freearc(nfa, a);
+    /*
+     * Constraints stop at post, and at the end states of the arms of a set
+     * (see parsearms), which are flagged like post.
+     */
+
+    for (s = nfa->states; s != NULL; s = s->next) {
+	if (!s->flag || s == nfa->pre) {
+	    continue;
+	}
+	for (a = s->ins; a != NULL; a = nexta) {
+	    nexta = a->inchain;
+	    if (a->type == '$') {
+		assert(a->co == 0 || a->co == 1);
+		newarc(nfa, PLAIN, nfa->eos[a->co], a->from, a->to);
+		freearc(nfa, a);
+	    }
 	}
     }
 }
@@ -39,9 +39,16 @@
 /* automatically gathered by fwd; do not hand-edit */
 /* === regcomp.c === */
 int compile(regex_t *, const chr *, size_t, int);
+int compileset(regex_t *, int, const chr *const *, const size_t *, int);
+void freedfas(regex_t *);
+static int compilearms(regex_t *, int, const chr *const *, const size_t *, int, int);
+static void parsearms(struct vars *, int, const chr *const *, const size_t *, int);
 static void moresubs(struct vars *, int);
 static int freev(struct vars *, int);
 static void makesearch(struct vars *, struct nfa *);
+static void findliteral(struct nfa *, struct guts *);
+static size_t literalchain(struct nfa *, struct state *, chr *);
+static int dominates(struct nfa *, struct state *, struct state **);
 static struct subre *parse(struct vars *, int, int, struct state *, struct state *);
 static struct subre *parsebranch(struct vars *, int, int, struct state *, struct state *, int);
 static void parseqatom(struct vars *, int, int, struct state *, struct state *, struct subre *);
@@ -97,6 +104,7 @@ static color newcolor(struct colormap *);
 static void freecolor(struct colormap *, pcolor);
 static color pseudocolor(struct colormap *);
 static color subcolor(struct colormap *, pchr c);
+static int singlechr(struct colormap *, pcolor, chr *);
 static color newsub(struct colormap *, pcolor);
 static void subrange(struct vars *, pchr, pchr, struct state *, struct state *);
 static void subblock(struct vars *, pchr, struct state *, struct state *);
@@ -268,9 +276,50 @@ compile(
     const chr *string,
     size_t len,
     int flags)
+{
+    return compilearms(re, 1, &string, &len, flags, 0);
+}
+
+/*
+ - compileset - compile a set of REs ("arms") to be matched together
+ * The result can only be used with execset(), which reports the first arm
+ * that matches anywhere in the subject; there is no subexpression tree, so
+ * it says nothing about where the match is. Arms with backreferences are
+ * accepted, but execset() refuses to run a set containing them (the search
+ * NFA only approximates backreferences).
+ ^ int compileset(regex_t *, int, const chr *const *, const size_t *, int);
+ */
+int
+compileset(
+    regex_t *re,
+    int narms,
+    const chr *const *strings,
+    const size_t *lens,
+    int flags)
+{
+    if (narms < 1 || strings == NULL || lens == NULL) {
+	return REG_INVARG;
+    }
+    return compilearms(re, narms, strings, lens, flags, 1);
+}
+
+/*
+ - compilearms - guts of compile() and compileset()
+ ^ static int compilearms(regex_t *, int, const chr *const *,
+ ^ 	const size_t *, int, int);
+ */
+static int
+compilearms(
+    regex_t *re,
+    int narms,
+    const chr *const *strings,
+    const size_t *lens,
+    int flags,
+    int isset)			/* compiling a set, for compileset()? */
 {
     AllocVars(v);
     struct guts *g;
+    struct state *s;
     int i;
     size_t j;
     FILE *debug = (flags&REG_PROGRESS) ? stdout : NULL;
@@ -280,10 +329,16 @@ compile(
      * Sanity checks.
      */
 
-    if (re == NULL || string == NULL) {
+    if (re == NULL) {
 	FreeVars(v);
 	return REG_INVARG;
     }
+    for (i = 0; i < narms; i++) {
+	if (strings[i] == NULL) {
+	    FreeVars(v);
+	    return REG_INVARG;
+	}
+    }
     if ((flags&REG_QUOTE) && (flags&(REG_ADVANCED|REG_EXPANDED|REG_NEWLINE))) {
 	FreeVars(v);
 	return REG_INVARG;
@@ -298,8 +353,8 @@ compile(
      */
 
     v->re = re;
-    v->now = string;
-    v->stop = v->now + len;
+    v->now = strings[0];
+    v->stop = v->now + lens[0];
     v->savenow = v->savestop = NULL;
     v->err = 0;
     v->cflags = flags;
@@ -316,6 +371,7 @@ compile(
     v->tree = NULL;
     v->treechain = NULL;
     v->treefree = NULL;
+    v->ntree = 0;
     v->cv = NULL;
     v->cv2 = NULL;
     v->lacons = NULL;
@@ -340,6 +396,16 @@ compile(
     v->cm = &g->cmap;
     g->lacons = NULL;
     g->nlacons = 0;
+    g->nliteral = 0;
+    g->literalprefix = 0;
+    for (i = 0; i < NDFACACHE; i++) {
+	g->dfacache[i] = NULL;
+	g->dfanogrow[i] = 0;
+    }
+    g->freedfa = NULL;
+    g->dfakept = 0;
+    g->narms = 0;
+    g->armends = NULL;
     ZAPCNFA(g->search);
     v->nfa = newnfa(v, v->cm, NULL);
     CNOERR();
@@ -352,6 +418,17 @@ compile(
      * Parsing.
      */
 
+    if (isset) {
+	parsearms(v, narms, strings, lens, flags);
+	CNOERR();
+	specialcolors(v->nfa);
+	CNOERR();
+	if (debug != NULL) {
+	    fprintf(debug, "\n\n\n========= RAW ==========\n");
+	    dumpnfa(v->nfa, debug);
+	}
+	goto search;
+    }
     lexstart(v);		/* also handles prefixes */
     if ((v->cflags&REG_NLSTOP) || (v->cflags&REG_NLANCH)) {
 	/*
@@ -393,6 +470,11 @@ compile(
 
     re->re_info |= nfatree(v, v->tree, debug);
     CNOERR();
+    if (v->tree->flags&SHORTER) {
+	NOTE(REG_USHORTEST);
+    }
+
+  search:
     assert(v->nlacons == 0 || v->lacons != NULL);
     for (i = 1; i < v->nlacons; i++) {
 	if (debug != NULL) {
@@ -401,9 +483,6 @@ compile(
 	nfanode(v, &v->lacons[i], debug);
     }
     CNOERR();
-    if (v->tree->flags&SHORTER) {
-	NOTE(REG_USHORTEST);
-    }
 
     /*
      * Build compacted NFAs for tree, lacons, fast search.
@@ -414,24 +493,50 @@ compile(
     }
 
     /*
-     * Can sacrifice main NFA now, so use it as work area.
+     * Can sacrifice main NFA now, so use it as work area. A set has no tree
+     * to analyze, so the search NFA tells whether it can match at all.
      */
 
-    (DISCARD) optimize(v->nfa, debug);
+    if (isset) {
+	re->re_info |= optimize(v->nfa, debug) & REG_UIMPOSSIBLE;
+    } else {
+	(DISCARD) optimize(v->nfa, debug);
+    }
     CNOERR();
+    findliteral(v->nfa, g);
     makesearch(v, v->nfa);
     CNOERR();
     compact(v->nfa, &g->search);
     CNOERR();
 
+    /*
+     * The end states of the arms are the flagged states after pre and post,
+     * in the order parsearms() made them.
+     */
+
+    if (isset) {
+	g->armends = (int *) MALLOC(narms * sizeof(int));
+	if (g->armends == NULL) {
+	    return freev(v, REG_ESPACE);
+	}
+	g->narms = 0;
+	for (s = v->nfa->states; s != NULL; s = s->next) {
+	    if (s->flag && s != v->nfa->pre && s != v->nfa->post) {
+		assert(g->narms < narms);
+		g->armends[g->narms++] = s->no;
+	    }
+	}
+	assert(g->narms == narms);
+    }
+
     /*
      * Looks okay, package it up.
      */
 
-    re->re_nsub = v->nsubexp;
+    re->re_nsub = isset ? 0 : v->nsubexp;
     v->re = NULL;		/* freev no longer frees re */
     g->magic = GUTSMAGIC;
-    g->cflags = v->cflags;
+    g->cflags = isset ? flags : v->cflags;
     g->info = re->re_info;
     g->nsub = re->re_nsub;
     g->tree = v->tree;
@@ -450,6 +555,66 @@ compile(
     return freev(v, 0);
 }
 
+/*
+ - parsearms - parse the arms of a set into the NFA
+ * Each arm gets its own final state, and its own flagged end state in place
+ * of post, so that a state set of the search DFA shows which arms have
+ * matched. Those end states reach post only through an arc of a pseudocolor
+ * that never appears in a subject, which keeps them and their arms alive
+ * through cleanup(). Each arm is parsed with the original flags, so options
+ * embedded in one arm do not leak into the next.
+ ^ static void parsearms(struct vars *, int, const chr *const *,
+ ^ 	const size_t *, int);
+ */
+static void
+parsearms(
+    struct vars *v,
+    int narms,
+    const chr *const *strings,
+    const size_t *lens,
+    int flags)
+{
+    struct nfa *nfa = v->nfa;
+    struct state *final, *end;
+    struct subre *tree;
+    color tag;
+    size_t j;
+    int i;
+
+    tag = pseudocolor(v->cm);
+    NOERR();
+    for (i = 0; i < narms; i++) {
+	v->now = strings[i];
+	v->stop = v->now + lens[i];
+	v->cflags = flags;
+	v->nsubexp = 0;
+	for (j = 0; j < v->nsubs; j++) {
+	    v->subs[j] = NULL;
+	}
+	lexstart(v);		/* also handles prefixes */
+	if (((v->cflags&REG_NLSTOP) || (v->cflags&REG_NLANCH))
+		&& v->nlcolor == COLORLESS) {
+	    v->nlcolor = subcolor(v->cm, newline());
+	    okcolors(nfa, v->cm);
+	}
+	NOERR();
+
+	final = newstate(nfa);
+	end = newfstate(nfa, '@');
+	NOERR();
+	rainbow(nfa, v->cm, PLAIN, COLORLESS, final, end);
+	newarc(nfa, '$', 1, final, end);
+	newarc(nfa, '$', 0, final, end);
+	newarc(nfa, PLAIN, tag, end, nfa->post);
+	NOERR();
+
+	tree = parse(v, EOS, PLAIN, nfa->init, final);
+	assert(SEE(EOS));	/* even if error; ISERR() => SEE(EOS) */
+	NOERR();
+	freesubre(v, tree);
+    }
+}
+
 /*
  - moresubs - enlarge subRE vector
  ^ static void moresubs(struct vars *, int);
@@ -529,6 +694,153 @@ freev(
     return ret;
 }
 
+/*
+ - findliteral - find a literal string that every match must contain
+ * Looks for a chain of states, each with a single out-arc of a color that
+ * stands for exactly one chr, beginning at a state that every path from pre
+ * to post passes through. Each visit to that state must then be followed by
+ * the chain's chrs, so every match contains them. If the chain begins where
+ * every match begins, the literal is also a prefix of every match. The
+ * executor uses the literal to reject subjects that lack it without running
+ * the DFA, and a prefix to skip ahead to the first place a match can start.
+ * The NFA accepts a superset of the language (backreferences are treated as
+ * arbitrary strings), so this is conservative. NFA must have been
+ * optimize()d already.
+ ^ static void findliteral(struct nfa *, struct guts *);
+ */
+static void
+findliteral(
+    struct nfa *nfa,
+    struct guts *g)
+{
+    struct arc *a;
+    struct state *s, *start;
+    struct state **stack;
+    chr chain[REG_MAX_LITERAL];
+    size_t n, i;
+    int nstates;
+
+    /*
+     * A literal prefix starts at the state that all of pre's arcs (which
+     * consume the context before the match) lead to.
+     */
+
+    start = NULL;
+    for (a = nfa->pre->outs; a != NULL; a = a->outchain) {
+	if (a->type != PLAIN || (start != NULL && a->to != start)) {
+	    start = NULL;
+	    break;
+	}
+	start = a->to;
+    }
+    if (start != NULL) {
+	g->nliteral = literalchain(nfa, start, g->literal);
+	g->literalprefix = (g->nliteral > 0);
+    }
+
+    /*
+     * Otherwise, look for the longest chain starting at a state that
+     * dominates post.
+     */
+
+    if (g->nliteral == 0) {
+	nstates = 0;
+	for (s = nfa->states; s != NULL; s = s->next) {
+	    nstates++;
+	}
+	if (nstates > REG_MAX_LITERAL_STATES) {
+	    return;
+	}
+	stack = (struct state **) MALLOC(nstates * sizeof(struct state *));
+	if (stack == NULL) {
+	    return;
+	}
+	for (s = nfa->states; s != NULL; s = s->next) {
+	    if (s == nfa->pre || s == nfa->post) {
+		continue;
+	    }
+	    n = literalchain(nfa, s, chain);
+	    if (n > g->nliteral && dominates(nfa, s, stack)) {
+		memcpy(VS(g->literal), VS(chain), n * sizeof(chr));
+		g->nliteral = n;
+	    }
+	}
+	FREE(stack);
+    }
+
+    /*
+     * Horspool shift table, indexed by the low byte of a chr. Chrs that
+     * share a low byte take the smallest shift of any of them.
+     */
+
+    if (g->nliteral > 0) {
+	for (i = 0; i < 256; i++) {
+	    g->literalskip[i] = (unsigned char) g->nliteral;
+	}
+	for (i = 0; i + 1 < g->nliteral; i++) {
+	    g->literalskip[g->literal[i] & 0xff] =
+		    (unsigned char) (g->nliteral - 1 - i);
+	}
+    }
+}
+
+/*
+ - literalchain - collect the chrs of a chain of single-chr arcs
+ ^ static size_t literalchain(struct nfa *, struct state *, chr *);
+ */
+static size_t			/* number of chrs collected */
+literalchain(
+    struct nfa *nfa,
+    struct state *s,		/* first state of the chain */
+    chr *chain)			/* REG_MAX_LITERAL chrs of space */
+{
+    size_t n = 0;
+
+    while (n < REG_MAX_LITERAL && s != nfa->post && s->nouts == 1
+	    && s->outs->type == PLAIN
+	    && singlechr(nfa->cm, s->outs->co, &chain[n])) {
+	n++;
+	s = s->outs->to;
+    }
+    return n;
+}
+
+/*
+ - dominates - does every path from pre to post pass through a state?
+ * Uses the states' tmp fields, and leaves them NULL.
+ ^ static int dominates(struct nfa *, struct state *, struct state **);
+ */
+static int
+dominates(
+    struct nfa *nfa,
+    struct state *s,		/* the state to avoid */
+    struct state **stack)	/* room for every state of the NFA */
+{
+    struct state *t;
+    struct arc *a;
+    int depth = 0, reached = 0;
+
+    nfa->pre->tmp = nfa->pre;
+    stack[depth++] = nfa->pre;
+    while (depth > 0 && !reached) {
+	t = stack[--depth];
+	for (a = t->outs; a != NULL; a = a->outchain) {
+	    if (a->to == nfa->post) {
+		reached = 1;
+		break;
+	    }
+	    if (a->to != s && a->to->tmp == NULL) {
+		a->to->tmp = a->to;
+		stack[depth++] = a->to;
+	    }
+	}
+    }
+    for (t = nfa->states; t != NULL; t = t->next) {
+	t->tmp = NULL;
+    }
+    return !reached;
+}
+
 /*
  - makesearch - turn an NFA into a search NFA (implicit prepend of .*?)
  * NFA must have been optimize()d already.
@@ -1970,6 +2282,31 @@ freelacons(
     FREE(subs);
 }
 
+/*
+ - freedfas - free the DFAs an RE keeps between execs
+ * The next exec builds its DFAs afresh. Ignores REs that are not valid.
+ ^ void freedfas(regex_t *);
+ */
+void
+freedfas(
+    regex_t *re)
+{
+    struct guts *g;
+    int i;
+
+    if (re == NULL || re->re_magic != REMAGIC) {
+	return;
+    }
+    g = (struct guts *) re->re_guts;
+    for (i = 0; i < NDFACACHE; i++) {
+	if (g->dfacache[i] != NULL) {
+	    (*g->freedfa)(g->dfacache[i]);
+	    g->dfacache[i] = NULL;
+	}
+    }
+    g->dfakept = 0;
+}
+
 /*
  - rfree - free a whole RE (insides of regfree)
  ^ static void rfree(regex_t *);
@@ -1979,6 +2316,7 @@ rfree(
     regex_t *re)
 {
     struct guts *g;
+    int i;
 
     if (re == NULL || re->re_magic != REMAGIC) {
 	return;
@@ -1989,6 +2327,11 @@ rfree(
     re->re_guts = NULL;
     re->re_fns = NULL;
     g->magic = 0;
+    for (i = 0; i < NDFACACHE; i++) {
+	if (g->dfacache[i] != NULL) {
+	    (*g->freedfa)(g->dfacache[i]);
+	}
+    }
     freecm(&g->cmap);
     if (g->tree != NULL) {
 	freesubre(NULL, g->tree);
@@ -1999,6 +2342,9 @@ rfree(
     if (!NULLCNFA(g->search)) {
 	freecnfa(&g->search);
     }
+    if (g->armends != NULL) {
+	FREE(g->armends);
+    }
     FREE(g);
 }
 
@@ -2044,7 +2390,9 @@ dump(
 	dumpcnfa(&g->lacons[i].cnfa, f);
     }
     fprintf(f, "\n");
-    dumpst(g->tree, f, 0);
+    if (g->tree != NULL) {
+	dumpst(g->tree, f, 0);
+    }
 #endif
 }
 
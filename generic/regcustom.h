@@ -122,6 +122,9 @@ typedef int celt;		/* Type to hold chr, or NOCELT */
 
 #define	compile		TclReComp
 #define	exec		TclReExec
+#define	compileset	TclReCompSet
+#define	execset		TclReExecSet
+#define	freedfas	TclReFreeDfas
 
 /*
 & Enable/disable debugging code (by whether REG_DEBUG is defined or not).
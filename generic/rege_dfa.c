@@ -32,21 +32,21 @@
 
 /*
  - longest - longest-preferred matching engine
- ^ static chr *longest(struct vars *, struct dfa *, chr *, chr *, int *);
+ ^ static schr *longest(struct vars *, struct dfa *, schr *, schr *, int *);
  */
-static chr *			/* endpoint, or NULL */
+static schr *			/* endpoint, or NULL */
 longest(
     struct vars *const v,	/* used only for debug and exec flags */
     struct dfa *const d,
-    chr *const start,		/* where the match should start */
-    chr *const stop,		/* match must end at or before here */
+    schr *const start,		/* where the match should start */
+    schr *const stop,		/* match must end at or before here */
     int *const hitstopp)	/* record whether hit v->stop, if non-NULL */
 {
-    chr *cp;
-    chr *realstop = (stop == v->stop) ? stop : stop + 1;
+    schr *cp;
+    schr *realstop = (stop == v->stop) ? stop : stop + 1;
     color co;
     struct sset *css, *ss;
-    chr *post;
+    schr *post;
     int i;
     struct colormap *cm = d->cm;
 
@@ -158,22 +158,22 @@ longest(
 
 /*
  - shortest - shortest-preferred matching engine
- ^ static chr *shortest(struct vars *, struct dfa *, chr *, chr *, chr *,
- ^ 	chr **, int *);
+ ^ static schr *shortest(struct vars *, struct dfa *, schr *, schr *, schr *,
+ ^ 	schr **, int *);
  */
-static chr *			/* endpoint, or NULL */
+static schr *			/* endpoint, or NULL */
 shortest(
     struct vars *const v,
     struct dfa *const d,
-    chr *const start,		/* where the match should start */
-    chr *const min,		/* match must end at or after here */
-    chr *const max,		/* match must end at or before here */
-    chr **const coldp,		/* store coldstart pointer here, if nonNULL */
+    schr *const start,		/* where the match should start */
+    schr *const min,		/* match must end at or after here */
+    schr *const max,		/* match must end at or before here */
+    schr **const coldp,		/* store coldstart pointer here, if nonNULL */
     int *const hitstopp)	/* record whether hit v->stop, if non-NULL */
 {
-    chr *cp;
-    chr *realmin = (min == v->stop) ? min : min + 1;
-    chr *realmax = (max == v->stop) ? max : max + 1;
+    schr *cp;
+    schr *realmin = (min == v->stop) ? min : min + 1;
+    schr *realmax = (max == v->stop) ? max : max + 1;
     color co;
     struct sset *css, *ss;
     struct colormap *cm = d->cm;
@@ -283,15 +283,15 @@ shortest(
 
 /*
  - lastCold - determine last point at which no progress had been made
- ^ static chr *lastCold(struct vars *, struct dfa *);
+ ^ static schr *lastCold(struct vars *, struct dfa *);
  */
-static chr *			/* endpoint, or NULL */
+static schr *			/* endpoint, or NULL */
 lastCold(
     struct vars *const v,
     struct dfa *const d)
 {
     struct sset *ss;
-    chr *nopr = d->lastnopr;
+    schr *nopr = d->lastnopr;
     int i;
 
     if (nopr == NULL) {
@@ -305,6 +305,100 @@ lastCold(
     return nopr;
 }
 
+/*
+ - firstArm - find the first arm of a set that matches anywhere
+ * Like shortest() run over the whole subject, except that there is no post
+ * state to stop at: instead it watches the state sets it passes through for
+ * the end states of the arms, and stops early only once arm 0 has matched.
+ ^ static int firstArm(struct vars *, struct dfa *, schr *);
+ */
+static int			/* arm number, narms if none matched */
+firstArm(
+    struct vars *const v,
+    struct dfa *const d,
+    schr *const start)		/* where the search should start */
+{
+    schr *cp;
+    color co;
+    struct sset *css, *ss;
+    struct colormap *cm = d->cm;
+    int best;
+#define	ARMOF(ss)	(((ss)->arm == ARMUNKNOWN) ? setArm(v, ss) : (ss)->arm)
+
+    /*
+     * Initialize and start up.
+     */
+
+    css = initialize(v, d, start);
+    cp = start;
+    if (cp == v->start) {
+	co = d->cnfa->bos[(v->eflags&REG_NOTBOL) ? 0 : 1];
+    } else {
+	co = GETCOLOR(cm, *(cp - 1));
+    }
+    css = miss(v, d, css, co, cp, start);
+    if (css == NULL) {
+	return v->g->narms;
+    }
+    css->lastseen = cp;
+    best = ARMOF(css);
+
+    /*
+     * Main loop.
+     */
+
+    while (cp < v->stop && best > 0) {
+	co = GETCOLOR(cm, *cp);
+	ss = css->outs[co];
+	if (ss == NULL) {
+	    ss = miss(v, d, css, co, cp+1, start);
+	    if (ss == NULL) {
+		return best;	/* no arm can match from here on */
+	    }
+	}
+	cp++;
+	ss->lastseen = cp;
+	css = ss;
+	if (ARMOF(css) < best) {
+	    best = css->arm;
+	}
+    }
+
+    /*
+     * An arm might have ended at the end of the subject.
+     */
+
+    if (cp == v->stop && best > 0) {
+	co = d->cnfa->eos[(v->eflags&REG_NOTEOL) ? 0 : 1];
+	ss = miss(v, d, css, co, cp, start);
+	if (ss != NULL && ARMOF(ss) < best) {
+	    best = ss->arm;
+	}
+    }
+    return best;
+#undef	ARMOF
+}
+
+/*
+ - setArm - work out the first arm of a set whose end is in a state set
+ ^ static int setArm(struct vars *, struct sset *);
+ */
+static int			/* arm number, narms if none */
+setArm(
+    struct vars *const v,
+    struct sset *const ss)
+{
+    int i;
+
+    for (i = 0; i < v->g->narms; i++) {
+	if (ISBSET(ss->states, v->g->armends[i])) {
+	    break;
+	}
+    }
+    ss->arm = i;
+    return i;
+}
+
 /*
  - newDFA - set up a fresh DFA
  ^ static struct dfa *newDFA(struct vars *, struct cnfa *,
@@ -320,6 +414,7 @@ newDFA(
     struct dfa *d;
     size_t nss = cnfa->nstates * 2;
     int wordsper = (cnfa->nstates + UBITS - 1) / UBITS;
+    int i;
     struct smalldfa *smallwas = sml;
 
     assert(cnfa != NULL && cnfa->nstates != 0);
@@ -335,6 +430,7 @@ newDFA(
 	}
 	d = &sml->dfa;
 	d->ssets = sml->ssets;
+	d->buckets = sml->buckets;
 	d->statesarea = sml->statesarea;
 	d->work = &d->statesarea[nss];
 	d->outsarea = sml->outsarea;
@@ -347,7 +443,20 @@ newDFA(
 	    ERR(REG_ESPACE);
 	    return NULL;
 	}
+
+	/*
+	 * Big NFAs (such as sets of many REs) start with a cache that fits in
+	 * the memory budget, so that it can be kept between execs, and leave
+	 * it to growDFA() to make more room if they turn out to need it.
+	 */
+
+	d->wordsper = wordsper;
+	d->ncolors = cnfa->ncolors;
+	while (nss > FEWSTATES && DFASIZE(d, nss) > v->dfabudget) {
+	    nss /= 2;
+	}
 	d->ssets = (struct sset *) MALLOC(nss * sizeof(struct sset));
+	d->buckets = (struct sset **) MALLOC(nss * sizeof(struct sset *));
 	d->statesarea = (unsigned *)
 		MALLOC((nss+WORK) * wordsper * sizeof(unsigned));
 	d->work = &d->statesarea[nss * wordsper];
@@ -357,7 +466,7 @@ newDFA(
 		MALLOC(nss * cnfa->ncolors * sizeof(struct arcp));
 	d->cptsmalloced = 1;
 	d->mallocarea = (char *)d;
-	if (d->ssets == NULL || d->statesarea == NULL ||
+	if (d->ssets == NULL || d->buckets == NULL || d->statesarea == NULL ||
 		d->outsarea == NULL || d->incarea == NULL) {
 	    freeDFA(d);
 	    ERR(REG_ESPACE);
@@ -365,7 +474,7 @@ newDFA(
 	}
     }
 
-    d->nssets = (v->eflags&REG_SMALL) ? 7 : nss;
+    d->nssets = ((v->eflags&REG_SMALL) && nss > 7) ? 7 : nss;
     d->nssused = 0;
     d->nstates = cnfa->nstates;
     d->ncolors = cnfa->ncolors;
@@ -375,6 +484,12 @@ newDFA(
     d->lastpost = NULL;
     d->lastnopr = NULL;
     d->search = d->ssets;
+    d->nogrow = 0;
+    d->flushes = 0;
+    setHashMask(d);
+    for (i = 0; i < d->nssets; i++) {
+	d->buckets[i] = NULL;
+    }
 
     /*
      * Initialization of sset fields is done as needed.
@@ -395,6 +510,9 @@ freeDFA(
 	if (d->ssets != NULL) {
 	    FREE(d->ssets);
 	}
+	if (d->buckets != NULL) {
+	    FREE(d->buckets);
+	}
 	if (d->statesarea != NULL) {
 	    FREE(d->statesarea);
 	}
@@ -430,16 +548,49 @@ hash(
     }
     return h;
 }
+
+/*
+ - bucket - pick the hash chain for a hash code
+ * The hash codes of state sets often differ only in a few high bits, so mix
+ * every bit into the low ones that the mask keeps.
+ ^ static int bucket(struct dfa *, unsigned);
+ */
+static int
+bucket(
+    struct dfa *const d,
+    unsigned h)
+{
+    h = (h ^ (h >> 16)) * 0x45d9f3b;
+    h ^= h >> 16;
+    return (int) (h & d->hashmask);
+}
+
+/*
+ - setHashMask - use as many hash chains as the largest power of 2 that
+ * does not exceed the cache size, so that picking one needs no division
+ ^ static void setHashMask(struct dfa *);
+ */
+static void
+setHashMask(
+    struct dfa *const d)
+{
+    unsigned n = 1;
+
+    while (n <= (unsigned) d->nssets / 2) {
+	n *= 2;
+    }
+    d->hashmask = n - 1;
+}
 
 /*
  - initialize - hand-craft a cache entry for startup, otherwise get ready
- ^ static struct sset *initialize(struct vars *, struct dfa *, chr *);
+ ^ static struct sset *initialize(struct vars *, struct dfa *, schr *);
  */
 static struct sset *
 initialize(
     struct vars *const v,	/* used only for debug flags */
     struct dfa *const d,
-    chr *const start)
+    schr *const start)
 {
     struct sset *ss;
     int i;
@@ -459,6 +610,7 @@ initialize(
 	ss->hash = HASH(ss->states, d->wordsper);
 	assert(d->cnfa->pre != d->cnfa->post);
 	ss->flags = STARTER|LOCKED|NOPROGRESS;
+	hashSS(d, ss);
 
 	/*
 	 * lastseen dealt with below
@@ -477,16 +629,16 @@ initialize(
 /*
  - miss - handle a cache miss
  ^ static struct sset *miss(struct vars *, struct dfa *, struct sset *,
- ^ 	pcolor, chr *, chr *);
+ ^ 	pcolor, schr *, schr *);
  */
 static struct sset *		/* NULL if goes to empty set */
 miss(
     struct vars *const v,	/* used only for debug flags */
     struct dfa *const d,
-    struct sset *const css,
+    struct sset *css,
     const pcolor co,
-    chr *const cp,		/* next chr */
-    chr *const start)		/* where the attempt got started */
+    schr *const cp,		/* next schr */
+    schr *const start)		/* where the attempt got started */
 {
     struct cnfa *cnfa = d->cnfa;
     unsigned h;
@@ -570,14 +722,16 @@ miss(
      * Next, is that in the cache?
      */
 
-    for (p = d->ssets, i = d->nssused; i > 0; p++, i--) {
+    for (p = d->buckets[bucket(d, h)]; p != NULL; p = p->hashnext) {
 	 if (HIT(h, d->work, p, d->wordsper)) {
 	     FDEBUG(("cached c%d\n", p - d->ssets));
 	     break;			/* NOTE BREAK OUT */
 	 }
     }
-    if (i == 0) {		/* nope, need a new cache entry */
+    if (p == NULL) {		/* nope, need a new cache entry */
+	i = css - d->ssets;
 	p = getVacantSS(v, d, cp, start);
+	css = &d->ssets[i];	/* the cache may have grown and moved */
 	assert(p != css);
 	for (i = 0; i < d->wordsper; i++) {
 	    p->states[i] = d->work[i];
@@ -587,6 +741,7 @@ miss(
 	if (noProgress) {
 	    p->flags |= NOPROGRESS;
 	}
+	hashSS(d, p);
 
 	/*
 	 * lastseen to be dealt with by caller
@@ -605,20 +760,20 @@ miss(
 
 /*
  - checkLAConstraint - lookahead-constraint checker for miss()
- ^ static int checkLAConstraint(struct vars *, struct cnfa *, chr *, pcolor);
+ ^ static int checkLAConstraint(struct vars *, struct cnfa *, schr *, pcolor);
  */
 static int			/* predicate:  constraint satisfied? */
 checkLAConstraint(
     struct vars *const v,
     struct cnfa *const pcnfa,	/* parent cnfa */
-    chr *const cp,
+    schr *const cp,
     const pcolor co)		/* "color" of the lookahead constraint */
 {
     int n;
     struct subre *sub;
     struct dfa *d;
     struct smalldfa sd;
-    chr *end;
+    schr *end;
 
     n = co - pcnfa->ncolors;
     assert(n < v->g->nlacons && v->g->lacons != NULL);
@@ -638,15 +793,16 @@ checkLAConstraint(
 /*
  - getVacantSS - get a vacant state set
  * This routine clears out the inarcs and outarcs, but does not otherwise
- * clear the innards of the state set -- that's up to the caller.
- ^ static struct sset *getVacantSS(struct vars *, struct dfa *, chr *, chr *);
+ * clear the innards of the state set -- that's up to the caller. It may
+ * grow the cache, which moves every state set; see growDFA.
+ ^ static struct sset *getVacantSS(struct vars *, struct dfa *, schr *, schr *);
  */
 static struct sset *
 getVacantSS(
     struct vars *const v,	/* used only for debug flags */
     struct dfa *const d,
-    chr *const cp,
-    chr *const start)
+    schr *const cp,
+    schr *const start)
 {
     int i;
     struct sset *ss, *p;
@@ -656,6 +812,18 @@ getVacantSS(
     ss = pickNextSS(v, d, cp, start);
     assert(!(ss->flags&LOCKED));
 
+    /*
+     * Take it off its hash chain.
+     */
+
+    if (ss->flags&HASHED) {
+	*ss->hashprevp = ss->hashnext;
+	if (ss->hashnext != NULL) {
+	    ss->hashnext->hashprevp = ss->hashprevp;
+	}
+	ss->flags &= ~HASHED;
+    }
+
     /*
      * Clear out its inarcs, including self-referential ones.
      */
@@ -714,29 +882,30 @@ getVacantSS(
 	d->lastnopr = ss->lastseen;
     }
 
+    ss->arm = ARMUNKNOWN;
     return ss;
 }
 
 /*
  - pickNextSS - pick the next stateset to be used
- ^ static struct sset *pickNextSS(struct vars *, struct dfa *, chr *, chr *);
+ ^ static struct sset *pickNextSS(struct vars *, struct dfa *, schr *, schr *);
  */
 static struct sset *
 pickNextSS(
-    struct vars *const v,	/* used only for debug flags */
+    struct vars *const v,	/* for flags, budget and statistics */
     struct dfa *const d,
-    chr *const cp,
-    chr *const start)
+    schr *const cp,
+    schr *const start)
 {
     int i;
     struct sset *ss, *end;
-    chr *ancient;
+    schr *ancient;
 
     /*
-     * Shortcut for cases where cache isn't full.
+     * Shortcut for cases where cache isn't full, or can be made bigger.
      */
 
-    if (d->nssused < d->nssets) {
+    if (d->nssused < d->nssets || growDFA(v, d)) {
 	i = d->nssused;
 	d->nssused++;
 	ss = &d->ssets[i];
@@ -763,6 +932,8 @@ pickNextSS(
      * Look for oldest, or old enough anyway.
      */
 
+    v->dfaflushes++;
+    d->flushes++;
     if (cp - start > d->nssets*2/3) {	/* oldest 33% are expendable */
 	ancient = cp - d->nssets*2/3;
     } else {
@@ -794,6 +965,135 @@ pickNextSS(
     ERR(REG_ASSERT);
     return d->ssets;
 }
+
+/*
+ - growDFA - double the size of a full state-set cache, if within budget
+ * The state sets move to the new areas but keep their indexes, so pointers
+ * between them are easily redirected; callers holding a pointer to one must
+ * recompute it from its index. Failing to grow is not an error: the caller
+ * just goes on to flush an old state set as usual.
+ ^ static int growDFA(struct vars *, struct dfa *);
+ */
+static int			/* 1 if grown, 0 if not */
+growDFA(
+    struct vars *const v,
+    struct dfa *const d)
+{
+    int nss = d->nssets * 2;
+    int i, j;
+    struct sset *ssets, *ss, *oss, **buckets;
+    unsigned *statesarea;
+    struct sset **outsarea;
+    struct arcp *incarea;
+
+    if ((v->eflags&REG_SMALL) || d->nogrow
+	    || DFASIZE(d, nss) > v->dfabudget) {
+	return 0;
+    }
+    ssets = (struct sset *) MALLOC(nss * sizeof(struct sset));
+    buckets = (struct sset **) MALLOC(nss * sizeof(struct sset *));
+    statesarea = (unsigned *)
+	    MALLOC((nss+WORK) * d->wordsper * sizeof(unsigned));
+    outsarea = (struct sset **)
+	    MALLOC(nss * d->ncolors * sizeof(struct sset *));
+    incarea = (struct arcp *) MALLOC(nss * d->ncolors * sizeof(struct arcp));
+    if (ssets == NULL || buckets == NULL || statesarea == NULL
+	    || outsarea == NULL || incarea == NULL) {
+	if (ssets != NULL) {
+	    FREE(ssets);
+	}
+	if (buckets != NULL) {
+	    FREE(buckets);
+	}
+	if (statesarea != NULL) {
+	    FREE(statesarea);
+	}
+	if (outsarea != NULL) {
+	    FREE(outsarea);
+	}
+	if (incarea != NULL) {
+	    FREE(incarea);
+	}
+	return 0;
+    }
+    FDEBUG(("growing cache to %d\n", nss));
+
+#define	MOVED(p)	(((p) == NULL) ? NULL : &ssets[(p) - d->ssets])
+    memcpy(VS(statesarea), VS(d->statesarea),
+	    d->nssused * d->wordsper * sizeof(unsigned));
+    memcpy(VS(&statesarea[nss * d->wordsper]), VS(d->work),
+	    WORK * d->wordsper * sizeof(unsigned));
+    for (i = 0; i < d->nssused; i++) {
+	ss = &ssets[i];
+	oss = &d->ssets[i];
+	*ss = *oss;
+	ss->states = &statesarea[i * d->wordsper];
+	ss->ins.ss = MOVED(oss->ins.ss);
+	ss->outs = &outsarea[i * d->ncolors];
+	ss->inchain = &incarea[i * d->ncolors];
+	for (j = 0; j < d->ncolors; j++) {
+	    ss->outs[j] = MOVED(oss->outs[j]);
+	    ss->inchain[j].ss = MOVED(oss->inchain[j].ss);
+	    ss->inchain[j].co = oss->inchain[j].co;
+	}
+    }
+    d->search = MOVED(d->search);
+#undef	MOVED
+
+    if (d->cptsmalloced) {
+	FREE(d->ssets);
+	FREE(d->buckets);
+	FREE(d->statesarea);
+	FREE(d->outsarea);
+	FREE(d->incarea);
+    }
+    d->ssets = ssets;
+    d->buckets = buckets;
+    d->statesarea = statesarea;
+    d->work = &statesarea[nss * d->wordsper];
+    d->outsarea = outsarea;
+    d->incarea = incarea;
+    d->cptsmalloced = 1;
+    d->nssets = nss;
+    setHashMask(d);
+
+    /*
+     * The number of hash chains has changed, so rebuild them.
+     */
+
+    for (i = 0; i < nss; i++) {
+	buckets[i] = NULL;
+    }
+    for (i = 0; i < d->nssused; i++) {
+	if (ssets[i].flags&HASHED) {
+	    ssets[i].flags &= ~HASHED;
+	    hashSS(d, &ssets[i]);
+	}
+    }
+    v->dfagrowths++;
+    return 1;
+}
+
+/*
+ - hashSS - put a state set, whose states and hash are set, on its hash chain
+ ^ static void hashSS(struct dfa *, struct sset *);
+ */
+static void
+hashSS(
+    struct dfa *const d,
+    struct sset *const ss)
+{
+    struct sset **chain = &d->buckets[bucket(d, ss->hash)];
+
+    assert(!(ss->flags&HASHED));
+    ss->hashnext = *chain;
+    if (*chain != NULL) {
+	(*chain)->hashprevp = &ss->hashnext;
+    }
+    ss->hashprevp = chain;
+    *chain = ss;
+    ss->flags |= HASHED;
+}
 
 /*
  * Local Variables:
@@ -192,8 +192,27 @@ typedef struct {
 /* supplementary control and reporting */
 typedef struct {
     regmatch_t rm_extend;	/* see REG_EXPECT */
+    size_t rm_dfabudget;	/* in: bytes a DFA's state cache may grow
+				 * to, 0 for REG_DFA_BUDGET */
+    long rm_dfagrowths;		/* out: times a state cache was grown */
+    long rm_dfaflushes;		/* out: state sets flushed from a full
+				 * cache */
+    size_t rm_dfakept;		/* out: bytes of DFAs the RE keeps for later
+				 * execs */
 } rm_detail_t;
 
+/*
+ * Default memory budget of one DFA state cache. A cache starts with room for
+ * twice as many state sets as its NFA has states, and doubles while that
+ * fits the budget instead of flushing state sets it may soon need again.
+ * The budget does not cover the DFAs that different REs keep between execs;
+ * callers holding many REs limit those with TclReFreeDfas.
+ */
+
+#ifndef REG_DFA_BUDGET
+#define	REG_DFA_BUDGET	(1024*1024)
+#endif
+
 /*
  * compilation
  ^ #ifndef __REG_NOCHAR
@@ -241,7 +260,7 @@ typedef struct {
  */
 #define	REG_NOTBOL	0001	/* BOS is not BOL */
 #define	REG_NOTEOL	0002	/* EOS is not EOL */
-#define	REG_STARTEND	0004	/* backward compatibility kludge */
+#define	REG_STARTEND	0004	/* search from pmatch[0].rm_so */
 #define	REG_FTRACE	0010	/* none of your business */
 #define	REG_MTRACE	0020	/* none of your business */
 #define	REG_SMALL	0040	/* none of your business */
@@ -314,6 +333,26 @@ MODULE_SCOPE size_t regerror(int, __REG_CONST regex_t *, char *, size_t);
 /* automatically gathered by fwd; do not hand-edit */
 /* =====^!^===== end forwards =====^!^===== */
 
+/*
+ * Executor for subjects made of bytes, each standing for the chr of the
+ * same value (see regexecb.c).
+ */
+MODULE_SCOPE int TclReExecBytes(regex_t *, __REG_CONST unsigned char *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
+
+/*
+ * Sets of REs compiled together, whose executors report the first of them
+ * that matches anywhere in the subject (see compileset in regcomp.c).
+ */
+MODULE_SCOPE int TclReCompSet(regex_t *, int, __REG_CONST Tcl_UniChar *const *, const size_t *, int);
+MODULE_SCOPE int TclReExecSet(regex_t *, __REG_CONST Tcl_UniChar *, size_t, rm_detail_t *, int *, int);
+MODULE_SCOPE int TclReExecSetBytes(regex_t *, __REG_CONST unsigned char *, size_t, rm_detail_t *, int *, int);
+
+/*
+ * Freeing the DFAs an RE keeps between execs, for callers that limit the
+ * memory all their REs keep (see freedfas in regcomp.c).
+ */
+MODULE_SCOPE void TclReFreeDfas(regex_t *);
+
 /*
  * more C++ voodoo
  */
@@ -30,6 +30,36 @@
 
 #include "regguts.h"
 
+/*
+ * The executor is compiled twice: here for subjects made of chrs, and by
+ * regexecb.c, which defines REG_BYTE_SUBJECT, for subjects made of bytes
+ * (byte arrays, and strings whose UTF-8 is all ASCII), which can then be
+ * matched without widening them to chrs first. A byte stands for the chr of
+ * the same value, so colors and match offsets mean the same in both.
+ */
+
+#ifdef REG_BYTE_SUBJECT
+typedef unsigned char schr;	/* a character of the subject */
+#undef	exec
+#define	exec	TclReExecBytes
+#undef	execset
+#define	execset	TclReExecSetBytes
+#else
+typedef chr schr;		/* a character of the subject */
+#endif
+
+/*
+ * Slots of the guts' dfacache used by this executor.
+ */
+
+#ifdef REG_BYTE_SUBJECT
+#define	SEARCHDFA	2	/* DFA of the search NFA */
+#define	MAINDFA		3	/* DFA of the main NFA */
+#else
+#define	SEARCHDFA	0
+#define	MAINDFA		1
+#endif
+
 /*
  * Lazy-DFA representation.
  */
@@ -50,8 +80,14 @@ struct sset {			/* state set */
 #define	POSTSTATE	02	/* includes the goal state */
 #define	LOCKED		04	/* locked in cache */
 #define	NOPROGRESS	010	/* zero-progress state set */
+#define	HASHED		020	/* on its hash chain */
+    struct sset *hashnext;	/* next on the chain for its hash */
+    struct sset **hashprevp;	/* the link that points here, when HASHED */
+    int arm;			/* first arm of a set ending here, narms if
+				 * none, ARMUNKNOWN if not yet looked at */
+#define	ARMUNKNOWN	(-1)
     struct arcp ins;		/* chain of inarcs pointing here */
-    chr *lastseen;		/* last entered on arrival here */
+    schr *lastseen;		/* last entered on arrival here */
     struct sset **outs;		/* outarc vector indexed by color */
     struct arcp *inchain;	/* chain-pointer vector for outarcs */
 };
@@ -63,21 +99,35 @@ struct dfa {
     int ncolors;		/* length of outarc and inchain vectors */
     int wordsper;		/* length of state-set bitvectors */
     struct sset *ssets;		/* state-set cache */
+    struct sset **buckets;	/* hash chains of ssets, hashmask+1 of them */
+    unsigned hashmask;		/* picks a chain, see setHashMask */
     unsigned *statesarea;	/* bitvector storage */
     unsigned *work;		/* pointer to work area within statesarea */
     struct sset **outsarea;	/* outarc-vector storage */
     struct arcp *incarea;	/* inchain storage */
     struct cnfa *cnfa;
     struct colormap *cm;
-    chr *lastpost;		/* location of last cache-flushed success */
-    chr *lastnopr;		/* location of last cache-flushed NOPROGRESS */
+    schr *lastpost;		/* location of last cache-flushed success */
+    schr *lastnopr;		/* location of last cache-flushed NOPROGRESS */
     struct sset *search;	/* replacement-search-pointer memory */
     int cptsmalloced;		/* were the areas individually malloced? */
     char *mallocarea;		/* self, or master malloced area, or NULL */
+    int nogrow;			/* never grow the cache (see putDFA) */
+    int flushes;		/* state sets flushed since getDFA */
 };
 
 #define	WORK	1		/* number of work bitvectors needed */
 
+/*
+ * Bytes taken by a malloced DFA with a cache of nss state sets.
+ */
+
+#define	DFASIZE(d, nss) \
+	(sizeof(struct dfa) + (size_t)(nss) * (sizeof(struct sset) \
+	+ sizeof(struct sset *) + (d)->wordsper * sizeof(unsigned) \
+	+ (d)->ncolors * (sizeof(struct sset *) + sizeof(struct arcp))) \
+	+ WORK * (d)->wordsper * sizeof(unsigned))
+
 /*
  * Setup for non-malloc allocation for small cases.
  */
@@ -87,6 +137,7 @@ struct dfa {
 struct smalldfa {
     struct dfa dfa;
     struct sset ssets[FEWSTATES*2];
+    struct sset *buckets[FEWSTATES*2];
     unsigned statesarea[FEWSTATES*2 + WORK];
     struct sset *outsarea[FEWSTATES*2 * FEWCOLORS];
     struct arcp incarea[FEWSTATES*2 * FEWCOLORS];
@@ -104,10 +155,14 @@ struct vars {
     size_t nmatch;
     regmatch_t *pmatch;
     rm_detail_t *details;
-    chr *start;			/* start of string */
-    chr *stop;			/* just past end of string */
+    schr *start;		/* start of string */
+    schr *stop;			/* just past end of string */
+    schr *search_start;		/* no match can start before this */
     int err;			/* error code if any (0 none) */
     regoff_t *mem;		/* memory vector for backtracking */
+    size_t dfabudget;		/* bytes a state cache may grow to */
+    long dfagrowths;		/* state caches grown, for details */
+    long dfaflushes;		/* state sets flushed, for details */
     struct smalldfa dfa1;
     struct smalldfa dfa2;
 };
@@ -125,46 +180,58 @@ struct vars {
 /* =====^!^===== begin forwards =====^!^===== */
 /* automatically gathered by fwd; do not hand-edit */
 /* === regexec.c === */
-int exec(regex_t *, const chr *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
+int exec(regex_t *, const schr *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
+int execset(regex_t *, const schr *, size_t, rm_detail_t *, int *, int);
+static schr *findLiteral(struct guts *const, schr *const, schr *const);
+static int compareSubject(struct vars *const, const schr *, const schr *, size_t);
+static struct dfa *getDFA(struct vars *const, const int, struct cnfa *const, struct smalldfa *);
+static void putDFA(struct vars *const, const int, struct dfa *const);
 static int simpleFind(struct vars *const, struct cnfa *const, struct colormap *const);
+static int setFind(struct vars *const, int *const);
 static int complicatedFind(struct vars *const, struct cnfa *const, struct colormap *const);
-static int complicatedFindLoop(struct vars *const, struct cnfa *const, struct colormap *const, struct dfa *const, struct dfa *const, chr **const);
+static int complicatedFindLoop(struct vars *const, struct cnfa *const, struct colormap *const, struct dfa *const, struct dfa *const, schr **const);
 static void zapSubexpressions(regmatch_t *const, const size_t);
 static void zapSubtree(struct vars *const, struct subre *const);
-static void subset(struct vars *const, struct subre *const, chr *const, chr *const);
-static int dissect(struct vars *const, struct subre *, chr *const, chr *const);
-static int concatenationDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int alternationDissect(struct vars *const, struct subre *, chr *const, chr *const);
-static inline int complicatedDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int complicatedCapturingDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int complicatedConcatenationDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int complicatedReversedDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int complicatedBackrefDissect(struct vars *const, struct subre *const, chr *const, chr *const);
-static int complicatedAlternationDissect(struct vars *const, struct subre *, chr *const, chr *const);
+static void subset(struct vars *const, struct subre *const, schr *const, schr *const);
+static int dissect(struct vars *const, struct subre *, schr *const, schr *const);
+static int concatenationDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int alternationDissect(struct vars *const, struct subre *, schr *const, schr *const);
+static inline int complicatedDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int complicatedCapturingDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int complicatedConcatenationDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int complicatedReversedDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int complicatedBackrefDissect(struct vars *const, struct subre *const, schr *const, schr *const);
+static int complicatedAlternationDissect(struct vars *const, struct subre *, schr *const, schr *const);
 /* === rege_dfa.c === */
-static chr *longest(struct vars *const, struct dfa *const, chr *const, chr *const, int *const);
-static chr *shortest(struct vars *const, struct dfa *const, chr *const, chr *const, chr *const, chr **const, int *const);
-static chr *lastCold(struct vars *const, struct dfa *const);
+static schr *longest(struct vars *const, struct dfa *const, schr *const, schr *const, int *const);
+static schr *shortest(struct vars *const, struct dfa *const, schr *const, schr *const, schr *const, schr **const, int *const);
+static schr *lastCold(struct vars *const, struct dfa *const);
+static int firstArm(struct vars *const, struct dfa *const, schr *const);
+static int setArm(struct vars *const, struct sset *const);
 static struct dfa *newDFA(struct vars *const, struct cnfa *const, struct colormap *const, struct smalldfa *);
 static void freeDFA(struct dfa *const);
 static unsigned hash(unsigned *const, const int);
-static struct sset *initialize(struct vars *const, struct dfa *const, chr *const);
-static struct sset *miss(struct vars *const, struct dfa *const, struct sset *const, const pcolor, chr *const, chr *const);
-static int checkLAConstraint(struct vars *const, struct cnfa *const, chr *const, const pcolor);
-static struct sset *getVacantSS(struct vars *const, struct dfa *const, chr *const, chr *const);
-static struct sset *pickNextSS(struct vars *const, struct dfa *const, chr *const, chr *const);
+static int bucket(struct dfa *const, unsigned);
+static void setHashMask(struct dfa *const);
+static struct sset *initialize(struct vars *const, struct dfa *const, schr *const);
+static struct sset *miss(struct vars *const, struct dfa *const, struct sset *, const pcolor, schr *const, schr *const);
+static int checkLAConstraint(struct vars *const, struct cnfa *const, schr *const, const pcolor);
+static struct sset *getVacantSS(struct vars *const, struct dfa *const, schr *const, schr *const);
+static struct sset *pickNextSS(struct vars *const, struct dfa *const, schr *const, schr *const);
+static int growDFA(struct vars *const, struct dfa *const);
+static void hashSS(struct dfa *const, struct sset *const);
 /* automatically gathered by fwd; do not hand-edit */
 /* =====^!^===== end forwards =====^!^===== */
 
 /*
  - exec - match regular expression
- ^ int exec(regex_t *, const chr *, size_t, rm_detail_t *,
+ ^ int exec(regex_t *, const schr *, size_t, rm_detail_t *,
  ^					size_t, regmatch_t [], int);
  */
 int
 exec(
     regex_t *re,
-    const chr *string,
+    const schr *string,
     size_t len,
     rm_detail_t *details,
     size_t nmatch,
@@ -174,6 +241,8 @@ exec(
     AllocVars(v);
     int st, backref;
     size_t n;
+    schr *first = NULL;
+    schr *from;
 #define	LOCALMAT	20
     regmatch_t mat[LOCALMAT];
 #define	LOCALMEM	40
@@ -192,12 +261,37 @@ exec(
 	return REG_MIXED;
     }
 
+    /*
+     * With REG_STARTEND, the search begins at pmatch[0].rm_so. The characters
+     * before it are context only, for ^ after a newline and word boundaries;
+     * offsets are still reported from the start of the string.
+     */
+
+    from = (schr *) string;
+    if (flags&REG_STARTEND) {
+	if (pmatch == NULL || pmatch[0].rm_so < 0
+		|| (size_t) pmatch[0].rm_so > len) {
+	    FreeVars(v);
+	    return REG_INVARG;
+	}
+	from += pmatch[0].rm_so;
+    }
+
     /*
      * Setup.
      */
 
     v->re = re;
     v->g = (struct guts *)re->re_guts;
+    if (details != NULL) {
+	details->rm_dfagrowths = 0;
+	details->rm_dfaflushes = 0;
+	details->rm_dfakept = v->g->dfakept;
+    }
+    if (v->g->narms > 0) {	/* sets are for execset() */
+	FreeVars(v);
+	return REG_INVARG;
+    }
     if ((v->g->cflags&REG_EXPECT) && details == NULL) {
 	FreeVars(v);
 	return REG_INVARG;
@@ -206,6 +300,22 @@ exec(
 	FreeVars(v);
 	return REG_NOMATCH;
     }
+
+    /*
+     * Subjects without the literal that every match contains cannot match.
+     * REG_EXPECT also wants to know where a partial match at the end of the
+     * subject starts, which takes the DFA; but when every match starts with
+     * the literal, the search can still skip to its first occurrence.
+     */
+
+    if (v->g->nliteral > 0 && (!(v->g->cflags&REG_EXPECT)
+	    || v->g->literalprefix)) {
+	first = findLiteral(v->g, from, (schr *) string + len);
+	if (first == NULL && !(v->g->cflags&REG_EXPECT)) {
+	    FreeVars(v);
+	    return REG_NOMATCH;
+	}
+    }
     backref = (v->g->info&REG_UBACKREF) ? 1 : 0;
     v->eflags = flags;
     if (v->g->cflags&REG_NOSUB) {
@@ -232,8 +342,13 @@ exec(
 	v->pmatch = pmatch;
     }
     v->details = details;
-    v->start = (chr *)string;
-    v->stop = (chr *)string + len;
+    v->dfabudget = (details != NULL && details->rm_dfabudget > 0) ?
+	    details->rm_dfabudget : REG_DFA_BUDGET;
+    v->dfagrowths = 0;
+    v->dfaflushes = 0;
+    v->start = (schr *)string;
+    v->stop = (schr *)string + len;
+    v->search_start = (first != NULL && v->g->literalprefix) ? first : from;
     v->err = 0;
     if (backref) {
 	/*
@@ -289,10 +404,231 @@ exec(
     if (v->mem != NULL && v->mem != mem) {
 	FREE(v->mem);
     }
+    if (details != NULL) {
+	details->rm_dfagrowths = v->dfagrowths;
+	details->rm_dfaflushes = v->dfaflushes;
+	details->rm_dfakept = v->g->dfakept;
+    }
     FreeVars(v);
     return st;
 }
 
+/*
+ - execset - find the first arm of a set that matches
+ * The RE must come from compileset(). Stores the number of the first arm
+ * (in the order given to compileset()) that matches anywhere in the subject
+ * through armPtr. Sets containing backreferences are refused, since the
+ * search DFA only approximates them.
+ ^ int execset(regex_t *, const schr *, size_t, rm_detail_t *, int *, int);
+ */
+int
+execset(
+    regex_t *re,
+    const schr *string,
+    size_t len,
+    rm_detail_t *details,
+    int *armPtr,
+    int flags)
+{
+    AllocVars(v);
+    int st;
+    schr *first = NULL;
+
+    /*
+     * Sanity checks.
+     */
+
+    if (re == NULL || string == NULL || armPtr == NULL
+	    || re->re_magic != REMAGIC) {
+	FreeVars(v);
+	return REG_INVARG;
+    }
+    if (re->re_csize != sizeof(chr)) {
+	FreeVars(v);
+	return REG_MIXED;
+    }
+
+    /*
+     * Setup.
+     */
+
+    v->re = re;
+    v->g = (struct guts *)re->re_guts;
+    if (details != NULL) {
+	details->rm_dfagrowths = 0;
+	details->rm_dfaflushes = 0;
+	details->rm_dfakept = v->g->dfakept;
+    }
+    if (v->g->narms == 0 || (v->g->info&REG_UBACKREF)) {
+	FreeVars(v);
+	return REG_INVARG;
+    }
+    if (v->g->info&REG_UIMPOSSIBLE) {
+	FreeVars(v);
+	return REG_NOMATCH;
+    }
+    if (v->g->nliteral > 0) {
+	first = findLiteral(v->g, (schr *) string, (schr *) string + len);
+	if (first == NULL) {
+	    FreeVars(v);
+	    return REG_NOMATCH;
+	}
+    }
+    v->eflags = flags;
+    v->nmatch = 0;
+    v->pmatch = NULL;
+    v->details = details;
+    v->dfabudget = (details != NULL && details->rm_dfabudget > 0) ?
+	    details->rm_dfabudget : REG_DFA_BUDGET;
+    v->dfagrowths = 0;
+    v->dfaflushes = 0;
+    v->start = (schr *)string;
+    v->stop = (schr *)string + len;
+    v->search_start = (first != NULL && v->g->literalprefix) ? first : v->start;
+    v->err = 0;
+    v->mem = NULL;
+
+    /*
+     * Do it.
+     */
+
+    st = setFind(v, armPtr);
+    if (details != NULL) {
+	details->rm_dfagrowths = v->dfagrowths;
+	details->rm_dfaflushes = v->dfaflushes;
+	details->rm_dfakept = v->g->dfakept;
+    }
+    FreeVars(v);
+    return st;
+}
+
+/*
+ - findLiteral - find the first occurrence of the required literal
+ * Boyer-Moore-Horspool, with shifts looked up by the low byte of a chr.
+ ^ static schr *findLiteral(struct guts *const, schr *const, schr *const);
+ */
+static schr *			/* start of the literal, or NULL if absent */
+findLiteral(
+    struct guts *const g,
+    schr *const start,
+    schr *const stop)
+{
+    const chr *literal = g->literal;
+    size_t last = g->nliteral - 1;
+    chr lastChr = literal[last];
+    schr *cp, *end;
+    size_t i;
+
+    if ((size_t) (stop - start) <= last) {
+	return NULL;
+    }
+    end = stop - last;
+    for (cp = start; cp < end; cp += g->literalskip[cp[last] & 0xff]) {
+	if (cp[last] == lastChr) {
+	    for (i = 0; i < last && cp[i] == literal[i]; i++) {
+		/* empty body */
+	    }
+	    if (i == last) {
+		return cp;
+	    }
+	}
+    }
+    return NULL;
+}
+
+/*
+ - compareSubject - compare two stretches of the subject, for backrefs
+ ^ static int compareSubject(struct vars *const, const schr *, const schr *,
+ ^	size_t);
+ */
+static int			/* 0 if equal, nonzero otherwise */
+compareSubject(
+    struct vars *const v,
+    const schr *x, const schr *y,	/* stretches to compare */
+    size_t len)			/* exact length of comparison */
+{
+#ifdef REG_BYTE_SUBJECT
+    if (!(v->g->cflags&REG_ICASE)) {
+	return memcmp(VS(x), VS(y), len);
+    }
+    for (; len > 0; len--, x++, y++) {
+	if ((*x != *y) && (Tcl_UniCharToLower(*x) != Tcl_UniCharToLower(*y))) {
+	    return 1;
+	}
+    }
+    return 0;
+#else
+    return v->g->compare(x, y, len);
+#endif
+}
+
+/*
+ - getDFA - get a DFA for the search or main NFA, preferably the one left
+ * behind by an earlier exec, with its state sets already built
+ ^ static struct dfa *getDFA(struct vars *const, const int, struct cnfa *const,
+ ^	struct smalldfa *);
+ */
+static struct dfa *
+getDFA(
+    struct vars *const v,
+    const int slot,		/* SEARCHDFA or MAINDFA */
+    struct cnfa *const cnfa,
+    struct smalldfa *sml)	/* preallocated space, may be NULL */
+{
+    struct dfa *d = v->g->dfacache[slot];
+
+    if (d != NULL && !(v->eflags&REG_SMALL)) {
+	v->g->dfacache[slot] = NULL;	/* ours until putDFA */
+	v->g->dfakept -= DFASIZE(d, d->nssets);
+	if (DFASIZE(d, d->nssets) <= v->dfabudget) {
+	    d->flushes = 0;
+	    return d;
+	}
+	freeDFA(d);			/* the budget has shrunk since */
+    }
+    d = newDFA(v, cnfa, &v->g->cmap, sml);
+    if (d != NULL) {
+	d->nogrow = v->g->dfanogrow[slot];
+    }
+    return d;
+}
+
+/*
+ * A DFA that has grown as far as the budget lets it and still flushed more
+ * state sets than it holds in one exec is thrashing: the bigger cache only
+ * makes each flush slower. Its slot then gets DFAs that do not grow.
+ */
+
+#define	THRASHED(d)	(!(d)->nogrow && (d)->flushes > (d)->nssets)
+
+/*
+ - putDFA - done with a DFA from getDFA; keep it for the next exec if it is
+ * malloced, within budget and not thrashing, else free it
+ ^ static void putDFA(struct vars *const, const int, struct dfa *const);
+ */
+static void
+putDFA(
+    struct vars *const v,
+    const int slot,		/* SEARCHDFA or MAINDFA */
+    struct dfa *const d)
+{
+    if (d->mallocarea == (char *) d && !(v->eflags&REG_SMALL)
+	    && THRASHED(d)) {
+	v->g->dfanogrow[slot] = 1;
+	freeDFA(d);
+	return;
+    }
+    if (d->mallocarea != (char *) d || (v->eflags&REG_SMALL)
+	    || v->g->dfacache[slot] != NULL
+	    || DFASIZE(d, d->nssets) > v->dfabudget) {
+	freeDFA(d);
+	return;
+    }
+    v->g->dfacache[slot] = d;
+    v->g->dfakept += DFASIZE(d, d->nssets);
+    v->g->freedfa = freeDFA;
+}
+
 /*
  - simpleFind - find a match for the main NFA (no-complications case)
  ^ static int simpleFind(struct vars *, struct cnfa *, struct colormap *);
@@ -304,9 +640,9 @@ simpleFind(
     struct colormap *const cm)
 {
     struct dfa *s, *d;
-    chr *begin, *end = NULL;
-    chr *cold;
-    chr *open, *close;		/* Open and close of range of possible
+    schr *begin, *end = NULL;
+    schr *cold;
+    schr *open, *close;		/* Open and close of range of possible
 				 * starts */
     int hitend;
     int shorter = (v->g->tree->flags&SHORTER) ? 1 : 0;
@@ -315,13 +651,14 @@ simpleFind(
      * First, a shot with the search RE.
      */
 
-    s = newDFA(v, &v->g->search, cm, &v->dfa1);
+    s = getDFA(v, SEARCHDFA, &v->g->search, &v->dfa1);
     assert(!(ISERR() && s != NULL));
     NOERR();
-    MDEBUG(("\nsearch at %ld\n", LOFF(v->start)));
+    MDEBUG(("\nsearch at %ld\n", LOFF(v->search_start)));
     cold = NULL;
-    close = shortest(v, s, v->start, v->start, v->stop, &cold, NULL);
-    freeDFA(s);
+    close = shortest(v, s, v->search_start, v->search_start, v->stop, &cold,
+	    NULL);
+    putDFA(v, SEARCHDFA, s);
     NOERR();
     if (v->g->cflags&REG_EXPECT) {
 	assert(v->details != NULL);
@@ -347,7 +684,7 @@ simpleFind(
     open = cold;
     cold = NULL;
     MDEBUG(("between %ld and %ld\n", LOFF(open), LOFF(close)));
-    d = newDFA(v, cnfa, cm, &v->dfa1);
+    d = getDFA(v, MAINDFA, cnfa, &v->dfa1);
     assert(!(ISERR() && d != NULL));
     NOERR();
     for (begin = open; begin <= close; begin++) {
@@ -366,7 +703,7 @@ simpleFind(
 	}
     }
     assert(end != NULL);	/* search RE succeeded so loop should */
-    freeDFA(d);
+    putDFA(v, MAINDFA, d);
 
     /*
      * And pin down details.
@@ -395,6 +732,32 @@ simpleFind(
     return dissect(v, v->g->tree, begin, end);
 }
 
+/*
+ - setFind - find the first arm of a set that matches anywhere
+ ^ static int setFind(struct vars *const, int *const);
+ */
+static int
+setFind(
+    struct vars *const v,
+    int *const armPtr)
+{
+    struct dfa *s;
+    int arm;
+
+    s = getDFA(v, SEARCHDFA, &v->g->search, &v->dfa1);
+    assert(!(ISERR() && s != NULL));
+    NOERR();
+    MDEBUG(("\nset search at %ld\n", LOFF(v->search_start)));
+    arm = firstArm(v, s, v->search_start);
+    putDFA(v, SEARCHDFA, s);
+    NOERR();
+    if (arm == v->g->narms) {
+	return REG_NOMATCH;
+    }
+    *armPtr = arm;
+    return REG_OKAY;
+}
+
 /*
  - complicatedFind - find a match for the main NFA (with complications)
  ^ static int complicatedFind(struct vars *, struct cnfa *, struct colormap *);
@@ -406,22 +769,22 @@ complicatedFind(
     struct colormap *const cm)
 {
     struct dfa *s, *d;
-    chr *cold = NULL; /* silence gcc 4 warning */
+    schr *cold = NULL; /* silence gcc 4 warning */
     int ret;
 
-    s = newDFA(v, &v->g->search, cm, &v->dfa1);
+    s = getDFA(v, SEARCHDFA, &v->g->search, &v->dfa1);
     NOERR();
-    d = newDFA(v, cnfa, cm, &v->dfa2);
+    d = getDFA(v, MAINDFA, cnfa, &v->dfa2);
     if (ISERR()) {
 	assert(d == NULL);
-	freeDFA(s);
+	putDFA(v, SEARCHDFA, s);
 	return v->err;
     }
 
     ret = complicatedFindLoop(v, cnfa, cm, d, s, &cold);
 
-    freeDFA(d);
-    freeDFA(s);
+    putDFA(v, MAINDFA, d);
+    putDFA(v, SEARCHDFA, s);
     NOERR();
     if (v->g->cflags&REG_EXPECT) {
 	assert(v->details != NULL);
@@ -438,7 +801,7 @@ complicatedFind(
 /*
  - complicatedFindLoop - the heart of complicatedFind
  ^ static int complicatedFindLoop(struct vars *, struct cnfa *, struct colormap *,
- ^	struct dfa *, struct dfa *, chr **);
+ ^	struct dfa *, struct dfa *, schr **);
  */
 static int
 complicatedFindLoop(
@@ -447,19 +810,19 @@ complicatedFindLoop(
     struct colormap *const cm,
     struct dfa *const d,
     struct dfa *const s,
-    chr **const coldp)		/* where to put coldstart pointer */
+    schr **const coldp)		/* where to put coldstart pointer */
 {
-    chr *begin, *end;
-    chr *cold;
-    chr *open, *close;		/* Open and close of range of possible
+    schr *begin, *end;
+    schr *cold;
+    schr *open, *close;		/* Open and close of range of possible
 				 * starts */
-    chr *estart, *estop;
+    schr *estart, *estop;
     int er, hitend;
     int shorter = v->g->tree->flags&SHORTER;
 
     assert(d != NULL && s != NULL);
     cold = NULL;
-    close = v->start;
+    close = v->search_start;
     do {
 	MDEBUG(("\ncsearch at %ld\n", LOFF(close)));
 	close = shortest(v, s, close, close, v->stop, &cold, NULL);
@@ -577,14 +940,14 @@ zapSubtree(
 
 /*
  - subset - set any subexpression relevant to a successful subre
- ^ static void subset(struct vars *, struct subre *, chr *, chr *);
+ ^ static void subset(struct vars *, struct subre *, schr *, schr *);
  */
 static void
 subset(
     struct vars *const v,
     struct subre *const sub,
-    chr *const begin,
-    chr *const end)
+    schr *const begin,
+    schr *const end)
 {
     int n = sub->subno;
 
@@ -600,14 +963,14 @@ subset(
 
 /*
  - dissect - determine subexpression matches (uncomplicated case)
- ^ static int dissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int dissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 dissect(
     struct vars *const v,
     struct subre *t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
 #ifndef COMPILER_DOES_TAILCALL_OPTIMIZATION
   restart:
@@ -645,20 +1008,20 @@ dissect(
 /*
  - concatenationDissect - determine concatenation subexpression matches
  - (uncomplicated)
- ^ static int concatenationDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int concatenationDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 concatenationDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     struct dfa *d, *d2;
-    chr *mid;
+    schr *mid;
     int i;
     int shorter = (t->left->flags&SHORTER) ? 1 : 0;
-    chr *stop = (shorter) ? end : begin;
+    schr *stop = (shorter) ? end : begin;
 
     assert(t->op == '.');
     assert(t->left != NULL && t->left->cnfa.nstates > 0);
@@ -742,14 +1105,14 @@ concatenationDissect(
 
 /*
  - alternationDissect - determine alternative subexpression matches (uncomplicated)
- ^ static int alternationDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int alternationDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 alternationDissect(
     struct vars *const v,
     struct subre *t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     int i;
 
@@ -779,14 +1142,14 @@ alternationDissect(
  - complicatedDissect - determine subexpression matches (with complications)
  * The retry memory stores the offset of the trial midpoint from begin, plus 1
  * so that 0 uniquely means "clean slate".
- ^ static int complicatedDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int complicatedDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static inline int		/* regexec return code */
 complicatedDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     assert(t != NULL);
     MDEBUG(("complicatedDissect %ld-%ld %c\n", LOFF(begin), LOFF(end), t->op));
@@ -817,8 +1180,8 @@ static int			/* regexec return code */
 complicatedCapturingDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     int er = complicatedDissect(v, t->left, begin, end);
 
@@ -832,17 +1195,17 @@ complicatedCapturingDissect(
  - complicatedConcatenationDissect - concatenation subexpression matches (with complications)
  * The retry memory stores the offset of the trial midpoint from begin, plus 1
  * so that 0 uniquely means "clean slate".
- ^ static int complicatedConcatenationDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int complicatedConcatenationDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 complicatedConcatenationDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     struct dfa *d, *d2;
-    chr *mid;
+    schr *mid;
 
     assert(t->op == '.');
     assert(t->left != NULL && t->left->cnfa.nstates > 0);
@@ -950,17 +1313,17 @@ complicatedConcatenationDissect(
  - matches
  * The retry memory stores the offset of the trial midpoint from begin, plus 1
  * so that 0 uniquely means "clean slate".
- ^ static int complicatedReversedDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int complicatedReversedDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 complicatedReversedDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     struct dfa *d, *d2;
-    chr *mid;
+    schr *mid;
 
     assert(t->op == '.');
     assert(t->left != NULL && t->left->cnfa.nstates > 0);
@@ -1066,17 +1429,17 @@ complicatedReversedDissect(
 
 /*
  - complicatedBackrefDissect - determine backref subexpression matches
- ^ static int complicatedBackrefDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int complicatedBackrefDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 complicatedBackrefDissect(
     struct vars *const v,
     struct subre *const t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     int i, n = t->subno, min = t->min, max = t->max;
-    chr *paren, *p, *stop;
+    schr *paren, *p, *stop;
     size_t len;
 
     assert(t != NULL);
@@ -1128,7 +1491,7 @@ complicatedBackrefDissect(
 
     i = 0;
     for (p = begin; p <= stop && (i < max || max == INFINITY); p += len) {
-	if (v->g->compare(paren, p, len) != 0) {
+	if (compareSubject(v, paren, p, len) != 0) {
 	    break;
 	}
 	i++;
@@ -1151,14 +1514,14 @@ complicatedBackrefDissect(
 /*
  - complicatedAlternationDissect - determine alternative subexpression matches (w.
  - complications)
- ^ static int complicatedAlternationDissect(struct vars *, struct subre *, chr *, chr *);
+ ^ static int complicatedAlternationDissect(struct vars *, struct subre *, schr *, schr *);
  */
 static int			/* regexec return code */
 complicatedAlternationDissect(
     struct vars *const v,
     struct subre *t,
-    chr *const begin,		/* beginning of relevant substring */
-    chr *const end)		/* end of same */
+    schr *const begin,		/* beginning of relevant substring */
+    schr *const end)		/* end of same */
 {
     int er;
 #define	UNTRIED	0		/* not yet tried at all */
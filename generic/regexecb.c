@@ -0,0 +1,14 @@
+/*
+ * regexecb.c --
+ *
+ *	The regular expression executor, compiled for subjects made of bytes
+ *	rather than chrs. Byte arrays, and strings whose UTF-8 representation
+ *	is all ASCII, are matched this way without first being converted to
+ *	Tcl_UniChar strings. See regexec.c for the executor itself.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#define REG_BYTE_SUBJECT
+#include "regexec.c"
@@ -179,6 +179,7 @@ struct colordesc {
 #define	NOSUB	COLORLESS
     struct arc *arcs;		/* color chain */
     int flags;
+    chr lastchr;		/* last chr given this color by subcolor() */
 #define	FREECOL	01		/* currently free */
 #define	PSEUDO	02		/* pseudocolor, no real chars */
 #define	UNUSEDCOLOR(cd)	((cd)->flags&FREECOL)
@@ -326,6 +327,31 @@ struct cnfa {
 #   define REG_MAX_STATES	100000
 #endif
 
+/*
+ * Limits for the required literal that the executor searches for before
+ * running any automaton (see findliteral() in regcomp.c). Looking for a
+ * literal in the middle of a pattern means checking, for each candidate
+ * state, whether every path through the NFA passes it, so that is only done
+ * for NFAs of modest size.
+ */
+
+#ifndef REG_MAX_LITERAL
+#   define REG_MAX_LITERAL	32
+#endif
+#ifndef REG_MAX_LITERAL_STATES
+#   define REG_MAX_LITERAL_STATES	100
+#endif
+
+/*
+ * DFAs for the search NFA and the main NFA are kept in the guts between exec
+ * calls, one pair for each type of subject (chr strings and byte strings),
+ * so that the state sets they have built up need not be rediscovered.
+ * Compiled REs are never used by two threads at once, so this needs no
+ * locking. freedfas() gives their memory back without freeing the RE.
+ */
+
+#define	NDFACACHE	4
+
 /*
  * subexpression tree
  */
@@ -386,6 +412,19 @@ struct guts {
     int FUNCPTR(compare, (const chr *, const chr *, size_t));
     struct subre *lacons;	/* lookahead-constraint vector */
     int nlacons;		/* size of lacons */
+    size_t nliteral;		/* length of literal, 0 if none */
+    int literalprefix;		/* does every match start with literal? */
+    chr literal[REG_MAX_LITERAL];	/* string every match contains */
+    unsigned char literalskip[256];	/* Horspool shifts, indexed by the
+					 * low byte of a chr */
+    struct dfa *dfacache[NDFACACHE];	/* DFAs kept from the last exec, by
+				 * subject type and NFA (see regexec.c) */
+    VOID FUNCPTR(freedfa, (struct dfa *const));	/* frees them */
+    size_t dfakept;		/* bytes taken by the DFAs in dfacache */
+    char dfanogrow[NDFACACHE];	/* DFAs for these slots start small and stay
+				 * so; growing did not stop them flushing */
+    int narms;			/* number of arms, if compiled as a set */
+    int *armends;		/* search NFA end state of each arm */
 };
 
 /*
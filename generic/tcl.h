@@ -1188,10 +1188,18 @@ struct Tcl_HashEntry {
  * TCL_HASH_KEY_SYSTEM_HASH -	If this flag is set then all memory internally
  *                              allocated for the hash table that is not for an
  *                              entry will use the system heap.
+ * TCL_HASH_KEY_INCREMENTAL_RESIZE -
+ *				If this flag is set then large tables are not
+ *				rehashed all at once when they grow. Instead,
+ *				a bounded number of old buckets is migrated to
+ *				the new bucket array on each insertion, so no
+ *				single operation pays for rehashing the whole
+ *				table. Searches walk the old and new buckets.
  */
 
 #define TCL_HASH_KEY_RANDOMIZE_HASH 0x1
 #define TCL_HASH_KEY_SYSTEM_HASH    0x2
+#define TCL_HASH_KEY_INCREMENTAL_RESIZE 0x4
 
 /*
  * Structure definition for the methods associated with a hash table key type.
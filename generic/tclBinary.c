@@ -52,21 +52,49 @@
 
 #define BINARY_SCAN_MAX_CACHE	260
 
+/*
+ * A format string for binary format and binary scan is parsed once into a
+ * BinaryProgram, an array of the fields returned by GetFormatSpec that ends
+ * with one whose cmd is '\0'. It is kept in the internal rep of the format
+ * object, so both passes of binary format, and repeated uses of the same
+ * literal format, work from the parsed fields.
+ */
+
+typedef struct BinarySpec {
+    char cmd;			/* Field character. */
+    int count;			/* Count, BINARY_ALL or BINARY_NOCOUNT. */
+    int flags;			/* BINARY_SIGNED or BINARY_UNSIGNED. */
+    int offset;			/* Where the field starts in the format
+				 * string, counting the blanks before it. */
+} BinarySpec;
+
+typedef struct BinaryProgram {
+    int refCount;		/* Users of the program, including the
+				 * internal reps that hold it. */
+    BinarySpec specs[1];	/* The fields; the actual size depends on the
+				 * format string. */
+} BinaryProgram;
+
 /*
  * Prototypes for local procedures defined in this file:
  */
 
+static void		DupBinaryFormatInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static void		DupByteArrayInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
 static int		FormatNumber(Tcl_Interp *interp, int type,
 			    Tcl_Obj *src, unsigned char **cursorPtr);
+static void		FreeBinaryFormatInternalRep(Tcl_Obj *objPtr);
 static void		FreeByteArrayInternalRep(Tcl_Obj *objPtr);
+static BinaryProgram *	GetBinaryProgram(Tcl_Obj *formatObj);
 static int		GetFormatSpec(const char **formatPtr, char *cmdPtr,
 			    int *countPtr, int *flagsPtr);
 static Tcl_Obj *	ScanNumber(unsigned char *buffer, int type,
 			    int flags, Tcl_HashTable **numberCachePtr);
 static int		SetByteArrayFromAny(Tcl_Interp *interp,
 			    Tcl_Obj *objPtr);
+static void		ReleaseBinaryProgram(BinaryProgram *programPtr);
 static void		UpdateStringOfByteArray(Tcl_Obj *listPtr);
 static void		DeleteScanNumberCache(Tcl_HashTable *numberCachePtr);
 static int		NeedReversing(int format);
@@ -162,6 +190,19 @@ const Tcl_ObjType tclByteArrayType = {
     SetByteArrayFromAny
 };
 
+/*
+ * The Tcl object type that keeps a parsed format string of binary format and
+ * binary scan in the format object.
+ */
+
+static const Tcl_ObjType binaryFormatType = {
+    "binaryformat",			/* name */
+    FreeBinaryFormatInternalRep,	/* freeIntRepProc */
+    DupBinaryFormatInternalRep,		/* dupIntRepProc */
+    NULL,				/* updateStringProc */
+    NULL				/* setFromAnyProc */
+};
+
 /*
  * The following structure is the internal rep for a ByteArray object. Keeps
  * track of how much memory has been used and how much has been allocated for
@@ -752,9 +793,8 @@ BinaryFormatCmd(
     char cmd;			/* Current format character. */
     int count;			/* Count associated with current format
 				 * character. */
-    int flags;			/* Format field flags */
-    const char *format;	/* Pointer to current position in format
-				 * string. */
+    BinaryProgram *programPtr;	/* The parsed format string. */
+    BinarySpec *specPtr;	/* Current field of the format. */
     Tcl_Obj *resultPtr = NULL;	/* Object holding result buffer. */
     unsigned char *buffer;	/* Start of result buffer. */
     unsigned char *cursor;	/* Current position within result buffer. */
@@ -775,16 +815,13 @@ BinaryFormatCmd(
      * places the formatted data into the buffer.
      */
 
-    format = TclGetString(objv[1]);
+    programPtr = GetBinaryProgram(objv[1]);
     arg = 2;
     offset = 0;
     length = 0;
-    while (*format != '\0') {
-	str = format;
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    break;
-	}
+    for (specPtr = programPtr->specs; specPtr->cmd != '\0'; specPtr++) {
+	cmd = specPtr->cmd;
+	count = specPtr->count;
 	switch (cmd) {
 	case 'a':
 	case 'A':
@@ -867,6 +904,7 @@ BinaryFormatCmd(
 
 		if (TclListObjGetElements(interp, objv[arg], &listc,
 			&listv) != TCL_OK) {
+		    ReleaseBinaryProgram(programPtr);
 		    return TCL_ERROR;
 		}
 		arg++;
@@ -877,6 +915,7 @@ BinaryFormatCmd(
 		    Tcl_AppendResult(interp,
 			    "number of elements in list does not match count",
 			    NULL);
+		    ReleaseBinaryProgram(programPtr);
 		    return TCL_ERROR;
 		}
 	    }
@@ -888,6 +927,7 @@ BinaryFormatCmd(
 		Tcl_AppendResult(interp,
 			"cannot use \"*\" in format string with \"x\"",
 			NULL);
+		ReleaseBinaryProgram(programPtr);
 		return TCL_ERROR;
 	    } else if (count == BINARY_NOCOUNT) {
 		count = 1;
@@ -919,7 +959,7 @@ BinaryFormatCmd(
 	    }
 	    break;
 	default:
-	    errorString = str;
+	    errorString = TclGetString(objv[1]) + specPtr->offset;
 	    goto badField;
 	}
     }
@@ -927,6 +967,7 @@ BinaryFormatCmd(
 	length = offset;
     }
     if (length == 0) {
+	ReleaseBinaryProgram(programPtr);
 	return TCL_OK;
     }
 
@@ -946,14 +987,11 @@ BinaryFormatCmd(
      */
 
     arg = 2;
-    format = TclGetString(objv[1]);
     cursor = buffer;
     maxPos = cursor;
-    while (*format != 0) {
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    break;
-	}
+    for (specPtr = programPtr->specs; specPtr->cmd != '\0'; specPtr++) {
+	cmd = specPtr->cmd;
+	count = specPtr->count;
 	if ((count == 0) && (cmd != '@')) {
 	    if (cmd != 'x') {
 		arg++;
@@ -1157,6 +1195,7 @@ BinaryFormatCmd(
 	    for (i = 0; i < count; i++) {
 		if (FormatNumber(interp, cmd, listv[i], &cursor)!=TCL_OK) {
 		    Tcl_DecrRefCount(resultPtr);
+		    ReleaseBinaryProgram(programPtr);
 		    return TCL_ERROR;
 		}
 	    }
@@ -1194,6 +1233,7 @@ BinaryFormatCmd(
 	    break;
 	}
     }
+    ReleaseBinaryProgram(programPtr);
     Tcl_SetObjResult(interp, resultPtr);
     return TCL_OK;
 
@@ -1201,6 +1241,7 @@ BinaryFormatCmd(
     Tcl_ResetResult(interp);
     Tcl_AppendResult(interp, "expected ", errorString,
 	" string but got \"", errorValue, "\" instead", NULL);
+    ReleaseBinaryProgram(programPtr);
     return TCL_ERROR;
 
  badCount:
@@ -1219,11 +1260,13 @@ BinaryFormatCmd(
 	Tcl_UtfToUniChar(errorString, &ch);
 	buf[Tcl_UniCharToUtf(ch, buf)] = '\0';
 	Tcl_AppendResult(interp, "bad field specifier \"", buf, "\"", NULL);
+	ReleaseBinaryProgram(programPtr);
 	return TCL_ERROR;
     }
 
  error:
     Tcl_AppendResult(interp, errorString, NULL);
+    ReleaseBinaryProgram(programPtr);
     return TCL_ERROR;
 }
 
@@ -1257,12 +1300,11 @@ BinaryScanCmd(
     int count;			/* Count associated with current format
 				 * character. */
     int flags;			/* Format field flags */
-    const char *format;	/* Pointer to current position in format
-				 * string. */
+    BinaryProgram *programPtr;	/* The parsed format string. */
+    BinarySpec *specPtr;	/* Current field of the format. */
     Tcl_Obj *resultPtr = NULL;	/* Object holding result buffer. */
     unsigned char *buffer;	/* Start of result buffer. */
     const char *errorString;
-    const char *str;
     int offset, size, length;
 
     int i;
@@ -1277,16 +1319,14 @@ BinaryScanCmd(
     }
     numberCachePtr = &numberCacheHash;
     Tcl_InitHashTable(numberCachePtr, TCL_ONE_WORD_KEYS);
+    programPtr = GetBinaryProgram(objv[2]);
     buffer = Tcl_GetByteArrayFromObj(objv[1], &length);
-    format = TclGetString(objv[2]);
     arg = 3;
     offset = 0;
-    while (*format != '\0') {
-	str = format;
-	flags = 0;
-	if (!GetFormatSpec(&format, &cmd, &count, &flags)) {
-	    goto done;
-	}
+    for (specPtr = programPtr->specs; specPtr->cmd != '\0'; specPtr++) {
+	cmd = specPtr->cmd;
+	count = specPtr->count;
+	flags = specPtr->flags;
 	switch (cmd) {
 	case 'a':
 	case 'A': {
@@ -1341,6 +1381,7 @@ BinaryScanCmd(
 	    arg++;
 	    if (resultPtr == NULL) {
 		DeleteScanNumberCache(numberCachePtr);
+		ReleaseBinaryProgram(programPtr);
 		return TCL_ERROR;
 	    }
 	    offset += count;
@@ -1395,6 +1436,7 @@ BinaryScanCmd(
 	    arg++;
 	    if (resultPtr == NULL) {
 		DeleteScanNumberCache(numberCachePtr);
+		ReleaseBinaryProgram(programPtr);
 		return TCL_ERROR;
 	    }
 	    offset += (count + 7) / 8;
@@ -1450,6 +1492,7 @@ BinaryScanCmd(
 	    arg++;
 	    if (resultPtr == NULL) {
 		DeleteScanNumberCache(numberCachePtr);
+		ReleaseBinaryProgram(programPtr);
 		return TCL_ERROR;
 	    }
 	    offset += (count + 1) / 2;
@@ -1520,6 +1563,7 @@ BinaryScanCmd(
 	    arg++;
 	    if (resultPtr == NULL) {
 		DeleteScanNumberCache(numberCachePtr);
+		ReleaseBinaryProgram(programPtr);
 		return TCL_ERROR;
 	    }
 	    break;
@@ -1557,7 +1601,7 @@ BinaryScanCmd(
 	    break;
 	default:
 	    DeleteScanNumberCache(numberCachePtr);
-	    errorString = str;
+	    errorString = TclGetString(objv[2]) + specPtr->offset;
 	    goto badField;
 	}
     }
@@ -1567,6 +1611,7 @@ BinaryScanCmd(
      */
 
  done:
+    ReleaseBinaryProgram(programPtr);
     Tcl_SetObjResult(interp, Tcl_NewLongObj(arg - 3));
     DeleteScanNumberCache(numberCachePtr);
 
@@ -1588,11 +1633,13 @@ BinaryScanCmd(
 	Tcl_UtfToUniChar(errorString, &ch);
 	buf[Tcl_UniCharToUtf(ch, buf)] = '\0';
 	Tcl_AppendResult(interp, "bad field specifier \"", buf, "\"", NULL);
+	ReleaseBinaryProgram(programPtr);
 	return TCL_ERROR;
     }
 
  error:
     Tcl_AppendResult(interp, errorString, NULL);
+    ReleaseBinaryProgram(programPtr);
     return TCL_ERROR;
 }
 
@@ -1661,6 +1708,110 @@ GetFormatSpec(
     return 1;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetBinaryProgram --
+ *
+ *	Get the parsed form of a format string for binary format or binary
+ *	scan, keeping it in the internal rep of the format object.
+ *
+ * Results:
+ *	The program, which the caller must release with ReleaseBinaryProgram.
+ *
+ * Side effects:
+ *	May set the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static BinaryProgram *
+GetBinaryProgram(
+    Tcl_Obj *formatObj)		/* The format string. */
+{
+    BinaryProgram *programPtr;
+    BinarySpec *specPtr;
+    const char *format, *start;
+    int length;
+
+    if (formatObj->typePtr != &binaryFormatType) {
+	/*
+	 * Each field takes at least one byte of the format.
+	 */
+
+	start = format = TclGetStringFromObj(formatObj, &length);
+	programPtr = (BinaryProgram *) ckalloc(sizeof(BinaryProgram)
+		+ length * sizeof(BinarySpec));
+	programPtr->refCount = 0;
+	specPtr = programPtr->specs;
+	while (1) {
+	    specPtr->offset = format - start;
+	    specPtr->flags = 0;
+	    if (!GetFormatSpec(&format, &specPtr->cmd, &specPtr->count,
+		    &specPtr->flags)) {
+		break;
+	    }
+	    specPtr++;
+	}
+	specPtr->cmd = '\0';
+
+	TclFreeIntRep(formatObj);
+	formatObj->internalRep.otherValuePtr = programPtr;
+	formatObj->typePtr = &binaryFormatType;
+	programPtr->refCount++;
+    }
+    programPtr = formatObj->internalRep.otherValuePtr;
+    programPtr->refCount++;
+    return programPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseBinaryProgram, FreeBinaryFormatInternalRep,
+ * DupBinaryFormatInternalRep --
+ *
+ *	Manage the lifetime of parsed format strings and of the internal reps
+ *	that hold them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A program is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseBinaryProgram(
+    BinaryProgram *programPtr)
+{
+    if (--programPtr->refCount <= 0) {
+	ckfree((char *) programPtr);
+    }
+}
+
+static void
+FreeBinaryFormatInternalRep(
+    Tcl_Obj *objPtr)
+{
+    ReleaseBinaryProgram(objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupBinaryFormatInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    BinaryProgram *programPtr = srcPtr->internalRep.otherValuePtr;
+
+    programPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = programPtr;
+    copyPtr->typePtr = &binaryFormatType;
+}
+
 /*
  *----------------------------------------------------------------------
  *
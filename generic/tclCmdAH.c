@@ -2791,7 +2791,7 @@ Tcl_FormatObjCmd(
 	return TCL_ERROR;
     }
 
-    resultPtr = Tcl_Format(interp, TclGetString(objv[1]), objc-2, objv+2);
+    resultPtr = TclFormatFromObj(interp, objv[1], objc-2, objv+2);
     if (resultPtr == NULL) {
 	return TCL_ERROR;
     }
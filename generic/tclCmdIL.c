@@ -23,24 +23,25 @@
 #include "tclRegexp.h"
 
 /*
- * During execution of the "lsort" command, structures of the following type
- * are used to arrange the objects being sorted into a collection of linked
- * lists.
+ * During execution of the "lsort" command, arrays of structures of the
+ * following type are used to hold the objects being sorted by string or by
+ * command. Sorts by number use arrays of SortPairs instead; see
+ * TclRadixSort.
  */
 
 typedef struct SortElement {
     union {                     /* The value that we sorting by. */
 	const char *strValuePtr;
-	long intValue;
-	double doubleValue;
 	Tcl_Obj *objValuePtr;
     } collationKey;
-    union {             	/* Object being sorted, or its index. */
-        Tcl_Obj *objPtr;
-        int index;
-    } payload;
-    struct SortElement *nextPtr;/* Next element in the list, or NULL for end
-				 * of list. */
+    const char *sortKey;	/* For -dictionary and -nocase sorts, the
+				 * string made from strValuePtr by
+				 * DictionaryKey or NocaseKey, which sorts
+				 * with memcmp the same way. */
+    int sortKeyLength;		/* Number of bytes in sortKey. */
+    int index;			/* Index in the list of the object being
+				 * sorted, or of the first object of its
+				 * group. */
 } SortElement;
 
 /*
@@ -74,7 +75,6 @@ typedef struct SortInfo {
     int indexc;			/* Number of indexes in indexv array. */
     int singleIndex;		/* Static space for common index case. */
     int unique;
-    int numElements;
     Tcl_Interp *interp;		/* The interpreter in which the sort is being
 				 * done. */
     int resultCode;		/* Completion code for the lsort command. If
@@ -102,11 +102,49 @@ typedef struct SortInfo {
 #define SORTIDX_NONE	-1	/* Not indexed; use whole value. */
 #define SORTIDX_END	-2	/* Indexed from end. */
 
+/*
+ * Number of elements looked at to decide whether dropping the duplicates of
+ * a sort with -unique through a hash table is worth it.
+ */
+
+#define UNIQUE_SAMPLE	1024
+
+#ifdef TCL_THREADS
+/*
+ * Large sorts by string are split over up to MAX_SORT_THREADS threads, each
+ * sorting at least SORT_CHUNK_MIN elements. The runs they sort are then
+ * merged in pairs, also in parallel. Each piece of that work is described by
+ * a SortJob.
+ */
+
+#define MAX_SORT_THREADS	8
+#define SORT_CHUNK_MIN		16384
+
+typedef struct SortJob {
+    SortInfo *infoPtr;		/* Information about the sort. */
+    SortElement *leftPtr;	/* The elements to sort, or the first of the
+				 * two runs to merge. */
+    int numLeft;		/* Number of elements at leftPtr. */
+    SortElement *rightPtr;	/* The second run to merge, or NULL when the
+				 * elements at leftPtr are to be sorted. */
+    int numRight;		/* Number of elements at rightPtr. */
+    SortElement *resultPtr;	/* Where to merge the runs to, or work space
+				 * for the sort, which leaves its result at
+				 * leftPtr. */
+    int numResult;		/* Number of elements in the result. */
+    Tcl_ThreadId threadId;	/* The thread doing the job. */
+    int threaded;		/* Whether the job has a thread of its own. */
+} SortJob;
+#endif /* TCL_THREADS */
+
 /*
  * Forward declarations for procedures defined in this file:
  */
 
+static int		CompareSortKeys(SortElement *elemPtr1,
+			    SortElement *elemPtr2);
 static int		DictionaryCompare(const char *left, const char *right);
+static int		DictionaryKey(const char *str, char *key);
 static int		IfConditionCallback(ClientData data[],
 			    Tcl_Interp *interp, int result);
 static int		InfoArgsCmd(ClientData dummy, Tcl_Interp *interp,
@@ -150,10 +188,28 @@ static int		InfoSharedlibCmd(ClientData dummy, Tcl_Interp *interp,
 			    int objc, Tcl_Obj *const objv[]);
 static int		InfoTclVersionCmd(ClientData dummy, Tcl_Interp *interp,
 			    int objc, Tcl_Obj *const objv[]);
-static SortElement *	MergeLists(SortElement *leftPtr, SortElement *rightPtr,
-			    SortInfo *infoPtr);
+static char *		MakeSortKeys(SortElement *elementArray,
+			    int numElements, int sortMode);
+static int		MergeElements(SortElement *leftPtr, int numLeft,
+			    SortElement *rightPtr, int numRight,
+			    SortElement *resultPtr, SortInfo *infoPtr);
+static int		NocaseKey(const char *str, char *key);
+#ifdef TCL_THREADS
+static SortElement *	ParallelSortElements(SortElement *elementPtr,
+			    SortElement *workPtr, int numElements,
+			    SortInfo *infoPtr, int *numSortedPtr);
+static void		RunSortJob(SortJob *jobPtr);
+static void		RunSortJobs(SortJob *jobs, int numJobs);
+static Tcl_ThreadCreateType SortJobThread(ClientData clientData);
+#endif
 static int		SortCompare(SortElement *firstPtr, SortElement *second,
 			    SortInfo *infoPtr);
+static int		SortElements(SortElement *elementPtr,
+			    SortElement *workPtr, int numElements,
+			    SortInfo *infoPtr);
+static int		SortElementsInto(SortElement *elementPtr,
+			    SortElement *resultPtr, int numElements,
+			    SortInfo *infoPtr);
 static Tcl_Obj *	SelectObjFromSublist(Tcl_Obj *firstPtr,
 			    SortInfo *infoPtr);
 
@@ -2830,6 +2886,7 @@ Tcl_LreverseObjCmd(
 	 * returning a pointer to the live array of Tcl_Obj values.
 	 */
 
+	TclListObjInvalidateIndex(objv[1]);
 	for (i=0,j=elemc-1 ; i<j ; i++,j--) {
 	    Tcl_Obj *tmp = elemv[i];
 
@@ -2875,6 +2932,7 @@ Tcl_LsearchObjCmd(
     Tcl_Obj *patObj, **listv, *listPtr, *startPtr, *itemPtr;
     SortStrCmpFn_t strCmpFn = strcmp;
     Tcl_RegExp regexp = NULL;
+    GlobPattern *globPtr = NULL;
     static const char *const options[] = {
 	"-all",	    "-ascii",   "-bisect", "-decreasing", "-dictionary",
 	"-exact",   "-glob",    "-increasing", "-index",
@@ -3124,6 +3182,14 @@ Tcl_LsearchObjCmd(
 	    result = TCL_ERROR;
 	    goto done;
 	}
+    } else if (mode == GLOB) {
+	/*
+	 * Likewise get the compiled glob pattern before the list rep. We hold
+	 * a reference to it, so it survives the pattern being shimmered.
+	 */
+
+	globPtr = TclGetGlobPatternFromObj(objv[objc - 1],
+		noCase ? TCL_MATCH_NOCASE : 0);
     }
 
     /*
@@ -3162,6 +3228,9 @@ Tcl_LsearchObjCmd(
 	    if (sortInfo.indexc > 1) {
 		TclStackFree(interp, sortInfo.indexv);
 	    }
+	    if (globPtr != NULL) {
+		TclReleaseGlobPattern(globPtr);
+	    }
 	    if (allMatches || inlineReturn) {
 		Tcl_ResetResult(interp);
 	    } else {
@@ -3218,7 +3287,15 @@ Tcl_LsearchObjCmd(
     index = -1;
     match = 0;
 
-    if (mode == SORTED && !allMatches && !negatedMatch) {
+    if (mode == EXACT && dataType == ASCII && !noCase && !allMatches
+	    && !negatedMatch && sortInfo.indexc == 0 && offset == 0) {
+	/*
+	 * Looking for the first element equal to a string is what [in] does,
+	 * which may use a hash index of the list.
+	 */
+
+	TclListObjFindElement(NULL, objv[objc - 2], patObj, &index);
+    } else if (mode == SORTED && !allMatches && !negatedMatch) {
 	/*
 	 * If the data is sorted, we can do a more intelligent search. Note
 	 * that there is no point in being smart when -all was specified; in
@@ -3392,8 +3469,8 @@ Tcl_LsearchObjCmd(
 		break;
 
 	    case GLOB:
-		match = Tcl_StringCaseMatch(TclGetString(itemPtr),
-			patternBytes, noCase);
+		bytes = TclGetStringFromObj(itemPtr, &elemLen);
+		match = TclGlobPatternMatch(globPtr, bytes, elemLen);
 		break;
 
 	    case REGEXP:
@@ -3443,7 +3520,10 @@ Tcl_LsearchObjCmd(
 		}
 		Tcl_ListObjAppendElement(interp, listPtr, itemPtr);
 	    } else {
-		Tcl_ListObjAppendElement(interp, listPtr, Tcl_NewIntObj(i));
+		Tcl_Obj **smallInts = TclGetSmallIntTable();
+
+		TclNewSharedIntObj(itemPtr, smallInts, i);
+		Tcl_ListObjAppendElement(interp, listPtr, itemPtr);
 	    }
 	}
     }
@@ -3480,13 +3560,16 @@ Tcl_LsearchObjCmd(
     result = TCL_OK;
 
     /*
-     * Cleanup the index list array.
+     * Cleanup the index list array and the glob pattern.
      */
 
   done:
     if (sortInfo.indexc > 1) {
 	TclStackFree(interp, sortInfo.indexv);
     }
+    if (globPtr != NULL) {
+	TclReleaseGlobPattern(globPtr);
+    }
     return result;
 }
 
@@ -3601,25 +3684,27 @@ Tcl_LsortObjCmd(
 {
     int i, j, index, indices, length, nocase = 0, sortMode, indexc;
     int group, groupSize, groupOffset, idx, allocatedIndexVector = 0;
+    int numElements, numSorted, slot, isNew;
     Tcl_Obj *resultPtr, *cmdPtr, **listObjPtrs, *listObj, *indexPtr;
-    SortElement *elementArray, *elementPtr;
+    Tcl_Obj *keyCmdPtr = NULL, *keyListPtr = NULL;
+    char *sortKeys = NULL;
+    Tcl_HashTable uniqueTable, *uniqueTablePtr = NULL;
+    Tcl_HashEntry *hPtr;
+    SortElement *elementArray = NULL, *sortedElements = NULL;
+    SortPair *pairArray = NULL, *sortedPairs = NULL;
+    Tcl_WideUInt key = 0;
     SortInfo sortInfo;		/* Information about this sort that needs to
 				 * be passed to the comparison function. */
-#   define NUM_LISTS 30
-    SortElement *subList[NUM_LISTS+1];
-				/* This array holds pointers to temporary
-				 * lists built during the merge sort. Element
-				 * i of the array holds a list of length
-				 * 2**i. */
     static const char *const switches[] = {
 	"-ascii", "-command", "-decreasing", "-dictionary", "-increasing",
-	"-index", "-indices", "-integer", "-nocase", "-real", "-stride",
-	"-unique", NULL
+	"-index", "-indices", "-integer", "-keycommand", "-nocase", "-real",
+	"-stride", "-unique", NULL
     };
     enum Lsort_Switches {
 	LSORT_ASCII, LSORT_COMMAND, LSORT_DECREASING, LSORT_DICTIONARY,
 	LSORT_INCREASING, LSORT_INDEX, LSORT_INDICES, LSORT_INTEGER,
-	LSORT_NOCASE, LSORT_REAL, LSORT_STRIDE, LSORT_UNIQUE
+	LSORT_KEYCOMMAND, LSORT_NOCASE, LSORT_REAL, LSORT_STRIDE,
+	LSORT_UNIQUE
     };
 
     if (objc < 2) {
@@ -3638,6 +3723,7 @@ Tcl_LsortObjCmd(
     sortInfo.unique = 0;
     sortInfo.interp = interp;
     sortInfo.resultCode = TCL_OK;
+    sortInfo.compareCmdPtr = NULL;
     cmdPtr = NULL;
     indices = 0;
     group = 0;
@@ -3715,6 +3801,17 @@ Tcl_LsortObjCmd(
 	case LSORT_INTEGER:
 	    sortInfo.sortMode = SORTMODE_INTEGER;
 	    break;
+	case LSORT_KEYCOMMAND:
+	    if (i == objc-2) {
+		Tcl_AppendResult(interp,
+			"\"-keycommand\" option must be followed "
+			"by key command", NULL);
+		sortInfo.resultCode = TCL_ERROR;
+		goto done2;
+	    }
+	    keyCmdPtr = objv[i+1];
+	    i++;
+	    break;
 	case LSORT_NOCASE:
 	    nocase = 1;
 	    break;
@@ -3784,9 +3881,7 @@ Tcl_LsortObjCmd(
 
     listObj = objv[objc-1];
 
-    if (sortInfo.sortMode == SORTMODE_COMMAND) {
-	Tcl_Obj *newCommandPtr, *newObjPtr;
-
+    if ((sortInfo.sortMode == SORTMODE_COMMAND) || keyCmdPtr) {
 	/*
 	 * When sorting using a command, we are reentrant and therefore might
 	 * have the representation of the list being sorted shimmered out from
@@ -3799,6 +3894,35 @@ Tcl_LsortObjCmd(
 	    sortInfo.resultCode = TCL_ERROR;
 	    goto done2;
 	}
+    } else {
+	Tcl_IncrRefCount(listObj);
+    }
+
+    if (keyCmdPtr) {
+	Tcl_Obj *newObjPtr;
+
+	/*
+	 * The key command is flattened with a dummy argument appended, like
+	 * the comparison command below. The keys it returns are kept alive
+	 * in keyListPtr until the sort is done.
+	 */
+
+	keyCmdPtr = Tcl_DuplicateObj(keyCmdPtr);
+	TclNewObj(newObjPtr);
+	Tcl_IncrRefCount(keyCmdPtr);
+	if (Tcl_ListObjAppendElement(interp, keyCmdPtr, newObjPtr)
+		!= TCL_OK) {
+	    Tcl_IncrRefCount(newObjPtr);
+	    TclDecrRefCount(newObjPtr);
+	    sortInfo.resultCode = TCL_ERROR;
+	    goto done;
+	}
+	TclNewObj(keyListPtr);
+	Tcl_IncrRefCount(keyListPtr);
+    }
+
+    if (sortInfo.sortMode == SORTMODE_COMMAND) {
+	Tcl_Obj *newCommandPtr, *newObjPtr;
 
 	/*
 	 * The existing command is a list. We want to flatten it, append two
@@ -3811,16 +3935,30 @@ Tcl_LsortObjCmd(
 	if (Tcl_ListObjAppendElement(interp, newCommandPtr, newObjPtr)
 		!= TCL_OK) {
 	    TclDecrRefCount(newCommandPtr);
-	    TclDecrRefCount(listObj);
 	    Tcl_IncrRefCount(newObjPtr);
 	    TclDecrRefCount(newObjPtr);
 	    sortInfo.resultCode = TCL_ERROR;
-	    goto done2;
+	    goto done;
 	}
 	Tcl_ListObjAppendElement(interp, newCommandPtr, Tcl_NewObj());
 	sortInfo.compareCmdPtr = newCommandPtr;
     }
 
+    /*
+     * Packed lists of integers or doubles sorted plainly by value are sorted
+     * on their unboxed values, producing another packed list.
+     */
+
+    if (listObj->typePtr == &tclPackedListType && !indices && !group
+	    && sortInfo.indexc == 0 && ((sortInfo.sortMode == SORTMODE_INTEGER
+	    && PackedListRepPtr(listObj)->elemType == TCL_PACKED_INT)
+	    || (sortInfo.sortMode == SORTMODE_REAL
+	    && PackedListRepPtr(listObj)->elemType == TCL_PACKED_DOUBLE))) {
+	Tcl_SetObjResult(interp, TclPackedListSort(listObj,
+		sortInfo.isIncreasing, sortInfo.unique));
+	goto done;
+    }
+
     sortInfo.resultCode = TclListObjGetElements(interp, listObj,
 	    &length, &listObjPtrs);
     if (sortInfo.resultCode != TCL_OK || length <= 0) {
@@ -3876,8 +4014,6 @@ Tcl_LsortObjCmd(
 	}
     }
 
-    sortInfo.numElements = length;
-
     indexc = sortInfo.indexc;
     sortMode = sortInfo.sortMode;
     if ((sortMode == SORTMODE_ASCII_NC)
@@ -3890,21 +4026,37 @@ Tcl_LsortObjCmd(
     }
 
     /*
-     * Initialize the sublists. After the following loop, subList[i] will
-     * contain a sorted sublist of length 2**i. Use one extra subList at the
-     * end, always at NULL, to indicate the end of the lists.
+     * Sorts by number are done by TclRadixSort on keys made from the
+     * numbers, others by merge sort. Either way, the array allocated is
+     * twice as long as the list, to make room for the work space.
      */
 
-    for (j=0 ; j<=NUM_LISTS ; j++) {
-	subList[j] = NULL;
+    if ((sortMode == SORTMODE_INTEGER) || (sortMode == SORTMODE_REAL)) {
+	pairArray = TclStackAlloc(interp, 2 * length * sizeof(SortPair));
+    } else {
+	elementArray = TclStackAlloc(interp, 2 * length * sizeof(SortElement));
     }
 
     /*
-     * The following loop creates a SortElement for each list element and
-     * begins sorting it into the sublists as it appears.
+     * Plain string sorts with -unique drop the duplicates before sorting,
+     * through a hash table of the strings, so that each distinct string is
+     * sorted once. Of equal elements, the last one is kept, as the merge
+     * sort would keep it. Hashing costs more than it saves unless there are
+     * many duplicates, so it stops if there are few among the first
+     * UNIQUE_SAMPLE elements; the merge sort then drops the remaining ones,
+     * which come after the elements already placed.
      */
 
-    elementArray = TclStackAlloc(interp, length * sizeof(SortElement));
+    if (sortInfo.unique && sortInfo.sortMode == SORTMODE_ASCII) {
+	uniqueTablePtr = &uniqueTable;
+	Tcl_InitObjHashTable(uniqueTablePtr);
+    }
+    numElements = 0;
+
+    /*
+     * The following loop fills in the key of each element to sort, and the
+     * index of what it stands for in the list.
+     */
 
     for (i=0; i < length; i++){
 	idx = groupSize * i + groupOffset;
@@ -3920,12 +4072,51 @@ Tcl_LsortObjCmd(
 	    indexPtr = listObjPtrs[idx];
 	}
 
+	/*
+	 * With -keycommand, the key is what the command returns for the
+	 * element, computed once here rather than on every comparison.
+	 */
+
+	if (keyCmdPtr != NULL) {
+	    int code, cmdc;
+	    Tcl_Obj **cmdv;
+
+	    TclListObjLength(interp, keyCmdPtr, &cmdc);
+	    Tcl_ListObjReplace(interp, keyCmdPtr, cmdc - 1, 1, 1, &indexPtr);
+	    TclListObjGetElements(interp, keyCmdPtr, &cmdc, &cmdv);
+	    code = Tcl_EvalObjv(interp, cmdc, cmdv, 0);
+	    if (code != TCL_OK) {
+		Tcl_AddErrorInfo(interp, "\n    (-keycommand command)");
+		sortInfo.resultCode = code;
+		goto done1;
+	    }
+	    indexPtr = Tcl_GetObjResult(interp);
+	    Tcl_ListObjAppendElement(NULL, keyListPtr, indexPtr);
+	    Tcl_ResetResult(interp);
+	}
+
 	/*
 	 * Determine the "value" of this object for sorting purposes
 	 */
 
+	if (uniqueTablePtr != NULL) {
+	    hPtr = Tcl_CreateHashEntry(uniqueTablePtr, (char *) indexPtr,
+		    &isNew);
+	    if (isNew) {
+		Tcl_SetHashValue(hPtr, INT2PTR(numElements++));
+	    }
+	    slot = PTR2INT(Tcl_GetHashValue(hPtr));
+	    if (i + 1 == UNIQUE_SAMPLE && numElements > UNIQUE_SAMPLE / 2) {
+		Tcl_DeleteHashTable(uniqueTablePtr);
+		uniqueTablePtr = NULL;
+	    }
+	} else {
+	    slot = numElements++;
+	}
+
 	if (sortMode == SORTMODE_ASCII) {
-	    elementArray[i].collationKey.strValuePtr = TclGetString(indexPtr);
+	    elementArray[slot].collationKey.strValuePtr =
+		    TclGetString(indexPtr);
 	} else if (sortMode == SORTMODE_INTEGER) {
 	    long a;
 
@@ -3933,7 +4124,7 @@ Tcl_LsortObjCmd(
 		sortInfo.resultCode = TCL_ERROR;
 		goto done1;
 	    }
-	    elementArray[i].collationKey.intValue = a;
+	    key = TclLongSortKey(a);
 	} else if (sortInfo.sortMode == SORTMODE_REAL) {
 	    double a;
 
@@ -3942,46 +4133,56 @@ Tcl_LsortObjCmd(
 		sortInfo.resultCode = TCL_ERROR;
 		goto done1;
 	    }
-	    elementArray[i].collationKey.doubleValue = a;
+	    key = TclDoubleSortKey(a);
 	} else {
-	    elementArray[i].collationKey.objValuePtr = indexPtr;
+	    elementArray[slot].collationKey.objValuePtr = indexPtr;
 	}
 
-	/*
-	 * Determine the representation of this element in the result: either
-	 * the objPtr itself, or its index in the original list.
-	 */
-
-	if (indices || group) {
-	    elementArray[i].payload.index = idx;
+	if (pairArray) {
+	    pairArray[slot].key = (sortInfo.isIncreasing ? key : ~key);
+	    pairArray[slot].index = idx;
 	} else {
-	    elementArray[i].payload.objPtr = listObjPtrs[idx];
-	}
-
-	/*
-	 * Merge this element in the pre-existing sublists (and merge together
-	 * sublists when we have two of the same size).
-	 */
-
-	elementArray[i].nextPtr = NULL;
-	elementPtr = &elementArray[i];
-	for (j=0 ; subList[j] ; j++) {
-	    elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
-	    subList[j] = NULL;
-	}
-	if (j >= NUM_LISTS) {
-	    j = NUM_LISTS-1;
+	    elementArray[slot].index = idx;
 	}
-	subList[j] = elementPtr;
     }
 
     /*
-     * Merge all sublists
+     * Dictionary and case-insensitive sorts compare keys made from the
+     * strings once, rather than decoding the strings on every comparison.
      */
 
-    elementPtr = subList[0];
-    for (j=1 ; j<NUM_LISTS ; j++) {
-	elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
+    if (elementArray != NULL && (sortInfo.sortMode == SORTMODE_DICTIONARY
+	    || sortInfo.sortMode == SORTMODE_ASCII_NC)) {
+	sortKeys = MakeSortKeys(elementArray, numElements, sortInfo.sortMode);
+    }
+
+    if (pairArray) {
+	/*
+	 * The radix sort is stable, so when dropping duplicates, keeping the
+	 * last of each run of equal keys keeps the same element as the merge
+	 * sort would.
+	 */
+
+	sortedPairs = TclRadixSort(pairArray, pairArray + length, numElements);
+	numSorted = numElements;
+	if (sortInfo.unique) {
+	    for (i = 0, numSorted = 0; i < numElements; i++) {
+		if ((i + 1 < numElements)
+			&& (sortedPairs[i].key == sortedPairs[i+1].key)) {
+		    continue;
+		}
+		sortedPairs[numSorted++] = sortedPairs[i];
+	    }
+	}
+#ifdef TCL_THREADS
+    } else if (sortMode == SORTMODE_ASCII) {
+	sortedElements = ParallelSortElements(elementArray,
+		elementArray + length, numElements, &sortInfo, &numSorted);
+#endif
+    } else {
+	sortedElements = elementArray;
+	numSorted = SortElements(elementArray, elementArray + length,
+		numElements, &sortInfo);
     }
 
     /*
@@ -3991,51 +4192,60 @@ Tcl_LsortObjCmd(
     if (sortInfo.resultCode == TCL_OK) {
 	List *listRepPtr;
 	Tcl_Obj **newArray, *objPtr;
+	Tcl_Obj **smallInts = TclGetSmallIntTable();
 
-	resultPtr = Tcl_NewListObj(sortInfo.numElements * groupSize, NULL);
+	resultPtr = Tcl_NewListObj(numSorted * groupSize, NULL);
 	listRepPtr = resultPtr->internalRep.twoPtrValue.ptr1;
 	newArray = &listRepPtr->elements;
-	if (group) {
-	    for (i=0; elementPtr!=NULL ; elementPtr=elementPtr->nextPtr) {
-		idx = elementPtr->payload.index;
-		for (j = 0; j < groupSize; j++) {
+	for (i=0, j=0 ; i < numSorted ; i++) {
+	    idx = (pairArray ? sortedPairs[i].index : sortedElements[i].index);
+	    if (group) {
+		int k;
+
+		for (k = 0; k < groupSize; k++) {
 		    if (indices) {
-			objPtr = Tcl_NewIntObj(idx + j - groupOffset);
-			newArray[i++] = objPtr;
-			Tcl_IncrRefCount(objPtr);
+			objPtr = Tcl_NewIntObj(idx + k - groupOffset);
 		    } else {
-			objPtr = listObjPtrs[idx + j - groupOffset];
-			newArray[i++] = objPtr;
-			Tcl_IncrRefCount(objPtr);
+			objPtr = listObjPtrs[idx + k - groupOffset];
 		    }
+		    newArray[j++] = objPtr;
+		    Tcl_IncrRefCount(objPtr);
 		}
-	    }
-	} else if (indices) {
-	    for (i=0; elementPtr != NULL ; elementPtr = elementPtr->nextPtr) {
-		objPtr = Tcl_NewIntObj(elementPtr->payload.index);
-		newArray[i++] = objPtr;
-		Tcl_IncrRefCount(objPtr);
-	    }
-	} else {
-	    for (i=0; elementPtr != NULL ; elementPtr = elementPtr->nextPtr) {
-		objPtr = elementPtr->payload.objPtr;
-		newArray[i++] = objPtr;
+	    } else {
+		if (indices) {
+		    TclNewSharedIntObj(objPtr, smallInts, idx);
+		} else {
+		    objPtr = listObjPtrs[idx];
+		}
+		newArray[j++] = objPtr;
 		Tcl_IncrRefCount(objPtr);
 	    }
 	}
-	listRepPtr->elemCount = i;
+	listRepPtr->elemCount = j;
 	Tcl_SetObjResult(interp, resultPtr);
     }
 
   done1:
-    TclStackFree(interp, elementArray);
+    if (uniqueTablePtr != NULL) {
+	Tcl_DeleteHashTable(uniqueTablePtr);
+    }
+    if (sortKeys != NULL) {
+	ckfree(sortKeys);
+    }
+    TclStackFree(interp, (pairArray ? (void *) pairArray : elementArray));
 
   done:
-    if (sortInfo.sortMode == SORTMODE_COMMAND) {
+    if (sortInfo.compareCmdPtr != NULL) {
 	TclDecrRefCount(sortInfo.compareCmdPtr);
-	TclDecrRefCount(listObj);
 	sortInfo.compareCmdPtr = NULL;
     }
+    if (keyCmdPtr != NULL) {
+	TclDecrRefCount(keyCmdPtr);
+    }
+    if (keyListPtr != NULL) {
+	TclDecrRefCount(keyListPtr);
+    }
+    TclDecrRefCount(listObj);
   done2:
     if (allocatedIndexVector) {
 	TclStackFree(interp, sortInfo.indexv);
@@ -4046,109 +4256,327 @@ Tcl_LsortObjCmd(
 /*
  *----------------------------------------------------------------------
  *
- * MergeLists -
+ * SortElements, SortElementsInto --
  *
- *	This procedure combines two sorted lists of SortElement structures
- *	into a single sorted list.
+ *	These procedures sort an array of SortElement structures with a top
+ *	down merge sort. SortElements leaves the result in the array it sorts,
+ *	and SortElementsInto in the one it is given as work space. Each sorts
+ *	the two halves of the array with the other, so that the sorted halves
+ *	end up where the merge can take them from.
  *
  * Results:
- *	The unified list of SortElement structures.
+ *	The number of sorted elements, which is less than numElements if
+ *	infoPtr->unique is set and there were duplicates.
+ *
+ * Side effects:
+ *	The other array is used as work space. Possibly others, if a
+ *	user-defined comparison command does something weird.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SortElements(
+    SortElement *elementPtr,	/* The elements to sort. */
+    SortElement *workPtr,	/* Work space for as many elements. */
+    int numElements,		/* Number of elements to sort. */
+    SortInfo *infoPtr)		/* Information needed by the comparison
+				 * operator. */
+{
+    int half = numElements / 2, numLeft, numRight;
+
+    if (numElements < 2) {
+	return numElements;
+    }
+    numLeft = SortElementsInto(elementPtr, workPtr, half, infoPtr);
+    numRight = SortElementsInto(elementPtr + half, workPtr + half,
+	    numElements - half, infoPtr);
+    return MergeElements(workPtr, numLeft, workPtr + half, numRight,
+	    elementPtr, infoPtr);
+}
+
+static int
+SortElementsInto(
+    SortElement *elementPtr,	/* The elements to sort; left as work
+				 * space. */
+    SortElement *resultPtr,	/* Where to put the sorted elements. */
+    int numElements,		/* Number of elements to sort; at least 1. */
+    SortInfo *infoPtr)		/* Information needed by the comparison
+				 * operator. */
+{
+    int half = numElements / 2, numLeft, numRight;
+
+    if (numElements < 2) {
+	*resultPtr = *elementPtr;
+	return 1;
+    }
+    numLeft = SortElements(elementPtr, resultPtr, half, infoPtr);
+    numRight = SortElements(elementPtr + half, resultPtr + half,
+	    numElements - half, infoPtr);
+    return MergeElements(elementPtr, numLeft, elementPtr + half, numRight,
+	    resultPtr, infoPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MergeElements -
+ *
+ *	This procedure combines two sorted runs of SortElement structures
+ *	into a single sorted run. When elements compare equal, the one from
+ *	the left run comes first, which keeps the sort stable.
+ *
+ * Results:
+ *	The number of elements in the merged run.
  *
  * Side effects:
- *	If infoPtr->unique is set then infoPtr->numElements may be updated.
  *	Possibly others, if a user-defined comparison command does something
  *	weird.
  *
  * Note:
  *	If infoPtr->unique is set, the merge assumes that there are no
- *	"repeated" elements in each of the left and right lists. In that case,
- *	if any element of the left list is equivalent to one in the right list
- *	it is omitted from the merged list.
+ *	"repeated" elements in each of the left and right runs. In that case,
+ *	if any element of the left run is equivalent to one in the right run
+ *	it is omitted from the merged run, so that the last of the equivalent
+ *	elements of the list is the one kept.
  *
- *	This simplified mechanism works because of the special way our
- *	MergeSort creates the sublists to be merged and will fail to eliminate
- *	all repeats in the general case where they are already present in
- *	either the left or right list. A general code would need to skip
- *	adjacent initial repeats in the left and right lists before comparing
- *	their initial elements, at each step.
+ *	This simplified mechanism works because every run merged has itself
+ *	been merged that way, or holds a single element.
  *
  *----------------------------------------------------------------------
  */
 
-static SortElement *
-MergeLists(
-    SortElement *leftPtr,	/* First list to be merged; may be NULL. */
-    SortElement *rightPtr,	/* Second list to be merged; may be NULL. */
+static int
+MergeElements(
+    SortElement *leftPtr,	/* First run to be merged. */
+    int numLeft,		/* Number of elements in it. */
+    SortElement *rightPtr,	/* Second run to be merged. */
+    int numRight,		/* Number of elements in it. */
+    SortElement *resultPtr,	/* Where to put the merged run; must not
+				 * overlap either run. */
     SortInfo *infoPtr)		/* Information needed by the comparison
 				 * operator. */
 {
-    SortElement *headPtr, *tailPtr;
+    SortElement *leftEnd = leftPtr + numLeft;
+    SortElement *rightEnd = rightPtr + numRight;
+    SortElement *startPtr = resultPtr;
     int cmp;
 
-    if (leftPtr == NULL) {
-	return rightPtr;
-    }
-    if (rightPtr == NULL) {
-	return leftPtr;
-    }
-    cmp = SortCompare(leftPtr, rightPtr, infoPtr);
-    if (cmp > 0 || (cmp == 0 && infoPtr->unique)) {
-	if (cmp == 0) {
-	    infoPtr->numElements--;
-	    leftPtr = leftPtr->nextPtr;
-	}
-	tailPtr = rightPtr;
-	rightPtr = rightPtr->nextPtr;
-    } else {
-	tailPtr = leftPtr;
-	leftPtr = leftPtr->nextPtr;
-    }
-    headPtr = tailPtr;
     if (!infoPtr->unique) {
-	while ((leftPtr != NULL) && (rightPtr != NULL)) {
-	    cmp = SortCompare(leftPtr, rightPtr, infoPtr);
-	    if (cmp > 0) {
-		tailPtr->nextPtr = rightPtr;
-		tailPtr = rightPtr;
-		rightPtr = rightPtr->nextPtr;
+	while ((leftPtr < leftEnd) && (rightPtr < rightEnd)) {
+	    if (SortCompare(leftPtr, rightPtr, infoPtr) > 0) {
+		*resultPtr++ = *rightPtr++;
 	    } else {
-		tailPtr->nextPtr = leftPtr;
-		tailPtr = leftPtr;
-		leftPtr = leftPtr->nextPtr;
+		*resultPtr++ = *leftPtr++;
 	    }
 	}
     } else {
-	while ((leftPtr != NULL) && (rightPtr != NULL)) {
+	while ((leftPtr < leftEnd) && (rightPtr < rightEnd)) {
 	    cmp = SortCompare(leftPtr, rightPtr, infoPtr);
 	    if (cmp >= 0) {
 		if (cmp == 0) {
-		    infoPtr->numElements--;
-		    leftPtr = leftPtr->nextPtr;
+		    leftPtr++;
 		}
-		tailPtr->nextPtr = rightPtr;
-		tailPtr = rightPtr;
-		rightPtr = rightPtr->nextPtr;
+		*resultPtr++ = *rightPtr++;
 	    } else {
-		tailPtr->nextPtr = leftPtr;
-		tailPtr = leftPtr;
-		leftPtr = leftPtr->nextPtr;
+		*resultPtr++ = *leftPtr++;
 	    }
 	}
     }
-    if (leftPtr != NULL) {
-	tailPtr->nextPtr = leftPtr;
+    if (leftPtr < leftEnd) {
+	memcpy(resultPtr, leftPtr, (leftEnd - leftPtr) * sizeof(SortElement));
+	resultPtr += leftEnd - leftPtr;
+    }
+    if (rightPtr < rightEnd) {
+	memcpy(resultPtr, rightPtr,
+		(rightEnd - rightPtr) * sizeof(SortElement));
+	resultPtr += rightEnd - rightPtr;
+    }
+    return resultPtr - startPtr;
+}
+
+#ifdef TCL_THREADS
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParallelSortElements --
+ *
+ *	This procedure sorts an array of SortElement structures like
+ *	SortElements, splitting the work over several threads when the array
+ *	is large enough and there are several processors. Each thread sorts
+ *	a chunk of the array, then the sorted runs are merged in pairs, each
+ *	pair by a thread, until one run is left. The comparisons must not use
+ *	the interpreter, so this is only for sorts by string.
+ *
+ * Results:
+ *	The sorted array, which is either elementPtr or workPtr. The number
+ *	of elements in it is stored in *numSortedPtr.
+ *
+ * Side effects:
+ *	Threads are created and joined. The other array is used as work
+ *	space.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SortElement *
+ParallelSortElements(
+    SortElement *elementPtr,	/* The elements to sort. */
+    SortElement *workPtr,	/* Work space for as many elements. */
+    int numElements,		/* Number of elements to sort. */
+    SortInfo *infoPtr,		/* Information needed by the comparison
+				 * operator. */
+    int *numSortedPtr)		/* Where to store the number of sorted
+				 * elements. */
+{
+    SortJob jobs[MAX_SORT_THREADS];
+    int offsets[MAX_SORT_THREADS], counts[MAX_SORT_THREADS];
+    int numRuns = numElements / SORT_CHUNK_MIN, numJobs, i;
+    SortElement *fromPtr = elementPtr, *toPtr = workPtr, *tmpPtr;
+
+    if (numRuns > MAX_SORT_THREADS) {
+	numRuns = MAX_SORT_THREADS;
+    }
+    if ((numRuns >= 2) && (numRuns > TclpNumProcessors())) {
+	numRuns = TclpNumProcessors();
+    }
+    if (numRuns < 2) {
+	*numSortedPtr = SortElements(elementPtr, workPtr, numElements,
+		infoPtr);
+	return elementPtr;
+    }
+
+    /*
+     * Sort the chunks. Each is sorted in place, so the runs are in fromPtr.
+     */
+
+    for (i = 0; i < numRuns; i++) {
+	offsets[i] = (int) (((Tcl_WideInt) numElements * i) / numRuns);
+    }
+    for (i = 0; i < numRuns; i++) {
+	jobs[i].infoPtr = infoPtr;
+	jobs[i].leftPtr = fromPtr + offsets[i];
+	jobs[i].numLeft = ((i + 1 < numRuns) ? offsets[i+1] : numElements)
+		- offsets[i];
+	jobs[i].rightPtr = NULL;
+	jobs[i].resultPtr = toPtr + offsets[i];
+    }
+    RunSortJobs(jobs, numRuns);
+    for (i = 0; i < numRuns; i++) {
+	counts[i] = jobs[i].numResult;
+    }
+
+    /*
+     * Merge the runs in pairs from one array to the other. A run without a
+     * partner is copied over. The merged runs start where the first run of
+     * their pair did, which leaves them room enough.
+     */
+
+    while (numRuns > 1) {
+	for (numJobs = 0; 2 * numJobs + 1 < numRuns; numJobs++) {
+	    SortJob *jobPtr = &jobs[numJobs];
+
+	    jobPtr->leftPtr = fromPtr + offsets[2 * numJobs];
+	    jobPtr->numLeft = counts[2 * numJobs];
+	    jobPtr->rightPtr = fromPtr + offsets[2 * numJobs + 1];
+	    jobPtr->numRight = counts[2 * numJobs + 1];
+	    jobPtr->resultPtr = toPtr + offsets[2 * numJobs];
+	}
+	if (numRuns & 1) {
+	    memcpy(toPtr + offsets[numRuns - 1],
+		    fromPtr + offsets[numRuns - 1],
+		    counts[numRuns - 1] * sizeof(SortElement));
+	}
+	RunSortJobs(jobs, numJobs);
+	for (i = 0; i < numJobs; i++) {
+	    offsets[i] = offsets[2 * i];
+	    counts[i] = jobs[i].numResult;
+	}
+	if (numRuns & 1) {
+	    offsets[numJobs] = offsets[numRuns - 1];
+	    counts[numJobs] = counts[numRuns - 1];
+	    numJobs++;
+	}
+	numRuns = numJobs;
+	tmpPtr = fromPtr;
+	fromPtr = toPtr;
+	toPtr = tmpPtr;
+    }
+
+    *numSortedPtr = counts[0];
+    return fromPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RunSortJobs --
+ *
+ *	This procedure does a number of SortJobs at once, the first one in
+ *	the current thread and the others each in a thread of its own. A job
+ *	that no thread could be created for is done in the current thread.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The jobs are done and their numResult fields filled in.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RunSortJobs(
+    SortJob *jobs,		/* The jobs to do. */
+    int numJobs)		/* Number of jobs. */
+{
+    int i;
+
+    for (i = 1; i < numJobs; i++) {
+	jobs[i].threaded = (TclpThreadCreate(&jobs[i].threadId, SortJobThread,
+		&jobs[i], TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE)
+		== TCL_OK);
+    }
+    RunSortJob(&jobs[0]);
+    for (i = 1; i < numJobs; i++) {
+	if (jobs[i].threaded) {
+	    Tcl_JoinThread(jobs[i].threadId, NULL);
+	} else {
+	    RunSortJob(&jobs[i]);
+	}
+    }
+}
+
+static Tcl_ThreadCreateType
+SortJobThread(
+    ClientData clientData)	/* The SortJob to do. */
+{
+    RunSortJob(clientData);
+    TclpThreadExit(0);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+static void
+RunSortJob(
+    SortJob *jobPtr)		/* The job to do. */
+{
+    if (jobPtr->rightPtr == NULL) {
+	jobPtr->numResult = SortElements(jobPtr->leftPtr, jobPtr->resultPtr,
+		jobPtr->numLeft, jobPtr->infoPtr);
     } else {
-	tailPtr->nextPtr = rightPtr;
+	jobPtr->numResult = MergeElements(jobPtr->leftPtr, jobPtr->numLeft,
+		jobPtr->rightPtr, jobPtr->numRight, jobPtr->resultPtr,
+		jobPtr->infoPtr);
     }
-    return headPtr;
 }
+#endif /* TCL_THREADS */
 
 /*
  *----------------------------------------------------------------------
  *
  * SortCompare --
  *
- *	This procedure is invoked by MergeLists to determine the proper
+ *	This procedure is invoked by MergeElements to determine the proper
  *	ordering between two elements.
  *
  * Results:
@@ -4176,23 +4604,19 @@ SortCompare(
 	order = strcmp(elemPtr1->collationKey.strValuePtr,
 		elemPtr2->collationKey.strValuePtr);
     } else if (infoPtr->sortMode == SORTMODE_ASCII_NC) {
-	order = strcasecmp(elemPtr1->collationKey.strValuePtr,
-		elemPtr2->collationKey.strValuePtr);
+	order = CompareSortKeys(elemPtr1, elemPtr2);
     } else if (infoPtr->sortMode == SORTMODE_DICTIONARY) {
-	order = DictionaryCompare(elemPtr1->collationKey.strValuePtr,
-		elemPtr2->collationKey.strValuePtr);
-    } else if (infoPtr->sortMode == SORTMODE_INTEGER) {
-	long a, b;
-
-	a = elemPtr1->collationKey.intValue;
-	b = elemPtr2->collationKey.intValue;
-	order = ((a >= b) - (a <= b));
-    } else if (infoPtr->sortMode == SORTMODE_REAL) {
-	double a, b;
-
-	a = elemPtr1->collationKey.doubleValue;
-	b = elemPtr2->collationKey.doubleValue;
-	order = ((a >= b) - (a <= b));
+	/*
+	 * The keys only differ when the strings differ in something other
+	 * than case and leading zeros, which DictionaryCompare only looks at
+	 * to break ties.
+	 */
+
+	order = CompareSortKeys(elemPtr1, elemPtr2);
+	if (order == 0) {
+	    order = DictionaryCompare(elemPtr1->collationKey.strValuePtr,
+		    elemPtr2->collationKey.strValuePtr);
+	}
     } else {
 	Tcl_Obj **objv, *paramObjv[2];
 	int objc;
@@ -4384,6 +4808,222 @@ DictionaryCompare(
     return diff;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MakeSortKeys --
+ *
+ *	This procedure makes the sort keys of the elements of a -dictionary or
+ *	-nocase sort. The keys of all the elements are stored in a single
+ *	block of memory, sized by measuring them first.
+ *
+ * Results:
+ *	Returns the block holding the keys, which the caller must free with
+ *	ckfree once the sort is done.
+ *
+ * Side effects:
+ *	Sets the sortKey and sortKeyLength fields of each element.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char *
+MakeSortKeys(
+    SortElement *elementArray,	/* The elements to make keys for. */
+    int numElements,		/* Number of elements in elementArray. */
+    int sortMode)		/* SORTMODE_DICTIONARY or SORTMODE_ASCII_NC */
+{
+    int i, length;
+    size_t total = 0;
+    char *keys, *p;
+    const char *str;
+
+    for (i = 0; i < numElements; i++) {
+	str = elementArray[i].collationKey.strValuePtr;
+	if (sortMode == SORTMODE_DICTIONARY) {
+	    length = DictionaryKey(str, NULL);
+	} else {
+	    length = NocaseKey(str, NULL);
+	}
+	elementArray[i].sortKeyLength = length;
+	total += length;
+    }
+
+    keys = ckalloc(total + 1);
+    for (i = 0, p = keys; i < numElements; i++) {
+	str = elementArray[i].collationKey.strValuePtr;
+	elementArray[i].sortKey = p;
+	if (sortMode == SORTMODE_DICTIONARY) {
+	    p += DictionaryKey(str, p);
+	} else {
+	    p += NocaseKey(str, p);
+	}
+    }
+    return keys;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DictionaryKey --
+ *
+ *	This procedure makes the key of a string for a -dictionary sort: a
+ *	string of bytes that compares with memcmp the way DictionaryCompare
+ *	compares the string, except for the ties DictionaryCompare breaks by
+ *	case and leading zeros. Each character other than a decimal digit is
+ *	replaced by the UTF-8 of its lower case form. Each run of digits is
+ *	replaced by its digits without leading zeros, prefixed by a byte
+ *	giving their number, so that longer numbers sort after shorter ones.
+ *	That byte is itself a digit ('1' to '8', or '9' followed by the
+ *	number in four bytes), so that numbers sort among other characters
+ *	where their first digit would.
+ *
+ * Results:
+ *	Returns the length of the key. If key is NULL, only the length is
+ *	computed.
+ *
+ * Side effects:
+ *	Stores the key in the memory key refers to, when not NULL.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+DictionaryKey(
+    const char *str,		/* The string to make the key of. */
+    char *key)			/* Where to store the key, or NULL. */
+{
+    const char *start;
+    Tcl_UniChar ch;
+    int length = 0, numDigits;
+
+    while (*str != '\0') {
+	if (isdigit(UCHAR(*str))) {			/* INTL: digit */
+	    while ((*str == '0') && isdigit(UCHAR(str[1]))) {
+		str++;
+	    }
+	    start = str;
+	    while (isdigit(UCHAR(*str))) {		/* INTL: digit */
+		str++;
+	    }
+	    numDigits = str - start;
+	    if (key != NULL) {
+		char *p = key + length;
+
+		if (numDigits < 9) {
+		    *p++ = (char) ('0' + numDigits);
+		} else {
+		    *p++ = '9';
+		    *p++ = (char) (numDigits >> 24);
+		    *p++ = (char) (numDigits >> 16);
+		    *p++ = (char) (numDigits >> 8);
+		    *p++ = (char) numDigits;
+		}
+		memcpy(p, start, (size_t) numDigits);
+	    }
+	    length += (numDigits < 9 ? 1 : 5) + numDigits;
+	    continue;
+	}
+
+	/*
+	 * The lower case character is stored as standard UTF-8, with its
+	 * NUL as a single zero byte, so that the bytes compare the way the
+	 * characters do.
+	 */
+
+	str += Tcl_UtfToUniChar(str, &ch);
+	ch = Tcl_UniCharToLower(ch);
+	if (ch < 0x80) {
+	    if (key != NULL) {
+		key[length] = (char) ch;
+	    }
+	    length++;
+	} else if (ch < 0x800) {
+	    if (key != NULL) {
+		key[length] = (char) (0xC0 | (ch >> 6));
+		key[length+1] = (char) (0x80 | (ch & 0x3F));
+	    }
+	    length += 2;
+	} else {
+	    if (key != NULL) {
+		key[length] = (char) (0xE0 | (ch >> 12));
+		key[length+1] = (char) (0x80 | ((ch >> 6) & 0x3F));
+		key[length+2] = (char) (0x80 | (ch & 0x3F));
+	    }
+	    length += 3;
+	}
+    }
+    return length;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NocaseKey --
+ *
+ *	This procedure makes the key of a string for a -nocase sort: the
+ *	string with each byte folded to lower case, as strcasecmp does.
+ *
+ * Results:
+ *	Returns the length of the key. If key is NULL, only the length is
+ *	computed.
+ *
+ * Side effects:
+ *	Stores the key in the memory key refers to, when not NULL.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+NocaseKey(
+    const char *str,		/* The string to make the key of. */
+    char *key)			/* Where to store the key, or NULL. */
+{
+    const char *p;
+
+    if (key == NULL) {
+	return strlen(str);
+    }
+    for (p = str; *p != '\0'; p++) {
+	*key++ = (char) tolower(UCHAR(*p));
+    }
+    return p - str;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompareSortKeys --
+ *
+ *	This procedure compares the keys made by MakeSortKeys for two
+ *	elements.
+ *
+ * Results:
+ *	A negative, zero or positive result, as for memcmp; a key sorts after
+ *	the keys it starts with.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CompareSortKeys(
+    SortElement *elemPtr1, SortElement *elemPtr2)
+				/* Elements whose keys are compared. */
+{
+    int length1 = elemPtr1->sortKeyLength;
+    int length2 = elemPtr2->sortKeyLength;
+    int order = memcmp(elemPtr1->sortKey, elemPtr2->sortKey,
+	    (size_t) (length1 < length2 ? length1 : length2));
+
+    if (order == 0) {
+	order = length1 - length2;
+    }
+    return order;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -33,6 +33,19 @@ static int		TryPostHandler(ClientData data[], Tcl_Interp *interp,
 			    int result);
 static int		UniCharIsAscii(int character);
 static int		UniCharIsHexDigit(int character);
+static struct StringMap *BuildStringMap(Tcl_Obj *const mapElemv[],
+			    int mapElemc, int nocase);
+static void		ApplyStringMap(const struct StringMap *mapPtr,
+			    const Tcl_UniChar *ustring, int length,
+			    Tcl_Obj *resultPtr);
+static void		DupStringMapInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreeStringMap(struct StringMap *mapPtr);
+static void		FreeStringMapInternalRep(Tcl_Obj *objPtr);
+static inline int *	MapEdgeSlot(const struct StringMap *mapPtr, int node,
+			    int ch);
+static inline int	StringMapStep(const struct StringMap *mapPtr,
+			    int node, int ch);
 
 /*
  * Default set of characters to trim in [string trim] and friends. This is a
@@ -42,6 +55,101 @@ static int		UniCharIsHexDigit(int character);
  */
 
 #define DEFAULT_TRIM_SET " \t\n\r\xe1\x8d\xa1\xe1\x9a\x80\xe3\x80\x80"
+
+/*
+ * [string map] with more than one key builds an Aho-Corasick automaton from
+ * the keys, so that the string is scanned once whatever the number of keys.
+ * The automaton is a trie of the keys plus, for each node, a failure link to
+ * the node for the longest proper suffix of its string that is also in the
+ * trie. The edges of the trie are found through a hash table, except those
+ * leaving the root for characters below 256, which are in a plain array.
+ *
+ * The automaton is kept as the internal rep of the mapping list, so that
+ * maps used over and over again are only built once. It keeps a reference
+ * to each of the replacement values, but no reference to the list itself;
+ * using the mapping as a list again turns it back into a list.
+ */
+
+typedef struct MapEdge {
+    int node;			/* Node the edge leaves. */
+    int ch;			/* Character the edge is labelled with. */
+    int child;			/* Node the edge leads to. */
+    int next;			/* Next edge leaving the same node, or -1. */
+} MapEdge;
+
+typedef struct MapNode {
+    int firstEdge;		/* First edge leaving this node, or -1. */
+    int fail;			/* Node to continue from when no edge matches
+				 * the next character. */
+    int depth;			/* Number of characters spelled by the path
+				 * from the root to this node. */
+    int key;			/* Index of the first key spelled by this
+				 * node, or -1 if no key ends here. */
+    int outLink;		/* Nearest node along the failure links that
+				 * is the end of a key, or -1. */
+} MapNode;
+
+typedef struct StringMap {
+    int refCount;		/* Number of objects using this map. */
+    int nocase;			/* Whether keys match without regard to
+				 * case. */
+    int numKeys;		/* Number of key/value pairs. */
+    int maxLen;			/* Length of the longest key. */
+    int *keyLens;		/* Length of each key. */
+    Tcl_Obj **values;		/* Replacement value for each key. */
+    int numNodes;		/* Number of nodes in the trie. */
+    MapNode *nodes;		/* The nodes; node 0 is the root. */
+    int numEdges;		/* Number of edges in the trie. */
+    MapEdge *edges;		/* The edges, in the order they were made. */
+    int *edgeHash;		/* Open hash table of indices into edges, or
+				 * -1 for an empty slot. */
+    int hashShift;		/* 32 minus log2 of the size of edgeHash. */
+    unsigned hashMask;		/* The size of edgeHash minus one. */
+    int rootNext[256];		/* Node reached from the root for each
+				 * character below 256. When matching without
+				 * case, for the character before folding. */
+} StringMap;
+
+#define MAP_HASH(mapPtr, node, ch) \
+    ((((unsigned) (node) << 8) ^ (unsigned) (ch)) * 2654435761U \
+	    >> (mapPtr)->hashShift)
+
+static const Tcl_ObjType stringMapType = {
+    "stringmap",		/* name */
+    FreeStringMapInternalRep,	/* freeIntRepProc */
+    DupStringMapInternalRep,	/* dupIntRepProc */
+    NULL,			/* updateStringProc */
+    NULL			/* setFromAnyProc */
+};
+
+/*
+ * [regexp -channel] reads the text to match a chunk at a time. It keeps only
+ * the text from where a match might still begin, as reported by the regexp
+ * engine for patterns compiled with TCL_REG_CANMATCH, plus one character
+ * before it for ^ and word boundaries to look at. Memory use is bounded by
+ * the chunk size and the longest match in progress, not by the size of the
+ * text.
+ */
+
+typedef struct RegexpStream {
+    Tcl_Channel chan;		/* Channel the text is read from. */
+    Tcl_Obj *bufObj;		/* Text read and not yet discarded. */
+    Tcl_WideInt base;		/* Index in the whole text of the first
+				 * character of bufObj. */
+    int offset;			/* Index in bufObj where the next search
+				 * begins. May be one past its end. */
+    int eof;			/* Whether the whole text has been read. */
+    int started;		/* Whether a search has been completed. */
+} RegexpStream;
+
+#ifndef REGEXP_CHUNK
+#define REGEXP_CHUNK	65536	/* Characters read from the channel at a
+				 * time. */
+#endif
+
+static int		RegexpStreamExec(Tcl_Interp *interp,
+			    Tcl_RegExp regExpr, RegexpStream *streamPtr,
+			    int nmatches);
 
 /*
  *----------------------------------------------------------------------
@@ -108,19 +216,23 @@ Tcl_RegexpObjCmd(
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
     int i, indices, match, about, offset, all, doinline, numMatchesSaved;
-    int cflags, eflags, stringLength, matchLength;
+    int cflags, eflags, stringLength, matchLength, channel, mode, rangeBase;
+    int code = TCL_OK;
+    Tcl_WideInt indexBase;
     Tcl_RegExp regExpr;
     Tcl_Obj *objPtr, *startIndex = NULL, *resultPtr = NULL;
     Tcl_RegExpInfo info;
+    RegexpStream stream;
     static const char *const options[] = {
 	"-all",		"-about",	"-indices",	"-inline",
 	"-expanded",	"-line",	"-linestop",	"-lineanchor",
-	"-nocase",	"-start",	"--",		NULL
+	"-nocase",	"-start",	"-channel",	"--",
+	NULL
     };
     enum options {
 	REGEXP_ALL,	REGEXP_ABOUT,	REGEXP_INDICES,	REGEXP_INLINE,
 	REGEXP_EXPANDED,REGEXP_LINE,	REGEXP_LINESTOP,REGEXP_LINEANCHOR,
-	REGEXP_NOCASE,	REGEXP_START,	REGEXP_LAST
+	REGEXP_NOCASE,	REGEXP_START,	REGEXP_CHANNEL,	REGEXP_LAST
     };
 
     indices = 0;
@@ -129,6 +241,8 @@ Tcl_RegexpObjCmd(
     offset = 0;
     all = 0;
     doinline = 0;
+    channel = 0;
+    stream.bufObj = NULL;
 
     for (i = 1; i < objc; i++) {
 	const char *name;
@@ -185,6 +299,9 @@ Tcl_RegexpObjCmd(
 	    Tcl_IncrRefCount(startIndex);
 	    break;
 	}
+	case REGEXP_CHANNEL:
+	    channel = 1;
+	    break;
 	case REGEXP_LAST:
 	    i++;
 	    goto endOfForLoop;
@@ -228,19 +345,44 @@ Tcl_RegexpObjCmd(
     }
 
     /*
-     * Get the length of the string that we are matching against so we can do
-     * the termination test for -all matches. Do this before getting the
-     * regexp to avoid shimmering problems.
+     * With -channel, the text is read from the channel named by the string
+     * argument, and the engine must report where a match might still begin
+     * so that the text before that can be dropped.
      */
 
     objPtr = objv[1];
-    stringLength = Tcl_GetCharLength(objPtr);
+    stringLength = 0;
+    if (channel) {
+	if (startIndex) {
+	    Tcl_AppendResult(interp, "regexp -start not allowed"
+		    " when using -channel", NULL);
+	    goto optionError;
+	}
+	if (TclGetChannelFromObj(interp, objPtr, &stream.chan, &mode,
+		0) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if ((mode & TCL_READABLE) == 0) {
+	    Tcl_AppendResult(interp, "channel \"", TclGetString(objPtr),
+		    "\" wasn't opened for reading", NULL);
+	    return TCL_ERROR;
+	}
+	cflags |= TCL_REG_CANMATCH;
+    } else {
+	/*
+	 * Get the length of the string that we are matching against so we
+	 * can do the termination test for -all matches. Do this before
+	 * getting the regexp to avoid shimmering problems.
+	 */
 
-    if (startIndex) {
-	TclGetIntForIndexM(NULL, startIndex, stringLength, &offset);
-	Tcl_DecrRefCount(startIndex);
-	if (offset < 0) {
-	    offset = 0;
+	stringLength = Tcl_GetCharLength(objPtr);
+
+	if (startIndex) {
+	    TclGetIntForIndexM(NULL, startIndex, stringLength, &offset);
+	    Tcl_DecrRefCount(startIndex);
+	    if (offset < 0) {
+		offset = 0;
+	    }
 	}
     }
 
@@ -249,6 +391,25 @@ Tcl_RegexpObjCmd(
 	return TCL_ERROR;
     }
 
+    if (channel) {
+	/*
+	 * Lookahead constraints look at the text after a match, which might
+	 * not have been read yet when the match is found.
+	 */
+
+	if (((TclRegexp *) regExpr)->re.re_info & REG_ULOOKAHEAD) {
+	    Tcl_AppendResult(interp, "regexp -channel does not support"
+		    " lookahead constraints", NULL);
+	    return TCL_ERROR;
+	}
+	stream.bufObj = Tcl_NewObj();
+	Tcl_IncrRefCount(stream.bufObj);
+	stream.base = 0;
+	stream.offset = 0;
+	stream.eof = 0;
+	stream.started = 0;
+    }
+
     objc -= 2;
     objv += 2;
 
@@ -267,6 +428,9 @@ Tcl_RegexpObjCmd(
 
 	numMatchesSaved = (objc == 0) ? all : objc;
     }
+    if (channel && numMatchesSaved == 0) {
+	numMatchesSaved = 1;
+    }
 
     /*
      * The following loop is to handle multiple matches within the same source
@@ -276,25 +440,42 @@ Tcl_RegexpObjCmd(
      */
 
     while (1) {
-	/*
-	 * Pass either 0 or TCL_REG_NOTBOL in the eflags. Passing
-	 * TCL_REG_NOTBOL indicates that the character at offset should not be
-	 * considered the start of the line. If for example the pattern {^} is
-	 * passed and -start is positive, then the pattern will not match the
-	 * start of the string unless the previous character is a newline.
-	 */
+	if (channel) {
+	    /*
+	     * Matches are found in the text read so far, and ranges are
+	     * relative to it; indices are from the start of the whole text.
+	     */
 
-	if ((offset == 0) || ((offset > 0) &&
-		(Tcl_GetUniChar(objPtr, offset-1) == (Tcl_UniChar) '\n'))) {
-	    eflags = 0;
+	    match = RegexpStreamExec(interp, regExpr, &stream,
+		    numMatchesSaved);
+	    objPtr = stream.bufObj;
+	    rangeBase = 0;
+	    indexBase = stream.base;
 	} else {
-	    eflags = TCL_REG_NOTBOL;
-	}
+	    /*
+	     * Pass either 0 or TCL_REG_NOTBOL in the eflags. Passing
+	     * TCL_REG_NOTBOL indicates that the character at offset should
+	     * not be considered the start of the line. If for example the
+	     * pattern {^} is passed and -start is positive, then the pattern
+	     * will not match the start of the string unless the previous
+	     * character is a newline.
+	     */
 
-	match = Tcl_RegExpExecObj(interp, regExpr, objPtr, offset,
-		numMatchesSaved, eflags);
+	    if ((offset == 0) || ((offset > 0) && (offset <= stringLength) &&
+		    (Tcl_GetUniChar(objPtr, offset-1) == (Tcl_UniChar) '\n'))) {
+		eflags = 0;
+	    } else {
+		eflags = TCL_REG_NOTBOL;
+	    }
+
+	    match = Tcl_RegExpExecObj(interp, regExpr, objPtr, offset,
+		    numMatchesSaved, eflags);
+	    rangeBase = offset;
+	    indexBase = offset;
+	}
 	if (match < 0) {
-	    return TCL_ERROR;
+	    code = TCL_ERROR;
+	    goto done;
 	}
 
 	if (match == 0) {
@@ -313,7 +494,7 @@ Tcl_RegexpObjCmd(
 		if (!doinline) {
 		    Tcl_SetObjResult(interp, Tcl_NewIntObj(0));
 		}
-		return TCL_OK;
+		goto done;
 	    }
 	    break;
 	}
@@ -339,7 +520,7 @@ Tcl_RegexpObjCmd(
 	    Tcl_Obj *newPtr;
 
 	    if (indices) {
-		int start, end;
+		Tcl_WideInt start, end;
 		Tcl_Obj *objs[2];
 
 		/*
@@ -348,15 +529,15 @@ Tcl_RegexpObjCmd(
 		 */
 
 		if (i <= info.nsubs && info.matches[i].start >= 0) {
-		    start = offset + info.matches[i].start;
-		    end = offset + info.matches[i].end;
+		    start = indexBase + info.matches[i].start;
+		    end = indexBase + info.matches[i].end;
 
 		    /*
 		     * Adjust index so it refers to the last character in the
 		     * match instead of the first character after the match.
 		     */
 
-		    if (end >= offset) {
+		    if (end >= indexBase) {
 			end--;
 		    }
 		} else {
@@ -364,15 +545,15 @@ Tcl_RegexpObjCmd(
 		    end = -1;
 		}
 
-		objs[0] = Tcl_NewLongObj(start);
-		objs[1] = Tcl_NewLongObj(end);
+		objs[0] = Tcl_NewWideIntObj(start);
+		objs[1] = Tcl_NewWideIntObj(end);
 
 		newPtr = Tcl_NewListObj(2, objs);
 	    } else {
 		if (i <= info.nsubs) {
 		    newPtr = Tcl_GetRange(objPtr,
-			    offset + info.matches[i].start,
-			    offset + info.matches[i].end - 1);
+			    rangeBase + info.matches[i].start,
+			    rangeBase + info.matches[i].end - 1);
 		} else {
 		    newPtr = Tcl_NewObj();
 		}
@@ -382,7 +563,8 @@ Tcl_RegexpObjCmd(
 			!= TCL_OK) {
 		    Tcl_DecrRefCount(newPtr);
 		    Tcl_DecrRefCount(resultPtr);
-		    return TCL_ERROR;
+		    code = TCL_ERROR;
+		    goto done;
 		}
 	    } else {
 		Tcl_Obj *valuePtr;
@@ -391,7 +573,8 @@ Tcl_RegexpObjCmd(
 		if (valuePtr == NULL) {
 		    Tcl_AppendResult(interp, "couldn't set variable \"",
 			    TclGetString(objv[i]), "\"", NULL);
-		    return TCL_ERROR;
+		    code = TCL_ERROR;
+		    goto done;
 		}
 	    }
 	}
@@ -412,17 +595,22 @@ Tcl_RegexpObjCmd(
 
 	matchLength = (info.matches[0].end - info.matches[0].start);
 
-	offset += info.matches[0].end;
-
 	/*
 	 * A match of length zero could happen for {^} {$} or {.*} and in
-	 * these cases we always want to bump the index up one.
+	 * these cases we always want to bump the index up one. With -channel,
+	 * RegexpStreamExec makes the termination test once it knows whether
+	 * more text follows.
 	 */
 
+	all++;
+	if (channel) {
+	    stream.offset = info.matches[0].end + (matchLength == 0);
+	    continue;
+	}
+	offset += info.matches[0].end;
 	if (matchLength == 0) {
 	    offset++;
 	}
-	all++;
 	if (offset >= stringLength) {
 	    break;
 	}
@@ -439,7 +627,139 @@ Tcl_RegexpObjCmd(
     } else {
 	Tcl_SetObjResult(interp, Tcl_NewIntObj(all ? all-1 : 1));
     }
-    return TCL_OK;
+
+  done:
+    if (stream.bufObj != NULL) {
+	Tcl_DecrRefCount(stream.bufObj);
+    }
+    return code;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RegexpStreamExec --
+ *
+ *	Finds the next match of a regexp compiled with TCL_REG_CANMATCH in the
+ *	text of a channel, searching from streamPtr->offset. Reads more of the
+ *	text whenever the match found so far might still change with it: when
+ *	it reaches the end of what was read, or when a match that begins
+ *	earlier might end beyond it.
+ *
+ * Results:
+ *	-1 if reading or matching failed, with an error message in interp's
+ *	result, 1 if a match was found and 0 if there is none. The match
+ *	ranges are relative to streamPtr->bufObj.
+ *
+ * Side effects:
+ *	Reads from the channel, and replaces streamPtr->bufObj to drop the
+ *	text that no match can begin in any more.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RegexpStreamExec(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_RegExp regExpr,		/* Regexp compiled with TCL_REG_CANMATCH. */
+    RegexpStream *streamPtr,	/* Text and where to search it. */
+    int nmatches)		/* How many subexpression matches are of
+				 * interest; at least the whole match, whose
+				 * range tells whether it is final. */
+{
+    Tcl_RegExpInfo info;
+    Tcl_Obj *newObj;
+    Tcl_WideInt from = streamPtr->base + streamPtr->offset;
+    int length, keep, match, eflags;
+
+    while (1) {
+	/*
+	 * Like [regexp -all] on a string, stop once the search after a match
+	 * would begin at or past the end of the text.
+	 */
+
+	length = Tcl_GetCharLength(streamPtr->bufObj);
+	if (streamPtr->started && streamPtr->eof
+		&& from >= streamPtr->base + length) {
+	    return 0;
+	}
+
+	if (streamPtr->offset <= length) {
+	    eflags = (streamPtr->base > 0) ? TCL_REG_NOTBOL : 0;
+	    if (!streamPtr->eof) {
+		eflags |= TCL_REG_NOTEOL;
+	    }
+	    match = TclRegExpExecFrom(interp, regExpr, streamPtr->bufObj,
+		    streamPtr->offset, nmatches, eflags);
+	    if (match < 0) {
+		return -1;
+	    }
+	    if (streamPtr->eof) {
+		streamPtr->started = 1;
+		return match;
+	    }
+
+	    /*
+	     * No match begins before the point where one might still begin
+	     * if more text were added, nor, if there is a match, after its
+	     * start. It is final unless it reaches the end of the text read
+	     * or a match might begin before it.
+	     */
+
+	    Tcl_RegExpGetInfo(regExpr, &info);
+	    keep = (int) info.extendStart;
+	    if (match) {
+		if (keep >= length && info.matches[0].end < length) {
+		    streamPtr->started = 1;
+		    return 1;
+		}
+		if (info.matches[0].start < keep) {
+		    keep = info.matches[0].start;
+		}
+	    }
+	    if (keep > length) {
+		keep = length;
+	    }
+	    if (keep > streamPtr->offset) {
+		streamPtr->offset = keep;
+	    }
+	}
+
+	/*
+	 * Drop the text before the search point, except the character just
+	 * before it, and read some more.
+	 */
+
+	keep = ((streamPtr->offset < length) ? streamPtr->offset : length) - 1;
+	if (keep > 0) {
+	    newObj = Tcl_GetRange(streamPtr->bufObj, keep, length - 1);
+	    Tcl_IncrRefCount(newObj);
+	    Tcl_DecrRefCount(streamPtr->bufObj);
+	    streamPtr->bufObj = newObj;
+	    streamPtr->base += keep;
+	    streamPtr->offset -= keep;
+	}
+
+	if (Tcl_ReadChars(streamPtr->chan, streamPtr->bufObj, REGEXP_CHUNK,
+		1) < 0) {
+	    goto readError;
+	}
+	if (Tcl_Eof(streamPtr->chan)) {
+	    streamPtr->eof = 1;
+	} else if (Tcl_InputBlocked(streamPtr->chan)) {
+	    Tcl_SetErrno(EAGAIN);
+	    goto readError;
+	}
+    }
+
+  readError:
+    if (!TclChanCaughtErrorBypass(interp, streamPtr->chan)) {
+	Tcl_ResetResult(interp);
+	Tcl_AppendResult(interp, "error reading \"",
+		Tcl_GetChannelName(streamPtr->chan), "\": ",
+		Tcl_PosixError(interp), NULL);
+    }
+    return -1;
 }
 
 /*
@@ -1157,8 +1477,7 @@ StringFirstCmd(
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    Tcl_UniChar *needleStr, *haystackStr;
-    int match, start, needleLen, haystackLen;
+    int start = 0;
 
     if (objc < 3 || objc > 4) {
 	Tcl_WrongNumArgs(interp, 1, objv,
@@ -1166,82 +1485,28 @@ StringFirstCmd(
 	return TCL_ERROR;
     }
 
-    /*
-     * We are searching haystackStr for the sequence needleStr.
-     */
-
-    match = -1;
-    start = 0;
-    haystackLen = -1;
-
-    needleStr = Tcl_GetUnicodeFromObj(objv[1], &needleLen);
-    haystackStr = Tcl_GetUnicodeFromObj(objv[2], &haystackLen);
-
     if (objc == 4) {
 	/*
 	 * If a startIndex is specified, we will need to fast forward to that
-	 * point in the string before we think about a match.
+	 * point in the string before we think about a match. An invalid start
+	 * index is mapped to the string start; Bug #423581
 	 */
 
-	if (TclGetIntForIndexM(interp, objv[3], haystackLen-1,
-		&start) != TCL_OK){
-	    return TCL_ERROR;
-	}
-
-	/*
-	 * Reread to prevent shimmering problems.
-	 */
-
-	needleStr = Tcl_GetUnicodeFromObj(objv[1], &needleLen);
-	haystackStr = Tcl_GetUnicodeFromObj(objv[2], &haystackLen);
+	int end = Tcl_GetCharLength(objv[2]) - 1;
 
-	if (start >= haystackLen) {
-	    goto str_first_done;
-	} else if (start > 0) {
-	    haystackStr += start;
-	    haystackLen -= start;
-	} else if (start < 0) {
-	    /*
-	     * Invalid start index mapped to string start; Bug #423581
-	     */
-
-	    start = 0;
-	}
-    }
-
-    /*
-     * If the length of the needle is more than the length of the haystack, it
-     * cannot be contained in there so we can avoid searching. [Bug 2960021]
-     */
-
-    if (needleLen > 0 && needleLen <= haystackLen) {
-	register Tcl_UniChar *p, *end;
-
-	end = haystackStr + haystackLen - needleLen + 1;
-	for (p = haystackStr;  p < end;  p++) {
-	    /*
-	     * Scan forward to find the first character.
-	     */
-
-	    if ((*p == *needleStr) && (TclUniCharNcmp(needleStr, p,
-		    (unsigned long) needleLen) == 0)) {
-		match = p - haystackStr;
-		break;
-	    }
+	if (TclGetIntForIndexM(interp, objv[3], end, &start) != TCL_OK) {
+	    return TCL_ERROR;
 	}
     }
 
     /*
-     * Compute the character index of the matching string by counting the
-     * number of characters before the match.
+     * We are searching haystackString for the sequence needleString. The
+     * reps of the strings are only fetched after the index is parsed, to
+     * prevent shimmering problems.
      */
 
-    if ((match != -1) && (objc == 4)) {
-	match += start;
-    }
-
-  str_first_done:
-    Tcl_SetObjResult(interp, Tcl_NewIntObj(match));
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(
+	    TclStringFirst(objv[1], objv[2], start)));
     return TCL_OK;
 }
 
@@ -1270,8 +1535,7 @@ StringLastCmd(
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    Tcl_UniChar *needleStr, *haystackStr, *p;
-    int match, start, needleLen, haystackLen;
+    int last;
 
     if (objc < 3 || objc > 4) {
 	Tcl_WrongNumArgs(interp, 1, objv,
@@ -1279,67 +1543,24 @@ StringLastCmd(
 	return TCL_ERROR;
     }
 
-    /*
-     * We are searching haystackString for the sequence needleString.
-     */
-
-    match = -1;
-    start = 0;
-    haystackLen = -1;
-
-    needleStr = Tcl_GetUnicodeFromObj(objv[1], &needleLen);
-    haystackStr = Tcl_GetUnicodeFromObj(objv[2], &haystackLen);
-
+    last = Tcl_GetCharLength(objv[2]) - 1;
     if (objc == 4) {
 	/*
 	 * If a startIndex is specified, we will need to restrict the string
 	 * range to that char index in the string
 	 */
 
-	if (TclGetIntForIndexM(interp, objv[3], haystackLen-1,
-		&start) != TCL_OK){
+	if (TclGetIntForIndexM(interp, objv[3], last, &last) != TCL_OK) {
 	    return TCL_ERROR;
 	}
-
-	/*
-	 * Reread to prevent shimmering problems.
-	 */
-
-	needleStr = Tcl_GetUnicodeFromObj(objv[1], &needleLen);
-	haystackStr = Tcl_GetUnicodeFromObj(objv[2], &haystackLen);
-
-	if (start < 0) {
-	    goto str_last_done;
-	} else if (start < haystackLen) {
-	    p = haystackStr + start + 1 - needleLen;
-	} else {
-	    p = haystackStr + haystackLen - needleLen;
-	}
-    } else {
-	p = haystackStr + haystackLen - needleLen;
     }
 
     /*
-     * If the length of the needle is more than the length of the haystack, it
-     * cannot be contained in there so we can avoid searching. [Bug 2960021]
+     * We are searching haystackString for the sequence needleString.
      */
 
-    if (needleLen > 0 && needleLen <= haystackLen) {
-	for (; p >= haystackStr; p--) {
-	    /*
-	     * Scan backwards to find the first character.
-	     */
-
-	    if ((*p == *needleStr) && !memcmp(needleStr, p,
-		    sizeof(Tcl_UniChar) * (size_t)needleLen)) {
-		match = p - haystackStr;
-		break;
-	    }
-	}
-    }
-
-  str_last_done:
-    Tcl_SetObjResult(interp, Tcl_NewIntObj(match));
+    Tcl_SetObjResult(interp, Tcl_NewIntObj(
+	    TclStringLast(objv[1], objv[2], last)));
     return TCL_OK;
 }
 
@@ -1718,6 +1939,14 @@ StringIsCmd(
 	    goto str_is_done;
 	}
 	end = string1 + length1;
+	if (chcomp == UniCharIsAscii) {
+	    /*
+	     * ASCII bytes are ASCII characters; skip them a word at a time.
+	     */
+
+	    failat = TclUtfAsciiLength(string1, length1);
+	    string1 += failat;
+	}
 	for (; string1 < end; string1 += length2, failat++) {
 	    length2 = TclUtfToUniChar(string1, &ch);
 	    if (!chcomp(ch)) {
@@ -1782,9 +2011,10 @@ StringMapCmd(
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
     int length1, length2, mapElemc, index;
-    int nocase = 0, mapWithDict = 0, copySource = 0;
-    Tcl_Obj **mapElemv, *sourceObj, *resultPtr;
+    int nocase = 0, mapWithDict = 0, copySource = 0, keepMap;
+    Tcl_Obj **mapElemv, *mapObj, *sourceObj, *resultPtr;
     Tcl_UniChar *ustring1, *ustring2, *p, *end;
+    StringMap *mapPtr = NULL;
     int (*strCmpFn)(const Tcl_UniChar*, const Tcl_UniChar*, unsigned long);
 
     if (objc < 3 || objc > 4) {
@@ -1804,13 +2034,33 @@ StringMapCmd(
 	    return TCL_ERROR;
 	}
     }
+    mapObj = objv[objc-2];
+
+    /*
+     * A mapping that is used as a list or dictionary elsewhere would shimmer
+     * back and forth if it kept the automaton, so only keep it for mappings
+     * that are not.
+     */
+
+    keepMap = (mapObj->typePtr != &tclListType
+	    && mapObj->typePtr != &tclDictType);
 
     /*
      * This test is tricky, but has to be that way or you get other strange
      * inconsistencies (see test string-10.20 for illustration why!)
      */
 
-    if (objv[objc-2]->typePtr == &tclDictType && objv[objc-2]->bytes == NULL){
+    if (mapObj->typePtr == &stringMapType
+	    && ((StringMap *) mapObj->internalRep.otherValuePtr)->nocase
+		    == nocase) {
+	/*
+	 * The automaton for this mapping was built by an earlier call. Hold
+	 * on to it, in case the mapping is shimmered while we work.
+	 */
+
+	mapPtr = mapObj->internalRep.otherValuePtr;
+	mapPtr->refCount++;
+    } else if (mapObj->typePtr == &tclDictType && mapObj->bytes == NULL) {
 	int i, done;
 	Tcl_DictSearch search;
 
@@ -1819,7 +2069,7 @@ StringMapCmd(
 	 * sure. This shortens this code quite a bit.
 	 */
 
-	Tcl_DictObjSize(interp, objv[objc-2], &mapElemc);
+	Tcl_DictObjSize(interp, mapObj, &mapElemc);
 	if (mapElemc == 0) {
 	    /*
 	     * Empty charMap, just return whatever string was given.
@@ -1838,14 +2088,14 @@ StringMapCmd(
 	 */
 
 	mapElemv = TclStackAlloc(interp, sizeof(Tcl_Obj *) * mapElemc);
-	Tcl_DictObjFirst(interp, objv[objc-2], &search, mapElemv+0,
+	Tcl_DictObjFirst(interp, mapObj, &search, mapElemv+0,
 		mapElemv+1, &done);
 	for (i=2 ; i<mapElemc ; i+=2) {
 	    Tcl_DictObjNext(&search, mapElemv+i, mapElemv+i+1, &done);
 	}
 	Tcl_DictObjDone(&search);
     } else {
-	if (TclListObjGetElements(interp, objv[objc-2], &mapElemc,
+	if (TclListObjGetElements(interp, mapObj, &mapElemc,
 		&mapElemv) != TCL_OK) {
 	    return TCL_ERROR;
 	}
@@ -1872,7 +2122,7 @@ StringMapCmd(
      * string to cut out nasty sharing crashes. [Bug 1018562]
      */
 
-    if (objv[objc-2] == objv[objc-1]) {
+    if (mapObj == objv[objc-1]) {
 	sourceObj = Tcl_DuplicateObj(objv[objc-1]);
 	copySource = 1;
     } else {
@@ -1886,6 +2136,38 @@ StringMapCmd(
 
 	goto done;
     }
+
+    /*
+     * Building the automaton takes about as long as scanning a string as
+     * long as all the keys together, so a shorter string is scanned trying
+     * each key in turn instead.
+     */
+
+    if (mapPtr == NULL && mapElemc > 2) {
+	int keysLength = 0;
+
+	for (index = 0; index < mapElemc && keysLength <= length1;
+		index += 2) {
+	    keysLength += Tcl_GetCharLength(mapElemv[index]);
+	}
+	if (keysLength <= length1) {
+	    mapPtr = BuildStringMap(mapElemv, mapElemc, nocase);
+	    mapPtr->refCount++;
+	    if (keepMap && !mapWithDict) {
+		/*
+		 * Keep the automaton as the internal rep of the mapping list,
+		 * so that the next [string map] with the same list can use
+		 * it.
+		 */
+
+		(void) TclGetString(mapObj);
+		TclFreeIntRep(mapObj);
+		mapObj->internalRep.otherValuePtr = mapPtr;
+		mapObj->typePtr = &stringMapType;
+		mapPtr->refCount++;
+	    }
+	}
+    }
     end = ustring1 + length1;
 
     strCmpFn = (nocase ? Tcl_UniCharNcasecmp : Tcl_UniCharNcmp);
@@ -1895,8 +2177,11 @@ StringMapCmd(
      */
 
     resultPtr = Tcl_NewUnicodeObj(ustring1, 0);
+    p = ustring1;
 
-    if (mapElemc == 2) {
+    if (mapPtr != NULL) {
+	ApplyStringMap(mapPtr, ustring1, length1, resultPtr);
+    } else if (mapElemc == 2) {
 	/*
 	 * Special case for one map pair which avoids the extra for loop and
 	 * extra calls to get Unicode data. The algorithm is otherwise
@@ -1908,7 +2193,6 @@ StringMapCmd(
 	Tcl_UniChar *mapString, u2lc;
 
 	ustring2 = Tcl_GetUnicodeFromObj(mapElemv[0], &length2);
-	p = ustring1;
 	if ((length2 > length1) || (length2 == 0)) {
 	    /*
 	     * Match string is either longer than input or empty.
@@ -1958,7 +2242,7 @@ StringMapCmd(
 		u2lc[index/2] = Tcl_UniCharToLower(*mapStrings[index]);
 	    }
 	}
-	for (p = ustring1; ustring1 < end; ustring1++) {
+	for (; ustring1 < end; ustring1++) {
 	    for (index = 0; index < mapElemc; index += 2) {
 		/*
 		 * Get the key string to match on.
@@ -2013,6 +2297,9 @@ StringMapCmd(
     }
     Tcl_SetObjResult(interp, resultPtr);
   done:
+    if (mapPtr != NULL && --mapPtr->refCount <= 0) {
+	FreeStringMap(mapPtr);
+    }
     if (mapWithDict) {
 	TclStackFree(interp, mapElemv);
     }
@@ -2022,6 +2309,431 @@ StringMapCmd(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * BuildStringMap --
+ *
+ *	Build the Aho-Corasick automaton that [string map] uses for a mapping
+ *	with more than one key.
+ *
+ * Results:
+ *	Returns the new automaton, with a reference count of zero.
+ *
+ * Side effects:
+ *	Converts the keys to Unicode and keeps a reference to each value.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static StringMap *
+BuildStringMap(
+    Tcl_Obj *const mapElemv[],	/* Keys and values, alternating. */
+    int mapElemc,		/* Number of elements in mapElemv. */
+    int nocase)			/* Whether keys match without regard to
+				 * case. */
+{
+    StringMap *mapPtr = (StringMap *) ckalloc(sizeof(StringMap));
+    MapNode *nodes;
+    int numKeys = mapElemc / 2, maxNodes = 1, bits, i, k, e, *queue;
+    unsigned hashSize;
+
+    for (i = 0; i < mapElemc; i += 2) {
+	int length;
+
+	(void) Tcl_GetUnicodeFromObj(mapElemv[i], &length);
+	maxNodes += length;
+    }
+    for (bits = 1; (1U << bits) < 2U * maxNodes; bits++) {
+	/* Empty loop body. */
+    }
+    hashSize = 1U << bits;
+
+    mapPtr->refCount = 0;
+    mapPtr->nocase = nocase;
+    mapPtr->numKeys = numKeys;
+    mapPtr->maxLen = 0;
+    mapPtr->keyLens = (int *) ckalloc(numKeys * sizeof(int));
+    mapPtr->values = (Tcl_Obj **) ckalloc(numKeys * sizeof(Tcl_Obj *));
+    mapPtr->nodes = nodes = (MapNode *) ckalloc(maxNodes * sizeof(MapNode));
+    mapPtr->edges = (MapEdge *) ckalloc(maxNodes * sizeof(MapEdge));
+    mapPtr->edgeHash = (int *) ckalloc(hashSize * sizeof(int));
+    mapPtr->hashShift = 32 - bits;
+    mapPtr->hashMask = hashSize - 1;
+    for (i = 0; i < (int) hashSize; i++) {
+	mapPtr->edgeHash[i] = -1;
+    }
+    mapPtr->numNodes = 1;
+    mapPtr->numEdges = 0;
+    nodes[0].firstEdge = -1;
+    nodes[0].fail = 0;
+    nodes[0].depth = 0;
+    nodes[0].key = -1;
+    nodes[0].outLink = -1;
+
+    /*
+     * Enter the keys in the trie. When a key appears more than once, the
+     * first one wins, as it would when trying the keys in order.
+     */
+
+    for (k = 0; k < numKeys; k++) {
+	int length, node = 0;
+	const Tcl_UniChar *key =
+		Tcl_GetUnicodeFromObj(mapElemv[2*k], &length);
+
+	mapPtr->keyLens[k] = length;
+	mapPtr->values[k] = mapElemv[2*k+1];
+	Tcl_IncrRefCount(mapPtr->values[k]);
+	if (length > mapPtr->maxLen) {
+	    mapPtr->maxLen = length;
+	}
+	for (i = 0; i < length; i++) {
+	    int ch = (nocase ? Tcl_UniCharToLower(key[i]) : key[i]);
+	    int *slotPtr = MapEdgeSlot(mapPtr, node, ch);
+
+	    if (*slotPtr < 0) {
+		MapEdge *edgePtr = mapPtr->edges + mapPtr->numEdges;
+		MapNode *childPtr = nodes + mapPtr->numNodes;
+
+		edgePtr->node = node;
+		edgePtr->ch = ch;
+		edgePtr->child = mapPtr->numNodes++;
+		edgePtr->next = nodes[node].firstEdge;
+		nodes[node].firstEdge = *slotPtr = mapPtr->numEdges++;
+		childPtr->firstEdge = -1;
+		childPtr->depth = nodes[node].depth + 1;
+		childPtr->key = -1;
+	    }
+	    node = mapPtr->edges[*slotPtr].child;
+	}
+	if (length > 0 && nodes[node].key < 0) {
+	    nodes[node].key = k;
+	}
+    }
+
+    /*
+     * Compute the failure links breadth first, so that the links of all
+     * shallower nodes are known when they are needed.
+     */
+
+    for (i = 0; i < 256; i++) {
+	mapPtr->rootNext[i] = 0;
+    }
+    queue = (int *) ckalloc(mapPtr->numNodes * sizeof(int));
+    queue[0] = 0;
+    for (i = 0, k = 1; i < k; i++) {
+	int node = queue[i];
+
+	for (e = nodes[node].firstEdge; e >= 0; e = mapPtr->edges[e].next) {
+	    int ch = mapPtr->edges[e].ch, child = mapPtr->edges[e].child;
+	    int fail = 0;
+
+	    if (node == 0) {
+		if (ch < 256) {
+		    mapPtr->rootNext[ch] = child;
+		}
+	    } else {
+		fail = StringMapStep(mapPtr, nodes[node].fail, ch);
+	    }
+	    nodes[child].fail = fail;
+	    nodes[child].outLink =
+		    (nodes[fail].key >= 0 ? fail : nodes[fail].outLink);
+	    queue[k++] = child;
+	}
+    }
+    ckfree((char *) queue);
+
+    /*
+     * Without case, let rootNext give the node for each character as it is
+     * in the string, which saves folding the case of characters that cannot
+     * start a key. Folding is idempotent, so this still does for the folded
+     * characters looked up by StringMapStep.
+     */
+
+    if (nocase) {
+	int folded[256];
+
+	for (i = 0; i < 256; i++) {
+	    int ch = Tcl_UniCharToLower(i);
+
+	    folded[i] = (ch < 256 ? mapPtr->rootNext[ch]
+		    : StringMapStep(mapPtr, 0, ch));
+	}
+	memcpy(mapPtr->rootNext, folded, sizeof(folded));
+    }
+    return mapPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapEdgeSlot, StringMapStep --
+ *
+ *	Move through the automaton of a [string map]. MapEdgeSlot finds the
+ *	slot of the hash table of edges for an edge labelled "ch" leaving
+ *	"node"; the slot holds -1 if there is no such edge. StringMapStep
+ *	follows the edge for "ch" from "node", falling back along the failure
+ *	links until one is found.
+ *
+ * Results:
+ *	MapEdgeSlot returns a pointer to the slot, StringMapStep the node
+ *	reached.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static inline int *
+MapEdgeSlot(
+    const StringMap *mapPtr,
+    int node,
+    int ch)
+{
+    unsigned h = MAP_HASH(mapPtr, node, ch);
+
+    while (1) {
+	int e = mapPtr->edgeHash[h];
+
+	if (e < 0 || (mapPtr->edges[e].node == node
+		&& mapPtr->edges[e].ch == ch)) {
+	    return mapPtr->edgeHash + h;
+	}
+	h = (h + 1) & mapPtr->hashMask;
+    }
+}
+
+static inline int
+StringMapStep(
+    const StringMap *mapPtr,
+    int node,
+    int ch)
+{
+    int *slotPtr;
+
+    for (; node != 0; node = mapPtr->nodes[node].fail) {
+	slotPtr = MapEdgeSlot(mapPtr, node, ch);
+	if (*slotPtr >= 0) {
+	    return mapPtr->edges[*slotPtr].child;
+	}
+    }
+    if (ch < 256) {
+	return mapPtr->rootNext[ch];
+    }
+    slotPtr = MapEdgeSlot(mapPtr, 0, ch);
+    return (*slotPtr >= 0 ? mapPtr->edges[*slotPtr].child : 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ApplyStringMap --
+ *
+ *	Replace the keys of a [string map] automaton that occur in a string,
+ *	with the same results as trying the keys in order at each position.
+ *
+ *	The automaton reports each occurrence of a key when it reaches its
+ *	last character, so the best key found for each start position is
+ *	kept in a ring buffer until no other occurrence can start there or
+ *	earlier: that is once the start is before the string spelled by the
+ *	current node. Those positions are then settled from left to right.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Appends the mapped string to resultPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ApplyStringMap(
+    const StringMap *mapPtr,	/* The automaton for the mapping. */
+    const Tcl_UniChar *ustring,	/* String to map. */
+    int length,			/* Number of characters in ustring. */
+    Tcl_Obj *resultPtr)		/* Object to append the result to. */
+{
+    const MapNode *nodes = mapPtr->nodes;
+    int i, j, node = 0, copied = 0, pos = 0, limit, ringMask, *ring;
+    const Tcl_UniChar *value;
+    int valueLen;
+
+    if (mapPtr->maxLen == 1) {
+	/*
+	 * All keys are single characters: every node other than the root
+	 * ends a key, and there is nothing to wait for.
+	 */
+
+	for (i = 0; i < length; i++) {
+	    int ch = ustring[i];
+
+	    if (ch < 256) {
+		node = mapPtr->rootNext[ch];
+	    } else {
+		node = StringMapStep(mapPtr, 0,
+			mapPtr->nocase ? Tcl_UniCharToLower(ch) : ch);
+	    }
+	    if (node != 0) {
+		if (i > copied) {
+		    Tcl_AppendUnicodeToObj(resultPtr, ustring + copied,
+			    i - copied);
+		}
+		value = Tcl_GetUnicodeFromObj(mapPtr->values[nodes[node].key],
+			&valueLen);
+		Tcl_AppendUnicodeToObj(resultPtr, value, valueLen);
+		copied = i + 1;
+	    }
+	}
+	if (length > copied) {
+	    Tcl_AppendUnicodeToObj(resultPtr, ustring + copied,
+		    length - copied);
+	}
+	return;
+    }
+
+    for (ringMask = 1; ringMask <= mapPtr->maxLen; ringMask <<= 1) {
+	/* Empty loop body. */
+    }
+    ring = (int *) ckalloc(ringMask * sizeof(int));
+    for (i = 0; i < ringMask; i++) {
+	ring[i] = -1;
+    }
+    ringMask--;
+
+    for (i = 0; i <= length; i++) {
+	if (node == 0) {
+	    /*
+	     * No key is under way: skip over the characters that cannot
+	     * start one.
+	     */
+
+	    while (i < length && ustring[i] < 256
+		    && mapPtr->rootNext[ustring[i]] == 0) {
+		i++;
+	    }
+	    if (pos < i) {
+		pos = i;
+	    }
+	}
+	if (i < length) {
+	    int ch = ustring[i], m;
+
+	    if (mapPtr->nocase) {
+		ch = Tcl_UniCharToLower(ch);
+	    }
+	    node = StringMapStep(mapPtr, node, ch);
+
+	    /*
+	     * Record the keys ending here, unless they start inside text that
+	     * has already been replaced.
+	     */
+
+	    m = (nodes[node].key >= 0 ? node : nodes[node].outLink);
+	    for (; m >= 0; m = nodes[m].outLink) {
+		int start = i - nodes[m].depth + 1;
+		int *slotPtr = ring + (start & ringMask);
+
+		if (start >= pos && (*slotPtr < 0 || *slotPtr > nodes[m].key)) {
+		    *slotPtr = nodes[m].key;
+		}
+	    }
+	    limit = i - nodes[node].depth + 1;
+	} else {
+	    limit = length;
+	}
+
+	while (pos < limit) {
+	    int k = ring[pos & ringMask], matchEnd;
+
+	    if (k < 0) {
+		pos++;
+		continue;
+	    }
+	    if (pos > copied) {
+		Tcl_AppendUnicodeToObj(resultPtr, ustring + copied,
+			pos - copied);
+	    }
+	    value = Tcl_GetUnicodeFromObj(mapPtr->values[k], &valueLen);
+	    Tcl_AppendUnicodeToObj(resultPtr, value, valueLen);
+
+	    /*
+	     * Forget the keys found inside the replaced text.
+	     */
+
+	    matchEnd = pos + mapPtr->keyLens[k];
+	    for (j = pos; j < matchEnd && j <= i; j++) {
+		ring[j & ringMask] = -1;
+	    }
+	    pos = copied = matchEnd;
+	}
+    }
+    if (length > copied) {
+	Tcl_AppendUnicodeToObj(resultPtr, ustring + copied, length - copied);
+    }
+    ckfree((char *) ring);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeStringMap, FreeStringMapInternalRep, DupStringMapInternalRep --
+ *
+ *	Manage the lifetime of [string map] automatons and of the internal
+ *	reps that hold them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	FreeStringMap releases the memory of an automaton and its references
+ *	to the replacement values.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeStringMap(
+    StringMap *mapPtr)
+{
+    int k;
+
+    for (k = 0; k < mapPtr->numKeys; k++) {
+	Tcl_DecrRefCount(mapPtr->values[k]);
+    }
+    ckfree((char *) mapPtr->keyLens);
+    ckfree((char *) mapPtr->values);
+    ckfree((char *) mapPtr->nodes);
+    ckfree((char *) mapPtr->edges);
+    ckfree((char *) mapPtr->edgeHash);
+    ckfree((char *) mapPtr);
+}
+
+static void
+FreeStringMapInternalRep(
+    Tcl_Obj *objPtr)
+{
+    StringMap *mapPtr = objPtr->internalRep.otherValuePtr;
+
+    if (--mapPtr->refCount <= 0) {
+	FreeStringMap(mapPtr);
+    }
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupStringMapInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    StringMap *mapPtr = srcPtr->internalRep.otherValuePtr;
+
+    mapPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = mapPtr;
+    copyPtr->typePtr = &stringMapType;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3696,7 +4408,43 @@ TclNRSwitchObjCmd(
 	return TCL_ERROR;
     }
 
-    for (i = 0; i < objc; i += 2) {
+    /*
+     * With enough -regexp arms, find the first one that matches with a
+     * single automaton for all of them, rather than by trying each in turn.
+     * If the winner's captures are wanted, the loop below runs it again on
+     * its own; if no arm matches, the loop only looks at the default arm.
+     * Patterns that cannot be matched as a set are left to the loop.
+     */
+
+    i = 0;
+    if (mode == OPT_REGEXP) {
+	int numArms = objc / 2;
+
+	if (strcmp(TclGetString(objv[objc-2]), "default") == 0) {
+	    numArms--;
+	}
+	if (numArms >= TCL_SWITCH_REGEXP_SET_MIN) {
+	    regExpr = TclGetRegExpSet(numArms, objv, 2,
+		    TCL_REG_ADVANCED | (noCase ? TCL_REG_NOCASE : 0));
+	}
+	if (regExpr != NULL) {
+	    int matched = TclRegExpExecSet(interp, regExpr, stringObj, &j);
+
+	    if (matched < 0) {
+		return TCL_ERROR;
+	    } else if (!matched) {
+		i = 2 * numArms;
+	    } else {
+		i = 2 * j;
+		if (!numMatchesSaved) {
+		    pattern = TclGetString(objv[i]);
+		    goto matchFound;
+		}
+	    }
+	}
+    }
+
+    for (; i < objc; i += 2) {
 	/*
 	 * See if the pattern matches the string.
 	 */
@@ -3739,11 +4487,19 @@ TclNRSwitchObjCmd(
 		goto matchFound;
 	    }
 	    break;
-	case OPT_GLOB:
-	    if (Tcl_StringCaseMatch(TclGetString(stringObj),pattern,noCase)) {
+	case OPT_GLOB: {
+	    GlobPattern *globPtr = TclGetGlobPatternFromObj(objv[i],
+		    noCase ? TCL_MATCH_NOCASE : 0);
+	    int length, matched;
+	    const char *str = TclGetStringFromObj(stringObj, &length);
+
+	    matched = TclGlobPatternMatch(globPtr, str, length);
+	    TclReleaseGlobPattern(globPtr);
+	    if (matched) {
 		goto matchFound;
 	    }
 	    break;
+	}
 	case OPT_REGEXP:
 	    regExpr = Tcl_GetRegExpFromObj(interp, objv[i],
 		    TCL_REG_ADVANCED | (noCase ? TCL_REG_NOCASE : 0));
@@ -3851,6 +4607,20 @@ TclNRSwitchObjCmd(
      */
 
   matchFound:
+    for (j = i + 1; ; j += 2) {
+	if (j >= objc) {
+	    /*
+	     * This shouldn't happen since we've checked that the last body is
+	     * not a continuation...
+	     */
+
+	    Tcl_Panic("fall-out when searching for body to match pattern");
+	}
+	if (strcmp(TclGetString(objv[j]), "-") != 0) {
+	    break;
+	}
+    }
+
     ctxPtr = TclStackAlloc(interp, sizeof(CmdFrame));
     *ctxPtr = *iPtr->cmdFramePtr;
 
@@ -3880,10 +4650,19 @@ TclNRSwitchObjCmd(
 
 	if (ctxPtr->type == TCL_LOCATION_SOURCE && ctxPtr->line[bidx] >= 0) {
 	    int bline = ctxPtr->line[bidx];
+	    int k;
+
+	    /*
+	     * Only the body to be run needs its line; the list is not scanned
+	     * any further than that.
+	     */
 
 	    ctxPtr->line = (int *) ckalloc(objc * sizeof(int));
 	    ctxPtr->nline = objc;
-	    TclListLines(blist, bline, objc, ctxPtr->line, objv);
+	    TclListLines(blist, bline, j + 1, ctxPtr->line, objv);
+	    for (k = j + 1; k < objc; k++) {
+		ctxPtr->line[k] = -1;
+	    }
 	} else {
 	    /*
 	     * This is either a dynamic code word, when all elements are
@@ -3903,20 +4682,6 @@ TclNRSwitchObjCmd(
 	}
     }
 
-    for (j = i + 1; ; j += 2) {
-	if (j >= objc) {
-	    /*
-	     * This shouldn't happen since we've checked that the last body is
-	     * not a continuation...
-	     */
-
-	    Tcl_Panic("fall-out when searching for body to match pattern");
-	}
-	if (strcmp(TclGetString(objv[j]), "-") != 0) {
-	    break;
-	}
-    }
-
     /*
      * TIP #280: Make invoking context available to switch branch.
      */
@@ -4769,9 +5534,9 @@ TclListLines(
     Tcl_Obj *const *elems)      /* The list elems as Tcl_Obj*, in need of
 				 * derived continuation data */
 {
-    const char *listStr = Tcl_GetString(listObj);
+    int i, length;
+    const char *listStr = Tcl_GetStringFromObj(listObj, &length);
     const char *listHead = listStr;
-    int i, length = strlen(listStr);
     const char *element = NULL, *next = NULL;
     ContLineLoc *clLocPtr = TclContinuationsGet(listObj);
     int *clNext= (clLocPtr ? &clLocPtr->loc[0] : NULL);
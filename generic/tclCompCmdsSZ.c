@@ -1225,6 +1225,24 @@ TclCompileSwitchCmd(
 	goto freeTemporaries;
     }
 
+    /*
+     * Many -regexp arms are matched faster by the interpreted version, which
+     * tries them all at once (see TclNRSwitchObjCmd), than by a compiled
+     * test of each arm in turn.
+     */
+
+    if (mode == Switch_Regexp) {
+	int numArms = numWords / 2;
+
+	if (bodyToken[numWords-2]->size == 7
+		&& !memcmp(bodyToken[numWords-2]->start, "default", 7)) {
+	    numArms--;
+	}
+	if (numArms >= TCL_SWITCH_REGEXP_SET_MIN) {
+	    goto freeTemporaries;
+	}
+    }
+
     /*
      * Now we commit to generating code; the parsing stage per se is done.
      * Check if we can generate a jump table, since if so that's faster than
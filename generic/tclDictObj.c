@@ -67,6 +67,7 @@ static void		InvalidateDictChain(Tcl_Obj *dictObj);
 static int		SetDictFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 static void		UpdateStringOfDict(Tcl_Obj *dictPtr);
 static Tcl_HashEntry *	AllocChainEntry(Tcl_HashTable *tablePtr,void *keyPtr);
+static unsigned int	HashDictKey(Tcl_HashTable *tablePtr, void *keyPtr);
 static inline void	InitChainTable(struct Dict *dict);
 static inline void	DeleteChainTable(struct Dict *dict);
 static inline Tcl_HashEntry *CreateChainEntry(struct Dict *dict,
@@ -169,7 +170,9 @@ const Tcl_ObjType tclDictType = {
  * The type of the specially adapted version of the Tcl_Obj*-containing hash
  * table defined in the tclObj.c code. This version differs in that it
  * allocates a bit more space in each hash entry in order to hold the pointers
- * used to keep the hash entries in a linked list.
+ * used to keep the hash entries in a linked list. It also asks for large
+ * tables to be resized incrementally, so that growing a huge dictionary never
+ * stalls on rehashing all of its entries at once.
  *
  * Note that this type of hash table is *only* suitable for direct use in
  * *this* file. Everything else should use the dict iterator API.
@@ -177,8 +180,8 @@ const Tcl_ObjType tclDictType = {
 
 static const Tcl_HashKeyType chainHashType = {
     TCL_HASH_KEY_TYPE_VERSION,
-    0,
-    TclHashObjKey,
+    TCL_HASH_KEY_INCREMENTAL_RESIZE,
+    HashDictKey,
     TclCompareObjKeys,
     AllocChainEntry,
     TclFreeObjEntry
@@ -221,6 +224,34 @@ AllocChainEntry(
     return &cPtr->entry;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashDictKey --
+ *
+ *	Compute the hash of a dictionary key. Keys are usually literals or
+ *	values held in variables that are looked up again and again, so
+ *	shared pure strings are given a "String" internal rep in which
+ *	TclHashObjKey can cache the hash.
+ *
+ * Results:
+ *	The hash value of the key's string rep.
+ *
+ * Side effects:
+ *	May change the internal rep of the key; see TclPrepareStringHash.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned int
+HashDictKey(
+    Tcl_HashTable *tablePtr,
+    void *keyPtr)
+{
+    TclPrepareStringHash(keyPtr);
+    return TclHashObjKey(tablePtr, keyPtr);
+}
+
 /*
  * Helper functions that disguise most of the details relating to how the
  * linked list of hash entries is managed. In particular, these manage the
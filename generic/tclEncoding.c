@@ -82,6 +82,16 @@ typedef struct TableEncodingData {
 				 * is no corresponding character the encoding,
 				 * the value in the matrix is 0x0000.
 				 * malloc'd. */
+    int asciiIdentity;		/* Nonzero if the bytes 0x01 to 0x7F are
+				 * characters by themselves that map to the
+				 * same Unicode characters and back, and NUL
+				 * maps to NUL from Unicode, so runs of them
+				 * are copied as they are. */
+    char *mapPtr;		/* The compiled table file the pages of
+				 * toUnicode and fromUnicode point into, or
+				 * NULL if the pages were allocated with the
+				 * arrays. */
+    size_t mapSize;		/* Size of that file mapping. */
 } TableEncodingData;
 
 /*
@@ -192,6 +202,28 @@ static Tcl_Encoding systemEncoding;
 
 static unsigned short emptyPage[256];
 
+/*
+ * WORD_ONES has a 1 in the low bit of every byte of a machine word and
+ * WORD_HIGH_BITS the high bit of every byte, for finding runs of 7-bit
+ * characters a word at a time as in tclUtf.c.
+ */
+
+#define WORD_ONES		(~(size_t) 0 / 0xff)
+#define WORD_HIGH_BITS		(WORD_ONES * 0x80)
+
+/*
+ * ConvertAsciiRuns looks for a run of 7-bit characters to copy, then has the
+ * character by character converter do the next ASCII_RUN_RETRY bytes before
+ * it looks again. Each look that finds no run of at least ASCII_RUN_LONG
+ * bytes doubles that stretch, up to ASCII_RUN_MAX_RETRY, so that text with
+ * few long runs pays next to nothing for looking. UtfToUtfProc only looks
+ * when it meets a 7-bit character, at most once every ASCII_RUN_RETRY bytes.
+ */
+
+#define ASCII_RUN_RETRY		(2 * (int) sizeof(size_t))
+#define ASCII_RUN_MAX_RETRY	8192
+#define ASCII_RUN_LONG		64
+
 /*
  * Functions used only in this module.
  */
@@ -201,6 +233,14 @@ static int		BinaryProc(ClientData clientData,
 			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
 			    int *srcReadPtr, int *dstWrotePtr,
 			    int *dstCharsPtr);
+static int		ConvertAsciiRuns(Tcl_EncodingConvertProc *charsProc,
+			    int toUtf, ClientData clientData, const char *src,
+			    int srcLen, int flags,
+			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
+static int		CopyAsciiRun(const char *src, int srcLen, char *dst,
+			    int dstLen, int stopAtNull);
 static void		DupEncodingIntRep(Tcl_Obj *srcPtr, Tcl_Obj *dupPtr);
 static void		EscapeFreeProc(ClientData clientData);
 static int		EscapeFromUtfProc(ClientData clientData,
@@ -218,22 +258,35 @@ static void		FreeEncoding(Tcl_Encoding encoding);
 static void		FreeEncodingIntRep(Tcl_Obj *objPtr);
 static Encoding *	GetTableEncoding(EscapeEncodingData *dataPtr,
 			    int state);
+static Tcl_Encoding	LoadCompiledEncoding(const char *name,
+			    Tcl_Obj *directory);
 static Tcl_Encoding	LoadEncodingFile(Tcl_Interp *interp, const char *name);
 static Tcl_Encoding	LoadTableEncoding(const char *name, int type,
 			    Tcl_Channel chan);
 static Tcl_Encoding	LoadEscapeEncoding(const char *name, Tcl_Channel chan);
 static Tcl_Channel	OpenEncodingFileChannel(Tcl_Interp *interp,
 			    const char *name);
+static int		TableAsciiIdentity(TableEncodingData *dataPtr);
 static void		TableFreeProc(ClientData clientData);
 static int		TableFromUtfProc(ClientData clientData,
 			    const char *src, int srcLen, int flags,
 			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
 			    int *srcReadPtr, int *dstWrotePtr,
 			    int *dstCharsPtr);
+static int		TableFromUtfChars(ClientData clientData,
+			    const char *src, int srcLen, int flags,
+			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
 static int		TableToUtfProc(ClientData clientData, const char *src,
 			    int srcLen, int flags, Tcl_EncodingState *statePtr,
 			    char *dst, int dstLen, int *srcReadPtr,
 			    int *dstWrotePtr, int *dstCharsPtr);
+static int		TableToUtfChars(ClientData clientData,
+			    const char *src, int srcLen, int flags,
+			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
 static size_t		unilen(const char *src);
 static int		UnicodeToUtfProc(ClientData clientData,
 			    const char *src, int srcLen, int flags,
@@ -265,11 +318,21 @@ static int		Iso88591FromUtfProc(ClientData clientData,
 			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
 			    int *srcReadPtr, int *dstWrotePtr,
 			    int *dstCharsPtr);
+static int		Iso88591FromUtfChars(ClientData clientData,
+			    const char *src, int srcLen, int flags,
+			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
 static int		Iso88591ToUtfProc(ClientData clientData,
 			    const char *src, int srcLen, int flags,
 			    Tcl_EncodingState *statePtr, char *dst,
 			    int dstLen, int *srcReadPtr, int *dstWrotePtr,
 			    int *dstCharsPtr);
+static int		Iso88591ToUtfChars(ClientData clientData,
+			    const char *src, int srcLen, int flags,
+			    Tcl_EncodingState *statePtr, char *dst, int dstLen,
+			    int *srcReadPtr, int *dstWrotePtr,
+			    int *dstCharsPtr);
 
 /*
  * A Tcl_ObjType for holding a cached Tcl_Encoding in the otherValuePtr field
@@ -615,6 +678,7 @@ TclInitEncodingSubsystem(void)
 	dataPtr->toUnicode[0][i] = i;
 	dataPtr->fromUnicode[0][i] = i;
     }
+    dataPtr->asciiIdentity = TableAsciiIdentity(dataPtr);
 
     type.encodingName	= "iso8859-1";
     type.toUtfProc	= Iso88591ToUtfProc;
@@ -1582,6 +1646,7 @@ LoadEncodingFile(
 {
     Tcl_Channel chan = NULL;
     Tcl_Encoding encoding = NULL;
+    Tcl_Obj *nameObj, *directory = NULL;
     int ch;
 
     chan = OpenEncodingFileChannel(interp, name);
@@ -1589,6 +1654,26 @@ LoadEncodingFile(
 	return NULL;
     }
 
+    /*
+     * Use the compiled form of the tables, if it was installed next to the
+     * encoding file where the channel was found.
+     */
+
+    nameObj = Tcl_NewStringObj(name, -1);
+    Tcl_IncrRefCount(nameObj);
+    Tcl_DictObjGet(NULL, TclGetProcessGlobalValue(&encodingFileMap), nameObj,
+	    &directory);
+    if (directory != NULL) {
+	Tcl_IncrRefCount(directory);
+	encoding = LoadCompiledEncoding(name, directory);
+	Tcl_DecrRefCount(directory);
+    }
+    Tcl_DecrRefCount(nameObj);
+    if (encoding != NULL) {
+	Tcl_Close(NULL, chan);
+	return encoding;
+    }
+
     Tcl_SetChannelOption(NULL, chan, "-encoding", "utf-8");
 
     while (1) {
@@ -1909,6 +1994,7 @@ LoadTableEncoding(
     }
   doneParse:
     Tcl_DStringFree(&lineString);
+    dataPtr->asciiIdentity = TableAsciiIdentity(dataPtr);
 
     /*
      * Package everything into an encoding structure.
@@ -1924,6 +2010,143 @@ LoadTableEncoding(
     return Tcl_CreateEncoding(&encType);
 }
 
+/*
+ *-------------------------------------------------------------------------
+ *
+ * LoadCompiledEncoding --
+ *
+ *	Helper function for LoadEncodingFile(). Creates a table encoding from
+ *	"name.tbl", the tables of "name.enc" compiled by
+ *	tools/encodingTables.tcl, in the same directory. The file is mapped
+ *	into memory and the pages are used where they lie, so they are read
+ *	only as they are touched and shared by all processes using the
+ *	encoding; only the two arrays of page pointers are allocated.
+ *
+ * Results:
+ *	The return value is the new encoding, or NULL if there is no compiled
+ *	table, it cannot be mapped, or it was not made from this encoding file
+ *	for this byte order. The table records the size and CRC-32 of the
+ *	encoding file it was made from, which must match the file now there,
+ *	since installing does not keep modification times. The caller then
+ *	parses the encoding file.
+ *
+ * Side effects:
+ *	The file stays mapped until the encoding is freed.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#define TABLE_MAGIC	0x54636c45	/* "TclE" in native byte order. */
+#define TABLE_VERSION	2
+#define TABLE_HEADER	(7 * 4 + 2 * 256 * sizeof(unsigned short))
+
+static Tcl_Encoding
+LoadCompiledEncoding(
+    const char *name,		/* Name for new encoding. */
+    Tcl_Obj *directory)		/* Directory holding the encoding file. */
+{
+    Tcl_Obj *fileObj, *pathPtr, *encPathPtr;
+    char *mapPtr, *encPtr;
+    size_t mapSize, encSize;
+    const unsigned int *header;
+    const unsigned short *index;
+    unsigned short *pages;
+    TableEncodingData *dataPtr;
+    Tcl_EncodingType encType;
+    int hi, type;
+
+    fileObj = Tcl_ObjPrintf("%s.enc", name);
+    Tcl_IncrRefCount(fileObj);
+    encPathPtr = Tcl_FSJoinToPath(directory, 1, &fileObj);
+    Tcl_IncrRefCount(encPathPtr);
+    Tcl_DecrRefCount(fileObj);
+
+    fileObj = Tcl_ObjPrintf("%s.tbl", name);
+    Tcl_IncrRefCount(fileObj);
+    pathPtr = Tcl_FSJoinToPath(directory, 1, &fileObj);
+    Tcl_IncrRefCount(pathPtr);
+    Tcl_DecrRefCount(fileObj);
+    mapPtr = TclpMapFile(pathPtr, &mapSize);
+    Tcl_DecrRefCount(pathPtr);
+    if (mapPtr == NULL) {
+	Tcl_DecrRefCount(encPathPtr);
+	return NULL;
+    }
+
+    /*
+     * Check the header and that every page number is in range, so that the
+     * conversion procedures can trust the tables as they trust the ones built
+     * by LoadTableEncoding().
+     */
+
+    header = (const unsigned int *) mapPtr;
+    index = (const unsigned short *) (mapPtr + 7 * 4);
+    pages = (unsigned short *) (mapPtr + TABLE_HEADER);
+    type = (mapSize < TABLE_HEADER) ? 0 : (int) header[4];
+    if ((type != 'S' && type != 'D' && type != 'M')
+	    || header[0] != TABLE_MAGIC || header[1] != TABLE_VERSION
+	    || header[6] > 512 || mapSize != TABLE_HEADER
+		    + header[6] * 256 * sizeof(unsigned short)) {
+	goto stale;
+    }
+    for (hi = 0; hi < 2 * 256; hi++) {
+	if (index[hi] > header[6]) {
+	    goto stale;
+	}
+    }
+
+    /*
+     * Check that the encoding file is the one the table was made from. Its
+     * size is compared first, since that needs no reading.
+     */
+
+    encPtr = TclpMapFile(encPathPtr, &encSize);
+    if (encPtr == NULL) {
+	goto stale;
+    }
+    if ((size_t) header[2] != encSize || header[3] != Tcl_ZlibCRC32(0,
+	    (unsigned char *) encPtr, (int) encSize)) {
+	TclpUnmapFile(encPtr, encSize);
+	goto stale;
+    }
+    TclpUnmapFile(encPtr, encSize);
+    Tcl_DecrRefCount(encPathPtr);
+
+    dataPtr = (TableEncodingData *) ckalloc(sizeof(TableEncodingData));
+    memset(dataPtr, 0, sizeof(TableEncodingData));
+    dataPtr->fallback = (int) header[5];
+    dataPtr->mapPtr = mapPtr;
+    dataPtr->mapSize = mapSize;
+    dataPtr->toUnicode = (unsigned short **)
+	    ckalloc(256 * sizeof(unsigned short *));
+    dataPtr->fromUnicode = (unsigned short **)
+	    ckalloc(256 * sizeof(unsigned short *));
+    for (hi = 0; hi < 256; hi++) {
+	dataPtr->toUnicode[hi] = (index[hi] == 0) ? emptyPage
+		: pages + (index[hi] - 1) * 256;
+	dataPtr->fromUnicode[hi] = (index[256 + hi] == 0) ? emptyPage
+		: pages + (index[256 + hi] - 1) * 256;
+	if (type == 'D' || (hi > 0 && index[hi] != 0)) {
+	    dataPtr->prefixBytes[hi] = 1;
+	}
+    }
+    dataPtr->asciiIdentity = TableAsciiIdentity(dataPtr);
+
+    encType.encodingName    = name;
+    encType.toUtfProc	    = TableToUtfProc;
+    encType.fromUtfProc	    = TableFromUtfProc;
+    encType.freeProc	    = TableFreeProc;
+    encType.nullSize	    = (type == 'D') ? 2 : 1;
+    encType.clientData	    = dataPtr;
+
+    return Tcl_CreateEncoding(&encType);
+
+  stale:
+    TclpUnmapFile(mapPtr, mapSize);
+    Tcl_DecrRefCount(encPathPtr);
+    return NULL;
+}
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -2053,6 +2276,150 @@ LoadEscapeEncoding(
     return Tcl_CreateEncoding(&type);
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CopyAsciiRun --
+ *
+ *	Copy a run of 7-bit characters, which the converters pass through
+ *	unchanged, checking them a machine word at a time. Runs shorter than
+ *	two words are left to the character by character path.
+ *
+ * Results:
+ *	The length of the run, at most srcLen and dstLen bytes and ending
+ *	before the first null byte, which the caller converts to 0xc080, if
+ *	stopAtNull is set; 0 if it is shorter than two words.
+ *
+ * Side effects:
+ *	Copies the run to dst.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+CopyAsciiRun(
+    const char *src,		/* Source string. */
+    int srcLen,			/* Source string length in bytes. */
+    char *dst,			/* Output buffer. */
+    int dstLen,			/* Room left in the output buffer. */
+    int stopAtNull)		/* Nonzero if null bytes end the run. */
+{
+    size_t w[2];
+    int run;
+
+    if (srcLen < (int) sizeof(w) || dstLen < (int) sizeof(w)) {
+	return 0;
+    }
+    memcpy(w, src, sizeof(w));
+    if (((w[0] | w[1]) & WORD_HIGH_BITS) || (stopAtNull
+	    && (((w[0] - WORD_ONES) | (w[1] - WORD_ONES)) & WORD_HIGH_BITS))) {
+	return 0;
+    }
+    run = sizeof(w) + TclUtfAsciiLength(src + sizeof(w),
+	    ((srcLen < dstLen) ? srcLen : dstLen) - (int) sizeof(w));
+    if (stopAtNull) {
+	const char *nul = memchr(src, 0, (size_t) run);
+
+	if (nul != NULL) {
+	    run = nul - src;
+	}
+    }
+    memcpy(dst, src, (size_t) run);
+    return run;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * ConvertAsciiRuns --
+ *
+ *	Convert a string with a converter whose encoding leaves 7-bit
+ *	characters alone, copying the runs of them that are long enough and
+ *	handing the stretches in between to charsProc, which converts
+ *	character by character. A character that charsProc finds cut off at
+ *	the end of a stretch is converted with the next one.
+ *
+ * Results:
+ *	Returns TCL_OK if conversion was successful, or the first error of
+ *	charsProc.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+ConvertAsciiRuns(
+    Tcl_EncodingConvertProc *charsProc,
+				/* Converts the stretches between runs. */
+    int toUtf,			/* Nonzero if the conversion is into UTF-8,
+				 * where null bytes end a run and charsProc
+				 * leaves room for a whole character. */
+    ClientData clientData,	/* Passed to charsProc. */
+    const char *src,		/* Source string. */
+    int srcLen,			/* Source string length in bytes. */
+    int flags,			/* Conversion control flags. */
+    Tcl_EncodingState *statePtr,/* Passed to charsProc. */
+    char *dst,			/* Output buffer in which converted string is
+				 * stored. */
+    int dstLen,			/* The maximum length of output buffer in
+				 * bytes. */
+    int *srcReadPtr,		/* Filled with the number of bytes from the
+				 * source string that were converted. */
+    int *dstWrotePtr,		/* Filled with the number of bytes that were
+				 * stored in the output buffer. */
+    int *dstCharsPtr)		/* Filled with the number of characters that
+				 * correspond to the bytes stored in the
+				 * output buffer. */
+{
+    const char *srcStart = src, *srcEnd = src + srcLen;
+    char *dstStart = dst, *dstEnd = dst + dstLen;
+    int result = TCL_OK, numChars = 0, span = ASCII_RUN_RETRY;
+    int run, segLen, segFlags, cut, bytesRead, bytesWrote, chars;
+
+    if (toUtf) {
+	dstEnd -= TCL_UTF_MAX - 1;
+    }
+    while (src < srcEnd) {
+	run = CopyAsciiRun(src, srcEnd - src, dst, dstEnd - dst, toUtf);
+	src += run;
+	dst += run;
+	numChars += run;
+	if (run >= ASCII_RUN_LONG) {
+	    span = ASCII_RUN_RETRY;
+	} else if (span < ASCII_RUN_MAX_RETRY) {
+	    span *= 2;
+	}
+	if (src == srcEnd) {
+	    break;
+	}
+
+	segLen = srcEnd - src;
+	segFlags = flags;
+	cut = (segLen > span);
+	if (cut) {
+	    segLen = span;
+	    segFlags &= ~TCL_ENCODING_END;
+	}
+	result = charsProc(clientData, src, segLen, segFlags, statePtr, dst,
+		dstStart + dstLen - dst, &bytesRead, &bytesWrote, &chars);
+	src += bytesRead;
+	dst += bytesWrote;
+	numChars += chars;
+	if ((result == TCL_CONVERT_MULTIBYTE) && cut) {
+	    result = TCL_OK;
+	} else if (result != TCL_OK) {
+	    break;
+	}
+    }
+
+    *srcReadPtr = src - srcStart;
+    *dstWrotePtr = dst - dstStart;
+    *dstCharsPtr = numChars;
+    return result;
+}
+
 /*
  *-------------------------------------------------------------------------
  *
@@ -2260,7 +2627,7 @@ UtfToUtfProc(
 				 * representation to real null-bytes or vice
 				 * versa. */
 {
-    const char *srcStart, *srcEnd, *srcClose;
+    const char *srcStart, *srcEnd, *srcClose, *runPtr;
     const char *dstStart, *dstEnd;
     int result, numChars;
     Tcl_UniChar ch;
@@ -2269,6 +2636,7 @@ UtfToUtfProc(
 
     srcStart = src;
     srcEnd = src + srcLen;
+    runPtr = src;
     srcClose = srcEnd;
     if ((flags & TCL_ENCODING_END) == 0) {
 	srcClose -= TCL_UTF_MAX;
@@ -2293,11 +2661,47 @@ UtfToUtfProc(
 	}
 	if (UCHAR(*src) < 0x80 && !(UCHAR(*src) == 0 && pureNullMode == 0)) {
 	    /*
-	     * Copy 7bit chatacters, but skip null-bytes when we are in input
-	     * mode, so that they get converted to 0xc080.
+	     * Copy 7bit chatacters, as many as there are in a row and there is
+	     * room for, but skip null-bytes when we are in input mode, so that
+	     * they get converted to 0xc080.
 	     */
 
+	    if (src >= runPtr) {
+		int run = CopyAsciiRun(src, srcEnd - src, dst,
+			dstEnd - dst + 1, pureNullMode == 0);
+
+		if (run > 0) {
+		    src += run;
+		    dst += run;
+		    numChars += run - 1;
+		    continue;
+		}
+		runPtr = src + ASCII_RUN_RETRY;
+	    }
 	    *dst++ = *src++;
+	} else if (UCHAR(*src) >= 0xC2 && UCHAR(*src) < 0xE0
+		&& srcEnd - src >= 2 && (UCHAR(src[1]) & 0xC0) == 0x80) {
+	    /*
+	     * A well-formed 2 byte character comes out as it went in.
+	     */
+
+	    dst[0] = src[0];
+	    dst[1] = src[1];
+	    src += 2;
+	    dst += 2;
+	} else if ((UCHAR(*src) & 0xF0) == 0xE0 && srcEnd - src >= 3
+		&& (UCHAR(src[1]) & 0xC0) == 0x80
+		&& (UCHAR(src[2]) & 0xC0) == 0x80
+		&& (UCHAR(*src) > 0xE0 || UCHAR(src[1]) >= 0xA0)) {
+	    /*
+	     * So does a well-formed 3 byte one.
+	     */
+
+	    dst[0] = src[0];
+	    dst[1] = src[1];
+	    dst[2] = src[2];
+	    src += 3;
+	    dst += 3;
 	} else if (pureNullMode == 1 && UCHAR(*src) == 0xc0 &&
 		UCHAR(*(src+1)) == 0x80) {
 	    /*
@@ -2516,7 +2920,8 @@ UtfToUnicodeProc(
  * TableToUtfProc --
  *
  *	Convert from the encoding specified by the TableEncodingData into
- *	UTF-8.
+ *	UTF-8. Runs of 7-bit characters are copied if the table leaves them
+ *	alone, and the rest is converted by TableToUtfChars.
  *
  * Results:
  *	Returns TCL_OK if conversion was successful.
@@ -2554,6 +2959,62 @@ TableToUtfProc(
     int *dstCharsPtr)		/* Filled with the number of characters that
 				 * correspond to the bytes stored in the
 				 * output buffer. */
+{
+    TableEncodingData *dataPtr = clientData;
+
+    if (!dataPtr->asciiIdentity) {
+	return TableToUtfChars(clientData, src, srcLen, flags, statePtr, dst,
+		dstLen, srcReadPtr, dstWrotePtr, dstCharsPtr);
+    }
+    return ConvertAsciiRuns(TableToUtfChars, 1, clientData, src, srcLen,
+	    flags, statePtr, dst, dstLen, srcReadPtr, dstWrotePtr,
+	    dstCharsPtr);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * TableToUtfChars --
+ *
+ *	Convert from the encoding specified by the TableEncodingData into
+ *	UTF-8.
+ *
+ * Results:
+ *	Returns TCL_OK if conversion was successful.
+ *
+ * Side effects:
+ *	None.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static int
+TableToUtfChars(
+    ClientData clientData,	/* TableEncodingData that specifies
+				 * encoding. */
+    const char *src,		/* Source string in specified encoding. */
+    int srcLen,			/* Source string length in bytes. */
+    int flags,			/* Conversion control flags. */
+    Tcl_EncodingState *statePtr,/* Place for conversion routine to store state
+				 * information used during a piecewise
+				 * conversion. Contents of statePtr are
+				 * initialized and/or reset by conversion
+				 * routine under control of flags argument. */
+    char *dst,			/* Output buffer in which converted string is
+				 * stored. */
+    int dstLen,			/* The maximum length of output buffer in
+				 * bytes. */
+    int *srcReadPtr,		/* Filled with the number of bytes from the
+				 * source string that were converted. This may
+				 * be less than the original source length if
+				 * there was a problem converting some source
+				 * characters. */
+    int *dstWrotePtr,		/* Filled with the number of bytes that were
+				 * stored in the output buffer as a result of
+				 * the conversion. */
+    int *dstCharsPtr)		/* Filled with the number of characters that
+				 * correspond to the bytes stored in the
+				 * output buffer. */
 {
     const char *srcStart, *srcEnd;
     const char *dstEnd, *dstStart, *prefixBytes;
@@ -2626,7 +3087,8 @@ TableToUtfProc(
  * TableFromUtfProc --
  *
  *	Convert from UTF-8 into the encoding specified by the
- *	TableEncodingData.
+ *	TableEncodingData. Runs of 7-bit characters are copied if the table
+ *	leaves them alone, and the rest is converted by TableFromUtfChars.
  *
  * Results:
  *	Returns TCL_OK if conversion was successful.
@@ -2664,6 +3126,62 @@ TableFromUtfProc(
     int *dstCharsPtr)		/* Filled with the number of characters that
 				 * correspond to the bytes stored in the
 				 * output buffer. */
+{
+    TableEncodingData *dataPtr = clientData;
+
+    if (!dataPtr->asciiIdentity) {
+	return TableFromUtfChars(clientData, src, srcLen, flags, statePtr, dst,
+		dstLen, srcReadPtr, dstWrotePtr, dstCharsPtr);
+    }
+    return ConvertAsciiRuns(TableFromUtfChars, 0, clientData, src, srcLen,
+	    flags, statePtr, dst, dstLen, srcReadPtr, dstWrotePtr,
+	    dstCharsPtr);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * TableFromUtfChars --
+ *
+ *	Convert from UTF-8 into the encoding specified by the
+ *	TableEncodingData.
+ *
+ * Results:
+ *	Returns TCL_OK if conversion was successful.
+ *
+ * Side effects:
+ *	None.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static int
+TableFromUtfChars(
+    ClientData clientData,	/* TableEncodingData that specifies
+				 * encoding. */
+    const char *src,		/* Source string in UTF-8. */
+    int srcLen,			/* Source string length in bytes. */
+    int flags,			/* Conversion control flags. */
+    Tcl_EncodingState *statePtr,/* Place for conversion routine to store state
+				 * information used during a piecewise
+				 * conversion. Contents of statePtr are
+				 * initialized and/or reset by conversion
+				 * routine under control of flags argument. */
+    char *dst,			/* Output buffer in which converted string is
+				 * stored. */
+    int dstLen,			/* The maximum length of output buffer in
+				 * bytes. */
+    int *srcReadPtr,		/* Filled with the number of bytes from the
+				 * source string that were converted. This may
+				 * be less than the original source length if
+				 * there was a problem converting some source
+				 * characters. */
+    int *dstWrotePtr,		/* Filled with the number of bytes that were
+				 * stored in the output buffer as a result of
+				 * the conversion. */
+    int *dstCharsPtr)		/* Filled with the number of characters that
+				 * correspond to the bytes stored in the
+				 * output buffer. */
 {
     const char *srcStart, *srcEnd, *srcClose;
     const char *dstStart, *dstEnd, *prefixBytes;
@@ -2748,7 +3266,8 @@ TableFromUtfProc(
  *
  * Iso88591ToUtfProc --
  *
- *	Convert from the "iso8859-1" encoding into UTF-8.
+ *	Convert from the "iso8859-1" encoding into UTF-8, copying runs of
+ *	7-bit characters and converting the rest with Iso88591ToUtfChars.
  *
  * Results:
  *	Returns TCL_OK if conversion was successful.
@@ -2785,6 +3304,54 @@ Iso88591ToUtfProc(
     int *dstCharsPtr)		/* Filled with the number of characters that
 				 * correspond to the bytes stored in the
 				 * output buffer. */
+{
+    return ConvertAsciiRuns(Iso88591ToUtfChars, 1, clientData, src, srcLen,
+	    flags, statePtr, dst, dstLen, srcReadPtr, dstWrotePtr,
+	    dstCharsPtr);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * Iso88591ToUtfChars --
+ *
+ *	Convert from the "iso8859-1" encoding into UTF-8.
+ *
+ * Results:
+ *	Returns TCL_OK if conversion was successful.
+ *
+ * Side effects:
+ *	None.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static int
+Iso88591ToUtfChars(
+    ClientData clientData,	/* Ignored. */
+    const char *src,		/* Source string in specified encoding. */
+    int srcLen,			/* Source string length in bytes. */
+    int flags,			/* Conversion control flags. */
+    Tcl_EncodingState *statePtr,/* Place for conversion routine to store state
+				 * information used during a piecewise
+				 * conversion. Contents of statePtr are
+				 * initialized and/or reset by conversion
+				 * routine under control of flags argument. */
+    char *dst,			/* Output buffer in which converted string is
+				 * stored. */
+    int dstLen,			/* The maximum length of output buffer in
+				 * bytes. */
+    int *srcReadPtr,		/* Filled with the number of bytes from the
+				 * source string that were converted. This may
+				 * be less than the original source length if
+				 * there was a problem converting some source
+				 * characters. */
+    int *dstWrotePtr,		/* Filled with the number of bytes that were
+				 * stored in the output buffer as a result of
+				 * the conversion. */
+    int *dstCharsPtr)		/* Filled with the number of characters that
+				 * correspond to the bytes stored in the
+				 * output buffer. */
 {
     const char *srcStart, *srcEnd;
     const char *dstEnd, *dstStart;
@@ -2829,7 +3396,8 @@ Iso88591ToUtfProc(
  *
  * Iso88591FromUtfProc --
  *
- *	Convert from UTF-8 into the encoding "iso8859-1".
+ *	Convert from UTF-8 into the encoding "iso8859-1", copying runs of
+ *	7-bit characters and converting the rest with Iso88591FromUtfChars.
  *
  * Results:
  *	Returns TCL_OK if conversion was successful.
@@ -2866,6 +3434,54 @@ Iso88591FromUtfProc(
     int *dstCharsPtr)		/* Filled with the number of characters that
 				 * correspond to the bytes stored in the
 				 * output buffer. */
+{
+    return ConvertAsciiRuns(Iso88591FromUtfChars, 0, clientData, src, srcLen,
+	    flags, statePtr, dst, dstLen, srcReadPtr, dstWrotePtr,
+	    dstCharsPtr);
+}
+
+/*
+ *-------------------------------------------------------------------------
+ *
+ * Iso88591FromUtfChars --
+ *
+ *	Convert from UTF-8 into the encoding "iso8859-1".
+ *
+ * Results:
+ *	Returns TCL_OK if conversion was successful.
+ *
+ * Side effects:
+ *	None.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+static int
+Iso88591FromUtfChars(
+    ClientData clientData,	/* Ignored. */
+    const char *src,		/* Source string in UTF-8. */
+    int srcLen,			/* Source string length in bytes. */
+    int flags,			/* Conversion control flags. */
+    Tcl_EncodingState *statePtr,/* Place for conversion routine to store state
+				 * information used during a piecewise
+				 * conversion. Contents of statePtr are
+				 * initialized and/or reset by conversion
+				 * routine under control of flags argument. */
+    char *dst,			/* Output buffer in which converted string is
+				 * stored. */
+    int dstLen,			/* The maximum length of output buffer in
+				 * bytes. */
+    int *srcReadPtr,		/* Filled with the number of bytes from the
+				 * source string that were converted. This may
+				 * be less than the original source length if
+				 * there was a problem converting some source
+				 * characters. */
+    int *dstWrotePtr,		/* Filled with the number of bytes that were
+				 * stored in the output buffer as a result of
+				 * the conversion. */
+    int *dstCharsPtr)		/* Filled with the number of characters that
+				 * correspond to the bytes stored in the
+				 * output buffer. */
 {
     const char *srcStart, *srcEnd, *srcClose;
     const char *dstStart, *dstEnd;
@@ -2929,6 +3545,42 @@ Iso88591FromUtfProc(
     return result;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TableAsciiIdentity --
+ *
+ *	Check whether a table encoding leaves 7-bit characters alone, so that
+ *	TableToUtfProc and TableFromUtfProc can copy runs of them instead of
+ *	looking each one up.
+ *
+ * Results:
+ *	The value for the asciiIdentity field of the encoding.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+TableAsciiIdentity(
+    TableEncodingData *dataPtr)	/* Tables of the encoding. */
+{
+    int ch;
+
+    if (dataPtr->prefixBytes[0] || dataPtr->fromUnicode[0][0] != 0) {
+	return 0;
+    }
+    for (ch = 1; ch < 0x80; ch++) {
+	if (dataPtr->prefixBytes[ch] || dataPtr->toUnicode[0][ch] != ch
+		|| dataPtr->fromUnicode[0][ch] != ch) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -2959,6 +3611,9 @@ TableFreeProc(
 
     ckfree((char *) dataPtr->toUnicode);
     ckfree((char *) dataPtr->fromUnicode);
+    if (dataPtr->mapPtr != NULL) {
+	TclpUnmapFile(dataPtr->mapPtr, dataPtr->mapSize);
+    }
     ckfree((char *) dataPtr);
 }
 
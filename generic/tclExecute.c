@@ -104,6 +104,7 @@ static const char *const resultStrings[] = {
 long		tclObjsAlloced = 0;
 long		tclObjsFreed = 0;
 long		tclObjsShared[TCL_MAX_SHARED_OBJ_STATS] = { 0, 0, 0, 0, 0 };
+long		tclObjsCached = 0;
 #endif /* TCL_COMPILE_STATS */
 
 /*
@@ -850,9 +851,10 @@ TclCreateExecEnv(
 	    + (size_t) (size-1) * sizeof(Tcl_Obj *));
 
     eePtr->execStackPtr = esPtr;
-    TclNewBooleanObj(eePtr->constants[0], 0);
+    eePtr->smallIntObjs = TclGetSmallIntTable();
+    eePtr->constants[0] = TclSmallIntObj(eePtr->smallIntObjs, 0);
     Tcl_IncrRefCount(eePtr->constants[0]);
-    TclNewBooleanObj(eePtr->constants[1], 1);
+    eePtr->constants[1] = TclSmallIntObj(eePtr->smallIntObjs, 1);
     Tcl_IncrRefCount(eePtr->constants[1]);
     eePtr->interp = interp;
     eePtr->callbackPtr = NULL;
@@ -2055,6 +2057,7 @@ TEBCresume(
 #endif
 #define LOCAL(i)	(&iPtr->varFramePtr->compiledLocals[(i)])
 #define TCONST(i)	(iPtr->execEnvPtr->constants[(i)])
+#define SMALLINTS	(iPtr->execEnvPtr->smallIntObjs)
 
     /*
      * These macros are just meant to save some global variables that are not
@@ -3336,7 +3339,7 @@ TEBCresume(
     case INST_INCR_SCALAR_STK_IMM:
     case INST_INCR_STK_IMM:
 	increment = TclGetInt1AtPtr(pc+1);
-	incrPtr = Tcl_NewIntObj(increment);
+	TclNewSharedIntObj(incrPtr, SMALLINTS, increment);
 	Tcl_IncrRefCount(incrPtr);
 	pcAdjustment = 2;
 
@@ -3369,7 +3372,7 @@ TEBCresume(
     case INST_INCR_ARRAY1_IMM:
 	opnd = TclGetUInt1AtPtr(pc+1);
 	increment = TclGetInt1AtPtr(pc+2);
-	incrPtr = Tcl_NewIntObj(increment);
+	TclNewSharedIntObj(incrPtr, SMALLINTS, increment);
 	Tcl_IncrRefCount(incrPtr);
 	pcAdjustment = 3;
 
@@ -3421,7 +3424,7 @@ TEBCresume(
 			TRACE(("%u %ld => ", opnd, increment));
 			if (Tcl_IsShared(objPtr)) {
 			    objPtr->refCount--;	/* We know it's shared. */
-			    TclNewLongObj(objResultPtr, sum);
+			    TclNewSharedIntObj(objResultPtr, SMALLINTS, sum);
 			    Tcl_IncrRefCount(objResultPtr);
 			    varPtr->value.objPtr = objResultPtr;
 			} else {
@@ -3494,7 +3497,8 @@ TEBCresume(
 	    } else {
 		objResultPtr = objPtr;
 	    }
-	    TclNewLongObj(incrPtr, increment);
+	    TclNewSharedIntObj(incrPtr, SMALLINTS, increment);
+	    Tcl_IncrRefCount(incrPtr);
 	    if (TclIncrObj(interp, objResultPtr, incrPtr) != TCL_OK) {
 		Tcl_DecrRefCount(incrPtr);
 		TRACE_APPEND(("ERROR: %.30s\n",
@@ -3509,7 +3513,7 @@ TEBCresume(
 	 * All other cases, flow through to generic handling.
 	 */
 
-	TclNewLongObj(incrPtr, increment);
+	TclNewSharedIntObj(incrPtr, SMALLINTS, increment);
 	Tcl_IncrRefCount(incrPtr);
 
     doIncrScalar:
@@ -4070,7 +4074,7 @@ TEBCresume(
 
     {
 	int index, numIndices, fromIdx, toIdx;
-	int nocase, match, length2, cflags, s1len, s2len;
+	int nocase, match, cflags, s1len, s2len;
 	const char *s1, *s2;
 
     case INST_LIST:
@@ -4091,7 +4095,7 @@ TEBCresume(
 		    Tcl_GetObjResult(interp));
 	    goto gotError;
 	}
-	TclNewIntObj(objResultPtr, length);
+	TclNewSharedIntObj(objResultPtr, SMALLINTS, length);
 	TRACE(("%.20s => %d\n", O2S(valuePtr), length));
 	NEXT_INST_F(1, 1, 1);
 
@@ -4100,9 +4104,20 @@ TEBCresume(
 	valuePtr = OBJ_UNDER_TOS;
 
 	/*
-	 * Extract the desired list element.
+	 * Extract the desired list element. Elements of packed lists are
+	 * boxed on demand rather than converting the whole list.
 	 */
 
+	if ((valuePtr->typePtr == &tclPackedListType)
+		&& (value2Ptr->typePtr != &tclListType)
+		&& (TclGetIntForIndexM(NULL, value2Ptr,
+			PackedListRepPtr(valuePtr)->elemCount - 1,
+			&index) == TCL_OK)) {
+	    TclDecrRefCount(value2Ptr);
+	    tosPtr--;
+	    pcAdjustment = 1;
+	    goto lindexPackedPath;
+	}
 	if ((TclListObjGetElements(interp, valuePtr, &objc, &objv) == TCL_OK)
 		&& (value2Ptr->typePtr != &tclListType)
 		&& (TclGetIntForIndexM(NULL , value2Ptr, objc-1,
@@ -4137,6 +4152,13 @@ TEBCresume(
 
 	valuePtr = OBJ_AT_TOS;
 	opnd = TclGetInt4AtPtr(pc+1);
+	pcAdjustment = 5;
+
+	if (valuePtr->typePtr == &tclPackedListType) {
+	    objc = PackedListRepPtr(valuePtr)->elemCount;
+	    index = (opnd < -1) ? opnd+1 + objc : opnd;
+	    goto lindexPackedPath;
+	}
 
 	/*
 	 * Get the contents of the list, making sure that it really is a list
@@ -4159,7 +4181,6 @@ TEBCresume(
 	} else {
 	    index = opnd;
 	}
-	pcAdjustment = 5;
 
     lindexFastPath:
 	if (index >= 0 && index < objc) {
@@ -4172,6 +4193,17 @@ TEBCresume(
 		objResultPtr);
 	NEXT_INST_F(pcAdjustment, 1, 1);
 
+    lindexPackedPath:
+	if (index >= 0 && index < PackedListRepPtr(valuePtr)->elemCount) {
+	    objResultPtr = TclPackedListElement(valuePtr, index);
+	} else {
+	    TclNewObj(objResultPtr);
+	}
+
+	TRACE_WITH_OBJ(("\"%.30s\" %d => ", O2S(valuePtr), opnd),
+		objResultPtr);
+	NEXT_INST_F(pcAdjustment, 1, 1);
+
     case INST_LIST_INDEX_MULTI:	/* 'lindex' with multiple index args */
 	/*
 	 * Determine the count of index args.
@@ -4350,35 +4382,13 @@ TEBCresume(
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 
-	s1 = TclGetStringFromObj(valuePtr, &s1len);
-	if (TclListObjLength(interp, value2Ptr, &length) != TCL_OK) {
+	if (TclListObjFindElement(interp, value2Ptr, valuePtr,
+		&index) != TCL_OK) {
 	    TRACE_WITH_OBJ(("\"%.30s\" \"%.30s\" => ERROR: ", O2S(valuePtr),
 		    O2S(value2Ptr)), Tcl_GetObjResult(interp));
 	    goto gotError;
 	}
-	match = 0;
-	if (length > 0) {
-	    int i = 0;
-	    Tcl_Obj *o;
-
-	    /*
-	     * An empty list doesn't match anything.
-	     */
-
-	    do {
-		Tcl_ListObjIndex(NULL, value2Ptr, i, &o);
-		if (o != NULL) {
-		    s2 = TclGetStringFromObj(o, &s2len);
-		} else {
-		    s2 = "";
-		    s2len = 0;
-		}
-		if (s1len == s2len) {
-		    match = (memcmp(s1, s2, s1len) == 0);
-		}
-		i++;
-	    } while (i < length && match == 0);
-	}
+	match = (index >= 0);
 
 	if (*pc == INST_LIST_NOT_IN) {
 	    match = !match;
@@ -4536,7 +4546,7 @@ TEBCresume(
 	    }
 	}
 	if (match < 0) {
-	    TclNewIntObj(objResultPtr, -1);
+	    objResultPtr = TclSmallIntObj(SMALLINTS, -1);
 	} else {
 	    objResultPtr = TCONST(match > 0);
 	}
@@ -4547,7 +4557,7 @@ TEBCresume(
     case INST_STR_LEN:
 	valuePtr = OBJ_AT_TOS;
 	length = Tcl_GetCharLength(valuePtr);
-	TclNewIntObj(objResultPtr, length);
+	TclNewSharedIntObj(objResultPtr, SMALLINTS, length);
 	TRACE(("%.20s => %d\n", O2S(valuePtr), length));
 	NEXT_INST_F(1, 1, 1);
 
@@ -4595,29 +4605,8 @@ TEBCresume(
 	valuePtr = OBJ_AT_TOS;		/* String */
 	value2Ptr = OBJ_UNDER_TOS;	/* Pattern */
 
-	/*
-	 * Check that at least one of the objects is Unicode before promoting
-	 * both.
-	 */
-
-	if ((valuePtr->typePtr == &tclStringType)
-		|| (value2Ptr->typePtr == &tclStringType)) {
-	    Tcl_UniChar *ustring1, *ustring2;
-
-	    ustring1 = Tcl_GetUnicodeFromObj(valuePtr, &length);
-	    ustring2 = Tcl_GetUnicodeFromObj(value2Ptr, &length2);
-	    match = TclUniCharMatch(ustring1, length, ustring2, length2,
-		    nocase);
-	} else if (TclIsPureByteArray(valuePtr) && !nocase) {
-	    unsigned char *bytes1, *bytes2;
-
-	    bytes1 = Tcl_GetByteArrayFromObj(valuePtr, &length);
-	    bytes2 = Tcl_GetByteArrayFromObj(value2Ptr, &length2);
-	    match = TclByteArrayMatch(bytes1, length, bytes2, length2, 0);
-	} else {
-	    match = Tcl_StringCaseMatch(TclGetString(valuePtr),
-		    TclGetString(value2Ptr), nocase);
-	}
+	match = TclStringMatchObj(valuePtr, value2Ptr,
+		nocase ? TCL_MATCH_NOCASE : 0);
 
 	/*
 	 * Reuse value2Ptr object already on stack if possible. Adjustment is
@@ -4926,7 +4915,7 @@ TEBCresume(
 			if (l1 > 0L) {
 			    objResultPtr = TCONST(0);
 			} else {
-			    TclNewIntObj(objResultPtr, -1);
+			    objResultPtr = TclSmallIntObj(SMALLINTS, -1);
 			}
 			TRACE(("%s\n", O2S(objResultPtr)));
 			NEXT_INST_F(1, 2, 1);
@@ -5008,7 +4997,7 @@ TEBCresume(
 	    longResultOfArithmetic:
 		TRACE(("%s %s => ", O2S(valuePtr), O2S(value2Ptr)));
 		if (Tcl_IsShared(valuePtr)) {
-		    TclNewLongObj(objResultPtr, lResult);
+		    TclNewSharedIntObj(objResultPtr, SMALLINTS, lResult);
 		    TRACE(("%s\n", O2S(objResultPtr)));
 		    NEXT_INST_F(1, 2, 1);
 		}
@@ -5142,7 +5131,11 @@ TEBCresume(
 	    wideResultOfArithmetic:
 		TRACE(("%s %s => ", O2S(valuePtr), O2S(value2Ptr)));
 		if (Tcl_IsShared(valuePtr)) {
-		    objResultPtr = Tcl_NewWideIntObj(wResult);
+		    if (TclIsSmallInt(wResult)) {
+			objResultPtr = TclSmallIntObj(SMALLINTS, (long) wResult);
+		    } else {
+			objResultPtr = Tcl_NewWideIntObj(wResult);
+		    }
 		    TRACE(("%s\n", O2S(objResultPtr)));
 		    NEXT_INST_F(1, 2, 1);
 		}
@@ -5253,7 +5246,7 @@ TEBCresume(
 	if (type1 == TCL_NUMBER_LONG) {
 	    l1 = *((const long *) ptr1);
 	    if (Tcl_IsShared(valuePtr)) {
-		TclNewLongObj(objResultPtr, ~l1);
+		TclNewSharedIntObj(objResultPtr, SMALLINTS, ~l1);
 		NEXT_INST_F(1, 1, 1);
 	    }
 	    TclSetLongObj(valuePtr, ~l1);
@@ -5285,7 +5278,7 @@ TEBCresume(
 	    l1 = *((const long *) ptr1);
 	    if (l1 != LONG_MIN) {
 		if (Tcl_IsShared(valuePtr)) {
-		    TclNewLongObj(objResultPtr, -l1);
+		    TclNewSharedIntObj(objResultPtr, SMALLINTS, -l1);
 		    NEXT_INST_F(1, 1, 1);
 		}
 		TclSetLongObj(valuePtr, -l1);
@@ -5513,12 +5506,20 @@ TEBCresume(
 
 		listVarPtr = LOCAL(listTmpIndex);
 		listPtr = TclListObjCopy(NULL, listVarPtr->value.objPtr);
-		TclListObjGetElements(interp, listPtr, &listLen, &elements);
+		if (listPtr->typePtr == &tclPackedListType) {
+		    listLen = PackedListRepPtr(listPtr)->elemCount;
+		    elements = NULL;
+		} else {
+		    TclListObjGetElements(interp, listPtr, &listLen,
+			    &elements);
+		}
 
 		valIndex = (iterNum * numVars);
 		for (j = 0;  j < numVars;  j++) {
 		    if (valIndex >= listLen) {
 			TclNewObj(valuePtr);
+		    } else if (elements == NULL) {
+			valuePtr = TclPackedListElement(listPtr, valIndex);
 		    } else {
 			valuePtr = elements[valIndex];
 		    }
@@ -5609,7 +5610,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, -1);
 
     case INST_PUSH_RETURN_CODE:
-	TclNewIntObj(objResultPtr, result);
+	TclNewSharedIntObj(objResultPtr, SMALLINTS, result);
 	TRACE(("=> %u\n", result));
 	NEXT_INST_F(1, 0, 1);
 
@@ -5725,9 +5726,10 @@ TEBCresume(
 		break;
 	    }
 	    if (valuePtr == NULL) {
-		Tcl_DictObjPut(NULL, dictPtr, OBJ_AT_TOS,Tcl_NewIntObj(opnd));
+		TclNewSharedIntObj(value2Ptr, SMALLINTS, opnd);
+		Tcl_DictObjPut(NULL, dictPtr, OBJ_AT_TOS, value2Ptr);
 	    } else {
-		value2Ptr = Tcl_NewIntObj(opnd);
+		TclNewSharedIntObj(value2Ptr, SMALLINTS, opnd);
 		Tcl_IncrRefCount(value2Ptr);
 		if (Tcl_IsShared(valuePtr)) {
 		    valuePtr = Tcl_DuplicateObj(valuePtr);
@@ -6431,6 +6433,7 @@ TEBCresume(
 #undef auxObjList
 #undef catchTop
 #undef TCONST
+#undef SMALLINTS
 
 /*
  *----------------------------------------------------------------------
@@ -8580,6 +8583,8 @@ EvalStatsCmd(
 	    tclObjsAlloced);
     Tcl_AppendPrintfToObj(objPtr, "Current objects\t\t\t%ld\n",
 	    (tclObjsAlloced - tclObjsFreed));
+    Tcl_AppendPrintfToObj(objPtr, "Shared small int objects reused\t%ld (%ld bytes not allocated)\n",
+	    tclObjsCached, (long) (tclObjsCached * sizeof(Tcl_Obj)));
     Tcl_AppendPrintfToObj(objPtr, "Total literal objects\t\t%ld\n",
 	    statsPtr->numLiteralsCreated);
 
@@ -39,6 +39,31 @@
 #define RANDOM_INDEX(tablePtr, i) \
     ((((i)*1103515245L) >> (tablePtr)->downShift) & (tablePtr)->mask)
 
+/*
+ * Tables whose key type has the TCL_HASH_KEY_INCREMENTAL_RESIZE flag set are
+ * not rehashed in one go once they have at least INCREMENTAL_MIN_BUCKETS
+ * buckets. Instead, the old bucket array is kept alive next to the new one
+ * and INCREMENTAL_STEP of its chains are moved across on every insertion,
+ * lookup and deletion, so that a table that stops growing still gets rid of
+ * it. Starting a search finishes the resize: a search visits every entry
+ * anyway, and as nothing may be inserted while it goes on, no chains can
+ * move under its feet. Since a table that large never uses its
+ * staticBuckets, those hold the migration state: the old bucket array
+ * (always a quarter of the size of the current one) and the index of the
+ * next old chain to move.
+ */
+
+#define INCREMENTAL_MIN_BUCKETS	1024
+#define INCREMENTAL_STEP	16
+
+#define IS_MIGRATING(tablePtr) \
+    ((tablePtr)->buckets != (tablePtr)->staticBuckets \
+	    && (tablePtr)->staticBuckets[0] != NULL)
+#define OLD_BUCKETS(tablePtr) \
+    ((Tcl_HashEntry **) (tablePtr)->staticBuckets[0])
+#define OLD_NEXT_INDEX(tablePtr) \
+    ((int) PTR2INT((tablePtr)->staticBuckets[1]))
+
 /*
  * Prototypes for the array hash key methods.
  */
@@ -77,7 +102,18 @@ static Tcl_HashEntry *	BogusCreate(Tcl_HashTable *tablePtr, const char *key,
 static Tcl_HashEntry *	CreateHashEntry(Tcl_HashTable *tablePtr, const char *key,
 			    int *newPtr);
 static Tcl_HashEntry *	FindHashEntry(Tcl_HashTable *tablePtr, const char *key);
+static Tcl_HashEntry *	FindInOldBuckets(Tcl_HashTable *tablePtr,
+			    const Tcl_HashKeyType *typePtr, const char *key,
+			    unsigned int hash);
+static const Tcl_HashKeyType *GetKeyType(Tcl_HashTable *tablePtr);
+static void		MigrateBuckets(Tcl_HashTable *tablePtr,
+			    const Tcl_HashKeyType *typePtr, int count);
+static int		OldBucketIndex(Tcl_HashTable *tablePtr,
+			    const Tcl_HashKeyType *typePtr, unsigned int hash);
 static void		RebuildTable(Tcl_HashTable *tablePtr);
+static void		RehashChain(Tcl_HashTable *tablePtr,
+			    const Tcl_HashKeyType *typePtr,
+			    Tcl_HashEntry **chainPtr);
 
 const Tcl_HashKeyType tclArrayHashKeyType = {
     TCL_HASH_KEY_TYPE_VERSION,		/* version */
@@ -300,6 +336,10 @@ CreateHashEntry(
 	typePtr = &tclArrayHashKeyType;
     }
 
+    if (IS_MIGRATING(tablePtr)) {
+	MigrateBuckets(tablePtr, typePtr, INCREMENTAL_STEP);
+    }
+
     if (typePtr->hashKeyProc) {
 	hash = typePtr->hashKeyProc(tablePtr, (void *) key);
 	if (typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
@@ -350,6 +390,21 @@ CreateHashEntry(
 	}
     }
 
+    /*
+     * While a resize is in progress, the entry might still be waiting in its
+     * chain of the old bucket array.
+     */
+
+    if (IS_MIGRATING(tablePtr)) {
+	hPtr = FindInOldBuckets(tablePtr, typePtr, key, hash);
+	if (hPtr != NULL) {
+	    if (newPtr) {
+		*newPtr = 0;
+	    }
+	    return hPtr;
+	}
+    }
+
     if (!newPtr) {
 	return NULL;
     }
@@ -433,6 +488,10 @@ Tcl_DeleteHashEntry(
 	typePtr = &tclArrayHashKeyType;
     }
 
+    if (IS_MIGRATING(tablePtr)) {
+	MigrateBuckets(tablePtr, typePtr, INCREMENTAL_STEP);
+    }
+
 #if TCL_HASH_KEY_STORE_HASH
     if (typePtr->hashKeyProc == NULL
 	    || typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
@@ -442,6 +501,22 @@ Tcl_DeleteHashEntry(
     }
 
     bucketPtr = &tablePtr->buckets[index];
+
+    /*
+     * During an incremental resize the entry may not have been moved out of
+     * the old bucket array yet.
+     */
+
+    if (IS_MIGRATING(tablePtr)) {
+	for (prevPtr = *bucketPtr; prevPtr != NULL && prevPtr != entryPtr;
+		prevPtr = prevPtr->nextPtr) {
+	    /* Empty loop body. */
+	}
+	if (prevPtr == NULL) {
+	    bucketPtr = &OLD_BUCKETS(tablePtr)[OldBucketIndex(tablePtr,
+		    typePtr, PTR2UINT(entryPtr->hash))];
+	}
+    }
 #else
     bucketPtr = entryPtr->bucketPtr;
 #endif
@@ -505,9 +580,33 @@ Tcl_DeleteHashTable(
     }
 
     /*
-     * Free up all the entries in the table.
+     * Free up all the entries in the table, including those that an
+     * incremental resize has not moved to the new bucket array yet.
      */
 
+    if (IS_MIGRATING(tablePtr)) {
+	Tcl_HashEntry **oldBuckets = OLD_BUCKETS(tablePtr);
+
+	for (i = OLD_NEXT_INDEX(tablePtr); i < tablePtr->numBuckets/4; i++) {
+	    hPtr = oldBuckets[i];
+	    while (hPtr != NULL) {
+		nextPtr = hPtr->nextPtr;
+		if (typePtr->freeEntryProc) {
+		    typePtr->freeEntryProc(hPtr);
+		} else {
+		    ckfree((char *) hPtr);
+		}
+		hPtr = nextPtr;
+	    }
+	}
+	if (typePtr->flags & TCL_HASH_KEY_SYSTEM_HASH) {
+	    TclpSysFree((char *) oldBuckets);
+	} else {
+	    ckfree((char *) oldBuckets);
+	}
+	tablePtr->staticBuckets[0] = tablePtr->staticBuckets[1] = NULL;
+    }
+
     for (i = 0; i < tablePtr->numBuckets; i++) {
 	hPtr = tablePtr->buckets[i];
 	while (hPtr != NULL) {
@@ -557,7 +656,7 @@ Tcl_DeleteHashTable(
  *	all of the entries in the table, one at a time.
  *
  * Side effects:
- *	None.
+ *	Completes any incremental resize in progress.
  *
  *----------------------------------------------------------------------
  */
@@ -568,6 +667,10 @@ Tcl_FirstHashEntry(
     Tcl_HashSearch *searchPtr)	/* Place to store information about progress
 				 * through the table. */
 {
+    if (IS_MIGRATING(tablePtr)) {
+	MigrateBuckets(tablePtr, GetKeyType(tablePtr), tablePtr->numBuckets);
+    }
+
     searchPtr->tablePtr = tablePtr;
     searchPtr->nextIndex = 0;
     searchPtr->nextEntryPtr = NULL;
@@ -630,7 +733,7 @@ Tcl_NextHashEntry(
  *	tablePtr. It is the caller's responsibility to free this string.
  *
  * Side effects:
- *	None.
+ *	Completes any incremental resize in progress.
  *
  *----------------------------------------------------------------------
  */
@@ -645,6 +748,10 @@ Tcl_HashStats(
     register Tcl_HashEntry *hPtr;
     char *result, *p;
 
+    if (IS_MIGRATING(tablePtr)) {
+	MigrateBuckets(tablePtr, GetKeyType(tablePtr), tablePtr->numBuckets);
+    }
+
     /*
      * Compute a histogram of bucket usage.
      */
@@ -999,7 +1106,9 @@ BogusCreate(
  *
  *	This function is invoked when the ratio of entries to hash buckets
  *	becomes too large. It creates a new table with a larger bucket array
- *	and moves all of the entries into the new table.
+ *	and moves all of the entries into the new table. For large tables with
+ *	the TCL_HASH_KEY_INCREMENTAL_RESIZE flag, the entries are left where
+ *	they are and moved later on by MigrateBuckets.
  *
  * Results:
  *	None.
@@ -1014,21 +1123,20 @@ static void
 RebuildTable(
     register Tcl_HashTable *tablePtr)	/* Table to enlarge. */
 {
-    int oldSize, count, index;
+    int oldSize, count;
     Tcl_HashEntry **oldBuckets;
     register Tcl_HashEntry **oldChainPtr, **newChainPtr;
-    register Tcl_HashEntry *hPtr;
     const Tcl_HashKeyType *typePtr;
 
-    if (tablePtr->keyType == TCL_STRING_KEYS) {
-	typePtr = &tclStringHashKeyType;
-    } else if (tablePtr->keyType == TCL_ONE_WORD_KEYS) {
-	typePtr = &tclOneWordHashKeyType;
-    } else if (tablePtr->keyType == TCL_CUSTOM_TYPE_KEYS
-	    || tablePtr->keyType == TCL_CUSTOM_PTR_KEYS) {
-	typePtr = tablePtr->typePtr;
-    } else {
-	typePtr = &tclArrayHashKeyType;
+    typePtr = GetKeyType(tablePtr);
+
+    /*
+     * Only one resize can be in progress at a time, so finish off the
+     * previous one before starting another.
+     */
+
+    if (IS_MIGRATING(tablePtr)) {
+	MigrateBuckets(tablePtr, typePtr, tablePtr->numBuckets);
     }
 
     oldSize = tablePtr->numBuckets;
@@ -1055,58 +1163,272 @@ RebuildTable(
     tablePtr->downShift -= 2;
     tablePtr->mask = (tablePtr->mask << 2) + 3;
 
+    /*
+     * If the table is big enough and its keys allow it, defer the rehashing
+     * of the existing entries. The old bucket array cannot be the static
+     * one here, so the static buckets are free to record the migration
+     * state.
+     */
+
+    if ((typePtr->flags & TCL_HASH_KEY_INCREMENTAL_RESIZE)
+	    && oldSize >= INCREMENTAL_MIN_BUCKETS) {
+	tablePtr->staticBuckets[0] = (Tcl_HashEntry *) oldBuckets;
+	tablePtr->staticBuckets[1] = (Tcl_HashEntry *) INT2PTR(0);
+	return;
+    }
+
     /*
      * Rehash all of the existing entries into the new bucket array.
      */
 
     for (oldChainPtr = oldBuckets; oldSize > 0; oldSize--, oldChainPtr++) {
-	for (hPtr = *oldChainPtr; hPtr != NULL; hPtr = *oldChainPtr) {
-	    *oldChainPtr = hPtr->nextPtr;
+	RehashChain(tablePtr, typePtr, oldChainPtr);
+    }
+
+    /*
+     * Free up the old bucket array, if it was dynamically allocated.
+     */
+
+    if (oldBuckets != tablePtr->staticBuckets) {
+	if (typePtr->flags & TCL_HASH_KEY_SYSTEM_HASH) {
+	    TclpSysFree((char *) oldBuckets);
+	} else {
+	    ckfree((char *) oldBuckets);
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RehashChain --
+ *
+ *	Moves all of the entries of a bucket chain (which does not belong to
+ *	the table's current bucket array) into the table's current bucket
+ *	array.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The chain is left empty.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RehashChain(
+    register Tcl_HashTable *tablePtr,	/* Table being enlarged. */
+    const Tcl_HashKeyType *typePtr,	/* Key type of the table. */
+    Tcl_HashEntry **chainPtr)		/* Chain to empty. */
+{
+    register Tcl_HashEntry *hPtr;
+    int index;
+
+    for (hPtr = *chainPtr; hPtr != NULL; hPtr = *chainPtr) {
+	*chainPtr = hPtr->nextPtr;
 #if TCL_HASH_KEY_STORE_HASH
-	    if (typePtr->hashKeyProc == NULL
-		    || typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
-		index = RANDOM_INDEX(tablePtr, PTR2INT(hPtr->hash));
-	    } else {
-		index = PTR2UINT(hPtr->hash) & tablePtr->mask;
-	    }
-	    hPtr->nextPtr = tablePtr->buckets[index];
-	    tablePtr->buckets[index] = hPtr;
+	if (typePtr->hashKeyProc == NULL
+		|| typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
+	    index = RANDOM_INDEX(tablePtr, PTR2INT(hPtr->hash));
+	} else {
+	    index = PTR2UINT(hPtr->hash) & tablePtr->mask;
+	}
+	hPtr->nextPtr = tablePtr->buckets[index];
+	tablePtr->buckets[index] = hPtr;
 #else
-	    void *key = Tcl_GetHashKey(tablePtr, hPtr);
+	void *key = Tcl_GetHashKey(tablePtr, hPtr);
 
-	    if (typePtr->hashKeyProc) {
-		unsigned int hash;
+	if (typePtr->hashKeyProc) {
+	    unsigned int hash;
 
-		hash = typePtr->hashKeyProc(tablePtr, key);
-		if (typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
-		    index = RANDOM_INDEX(tablePtr, hash);
-		} else {
-		    index = hash & tablePtr->mask;
-		}
+	    hash = typePtr->hashKeyProc(tablePtr, key);
+	    if (typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
+		index = RANDOM_INDEX(tablePtr, hash);
 	    } else {
-		index = RANDOM_INDEX(tablePtr, key);
+		index = hash & tablePtr->mask;
 	    }
+	} else {
+	    index = RANDOM_INDEX(tablePtr, key);
+	}
 
-	    hPtr->bucketPtr = &tablePtr->buckets[index];
-	    hPtr->nextPtr = *hPtr->bucketPtr;
-	    *hPtr->bucketPtr = hPtr;
+	hPtr->bucketPtr = &tablePtr->buckets[index];
+	hPtr->nextPtr = *hPtr->bucketPtr;
+	*hPtr->bucketPtr = hPtr;
 #endif
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MigrateBuckets --
+ *
+ *	Performs a step of an incremental resize by moving the entries of up
+ *	to count chains of the old bucket array into the current one. When
+ *	the last old chain has been emptied, the old bucket array is freed
+ *	and the resize is over.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Entries get re-hashed to new buckets.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MigrateBuckets(
+    Tcl_HashTable *tablePtr,		/* Table being enlarged. */
+    const Tcl_HashKeyType *typePtr,	/* Key type of the table. */
+    int count)				/* Maximum number of old chains to
+					 * move. */
+{
+    Tcl_HashEntry **oldBuckets = OLD_BUCKETS(tablePtr);
+    int oldSize = tablePtr->numBuckets / 4;
+    int next = OLD_NEXT_INDEX(tablePtr);
+
+    for (; count > 0 && next < oldSize; count--, next++) {
+	if (oldBuckets[next] != NULL) {
+	    RehashChain(tablePtr, typePtr, &oldBuckets[next]);
 	}
     }
 
+    if (next < oldSize) {
+	tablePtr->staticBuckets[1] = (Tcl_HashEntry *) INT2PTR(next);
+	return;
+    }
+
+    if (typePtr->flags & TCL_HASH_KEY_SYSTEM_HASH) {
+	TclpSysFree((char *) oldBuckets);
+    } else {
+	ckfree((char *) oldBuckets);
+    }
+    tablePtr->staticBuckets[0] = tablePtr->staticBuckets[1] = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * OldBucketIndex --
+ *
+ *	Computes which chain of the old bucket array of a table being resized
+ *	incrementally holds the entries with a particular hash value.
+ *
+ * Results:
+ *	The index into the old bucket array.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+OldBucketIndex(
+    Tcl_HashTable *tablePtr,		/* Table being enlarged. */
+    const Tcl_HashKeyType *typePtr,	/* Key type of the table. */
+    unsigned int hash)			/* Hash value of the key. */
+{
     /*
-     * Free up the old bucket array, if it was dynamically allocated.
+     * The old array had a quarter of the buckets, so its mask is two bits
+     * narrower and the randomized index came from two bits further up.
      */
 
-    if (oldBuckets != tablePtr->staticBuckets) {
-	if (typePtr->flags & TCL_HASH_KEY_SYSTEM_HASH) {
-	    TclpSysFree((char *) oldBuckets);
-	} else {
-	    ckfree((char *) oldBuckets);
+    if (typePtr->hashKeyProc == NULL
+	    || typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
+	return (((hash)*1103515245L) >> (tablePtr->downShift + 2))
+		& (tablePtr->mask >> 2);
+    }
+    return hash & (tablePtr->mask >> 2);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FindInOldBuckets --
+ *
+ *	Looks for an entry in the part of the old bucket array that has not
+ *	been migrated yet by an incremental resize.
+ *
+ * Results:
+ *	The matching entry, or NULL if there is none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_HashEntry *
+FindInOldBuckets(
+    Tcl_HashTable *tablePtr,		/* Table being enlarged. */
+    const Tcl_HashKeyType *typePtr,	/* Key type of the table. */
+    const char *key,			/* Key to look for. */
+    unsigned int hash)			/* Hash value of the key. */
+{
+    register Tcl_HashEntry *hPtr;
+    int index = OldBucketIndex(tablePtr, typePtr, hash);
+
+    if (index < OLD_NEXT_INDEX(tablePtr)) {
+	/*
+	 * That chain has already been moved.
+	 */
+
+	return NULL;
+    }
+
+    for (hPtr = OLD_BUCKETS(tablePtr)[index]; hPtr != NULL;
+	    hPtr = hPtr->nextPtr) {
+#if TCL_HASH_KEY_STORE_HASH
+	if (hash != PTR2UINT(hPtr->hash)) {
+	    continue;
+	}
+#endif
+	if (typePtr->compareKeysProc) {
+	    if (typePtr->compareKeysProc((void *) key, hPtr)) {
+		return hPtr;
+	    }
+	} else if (key == hPtr->key.oneWordValue) {
+	    return hPtr;
 	}
     }
+    return NULL;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetKeyType --
+ *
+ *	Works out the key type that describes the keys of a table.
+ *
+ * Results:
+ *	The key type.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const Tcl_HashKeyType *
+GetKeyType(
+    Tcl_HashTable *tablePtr)	/* Table to look at. */
+{
+    if (tablePtr->keyType == TCL_STRING_KEYS) {
+	return &tclStringHashKeyType;
+    } else if (tablePtr->keyType == TCL_ONE_WORD_KEYS) {
+	return &tclOneWordHashKeyType;
+    } else if (tablePtr->keyType == TCL_CUSTOM_TYPE_KEYS
+	    || tablePtr->keyType == TCL_CUSTOM_PTR_KEYS) {
+	return tablePtr->typePtr;
+    } else {
+	return &tclArrayHashKeyType;
+    }
+}
+
 /*
  * Local Variables:
  * mode: c
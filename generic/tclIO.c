@@ -50,6 +50,7 @@ static Tcl_ThreadDataKey dataKey;
  */
 
 static ChannelBuffer *	AllocChannelBuffer(int length);
+static int		CanCopyDirect(CopyState *csPtr);
 static void		ChannelTimerProc(ClientData clientData);
 static int		CheckChannelErrors(ChannelState *statePtr,
 			    int direction);
@@ -236,6 +237,14 @@ static const Tcl_ObjType tclChannelType = {
       (((st)->csPtrW) && ((fl) & TCL_WRITABLE)))
 
 #define MAX_CHANNEL_BUFFER_SIZE (1024*1024)
+
+/*
+ * The most bytes a copy moves with one TclpCopyDirect call, so that a
+ * background copy between native channels still returns to the event loop
+ * now and then.
+ */
+
+#define DIRECT_COPY_SIZE (1024*1024)
 
 /*
  *---------------------------------------------------------------------------
@@ -9050,6 +9059,7 @@ TclCopyChannel(
     csPtr->writeFlags = writeFlags;
     csPtr->toRead = toRead;
     csPtr->total = (Tcl_WideInt) 0;
+    csPtr->direct = 1;
     csPtr->interp = interp;
     if (cmdPtr) {
 	Tcl_IncrRefCount(cmdPtr);
@@ -9151,6 +9161,63 @@ CopyData(
 	    goto writeError;
 	}
 
+	/*
+	 * Between unstacked native channels passing the bytes through
+	 * unchanged, let the system move them without our buffers. When it
+	 * cannot, including on any error, the copy goes on the slow way below,
+	 * which reports real errors itself.
+	 */
+
+	if (!(cmdPtr && (mask == 0)) && CanCopyDirect(csPtr)) {
+	    int errorCode;
+
+	    if ((csPtr->toRead == (Tcl_WideInt) -1)
+		    || (csPtr->toRead > (Tcl_WideInt) DIRECT_COPY_SIZE)) {
+		sizeb = DIRECT_COPY_SIZE;
+	    } else {
+		sizeb = (int) csPtr->toRead;
+	    }
+	    ResetFlag(inStatePtr, CHANNEL_EOF | CHANNEL_BLOCKED);
+	    size = TclpCopyDirect(inChan, outChan, sizeb, &errorCode);
+	    if (size > 0) {
+		if (csPtr->toRead != -1) {
+		    csPtr->toRead -= size;
+		}
+		csPtr->total += size;
+
+		/*
+		 * Background copies go back to the event loop after each
+		 * call, keeping the handler that brought them here.
+		 */
+
+		if (cmdPtr && (csPtr->toRead != 0)) {
+		    return TCL_OK;
+		}
+		continue;
+	    } else if (size == 0) {
+		SetFlag(inStatePtr, CHANNEL_EOF);
+		inStatePtr->inputEncodingFlags |= TCL_ENCODING_END;
+		break;
+	    } else if (cmdPtr && (errorCode == EAGAIN)) {
+		/*
+		 * One of the channels is not ready. If it was not the one
+		 * whose handler brought us here, wait for the other.
+		 */
+
+		if (mask & TCL_WRITABLE) {
+		    Tcl_DeleteChannelHandler(outChan, CopyEventProc, csPtr);
+		    Tcl_CreateChannelHandler(inChan, TCL_READABLE,
+			    CopyEventProc, csPtr);
+		} else {
+		    Tcl_DeleteChannelHandler(inChan, CopyEventProc, csPtr);
+		    Tcl_CreateChannelHandler(outChan, TCL_WRITABLE,
+			    CopyEventProc, csPtr);
+		}
+		return TCL_OK;
+	    }
+	    csPtr->direct = 0;
+	}
+
 	if (cmdPtr && (mask == 0)) {
 	    /*
 	     * In async mode, we skip reading synchronously and fake an
@@ -9389,6 +9456,57 @@ CopyData(
     return result;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * CanCopyDirect --
+ *
+ *	Decides whether the next part of a copy may bypass the channel
+ *	buffers: both channels must be unstacked, neither may translate,
+ *	convert or stop at an EOF character, and neither may hold buffered
+ *	data. TclpCopyDirect then checks that they are native channels it can
+ *	handle.
+ *
+ * Results:
+ *	1 if TclpCopyDirect should be tried, 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CanCopyDirect(
+    CopyState *csPtr)		/* State of copy operation. */
+{
+    ChannelState *inStatePtr = csPtr->readPtr->state;
+    ChannelState *outStatePtr = csPtr->writePtr->state;
+    ChannelBuffer *bufPtr;
+
+    if (!csPtr->direct
+	    || (inStatePtr->topChanPtr != inStatePtr->bottomChanPtr)
+	    || (outStatePtr->topChanPtr != outStatePtr->bottomChanPtr)
+	    || (inStatePtr->encoding != outStatePtr->encoding)
+	    || (inStatePtr->inputTranslation != TCL_TRANSLATE_LF)
+	    || (outStatePtr->outputTranslation != TCL_TRANSLATE_LF)
+	    || (inStatePtr->inEofChar != 0)
+	    || GotFlag(inStatePtr, CHANNEL_STICKY_EOF)
+	    || GotFlag(outStatePtr, BG_FLUSH_SCHEDULED)
+	    || (outStatePtr->outQueueHead != NULL)
+	    || ((outStatePtr->curOutPtr != NULL)
+		    && !IsBufferEmpty(outStatePtr->curOutPtr))) {
+	return 0;
+    }
+    for (bufPtr = inStatePtr->inQueueHead; bufPtr != NULL;
+	    bufPtr = bufPtr->nextPtr) {
+	if (!IsBufferEmpty(bufPtr)) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
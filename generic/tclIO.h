@@ -46,6 +46,9 @@ typedef struct CopyState {
     Tcl_WideInt total;		/* Total bytes transferred (written). */
     Tcl_Interp *interp;		/* Interp that started the copy. */
     Tcl_Obj *cmdPtr;		/* Command to be invoked at completion. */
+    int direct;			/* Whether to try TclpCopyDirect when the
+				 * channels allow it; cleared when it
+				 * fails. */
     int bufSize;		/* Size of appended buffer. */
     char buffer[1];		/* Copy buffer, this must be the last
 				 * field. */
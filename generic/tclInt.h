@@ -1374,6 +1374,19 @@ typedef void **TclHandle;
 #define TCL_REG_BOSONLY 002000	/* Prepend \A to pattern so it only matches at
 				 * the beginning of the string. */
 
+/*
+ *----------------------------------------------------------------
+ * Number of -regexp arms from which [switch] finds the matching arm with a
+ * single automaton for all of them (see TclGetRegExpSet), rather than by
+ * trying the arms one at a time. The bytecode compiler leaves such switches
+ * to the interpreted command.
+ *----------------------------------------------------------------
+ */
+
+#ifndef TCL_SWITCH_REGEXP_SET_MIN
+#define TCL_SWITCH_REGEXP_SET_MIN 8
+#endif
+
 /*
  * These are a thin layer over TclpThreadKeyDataGet and TclpThreadKeyDataSet
  * when threads are used, or an emulation if there are no threads. These are
@@ -1492,6 +1505,8 @@ typedef struct ExecEnv {
     ExecStack *execStackPtr;	/* Points to the first item in the evaluation
 				 * stack on the heap. */
     Tcl_Obj *constants[2];	/* Pointers to constant "0" and "1" objs. */
+    Tcl_Obj **smallIntObjs;	/* The thread's table of shared small integer
+				 * objects; see TclGetSmallIntTable. */
     struct Tcl_Interp *interp;
     struct TEOV_callback *callbackPtr;
 				/* Top callback in TEOV's stack. */
@@ -2423,10 +2438,60 @@ typedef struct List {
 				 * derived from the list representation. May
 				 * be ignored if there is no string rep at
 				 * all.*/
+    int numSearches;		/* Number of searches TclListObjFindElement
+				 * has made in the elements since they last
+				 * changed. */
+    Tcl_HashTable *indexPtr;	/* Maps the string value of each element to
+				 * the index of its first occurrence, built
+				 * by TclListObjFindElement once the list has
+				 * been searched often enough, or NULL.
+				 * Dropped when the elements change, except
+				 * when appended by TclLappendListElement. */
     Tcl_Obj *elements;		/* First list element; the struct is grown to
 				 * accomodate all elements. */
 } List;
 
+/*
+ * The structure used as the internal representation of packed list objects:
+ * lists whose elements are all pure integers or all pure doubles, with the
+ * values stored unboxed. Packed lists are converted back to ordinary lists
+ * whenever an operation needs the element Tcl_Objs; see tclListObj.c.
+ */
+
+typedef union PackedValue {
+    long longValue;
+    double doubleValue;
+} PackedValue;
+
+typedef struct PackedList {
+    int refCount;
+    int maxElemCount;		/* Total number of element array slots. */
+    int elemCount;		/* Current number of list elements. */
+    int elemType;		/* TCL_PACKED_INT or TCL_PACKED_DOUBLE. */
+    PackedValue elements[1];	/* First list element; the struct is grown to
+				 * accomodate all elements. */
+} PackedList;
+
+#define TCL_PACKED_INT		1
+#define TCL_PACKED_DOUBLE	2
+
+#define PackedListRepPtr(listPtr) \
+    ((PackedList *) (listPtr)->internalRep.twoPtrValue.ptr1)
+
+/*
+ * The structure sorted by TclRadixSort: an unsigned key and the index of the
+ * value it was made from. TclLongSortKey and TclDoubleSortKey make keys that
+ * order the same way as the numbers they are made from.
+ */
+
+typedef struct SortPair {
+    Tcl_WideUInt key;
+    int index;
+} SortPair;
+
+#define TclLongSortKey(l) \
+    ((Tcl_WideUInt) (Tcl_WideInt) (l) ^ ((Tcl_WideUInt) 1 << 63))
+
 /*
  * Macro used to get the elements of a list object.
  */
@@ -2547,6 +2612,13 @@ typedef struct TclFileAttrProcs {
 
 typedef struct TclFile_ *TclFile;
 
+/*
+ * A glob pattern compiled for matching many strings; see TclNewGlobPattern
+ * and TclGetGlobPatternFromObj in tclUtil.c.
+ */
+
+typedef struct GlobPattern GlobPattern;
+
 /*
  * The "globParameters" argument of the function TclGlob is an or'ed
  * combination of the following values:
@@ -2686,6 +2758,7 @@ MODULE_SCOPE const Tcl_ObjType tclDoubleType;
 MODULE_SCOPE const Tcl_ObjType tclEndOffsetType;
 MODULE_SCOPE const Tcl_ObjType tclIntType;
 MODULE_SCOPE const Tcl_ObjType tclListType;
+MODULE_SCOPE const Tcl_ObjType tclPackedListType;
 MODULE_SCOPE const Tcl_ObjType tclDictType;
 MODULE_SCOPE const Tcl_ObjType tclProcBodyType;
 MODULE_SCOPE const Tcl_ObjType tclStringType;
@@ -2718,6 +2791,7 @@ MODULE_SCOPE long	tclObjsAlloced;
 MODULE_SCOPE long	tclObjsFreed;
 #define TCL_MAX_SHARED_OBJ_STATS 5
 MODULE_SCOPE long	tclObjsShared[TCL_MAX_SHARED_OBJ_STATS];
+MODULE_SCOPE long	tclObjsCached;
 #endif /* TCL_COMPILE_STATS */
 
 /*
@@ -2873,6 +2947,7 @@ MODULE_SCOPE ContLineLoc *TclContinuationsGet(Tcl_Obj *objPtr);
 MODULE_SCOPE void	TclContinuationsCopy(Tcl_Obj *objPtr,
 			    Tcl_Obj *originObjPtr);
 MODULE_SCOPE void	TclDeleteNamespaceVars(Namespace *nsPtr);
+MODULE_SCOPE Tcl_WideUInt TclDoubleSortKey(double d);
 /* TIP #280 - Modified token based evulation, with line information. */
 MODULE_SCOPE int	TclEvalEx(Tcl_Interp *interp, const char *script,
 			    int numBytes, int flags, int line,
@@ -2909,7 +2984,13 @@ MODULE_SCOPE void	TclFinalizeSynchronization(void);
 MODULE_SCOPE void	TclFinalizeThreadAlloc(void);
 MODULE_SCOPE void	TclFinalizeThreadData(void);
 MODULE_SCOPE void	TclFinalizeThreadObjects(void);
+MODULE_SCOPE Tcl_Obj *	TclFillSmallIntObj(Tcl_Obj **table, long value);
+MODULE_SCOPE int	TclFetchStringHash(Tcl_Obj *objPtr,
+			    unsigned int *hashPtr);
 MODULE_SCOPE double	TclFloor(const mp_int *a);
+MODULE_SCOPE Tcl_Obj *	TclFormatFromObj(Tcl_Interp *interp,
+			    Tcl_Obj *formatObj, int objc,
+			    Tcl_Obj *const objv[]);
 MODULE_SCOPE void	TclFormatNaN(double value, char *buffer);
 MODULE_SCOPE int	TclFSFileAttrIndex(Tcl_Obj *pathPtr,
 			    const char *attributeName, int *indexPtr);
@@ -2923,6 +3004,8 @@ MODULE_SCOPE int	TclGetChannelFromObj(Tcl_Interp *interp,
 			    int *modePtr, int flags);
 MODULE_SCOPE int TclGetCompletionCodeFromObj(Tcl_Interp *interp,
 			    Tcl_Obj *value, int *code);
+MODULE_SCOPE GlobPattern *TclGetGlobPatternFromObj(Tcl_Obj *objPtr,
+			    int flags);
 MODULE_SCOPE int	TclGetNumberFromObj(Tcl_Interp *interp,
 			    Tcl_Obj *objPtr, ClientData *clientDataPtr,
 			    int *typePtr);
@@ -2930,10 +3013,15 @@ MODULE_SCOPE int	TclGetOpenModeEx(Tcl_Interp *interp,
 			    const char *modeString, int *seekFlagPtr,
 			    int *binaryPtr);
 MODULE_SCOPE Tcl_Obj *	TclGetProcessGlobalValue(ProcessGlobalValue *pgvPtr);
+MODULE_SCOPE Tcl_RegExp	TclGetRegExpSet(int objc, Tcl_Obj *const objv[],
+			    int stride, int flags);
 MODULE_SCOPE const char *TclGetSrcInfoForCmd(Interp *iPtr, int *lenPtr);
+MODULE_SCOPE Tcl_Obj **	TclGetSmallIntTable(void);
 MODULE_SCOPE int	TclGlob(Tcl_Interp *interp, char *pattern,
 			    Tcl_Obj *unquotedPrefix, int globFlags,
 			    Tcl_GlobTypeData *types);
+MODULE_SCOPE int	TclGlobPatternMatch(GlobPattern *globPtr,
+			    const char *str, int length);
 MODULE_SCOPE int	TclIncrObj(Tcl_Interp *interp, Tcl_Obj *valuePtr,
 			    Tcl_Obj *incrPtr);
 MODULE_SCOPE Tcl_Obj *	TclIncrObjVar2(Tcl_Interp *interp, Tcl_Obj *part1Ptr,
@@ -2973,6 +3061,12 @@ MODULE_SCOPE Tcl_Obj *	TclLindexFlat(Tcl_Interp *interp, Tcl_Obj *listPtr,
 MODULE_SCOPE void	TclListLines(Tcl_Obj *listObj, int line, int n,
 			    int *lines, Tcl_Obj *const *elems);
 MODULE_SCOPE Tcl_Obj *	TclListObjCopy(Tcl_Interp *interp, Tcl_Obj *listPtr);
+MODULE_SCOPE int	TclListObjFindElement(Tcl_Interp *interp,
+			    Tcl_Obj *listPtr, Tcl_Obj *valuePtr,
+			    int *indexPtr);
+MODULE_SCOPE void	TclListObjInvalidateIndex(Tcl_Obj *listPtr);
+MODULE_SCOPE int	TclLappendListElement(Tcl_Interp *interp,
+			    Tcl_Obj *listPtr, Tcl_Obj *objPtr);
 MODULE_SCOPE Tcl_Obj *	TclLsetList(Tcl_Interp *interp, Tcl_Obj *listPtr,
 			    Tcl_Obj *indexPtr, Tcl_Obj *valuePtr);
 MODULE_SCOPE Tcl_Obj *	TclLsetFlat(Tcl_Interp *interp, Tcl_Obj *listPtr,
@@ -2987,6 +3081,8 @@ MODULE_SCOPE int	TclMergeReturnOptions(Tcl_Interp *interp, int objc,
 			    Tcl_Obj *const objv[], Tcl_Obj **optionsPtrPtr,
 			    int *codePtr, int *levelPtr);
 MODULE_SCOPE int	TclNokia770Doubles(void);
+MODULE_SCOPE GlobPattern *TclNewGlobPattern(const char *pattern, int length,
+			    int flags);
 MODULE_SCOPE void	TclNsDecrRefCount(Namespace *nsPtr);
 MODULE_SCOPE void	TclObjVarErrMsg(Tcl_Interp *interp, Tcl_Obj *part1Ptr,
 			    Tcl_Obj *part2Ptr, const char *operation,
@@ -2996,6 +3092,10 @@ MODULE_SCOPE int	TclObjInvokeNamespace(Tcl_Interp *interp,
 			    Tcl_Namespace *nsPtr, int flags);
 MODULE_SCOPE int	TclObjUnsetVar2(Tcl_Interp *interp,
 			    Tcl_Obj *part1Ptr, Tcl_Obj *part2Ptr, int flags);
+MODULE_SCOPE Tcl_Obj *	TclPackedListElement(Tcl_Obj *listPtr, int index);
+MODULE_SCOPE Tcl_Obj *	TclPackedListSort(Tcl_Obj *listPtr, int isIncreasing,
+			    int unique);
+MODULE_SCOPE void	TclPrepareStringHash(Tcl_Obj *objPtr);
 MODULE_SCOPE int	TclParseBackslash(const char *src,
 			    int numBytes, int *readPtr, char *dst);
 MODULE_SCOPE int	TclParseHex(const char *src, int numBytes,
@@ -3025,6 +3125,7 @@ MODULE_SCOPE int	TclCreateSocketAddress(Tcl_Interp *interp,
 MODULE_SCOPE int	TclpThreadCreate(Tcl_ThreadId *idPtr,
 			    Tcl_ThreadCreateProc *proc, ClientData clientData,
 			    int stackSize, int flags);
+MODULE_SCOPE int	TclpNumProcessors(void);
 MODULE_SCOPE int	TclpFindVariable(const char *name, int *lengthPtr);
 MODULE_SCOPE void	TclpInitLibraryPath(char **valuePtr,
 			    int *lengthPtr, Tcl_Encoding *encodingPtr);
@@ -3071,9 +3172,23 @@ MODULE_SCOPE void *	TclThreadStorageKeyGet(Tcl_ThreadDataKey *keyPtr);
 MODULE_SCOPE void	TclThreadStorageKeySet(Tcl_ThreadDataKey *keyPtr,
 			    void *data);
 MODULE_SCOPE void	TclpThreadExit(int status);
+MODULE_SCOPE SortPair *	TclRadixSort(SortPair *pairs, SortPair *work,
+			    int numPairs);
+MODULE_SCOPE void	TclReleaseGlobPattern(GlobPattern *globPtr);
 MODULE_SCOPE void	TclRememberCondition(Tcl_Condition *mutex);
 MODULE_SCOPE void	TclRememberJoinableThread(Tcl_ThreadId id);
 MODULE_SCOPE void	TclRememberMutex(Tcl_Mutex *mutex);
+MODULE_SCOPE int	TclRegExpExecFrom(Tcl_Interp *interp, Tcl_RegExp re,
+			    Tcl_Obj *textObj, int offset, int nmatches,
+			    int flags);
+MODULE_SCOPE int	TclRegExpExecSet(Tcl_Interp *interp, Tcl_RegExp re,
+			    Tcl_Obj *textObj, int *armPtr);
+MODULE_SCOPE int	TclRegexpCacheObjCmd(ClientData clientData,
+			    Tcl_Interp *interp, int objc,
+			    Tcl_Obj *const objv[]);
+MODULE_SCOPE int	TclRegexpDfaObjCmd(ClientData clientData,
+			    Tcl_Interp *interp, int objc,
+			    Tcl_Obj *const objv[]);
 MODULE_SCOPE void	TclRemoveScriptLimitCallbacks(Tcl_Interp *interp);
 MODULE_SCOPE int	TclReToGlob(Tcl_Interp *interp, const char *reStr,
 			    int reStrLen, Tcl_DString *dsPtr, int *flagsPtr);
@@ -3089,11 +3204,17 @@ MODULE_SCOPE void	TclSetProcessGlobalValue(ProcessGlobalValue *pgvPtr,
 MODULE_SCOPE void	TclSignalExitThread(Tcl_ThreadId id, int result);
 MODULE_SCOPE void *	TclStackRealloc(Tcl_Interp *interp, void *ptr,
 			    int numBytes);
+MODULE_SCOPE int	TclStringFirst(Tcl_Obj *needle, Tcl_Obj *haystack,
+			    int start);
+MODULE_SCOPE int	TclStringLast(Tcl_Obj *needle, Tcl_Obj *haystack,
+			    int last);
 MODULE_SCOPE int	TclStringMatch(const char *str, int strLen,
 			    const char *pattern, int ptnLen, int flags);
 MODULE_SCOPE int	TclStringMatchObj(Tcl_Obj *stringObj,
 			    Tcl_Obj *patternObj, int flags);
 MODULE_SCOPE Tcl_Obj *	TclStringObjReverse(Tcl_Obj *objPtr);
+MODULE_SCOPE void	TclStoreStringHash(Tcl_Obj *objPtr,
+			    unsigned int hash);
 MODULE_SCOPE void	TclSubstCompile(Tcl_Interp *interp, const char *bytes,
 			    int numBytes, int flags, int line,
 			    struct CompileEnv *envPtr);
@@ -3105,12 +3226,18 @@ MODULE_SCOPE void	TclSubstParse(Tcl_Interp *interp, const char *bytes,
 MODULE_SCOPE int	TclSubstTokens(Tcl_Interp *interp, Tcl_Token *tokenPtr,
 			    int count, int *tokensLeftPtr, int line,
 			    int *clNextOuter, const char *outerScript);
+MODULE_SCOPE int	TclUtfAsciiLength(const char *src, int length);
+MODULE_SCOPE int	TclUtfSingleByteLength(const char *src, int length);
+MODULE_SCOPE int	TclpCopyDirect(Tcl_Channel inChan, Tcl_Channel outChan,
+			    int toCopy, int *errorCodePtr);
 MODULE_SCOPE Tcl_Obj *	TclpNativeToNormalized(ClientData clientData);
 MODULE_SCOPE Tcl_Obj *	TclpFilesystemPathType(Tcl_Obj *pathPtr);
 MODULE_SCOPE int	TclpDlopen(Tcl_Interp *interp, Tcl_Obj *pathPtr,
 			    Tcl_LoadHandle *loadHandle,
 			    Tcl_FSUnloadFileProc **unloadProcPtr);
 MODULE_SCOPE int	TclpUtime(Tcl_Obj *pathPtr, struct utimbuf *tval);
+MODULE_SCOPE char *	TclpMapFile(Tcl_Obj *pathPtr, size_t *sizePtr);
+MODULE_SCOPE void	TclpUnmapFile(char *mapPtr, size_t size);
 #ifdef TCL_LOAD_FROM_MEMORY
 MODULE_SCOPE void *	TclpLoadMemoryGetBuffer(Tcl_Interp *interp, int size);
 MODULE_SCOPE int	TclpLoadMemory(Tcl_Interp *interp, void *buffer,
@@ -3781,9 +3908,12 @@ typedef const char *TclDTraceStr;
     tclObjsAlloced++
 #  define TclIncrObjsFreed() \
     tclObjsFreed++
+#  define TclIncrObjsCached() \
+    tclObjsCached++
 #else
 #  define TclIncrObjsAllocated()
 #  define TclIncrObjsFreed()
+#  define TclIncrObjsCached()	((void) 0)
 #endif /* TCL_COMPILE_STATS */
 
 #  define TclAllocObjStorage(objPtr)		\
@@ -4104,10 +4234,10 @@ MODULE_SCOPE void	TclDbInitNewObj(Tcl_Obj *objPtr, const char *file,
 
 /*
  *----------------------------------------------------------------
- * Macro counterpart of the Tcl_NumUtfChars() function. To be used in speed-
- * -sensitive points where it pays to avoid a function call in the common case
- * of counting along a string of all one-byte characters.  The ANSI C
- * "prototype" for this macro is:
+ * Macro counterpart of the Tcl_NumUtfChars() function. There is no inline
+ * fast path any more: Tcl_NumUtfChars() skips runs of one-byte characters a
+ * machine word at a time, which beats a byte loop for all but the shortest
+ * strings. The ANSI C "prototype" for this macro is:
  *
  * MODULE_SCOPE void	TclNumUtfChars(int numChars, const char *bytes,
  *				int numBytes);
@@ -4115,16 +4245,7 @@ MODULE_SCOPE void	TclDbInitNewObj(Tcl_Obj *objPtr, const char *file,
  */
 
 #define TclNumUtfChars(numChars, bytes, numBytes) \
-    do { \
-	int count, i = (numBytes); \
-	unsigned char *str = (unsigned char *) (bytes); \
-	while (i && (*str < 0xC0)) { i--; str++; } \
-	count = (numBytes) - i; \
-	if (i) { \
-	    count += Tcl_NumUtfChars((bytes) + count, i); \
-	} \
-	(numChars) = count; \
-    } while (0);
+    ((numChars) = Tcl_NumUtfChars((bytes), (numBytes)))
 
 /*
  *----------------------------------------------------------------
@@ -4357,6 +4478,51 @@ MODULE_SCOPE Tcl_PackageInitProc Procbodytest_SafeInit;
 #define TclNewLiteralStringObj(objPtr, sLiteral) \
     TclNewStringObj((objPtr), (sLiteral), (int) (sizeof(sLiteral "") - 1))
 
+/*
+ *----------------------------------------------------------------
+ * Macros used by the Tcl core to hand out the per-thread shared objects for
+ * small integer values instead of allocating a fresh object each time. The
+ * table of shared objects is owned by the thread (see TclGetSmallIntTable in
+ * tclObj.c) and holds a reference to each of its objects, so they are always
+ * shared and callers must never modify them in place. The range of values
+ * covered may be changed at compile time. The ANSI C "prototypes" for these
+ * macros are:
+ *
+ * MODULE_SCOPE int	TclIsSmallInt(long l);
+ * MODULE_SCOPE Tcl_Obj *TclSmallIntObj(Tcl_Obj **table, long l);
+ * MODULE_SCOPE void	TclNewSharedIntObj(Tcl_Obj *objPtr, Tcl_Obj **table,
+ *			    long l);
+ *
+ * TclSmallIntObj may only be used for values for which TclIsSmallInt is
+ * true; TclNewSharedIntObj falls back to a new unshared object otherwise.
+ *----------------------------------------------------------------
+ */
+
+#ifndef TCL_SMALL_INT_MIN
+#define TCL_SMALL_INT_MIN	(-128)
+#endif
+#ifndef TCL_SMALL_INT_MAX
+#define TCL_SMALL_INT_MAX	1023
+#endif
+
+#define TclIsSmallInt(l) \
+    ((l) >= TCL_SMALL_INT_MIN && (l) <= TCL_SMALL_INT_MAX)
+
+#define TclSmallIntObj(table, l) \
+    ((((table)[(l) - TCL_SMALL_INT_MIN] != NULL)			\
+	    && ((table)[(l) - TCL_SMALL_INT_MIN]->typePtr == &tclIntType))	\
+	    ? (TclIncrObjsCached(), (table)[(l) - TCL_SMALL_INT_MIN])	\
+	    : TclFillSmallIntObj((table), (l)))
+
+#define TclNewSharedIntObj(objPtr, table, l) \
+    do {							\
+	if (TclIsSmallInt(l)) {					\
+	    (objPtr) = TclSmallIntObj((table), (l));		\
+	} else {						\
+	    TclNewLongObj((objPtr), (l));			\
+	}							\
+    } while (0)
+
 /*
  *----------------------------------------------------------------
  * Macros used by the Tcl core to test for some special double values.
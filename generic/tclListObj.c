@@ -14,6 +14,7 @@
  */
 
 #include "tclInt.h"
+#include <math.h>
 
 /*
  * Prototypes for functions defined later in this file:
@@ -22,8 +23,16 @@
 static List *		NewListIntRep(int objc, Tcl_Obj *const objv[]);
 static void		DupListInternalRep(Tcl_Obj *srcPtr, Tcl_Obj *copyPtr);
 static void		FreeListInternalRep(Tcl_Obj *listPtr);
+static void		ResetListIndex(List *listRepPtr);
 static int		SetListFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 static void		UpdateStringOfList(Tcl_Obj *listPtr);
+static int		PackedElementType(Tcl_Obj *objPtr);
+static int		PackList(Tcl_Obj *listPtr, int elemType);
+static int		PackedListAppend(Tcl_Obj *listPtr, Tcl_Obj *objPtr);
+static void		DupPackedListInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreePackedListInternalRep(Tcl_Obj *listPtr);
+static void		UpdateStringOfPackedList(Tcl_Obj *listPtr);
 
 /*
  * The structure below defines the list Tcl object type by means of functions
@@ -45,6 +54,55 @@ const Tcl_ObjType tclListType = {
     UpdateStringOfList,		/* updateStringProc */
     SetListFromAny		/* setFromAnyProc */
 };
+
+/*
+ * The packed list type is an alternative internal representation for lists
+ * whose elements are all pure integers (tclIntType values without a string
+ * representation) or all pure doubles. The values are stored unboxed in a
+ * PackedList structure, one machine word per element instead of a pointer
+ * plus a whole Tcl_Obj. [llength], [lindex], [foreach], [lsort -integer] and
+ * [lsort -real] and string generation work on the packed values directly,
+ * creating element objects only for the elements they hand out. Any other
+ * operation converts the value to an ordinary list with SetListFromAny, which
+ * boxes all the elements.
+ *
+ * Lists become packed only through TclLappendListElement (the [lappend]
+ * path), when a list of at least PACKED_LIST_MIN qualifying elements is about
+ * to grow its element array; the scan is amortized over the doubling of the
+ * array. There is no setFromAnyProc: the type is never requested by name.
+ */
+
+const Tcl_ObjType tclPackedListType = {
+    "packedList",		/* name */
+    FreePackedListInternalRep,	/* freeIntRepProc */
+    DupPackedListInternalRep,	/* dupIntRepProc */
+    UpdateStringOfPackedList,	/* updateStringProc */
+    NULL			/* setFromAnyProc */
+};
+
+#define PACKED_LIST_MIN		64
+#define PackedListSize(n) \
+    (sizeof(PackedList) + ((n)-1) * sizeof(PackedValue))
+
+/*
+ * TclRadixSort sorts arrays shorter than this by insertion, which is faster
+ * than clearing and filling in its tables of counts.
+ */
+
+#define RADIX_SORT_MIN		32
+
+/*
+ * TclListObjFindElement looks elements up in a hash index of a list of at
+ * least LIST_INDEX_MIN elements, once it has searched the list linearly
+ * TCL_LIST_INDEX_SEARCHES times without the list changing in between. The
+ * threshold can be set when building Tcl; the index costs a hash entry per
+ * element, and building it costs about as much as a few linear searches.
+ */
+
+#define LIST_INDEX_MIN		16
+#ifndef TCL_LIST_INDEX_SEARCHES
+#define TCL_LIST_INDEX_SEARCHES	3
+#endif
 
 /*
  *----------------------------------------------------------------------
@@ -100,6 +158,8 @@ NewListIntRep(
     listRepPtr->canonicalFlag = 0;
     listRepPtr->refCount = 0;
     listRepPtr->maxElemCount = objc;
+    listRepPtr->numSearches = 0;
+    listRepPtr->indexPtr = NULL;
 
     if (objv) {
 	Tcl_Obj **elemPtrs;
@@ -371,6 +431,12 @@ TclListObjCopy(
 {
     Tcl_Obj *copyPtr;
 
+    if (listPtr->typePtr == &tclPackedListType) {
+	TclNewObj(copyPtr);
+	TclInvalidateStringRep(copyPtr);
+	DupPackedListInternalRep(listPtr, copyPtr);
+	return copyPtr;
+    }
     if (listPtr->typePtr != &tclListType) {
 	if (SetListFromAny(interp, listPtr) != TCL_OK) {
 	    return NULL;
@@ -425,6 +491,9 @@ Tcl_ListObjGetElements(
 {
     register List *listRepPtr;
 
+    if (listPtr->typePtr == &tclPackedListType) {
+	SetListFromAny(NULL, listPtr);
+    }
     if (listPtr->typePtr != &tclListType) {
 	int result, length;
 
@@ -552,6 +621,18 @@ Tcl_ListObjAppendElement(
     if (Tcl_IsShared(listPtr)) {
 	Tcl_Panic("%s called with shared object", "Tcl_ListObjAppendElement");
     }
+    if (listPtr->typePtr == &tclPackedListType) {
+	/*
+	 * The packed form only records the element's value, so it can only
+	 * absorb an element that someone else holds a reference to; a new
+	 * element would otherwise be leaked or freed under the caller.
+	 */
+
+	if (objPtr->refCount > 0 && PackedListAppend(listPtr, objPtr)) {
+	    return TCL_OK;
+	}
+	SetListFromAny(NULL, listPtr);
+    }
     if (listPtr->typePtr != &tclListType) {
 	int result, length;
 
@@ -570,6 +651,7 @@ Tcl_ListObjAppendElement(
     listRepPtr = (List *) listPtr->internalRep.twoPtrValue.ptr1;
     numElems = listRepPtr->elemCount;
     numRequired = numElems + 1 ;
+    ResetListIndex(listRepPtr);
 
     /*
      * If there is no room in the current array of element pointers, allocate
@@ -628,6 +710,83 @@ Tcl_ListObjAppendElement(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclLappendListElement --
+ *
+ *	Variant of Tcl_ListObjAppendElement used by [lappend]. Besides
+ *	appending objPtr to the unshared list listPtr, it switches a large
+ *	list of pure integers or pure doubles to the packed list
+ *	representation when the list's element array has to grow, and keeps
+ *	appending to packed lists without boxing.
+ *
+ * Results:
+ *	The same as for Tcl_ListObjAppendElement.
+ *
+ * Side effects:
+ *	As for Tcl_ListObjAppendElement, except that when the value is stored
+ *	unboxed the list takes no reference to objPtr; an objPtr with a zero
+ *	reference count is then freed. The caller must not use objPtr after
+ *	the call unless it holds its own reference.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclLappendListElement(
+    Tcl_Interp *interp,		/* Used to report errors if not NULL. */
+    Tcl_Obj *listPtr,		/* List object to append objPtr to. */
+    Tcl_Obj *objPtr)		/* Object to append to listPtr's list. */
+{
+    if (Tcl_IsShared(listPtr)) {
+	Tcl_Panic("%s called with shared object", "TclLappendListElement");
+    }
+    if (listPtr->typePtr == &tclListType) {
+	List *listRepPtr = ListRepPtr(listPtr);
+	int elemType;
+
+	if (listRepPtr->indexPtr != NULL && listRepPtr->refCount == 1) {
+	    /*
+	     * Keep the index of a list being searched and appended to in
+	     * turn, as in [if {$x ni $l} {lappend l $x}], up to date rather
+	     * than rebuilding it. The element appended by [lappend] is not
+	     * changed in place afterwards, unlike those appended by other
+	     * callers of Tcl_ListObjAppendElement.
+	     */
+
+	    Tcl_HashTable *tablePtr = listRepPtr->indexPtr;
+	    int numSearches = listRepPtr->numSearches;
+	    int index = listRepPtr->elemCount, isNew;
+	    Tcl_HashEntry *hPtr;
+
+	    listRepPtr->indexPtr = NULL;
+	    Tcl_ListObjAppendElement(interp, listPtr, objPtr);
+	    listRepPtr = ListRepPtr(listPtr);
+	    listRepPtr->indexPtr = tablePtr;
+	    listRepPtr->numSearches = numSearches;
+	    hPtr = Tcl_CreateHashEntry(tablePtr, (char *) objPtr, &isNew);
+	    if (isNew) {
+		Tcl_SetHashValue(hPtr, INT2PTR(index));
+	    }
+	    return TCL_OK;
+	}
+	if (listRepPtr->elemCount >= PACKED_LIST_MIN
+		&& listRepPtr->elemCount == listRepPtr->maxElemCount
+		&& listRepPtr->refCount == 1
+		&& (elemType = PackedElementType(objPtr)) != 0) {
+	    PackList(listPtr, elemType);
+	}
+    }
+    if (listPtr->typePtr == &tclPackedListType
+	    && PackedListAppend(listPtr, objPtr)) {
+	Tcl_IncrRefCount(objPtr);
+	Tcl_DecrRefCount(objPtr);
+	return TCL_OK;
+    }
+    return Tcl_ListObjAppendElement(interp, listPtr, objPtr);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -663,6 +822,9 @@ Tcl_ListObjIndex(
 {
     register List *listRepPtr;
 
+    if (listPtr->typePtr == &tclPackedListType) {
+	SetListFromAny(NULL, listPtr);
+    }
     if (listPtr->typePtr != &tclListType) {
 	int result, length;
 
@@ -718,6 +880,10 @@ Tcl_ListObjLength(
 {
     register List *listRepPtr;
 
+    if (listPtr->typePtr == &tclPackedListType) {
+	*intPtr = PackedListRepPtr(listPtr)->elemCount;
+	return TCL_OK;
+    }
     if (listPtr->typePtr != &tclListType) {
 	int result, length;
 
@@ -793,6 +959,9 @@ Tcl_ListObjReplace(
     if (Tcl_IsShared(listPtr)) {
 	Tcl_Panic("%s called with shared object", "Tcl_ListObjReplace");
     }
+    if (listPtr->typePtr == &tclPackedListType) {
+	SetListFromAny(NULL, listPtr);
+    }
     if (listPtr->typePtr != &tclListType) {
 	int length;
 
@@ -823,6 +992,7 @@ Tcl_ListObjReplace(
     listRepPtr = (List *) listPtr->internalRep.twoPtrValue.ptr1;
     elemPtrs = &listRepPtr->elements;
     numElems = listRepPtr->elemCount;
+    ResetListIndex(listRepPtr);
 
     if (first < 0) {
 	first = 0;
@@ -1094,7 +1264,7 @@ TclLindexFlat(
     Tcl_IncrRefCount(listPtr);
 
     for (i=0 ; i<indexCount && listPtr ; i++) {
-	int index, listLen = 0;
+	int index, listLen = 0, packed = 0;
 	Tcl_Obj **elemPtrs = NULL, *sublistCopy;
 
 	/*
@@ -1114,7 +1284,12 @@ TclLindexFlat(
 
 	    break;
 	}
-	TclListObjGetElements(NULL, sublistCopy, &listLen, &elemPtrs);
+	if (sublistCopy->typePtr == &tclPackedListType) {
+	    packed = 1;
+	    listLen = PackedListRepPtr(sublistCopy)->elemCount;
+	} else {
+	    TclListObjGetElements(NULL, sublistCopy, &listLen, &elemPtrs);
+	}
 
 	if (TclGetIntForIndexM(interp, indexArray[i], /*endValue*/ listLen-1,
 		&index) == TCL_OK) {
@@ -1134,10 +1309,15 @@ TclLindexFlat(
 		listPtr = Tcl_NewObj();
 	    } else {
 		/*
-		 * Extract the pointer to the appropriate element.
+		 * Extract the pointer to the appropriate element. Elements of
+		 * packed lists are boxed on demand.
 		 */
 
-		listPtr = elemPtrs[index];
+		if (packed) {
+		    listPtr = TclPackedListElement(sublistCopy, index);
+		} else {
+		    listPtr = elemPtrs[index];
+		}
 	    }
 	    Tcl_IncrRefCount(listPtr);
 	}
@@ -1502,6 +1682,9 @@ TclListObjSetElement(
     if (Tcl_IsShared(listPtr)) {
 	Tcl_Panic("%s called with shared object", "TclListObjSetElement");
     }
+    if (listPtr->typePtr == &tclPackedListType) {
+	SetListFromAny(NULL, listPtr);
+    }
     if (listPtr->typePtr != &tclListType) {
 	int length, result;
 
@@ -1520,6 +1703,7 @@ TclListObjSetElement(
     listRepPtr = (List *) listPtr->internalRep.twoPtrValue.ptr1;
     elemCount = listRepPtr->elemCount;
     elemPtrs = &listRepPtr->elements;
+    ResetListIndex(listRepPtr);
 
     /*
      * Ensure that the index is in bounds.
@@ -1579,6 +1763,129 @@ TclListObjSetElement(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListObjFindElement --
+ *
+ *	This function finds the first element of a list whose string value is
+ *	the same as that of valuePtr, for [in], [ni] and [lsearch -exact].
+ *	Once a list of some size has been searched TCL_LIST_INDEX_SEARCHES
+ *	times without changing, a hash table of its elements is built and
+ *	kept in the List struct, so that searching the same list again and
+ *	again does not take time proportional to its length.
+ *
+ * Results:
+ *	The return value is normally TCL_OK; in this case *indexPtr is set to
+ *	the index of the element found, or -1 if there is none. If listPtr
+ *	does not refer to a list and can't be converted to one, TCL_ERROR is
+ *	returned and an error message is left in the interpreter's result if
+ *	interp is not NULL.
+ *
+ * Side effects:
+ *	listPtr will be converted, if necessary, to a list object. The index
+ *	may be built, which gives the elements string representations.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclListObjFindElement(
+    Tcl_Interp *interp,		/* Used to report errors if not NULL. */
+    Tcl_Obj *listPtr,		/* List object to search. */
+    Tcl_Obj *valuePtr,		/* Value to search the list for. */
+    int *indexPtr)		/* Where to store the index found. */
+{
+    List *listRepPtr;
+    Tcl_Obj **elemPtrs;
+    Tcl_HashEntry *hPtr;
+    const char *bytes, *elemBytes;
+    int numElems, length, elemLength, i, isNew;
+
+    if (TclListObjGetElements(interp, listPtr, &numElems,
+	    &elemPtrs) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    *indexPtr = -1;
+    if (numElems == 0) {
+	return TCL_OK;
+    }
+
+    listRepPtr = ListRepPtr(listPtr);
+    if (listRepPtr->indexPtr == NULL && numElems >= LIST_INDEX_MIN
+	    && ++listRepPtr->numSearches > TCL_LIST_INDEX_SEARCHES) {
+	listRepPtr->indexPtr = (Tcl_HashTable *)
+		ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitObjHashTable(listRepPtr->indexPtr);
+	for (i = 0; i < numElems; i++) {
+	    hPtr = Tcl_CreateHashEntry(listRepPtr->indexPtr,
+		    (char *) elemPtrs[i], &isNew);
+	    if (isNew) {
+		Tcl_SetHashValue(hPtr, INT2PTR(i));
+	    }
+	}
+    }
+    if (listRepPtr->indexPtr != NULL) {
+	hPtr = Tcl_FindHashEntry(listRepPtr->indexPtr, (char *) valuePtr);
+	if (hPtr != NULL) {
+	    *indexPtr = PTR2INT(Tcl_GetHashValue(hPtr));
+	}
+	return TCL_OK;
+    }
+
+    bytes = TclGetStringFromObj(valuePtr, &length);
+    for (i = 0; i < numElems; i++) {
+	elemBytes = TclGetStringFromObj(elemPtrs[i], &elemLength);
+	if (elemLength == length
+		&& memcmp(elemBytes, bytes, (size_t) length) == 0) {
+	    *indexPtr = i;
+	    break;
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListObjInvalidateIndex, ResetListIndex --
+ *
+ *	These functions drop the hash index of a list's elements built by
+ *	TclListObjFindElement, and restart the count of searches, because the
+ *	elements are about to change. TclListObjInvalidateIndex is for code
+ *	outside this file that changes the elements of an unshared list in
+ *	place.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The index is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclListObjInvalidateIndex(
+    Tcl_Obj *listPtr)		/* List object about to change. */
+{
+    if (listPtr->typePtr == &tclListType) {
+	ResetListIndex(ListRepPtr(listPtr));
+    }
+}
+
+static void
+ResetListIndex(
+    List *listRepPtr)		/* List struct about to change. */
+{
+    listRepPtr->numSearches = 0;
+    if (listRepPtr->indexPtr != NULL) {
+	Tcl_DeleteHashTable(listRepPtr->indexPtr);
+	ckfree((char *) listRepPtr->indexPtr);
+	listRepPtr->indexPtr = NULL;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1609,6 +1916,7 @@ FreeListInternalRep(
     int i;
 
     if (--listRepPtr->refCount <= 0) {
+	ResetListIndex(listRepPtr);
 	for (i = 0;  i < numElems;  i++) {
 	    objPtr = elemPtrs[i];
 	    Tcl_DecrRefCount(objPtr);
@@ -1685,6 +1993,28 @@ SetListFromAny(
     register Tcl_Obj *elemPtr;
     List *listRepPtr;
 
+    /*
+     * Packed lists are converted by boxing each element value. The string
+     * representation, if any, stays valid.
+     */
+
+    if (objPtr->typePtr == &tclPackedListType) {
+	PackedList *packedPtr = PackedListRepPtr(objPtr);
+
+	listRepPtr = NewListIntRep(packedPtr->maxElemCount, NULL);
+	if (!listRepPtr) {
+	    Tcl_Panic("Not enough memory to allocate list");
+	}
+	elemPtrs = &listRepPtr->elements;
+	for (i = 0; i < packedPtr->elemCount; i++) {
+	    elemPtrs[i] = TclPackedListElement(objPtr, i);
+	    Tcl_IncrRefCount(elemPtrs[i]);
+	}
+	listRepPtr->elemCount = packedPtr->elemCount;
+	listRepPtr->canonicalFlag = 1;
+	goto commitRepresentation;
+    }
+
     /*
      * Dictionaries are a special case; they have a string representation such
      * that *all* valid dictionaries are valid lists. Hence we can convert
@@ -1935,6 +2265,533 @@ UpdateStringOfList(
     listRepPtr->canonicalFlag = 1;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PackedElementType --
+ *
+ *	Determine whether an element value can be stored in a packed list.
+ *	The packed form must reproduce the element's string exactly, so
+ *	integers qualify only when they have no string representation or the
+ *	canonical one (as literals such as "0" do), and doubles only when they
+ *	have no string representation, since their formatting depends on
+ *	tcl_precision.
+ *
+ * Results:
+ *	TCL_PACKED_INT for such integers, TCL_PACKED_DOUBLE for pure doubles
+ *	other than NaN, and 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PackedElementType(
+    Tcl_Obj *objPtr)		/* Candidate element. */
+{
+    if (objPtr->typePtr == &tclIntType) {
+	if (objPtr->bytes != NULL) {
+	    char buf[TCL_INTEGER_SPACE];
+
+	    if (objPtr->length != TclFormatInt(buf,
+		    objPtr->internalRep.longValue)
+		    || memcmp(buf, objPtr->bytes, (size_t) objPtr->length)) {
+		return 0;
+	    }
+	}
+	return TCL_PACKED_INT;
+    }
+    if (objPtr->bytes != NULL) {
+	return 0;
+    }
+    if (objPtr->typePtr == &tclDoubleType
+	    && !TclIsNaN(objPtr->internalRep.doubleValue)) {
+	return TCL_PACKED_DOUBLE;
+    }
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PackList --
+ *
+ *	Attempt to convert an ordinary list, whose List struct must not be
+ *	shared, to the packed list representation. Room is reserved for twice
+ *	the current number of elements.
+ *
+ * Results:
+ *	1 if the list was converted, 0 if some element does not have the type
+ *	elemType or memory could not be allocated.
+ *
+ * Side effects:
+ *	On success the element objects are released. The string
+ *	representation, if any, is kept.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PackList(
+    Tcl_Obj *listPtr,		/* List object to convert. */
+    int elemType)		/* Required type of all elements. */
+{
+    List *listRepPtr = ListRepPtr(listPtr);
+    Tcl_Obj **elemPtrs = &listRepPtr->elements;
+    int i, numElems = listRepPtr->elemCount;
+    PackedList *packedPtr;
+
+    for (i = 0; i < numElems; i++) {
+	if (PackedElementType(elemPtrs[i]) != elemType) {
+	    return 0;
+	}
+    }
+    if ((size_t) numElems > INT_MAX / (2 * sizeof(PackedValue))) {
+	return 0;
+    }
+    packedPtr = (PackedList *) attemptckalloc(PackedListSize(2 * numElems));
+    if (packedPtr == NULL) {
+	return 0;
+    }
+    packedPtr->refCount = 1;
+    packedPtr->maxElemCount = 2 * numElems;
+    packedPtr->elemCount = numElems;
+    packedPtr->elemType = elemType;
+    if (elemType == TCL_PACKED_INT) {
+	for (i = 0; i < numElems; i++) {
+	    packedPtr->elements[i].longValue =
+		    elemPtrs[i]->internalRep.longValue;
+	}
+    } else {
+	for (i = 0; i < numElems; i++) {
+	    packedPtr->elements[i].doubleValue =
+		    elemPtrs[i]->internalRep.doubleValue;
+	}
+    }
+
+    TclFreeIntRep(listPtr);
+    listPtr->internalRep.twoPtrValue.ptr1 = packedPtr;
+    listPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    listPtr->typePtr = &tclPackedListType;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PackedListAppend --
+ *
+ *	Append the value of objPtr to an unshared packed list object, growing
+ *	or unsharing its PackedList struct as needed.
+ *
+ * Results:
+ *	1 if the value was appended, 0 if objPtr's value cannot be stored in
+ *	this packed list or memory could not be allocated.
+ *
+ * Side effects:
+ *	No reference to objPtr is kept. The list's string representation is
+ *	invalidated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+PackedListAppend(
+    Tcl_Obj *listPtr,		/* Packed list object to append to. */
+    Tcl_Obj *objPtr)		/* Element value to append. */
+{
+    PackedList *packedPtr = PackedListRepPtr(listPtr);
+    int numElems = packedPtr->elemCount;
+
+    if (PackedElementType(objPtr) != packedPtr->elemType) {
+	return 0;
+    }
+    if (packedPtr->refCount > 1 || numElems >= packedPtr->maxElemCount) {
+	PackedList *newPtr;
+	int newMax = packedPtr->maxElemCount;
+
+	if (numElems >= newMax) {
+	    if ((size_t) numElems + 1 > INT_MAX / (2 * sizeof(PackedValue))) {
+		return 0;
+	    }
+	    newMax = 2 * (numElems + 1);
+	}
+	if (packedPtr->refCount > 1) {
+	    newPtr = (PackedList *) attemptckalloc(PackedListSize(newMax));
+	    if (newPtr == NULL) {
+		return 0;
+	    }
+	    memcpy(newPtr, packedPtr, PackedListSize(numElems));
+	    newPtr->refCount = 1;
+	    packedPtr->refCount--;
+	} else {
+	    newPtr = (PackedList *) attemptckrealloc((char *) packedPtr,
+		    PackedListSize(newMax));
+	    if (newPtr == NULL) {
+		return 0;
+	    }
+	}
+	newPtr->maxElemCount = newMax;
+	packedPtr = newPtr;
+	listPtr->internalRep.twoPtrValue.ptr1 = packedPtr;
+    }
+
+    if (packedPtr->elemType == TCL_PACKED_INT) {
+	packedPtr->elements[numElems].longValue =
+		objPtr->internalRep.longValue;
+    } else {
+	packedPtr->elements[numElems].doubleValue =
+		objPtr->internalRep.doubleValue;
+    }
+    packedPtr->elemCount++;
+    Tcl_InvalidateStringRep(listPtr);
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListElement --
+ *
+ *	Box one element of a packed list object. The index must be in range.
+ *
+ * Results:
+ *	An integer or double object holding the element. Small integers are
+ *	the thread's shared objects (see TclSmallIntObj), anything else is a
+ *	new object with a reference count of zero.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclPackedListElement(
+    Tcl_Obj *listPtr,		/* Packed list object. */
+    int index)			/* Index of the element to box. */
+{
+    PackedList *packedPtr = PackedListRepPtr(listPtr);
+    Tcl_Obj *objPtr;
+
+    if (packedPtr->elemType == TCL_PACKED_INT) {
+	long value = packedPtr->elements[index].longValue;
+
+	if (TclIsSmallInt(value)) {
+	    objPtr = TclSmallIntObj(TclGetSmallIntTable(), value);
+	} else {
+	    TclNewLongObj(objPtr, value);
+	}
+    } else {
+	TclNewDoubleObj(objPtr, packedPtr->elements[index].doubleValue);
+    }
+    return objPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListSort --
+ *
+ *	Sort the values of a packed list numerically, as [lsort -integer] or
+ *	[lsort -real] would for integer and double packed lists respectively.
+ *	The sort is a stable radix sort, so equal values (0.0 and -0.0) keep
+ *	their relative order; with unique set, only the last of each run of
+ *	equal values is retained, as [lsort -unique] does.
+ *
+ * Results:
+ *	A new packed list object with a reference count of zero.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclPackedListSort(
+    Tcl_Obj *listPtr,		/* Packed list object to sort. */
+    int isIncreasing,		/* Sort order. */
+    int unique)			/* Drop duplicate values. */
+{
+    PackedList *srcPtr = PackedListRepPtr(listPtr), *sortedPtr;
+    int numElems = srcPtr->elemCount, isInt = srcPtr->elemType==TCL_PACKED_INT;
+    int i, k;
+    SortPair *pairs, *sortedPairs;
+    Tcl_Obj *resultPtr;
+
+    pairs = (SortPair *) ckalloc(2 * numElems * sizeof(SortPair));
+    for (i = 0; i < numElems; i++) {
+	Tcl_WideUInt key = isInt
+		? TclLongSortKey(srcPtr->elements[i].longValue)
+		: TclDoubleSortKey(srcPtr->elements[i].doubleValue);
+
+	pairs[i].key = (isIncreasing ? key : ~key);
+	pairs[i].index = i;
+    }
+    sortedPairs = TclRadixSort(pairs, pairs + numElems, numElems);
+
+    sortedPtr = (PackedList *) ckalloc(PackedListSize(numElems));
+    sortedPtr->refCount = 1;
+    sortedPtr->maxElemCount = numElems;
+    sortedPtr->elemType = srcPtr->elemType;
+    for (i = 0, k = 0; i < numElems; i++) {
+	if (unique && (i + 1 < numElems)
+		&& (sortedPairs[i].key == sortedPairs[i+1].key)) {
+	    continue;
+	}
+	sortedPtr->elements[k++] = srcPtr->elements[sortedPairs[i].index];
+    }
+    sortedPtr->elemCount = k;
+    ckfree((char *) pairs);
+
+    TclNewObj(resultPtr);
+    TclInvalidateStringRep(resultPtr);
+    resultPtr->internalRep.twoPtrValue.ptr1 = sortedPtr;
+    resultPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    resultPtr->typePtr = &tclPackedListType;
+    return resultPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclDoubleSortKey --
+ *
+ *	Make the key by which TclRadixSort orders a double. Keys compare as
+ *	unsigned integers in the same order as the doubles they are made from,
+ *	which must not be NaN. Both zeros have the same key.
+ *
+ * Results:
+ *	The key.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_WideUInt
+TclDoubleSortKey(
+    double d)			/* The value to make a key for. */
+{
+    union {
+	double d;
+	Tcl_WideUInt w;
+    } u;
+    Tcl_WideUInt sign = (Tcl_WideUInt) 1 << 63;
+
+    u.d = (d == 0.0) ? 0.0 : d;
+
+    /*
+     * Positive doubles order like their bits, so setting the sign bit puts
+     * them above all negative ones. Negative doubles order in reverse, so
+     * they have all their bits flipped.
+     */
+
+    return (u.w & sign) ? ~u.w : (u.w | sign);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRadixSort --
+ *
+ *	Sort an array of SortPairs by increasing key with an LSD radix sort,
+ *	one byte of the key per pass. Pairs with equal keys keep their order.
+ *	Passes over bytes that are the same in every key are skipped, so
+ *	small integers take only a few passes. Short arrays are sorted by
+ *	insertion instead.
+ *
+ * Results:
+ *	The sorted array: either pairs or work, which must have room for
+ *	numPairs pairs. The other one holds garbage.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+SortPair *
+TclRadixSort(
+    SortPair *pairs,		/* The pairs to sort. */
+    SortPair *work,		/* Work space for as many pairs. */
+    int numPairs)		/* Number of pairs. */
+{
+    int counts[8][256];
+    int digit, i, n, sum;
+    SortPair *fromPtr = pairs, *toPtr = work, *tmpPtr;
+
+    if (numPairs < RADIX_SORT_MIN) {
+	for (i = 1; i < numPairs; i++) {
+	    SortPair pair = pairs[i];
+
+	    for (n = i; (n > 0) && (pairs[n-1].key > pair.key); n--) {
+		pairs[n] = pairs[n-1];
+	    }
+	    pairs[n] = pair;
+	}
+	return pairs;
+    }
+
+    /*
+     * Count the values of every byte in one go.
+     */
+
+    memset(counts, 0, sizeof(counts));
+    for (i = 0; i < numPairs; i++) {
+	Tcl_WideUInt key = pairs[i].key;
+
+	for (digit = 0; digit < 8; digit++) {
+	    counts[digit][(int) ((key >> (8 * digit)) & 0xFF)]++;
+	}
+    }
+
+    for (digit = 0; digit < 8; digit++) {
+	int *countPtr = counts[digit];
+	int shift = 8 * digit;
+
+	if (countPtr[(int) ((fromPtr[0].key >> shift) & 0xFF)] == numPairs) {
+	    continue;
+	}
+
+	/*
+	 * Turn the counts into the places where each byte value starts, then
+	 * distribute the pairs there in order.
+	 */
+
+	for (i = 0, sum = 0; i < 256; i++) {
+	    n = countPtr[i];
+	    countPtr[i] = sum;
+	    sum += n;
+	}
+	for (i = 0; i < numPairs; i++) {
+	    toPtr[countPtr[(int) ((fromPtr[i].key >> shift) & 0xFF)]++] =
+		    fromPtr[i];
+	}
+	tmpPtr = fromPtr;
+	fromPtr = toPtr;
+	toPtr = tmpPtr;
+    }
+    return fromPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreePackedListInternalRep --
+ *
+ *	Deallocate the storage associated with a packed list object's
+ *	internal representation.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the PackedList struct once no object refers to it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreePackedListInternalRep(
+    Tcl_Obj *listPtr)		/* Packed list object with internal rep to
+				 * free. */
+{
+    PackedList *packedPtr = PackedListRepPtr(listPtr);
+
+    if (--packedPtr->refCount <= 0) {
+	ckfree((char *) packedPtr);
+    }
+    listPtr->internalRep.twoPtrValue.ptr1 = NULL;
+    listPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    listPtr->typePtr = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DupPackedListInternalRep --
+ *
+ *	Initialize the internal representation of a packed list Tcl_Obj to
+ *	share the internal representation of an existing one.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The reference count of the PackedList internal rep is incremented.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DupPackedListInternalRep(
+    Tcl_Obj *srcPtr,		/* Object with internal rep to copy. */
+    Tcl_Obj *copyPtr)		/* Object with internal rep to set. */
+{
+    PackedList *packedPtr = PackedListRepPtr(srcPtr);
+
+    packedPtr->refCount++;
+    copyPtr->internalRep.twoPtrValue.ptr1 = packedPtr;
+    copyPtr->internalRep.twoPtrValue.ptr2 = NULL;
+    copyPtr->typePtr = &tclPackedListType;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdateStringOfPackedList --
+ *
+ *	Update the string representation for a packed list object, formatting
+ *	the values directly. Numbers never need list quoting, so the result
+ *	is the same as UpdateStringOfList would produce for the boxed
+ *	elements.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The object's string is set to the canonical list string.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfPackedList(
+    Tcl_Obj *listPtr)		/* Packed list object with string rep to
+				 * update. */
+{
+    PackedList *packedPtr = PackedListRepPtr(listPtr);
+    int i, numElems = packedPtr->elemCount;
+    int space = (packedPtr->elemType == TCL_PACKED_INT)
+	    ? TCL_INTEGER_SPACE : TCL_DOUBLE_SPACE;
+    char *dst;
+
+    if (numElems > (INT_MAX - 1) / (space + 1)) {
+	Tcl_Panic("string representation size exceeds sane bounds");
+    }
+    listPtr->bytes = ckalloc((unsigned) numElems * (space + 1) + 1);
+    dst = listPtr->bytes;
+    for (i = 0; i < numElems; i++) {
+	if (i > 0) {
+	    *dst++ = ' ';
+	}
+	if (packedPtr->elemType == TCL_PACKED_INT) {
+	    dst += TclFormatInt(dst, packedPtr->elements[i].longValue);
+	} else {
+	    Tcl_PrintDouble(NULL, packedPtr->elements[i].doubleValue, dst);
+	    dst += strlen(dst);
+	}
+    }
+    *dst = '\0';
+    listPtr->length = dst - listPtr->bytes;
+    listPtr->bytes = ckrealloc(listPtr->bytes, (unsigned) listPtr->length+1);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -33,6 +33,7 @@
 static int		AddLocalLiteralEntry(CompileEnv *envPtr,
 			    Tcl_Obj *objPtr, int localHash);
 static void		ExpandLocalLiteralArray(CompileEnv *envPtr);
+static unsigned		HashLiteralObj(Tcl_Obj *objPtr);
 static unsigned		HashString(const char *string, int length);
 static void		RebuildLiteralTable(LiteralTable *tablePtr);
 
@@ -516,11 +517,9 @@ TclLookupLiteralEntry(
     Interp *iPtr = (Interp *) interp;
     LiteralTable *globalTablePtr = &iPtr->literalTable;
     register LiteralEntry *entryPtr;
-    const char *bytes;
-    int length, globalHash;
+    int globalHash;
 
-    bytes = TclGetStringFromObj(objPtr, &length);
-    globalHash = (HashString(bytes, length) & globalTablePtr->mask);
+    globalHash = (HashLiteralObj(objPtr) & globalTablePtr->mask);
     for (entryPtr=globalTablePtr->buckets[globalHash] ; entryPtr!=NULL;
 	    entryPtr=entryPtr->nextPtr) {
 	if (entryPtr->objPtr == objPtr) {
@@ -561,8 +560,7 @@ TclHideLiteral(
 {
     LiteralEntry **nextPtrPtr, *entryPtr, *lPtr;
     LiteralTable *localTablePtr = &envPtr->localLitTable;
-    int localHash, length;
-    const char *bytes;
+    int localHash;
     Tcl_Obj *newObjPtr;
 
     lPtr = &envPtr->literalArrayPtr[index];
@@ -579,8 +577,7 @@ TclHideLiteral(
     TclReleaseLiteral(interp, lPtr->objPtr);
     lPtr->objPtr = newObjPtr;
 
-    bytes = TclGetStringFromObj(newObjPtr, &length);
-    localHash = (HashString(bytes, length) & localTablePtr->mask);
+    localHash = (HashLiteralObj(newObjPtr) & localTablePtr->mask);
     nextPtrPtr = &localTablePtr->buckets[localHash];
 
     for (entryPtr=*nextPtrPtr ; entryPtr!=NULL ; entryPtr=*nextPtrPtr) {
@@ -827,11 +824,9 @@ TclReleaseLiteral(
     Interp *iPtr = (Interp *) interp;
     LiteralTable *globalTablePtr = &iPtr->literalTable;
     register LiteralEntry *entryPtr, *prevPtr;
-    const char *bytes;
-    int length, index;
+    int index;
 
-    bytes = TclGetStringFromObj(objPtr, &length);
-    index = (HashString(bytes, length) & globalTablePtr->mask);
+    index = (HashLiteralObj(objPtr) & globalTablePtr->mask);
 
     /*
      * Check to see if the object is in the global literal table and remove
@@ -862,7 +857,8 @@ TclReleaseLiteral(
 		TclDecrRefCount(objPtr);
 
 #ifdef TCL_COMPILE_STATS
-		iPtr->stats.currentLitStringBytes -= (double) (length + 1);
+		iPtr->stats.currentLitStringBytes -=
+			(double) (objPtr->length + 1);
 #endif /*TCL_COMPILE_STATS*/
 	    }
 	    break;
@@ -876,6 +872,38 @@ TclReleaseLiteral(
     Tcl_DecrRefCount(objPtr);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashLiteralObj --
+ *
+ *	Compute the hash of the string rep of a literal object, using the
+ *	value cached in the object by TclHashObjKey when there is one.
+ *
+ * Results:
+ *	The same value as HashString gives for the object's string rep.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned
+HashLiteralObj(
+    Tcl_Obj *objPtr)		/* Literal object to hash. */
+{
+    unsigned hash;
+    const char *bytes;
+    int length;
+
+    if (TclFetchStringHash(objPtr, &hash)) {
+	return hash;
+    }
+    bytes = TclGetStringFromObj(objPtr, &length);
+    return HashString(bytes, length);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -966,8 +994,7 @@ RebuildLiteralTable(
     register LiteralEntry **oldChainPtr, **newChainPtr;
     register LiteralEntry *entryPtr;
     LiteralEntry **bucketPtr;
-    const char *bytes;
-    int oldSize, count, index, length;
+    int oldSize, count, index;
 
     oldSize = tablePtr->numBuckets;
     oldBuckets = tablePtr->buckets;
@@ -993,8 +1020,7 @@ RebuildLiteralTable(
 
     for (oldChainPtr=oldBuckets ; oldSize>0 ; oldSize--,oldChainPtr++) {
 	for (entryPtr=*oldChainPtr ; entryPtr!=NULL ; entryPtr=*oldChainPtr) {
-	    bytes = TclGetStringFromObj(entryPtr->objPtr, &length);
-	    index = (HashString(bytes, length) & tablePtr->mask);
+	    index = (HashLiteralObj(entryPtr->objPtr) & tablePtr->mask);
 
 	    *oldChainPtr = entryPtr->nextPtr;
 	    bucketPtr = &tablePtr->buckets[index];
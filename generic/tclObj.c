@@ -90,6 +90,11 @@ typedef struct ThreadSpecificData {
                                  * tclCompile.h for the definition of this
                                  * structure, and for references to all
                                  * related places in the core. */
+    Tcl_Obj **smallIntObjs;	/* Table of shared objects for the integers
+				 * from TCL_SMALL_INT_MIN to TCL_SMALL_INT_MAX,
+				 * filled on demand. Each object in it has a
+				 * reference held by the table, so they are
+				 * never unshared. See TclGetSmallIntTable. */
 #if defined(TCL_MEM_DEBUG) && defined(TCL_THREADS)
     Tcl_HashTable *objThreadMap;/* Thread local table that is used to check
                                  * that a Tcl_Obj was not allocated by some
@@ -417,6 +422,7 @@ TclInitObjSubsystem(void)
     Tcl_MutexLock(&tclObjMutex);
     tclObjsAlloced = 0;
     tclObjsFreed = 0;
+    tclObjsCached = 0;
     {
 	int i;
 
@@ -440,7 +446,7 @@ TclInitObjSubsystem(void)
  *	None.
  *
  * Side effects:
- *	None.
+ *	Releases the thread's shared small integer objects.
  *
  *----------------------------------------------------------------------
  */
@@ -448,11 +454,33 @@ TclInitObjSubsystem(void)
 void
 TclFinalizeThreadObjects(void)
 {
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 #if defined(TCL_MEM_DEBUG) && defined(TCL_THREADS)
     Tcl_HashEntry *hPtr;
     Tcl_HashSearch hSearch;
-    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
-    Tcl_HashTable *tablePtr = tsdPtr->objThreadMap;
+    Tcl_HashTable *tablePtr;
+#endif
+
+    /*
+     * Release the shared small integer objects. This must happen before the
+     * objThreadMap goes away as freeing them consults it.
+     */
+
+    if (tsdPtr->smallIntObjs != NULL) {
+	Tcl_Obj **table = tsdPtr->smallIntObjs;
+	int i;
+
+	tsdPtr->smallIntObjs = NULL;
+	for (i=0 ; i<=TCL_SMALL_INT_MAX-TCL_SMALL_INT_MIN ; i++) {
+	    if (table[i] != NULL) {
+		TclDecrRefCount(table[i]);
+	    }
+	}
+	ckfree((char *) table);
+    }
+
+#if defined(TCL_MEM_DEBUG) && defined(TCL_THREADS)
+    tablePtr = tsdPtr->objThreadMap;
 
     if (tablePtr != NULL) {
 	for (hPtr = Tcl_FirstHashEntry(tablePtr, &hSearch);
@@ -508,6 +536,85 @@ TclFinalizeObjects(void)
     Tcl_MutexUnlock(&tclObjMutex);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetSmallIntTable --
+ *
+ *	Returns the calling thread's table of shared objects for small integer
+ *	values, creating it if needed. The table is indexed by the value minus
+ *	TCL_SMALL_INT_MIN and its slots are filled on demand; use the
+ *	TclSmallIntObj and TclNewSharedIntObj macros rather than indexing it
+ *	directly. It lives until TclFinalizeThreadObjects.
+ *
+ * Results:
+ *	A pointer to the first slot of the table.
+ *
+ * Side effects:
+ *	May allocate memory for the table.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj **
+TclGetSmallIntTable(void)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    if (tsdPtr->smallIntObjs == NULL) {
+	size_t size = sizeof(Tcl_Obj *)
+		* (TCL_SMALL_INT_MAX - TCL_SMALL_INT_MIN + 1);
+
+	tsdPtr->smallIntObjs = (Tcl_Obj **) ckalloc(size);
+	memset(tsdPtr->smallIntObjs, 0, size);
+    }
+    return tsdPtr->smallIntObjs;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclFillSmallIntObj --
+ *
+ *	Slow path of TclSmallIntObj, taken when the slot for a value is still
+ *	empty or its object has been converted to some other type since it
+ *	was made (e.g., by using it as a list).
+ *
+ * Results:
+ *	The shared object for the value, which must be within the range
+ *	covered by the table.
+ *
+ * Side effects:
+ *	Allocates the object, or resets its internal rep to an integer.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclFillSmallIntObj(
+    Tcl_Obj **table,		/* The thread's small integer table. */
+    long value)			/* Value to get the shared object of. */
+{
+    Tcl_Obj **slotPtr = &table[value - TCL_SMALL_INT_MIN];
+    Tcl_Obj *objPtr = *slotPtr;
+
+    if (objPtr == NULL) {
+	TclNewLongObj(objPtr, value);
+	Tcl_IncrRefCount(objPtr);
+	*slotPtr = objPtr;
+    } else {
+	/*
+	 * The object still has the same value, so any string rep it has is
+	 * still valid; only the internal rep needs restoring.
+	 */
+
+	TclFreeIntRep(objPtr);
+	objPtr->internalRep.longValue = value;
+	objPtr->typePtr = &tclIntType;
+    }
+    return objPtr;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4050,7 +4157,7 @@ TclFreeObjEntry(
  *	string representation of the Tcl_Obj.
  *
  * Side effects:
- *	None.
+ *	The hash value may be cached in the Tcl_Obj; see TclStoreStringHash.
  *
  *----------------------------------------------------------------------
  */
@@ -4062,9 +4169,19 @@ TclHashObjKey(
 {
     Tcl_Obj *objPtr = keyPtr;
     int length;
-    const char *string = TclGetStringFromObj(objPtr, &length);
+    const char *string;
     unsigned int result = 0;
 
+    /*
+     * The same key values (literals especially) tend to be hashed over and
+     * over again, so the hash may already be cached in the value.
+     */
+
+    if (TclFetchStringHash(objPtr, &result)) {
+	return result;
+    }
+    string = TclGetStringFromObj(objPtr, &length);
+
     /*
      * I tried a zillion different hash functions and asked many other people
      * for advice. Many people had their own favorite functions, all
@@ -4105,6 +4222,7 @@ TclHashObjKey(
 	    result += (result << 3) + UCHAR(*++string);
 	}
     }
+    TclStoreStringHash(objPtr, result);
     return result;
 }
 
@@ -61,22 +61,77 @@
 
 /*
  * Thread local storage used to maintain a per-thread cache of compiled
- * regular expressions.
+ * regular expressions. Patterns are looked up in a hash table keyed by the
+ * pattern string; since the same pattern may be compiled with different
+ * flags, each table entry holds a chain of cache entries. All cache entries
+ * are also kept on a list in order of use, so that the least recently used
+ * one can be discarded when the cache is full.
+ *
+ * The default capacity may be overridden at build time, and at run time with
+ * the tcl::unsupported::regexpcache command.
  */
 
-#define NUM_REGEXPS 30
+#ifndef TCL_REGEXP_CACHE_SIZE
+#define TCL_REGEXP_CACHE_SIZE 250
+#endif
+
+/*
+ * The regexp engine keeps the DFAs of a regexp for its next match. The bytes
+ * they take in all the regexps of a thread are kept within a budget by
+ * freeing those of the least recently used regexps. One DFA may grow to half
+ * the budget, or REG_DFA_BUDGET if that is less, so that the two a match
+ * uses fit together.
+ */
+
+#ifndef TCL_REGEXP_DFA_BUDGET
+#define TCL_REGEXP_DFA_BUDGET (4 * REG_DFA_BUDGET)
+#endif
+
+/*
+ * Flag distinguishing a set of patterns compiled together (see
+ * TclGetRegExpSet) from a single pattern in the cache. It is never passed to
+ * the regexp engine.
+ */
+
+#define REGEXP_SET	0200000
+
+typedef struct RegexpCacheEntry {
+    struct TclRegexp *regexpPtr;/* Compiled form of the pattern. The cache
+				 * holds one reference to it. */
+    Tcl_HashEntry *hPtr;	/* Entry for the pattern in patternTable. */
+    struct RegexpCacheEntry *nextFlagsPtr;
+				/* Next entry with the same pattern but other
+				 * compilation flags, or NULL. */
+    struct RegexpCacheEntry *prevPtr;
+				/* Next more recently used entry, or NULL. */
+    struct RegexpCacheEntry *nextPtr;
+				/* Next less recently used entry, or NULL. */
+} RegexpCacheEntry;
 
 typedef struct ThreadSpecificData {
     int initialized;		/* Set to 1 when the module is initialized. */
-    char *patterns[NUM_REGEXPS];/* Strings corresponding to compiled regular
-				 * expression patterns. NULL means that this
-				 * slot isn't used. Malloc-ed. */
-    int patLengths[NUM_REGEXPS];/* Number of non-null characters in
-				 * corresponding entry in patterns. -1 means
-				 * entry isn't used. */
-    struct TclRegexp *regexps[NUM_REGEXPS];
-				/* Compiled forms of above strings. Also
-				 * malloc-ed, or NULL if not in use yet. */
+    Tcl_HashTable patternTable;	/* Maps pattern strings to chains of
+				 * RegexpCacheEntry. */
+    RegexpCacheEntry *firstPtr;	/* Most recently used entry. */
+    RegexpCacheEntry *lastPtr;	/* Least recently used entry; the first to be
+				 * discarded. */
+    int numEntries;		/* Number of entries in the cache. */
+    int maxEntries;		/* Capacity of the cache; always at least
+				 * 1. */
+    Tcl_WideInt hits;		/* Number of lookups satisfied by the
+				 * cache. */
+    Tcl_WideInt misses;		/* Number of lookups that had to compile. */
+    Tcl_WideInt compileTime;	/* Total time spent compiling patterns, in
+				 * microseconds. */
+    int dfaBudget;		/* Bytes the DFAs kept by all the regexps of
+				 * the thread may take. */
+    size_t dfaKept;		/* Bytes they take now. */
+    TclRegexp *firstDfaPtr;	/* Most recently used regexp keeping DFAs. */
+    TclRegexp *lastDfaPtr;	/* Least recently used one; the first whose
+				 * DFAs are freed. */
+    Tcl_WideInt dfaGrowths;	/* Number of times a DFA state cache grew. */
+    Tcl_WideInt dfaFlushes;	/* Number of state sets flushed from full DFA
+				 * state caches. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
@@ -87,15 +142,34 @@ static Tcl_ThreadDataKey dataKey;
 
 static TclRegexp *	CompileRegexp(Tcl_Interp *interp, const char *pattern,
 			    int length, int flags);
+static TclRegexp *	NewRegexp(int flags);
+static void		DiscardCacheEntry(ThreadSpecificData *tsdPtr,
+			    RegexpCacheEntry *entryPtr);
+static void		DiscardDfas(ThreadSpecificData *tsdPtr,
+			    TclRegexp *regexpPtr);
 static void		DupRegexpInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
 static void		FinalizeRegexp(ClientData clientData);
 static void		FreeRegexp(TclRegexp *regexpPtr);
 static void		FreeRegexpInternalRep(Tcl_Obj *objPtr);
+static ThreadSpecificData *GetRegexpCache(void);
+static int		RegExpExecBytes(Tcl_Interp *interp, Tcl_RegExp re,
+			    const unsigned char *bytes, int numBytes,
+			    int nmatches, int flags);
 static int		RegExpExecUniChar(Tcl_Interp *interp, Tcl_RegExp re,
 			    const Tcl_UniChar *uniString, int numChars,
 			    int nmatches, int flags);
 static int		SetRegexpFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
+static void		CacheRegexp(ThreadSpecificData *tsdPtr,
+			    const char *key, TclRegexp *regexpPtr);
+static TclRegexp *	LookupRegexp(ThreadSpecificData *tsdPtr,
+			    const char *key, int flags);
+static void		PrepareExec(ThreadSpecificData *tsdPtr,
+			    TclRegexp *regexpPtr);
+static void		TrackDfas(ThreadSpecificData *tsdPtr,
+			    TclRegexp *regexpPtr);
+static void		UnlinkDfas(ThreadSpecificData *tsdPtr,
+			    TclRegexp *regexpPtr);
 
 /*
  * The regular expression Tcl object type. This serves as a cache of the
@@ -178,6 +252,7 @@ Tcl_RegExpExec(
     TclRegexp *regexp = (TclRegexp *) re;
     Tcl_DString ds;
     const Tcl_UniChar *ustr;
+    const char *p;
 
     /*
      * If the starting point is offset from the beginning of the buffer, then
@@ -198,9 +273,18 @@ Tcl_RegExpExec(
     regexp->objPtr = NULL;
 
     /*
-     * Convert the string to Unicode and perform the match.
+     * An all-ASCII string can be matched as it is. Otherwise convert the
+     * string to Unicode and perform the match.
      */
 
+    for (p = text; UCHAR(*p) != 0 && UCHAR(*p) < 0x80; p++) {
+	/* Empty loop body. */
+    }
+    if (*p == '\0') {
+	return RegExpExecBytes(interp, re, (const unsigned char *) text,
+		p - text, -1 /* nmatches */, flags);
+    }
+
     Tcl_DStringInit(&ds);
     ustr = Tcl_UtfToUniCharDString(text, -1, &ds);
     numChars = Tcl_DStringLength(&ds) / sizeof(Tcl_UniChar);
@@ -295,6 +379,7 @@ RegExpExecUniChar(
 {
     int status;
     TclRegexp *regexpPtr = (TclRegexp *) re;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
     size_t last = regexpPtr->re.re_nsub + 1;
     size_t nm = last;
 
@@ -302,8 +387,10 @@ RegExpExecUniChar(
 	nm = (size_t) nmatches;
     }
 
+    PrepareExec(tsdPtr, regexpPtr);
     status = TclReExec(&regexpPtr->re, wString, (size_t) numChars,
 	    &regexpPtr->details, nm, regexpPtr->matches, flags);
+    TrackDfas(tsdPtr, regexpPtr);
 
     /*
      * Check for errors.
@@ -322,6 +409,67 @@ RegExpExecUniChar(
     return 1;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * RegExpExecBytes --
+ *
+ *	Like RegExpExecUniChar, but for a subject whose characters are all
+ *	below U+0100 and stored one per byte: a byte array, or a string whose
+ *	UTF-8 representation is all ASCII. Saves converting the subject to
+ *	Unicode; match offsets are still character indices.
+ *
+ * Results:
+ *	If an error occurs during the matching operation then -1 is returned
+ *	and an error message is left in interp's result. Otherwise the return
+ *	value is 1 if a matching range was found or 0 if there was no matching
+ *	range.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RegExpExecBytes(
+    Tcl_Interp *interp,		/* Interpreter to use for error reporting. */
+    Tcl_RegExp re,		/* Compiled regular expression; returned by a
+				 * previous call to Tcl_GetRegExpFromObj */
+    const unsigned char *bytes,	/* String against which to match re. */
+    int numBytes,		/* Length of the string (must be >=0). */
+    int nmatches,		/* How many subexpression matches (counting
+				 * the whole match as subexpression 0) are of
+				 * interest. -1 means "don't know". */
+    int flags)			/* Regular expression flags. */
+{
+    int status;
+    TclRegexp *regexpPtr = (TclRegexp *) re;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
+    size_t nm = regexpPtr->re.re_nsub + 1;
+
+    if (nmatches >= 0 && (size_t) nmatches < nm) {
+	nm = (size_t) nmatches;
+    }
+
+    PrepareExec(tsdPtr, regexpPtr);
+    status = TclReExecBytes(&regexpPtr->re, bytes, (size_t) numBytes,
+	    &regexpPtr->details, nm, regexpPtr->matches, flags);
+    TrackDfas(tsdPtr, regexpPtr);
+
+    if (status != REG_OKAY) {
+	if (status == REG_NOMATCH) {
+	    return 0;
+	}
+	if (interp != NULL) {
+	    TclRegError(interp, "error while matching regular expression: ",
+		    status);
+	}
+	return -1;
+    }
+    return 1;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -414,7 +562,8 @@ Tcl_RegExpMatch(
  *	return value is 1 if "string" matches "pattern" and 0 otherwise.
  *
  * Side effects:
- *	Converts the object to a Unicode object.
+ *	Converts the object to a Unicode object, unless it is a byte array or
+ *	its string representation is all ASCII.
  *
  *----------------------------------------------------------------------
  */
@@ -435,6 +584,7 @@ Tcl_RegExpExecObj(
 {
     TclRegexp *regexpPtr = (TclRegexp *) re;
     Tcl_UniChar *udata;
+    unsigned char *bytes;
     int length;
     int reflags = regexpPtr->flags;
 #define TCL_REG_GLOBOK_FLAGS \
@@ -466,6 +616,29 @@ Tcl_RegExpExecObj(
     regexpPtr->string = NULL;
     regexpPtr->objPtr = textObj;
 
+    /*
+     * Byte arrays, and strings whose UTF-8 representation is all ASCII, are
+     * matched one byte per character. Only other strings need their Unicode
+     * representation.
+     */
+
+    if (TclIsPureByteArray(textObj)) {
+	bytes = Tcl_GetByteArrayFromObj(textObj, &length);
+    } else {
+	length = Tcl_GetCharLength(textObj);
+	bytes = NULL;
+	if (textObj->bytes != NULL && textObj->length == length) {
+	    bytes = (unsigned char *) textObj->bytes;
+	}
+    }
+    if (bytes != NULL) {
+	if (offset > length) {
+	    offset = length;
+	}
+	return RegExpExecBytes(interp, re, bytes + offset, length - offset,
+		nmatches, flags);
+    }
+
     udata = Tcl_GetUnicodeFromObj(textObj, &length);
 
     if (offset > length) {
@@ -477,6 +650,67 @@ Tcl_RegExpExecObj(
     return RegExpExecUniChar(interp, re, udata, length, nmatches, flags);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegExpExecFrom --
+ *
+ *	Like Tcl_RegExpExecObj, but the search begins at offset without
+ *	cutting off the characters before it: they are the context that
+ *	decides whether ^ (with -lineanchor), \m, \M and \y match there. The
+ *	reported ranges are character indices from the start of textObj.
+ *
+ * Results:
+ *	If an error occurs during the matching operation then -1 is returned
+ *	and the interp's result contains an error message. Otherwise the
+ *	return value is 1 if a match was found and 0 otherwise.
+ *
+ * Side effects:
+ *	Converts the object to a Unicode object, unless it is a byte array or
+ *	its string representation is all ASCII.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegExpExecFrom(
+    Tcl_Interp *interp,		/* Interpreter to use for error reporting. */
+    Tcl_RegExp re,		/* Compiled regular expression. */
+    Tcl_Obj *textObj,		/* Text against which to match re. */
+    int offset,			/* Character index at which the search
+				 * begins; must be within textObj. */
+    int nmatches,		/* How many subexpression matches (counting
+				 * the whole match as subexpression 0) are of
+				 * interest. -1 means all of them. */
+    int flags)			/* Regular expression execution flags. */
+{
+    TclRegexp *regexpPtr = (TclRegexp *) re;
+    unsigned char *bytes;
+    Tcl_UniChar *udata;
+    int length;
+
+    regexpPtr->string = NULL;
+    regexpPtr->objPtr = textObj;
+    regexpPtr->matches[0].rm_so = offset;
+
+    if (TclIsPureByteArray(textObj)) {
+	bytes = Tcl_GetByteArrayFromObj(textObj, &length);
+    } else {
+	length = Tcl_GetCharLength(textObj);
+	bytes = NULL;
+	if (textObj->bytes != NULL && textObj->length == length) {
+	    bytes = (unsigned char *) textObj->bytes;
+	}
+    }
+    if (bytes != NULL) {
+	return RegExpExecBytes(interp, re, bytes, length, nmatches,
+		flags | REG_STARTEND);
+    }
+    udata = Tcl_GetUnicodeFromObj(textObj, &length);
+    return RegExpExecUniChar(interp, re, udata, length, nmatches,
+	    flags | REG_STARTEND);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -609,6 +843,188 @@ Tcl_GetRegExpFromObj(
     return (Tcl_RegExp) regexpPtr;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetRegExpSet --
+ *
+ *	Compile a set of patterns into a single regexp that finds the first
+ *	of them to match, using the per-thread regexp cache. The patterns are
+ *	every stride'th element of objv. This is how [switch -regexp] finds
+ *	its matching arm without trying each arm in turn.
+ *
+ * Results:
+ *	The compiled set, for TclRegExpExecSet, or NULL if the patterns cannot
+ *	be matched as a set: one of them does not compile, or uses
+ *	backreferences. Callers then fall back to matching the patterns one
+ *	by one, which also reports any errors in the right order.
+ *
+ * Side effects:
+ *	The set is added to the regexp cache.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_RegExp
+TclGetRegExpSet(
+    int objc,			/* Number of patterns. */
+    Tcl_Obj *const objv[],	/* The patterns, stride elements apart. */
+    int stride,			/* Distance between patterns in objv. */
+    int flags)			/* Compilation flags for every pattern. */
+{
+    TclRegexp *regexpPtr;
+    const Tcl_UniChar **uniStrings;
+    size_t *numChars;
+    int i, length, status;
+    const char *pattern;
+    char buf[TCL_INTEGER_SPACE + 1];
+    Tcl_DString key, stringBuf;
+    Tcl_Time before, after;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
+
+    /*
+     * The cache key spells out each pattern's length before the pattern,
+     * so that no two sets share one.
+     */
+
+    Tcl_DStringInit(&key);
+    for (i = 0; i < objc; i++) {
+	pattern = TclGetStringFromObj(objv[i*stride], &length);
+	Tcl_DStringAppend(&key, buf, TclFormatInt(buf, length));
+	Tcl_DStringAppend(&key, ":", 1);
+	Tcl_DStringAppend(&key, pattern, length);
+    }
+    regexpPtr = LookupRegexp(tsdPtr, Tcl_DStringValue(&key),
+	    flags | REGEXP_SET);
+    if (regexpPtr != NULL) {
+	Tcl_DStringFree(&key);
+	goto done;
+    }
+
+    /*
+     * Convert all the patterns to Unicode, one after another in the same
+     * buffer, and only then take pointers into it.
+     */
+
+    numChars = (size_t *) ckalloc(objc * sizeof(size_t));
+    uniStrings = (const Tcl_UniChar **) ckalloc(objc * sizeof(Tcl_UniChar *));
+    Tcl_DStringInit(&stringBuf);
+    for (i = 0; i < objc; i++) {
+	Tcl_DString patternBuf;
+
+	pattern = TclGetStringFromObj(objv[i*stride], &length);
+	Tcl_DStringInit(&patternBuf);
+	Tcl_UtfToUniCharDString(pattern, length, &patternBuf);
+	numChars[i] = Tcl_DStringLength(&patternBuf) / sizeof(Tcl_UniChar);
+	Tcl_DStringAppend(&stringBuf, Tcl_DStringValue(&patternBuf),
+		Tcl_DStringLength(&patternBuf));
+	Tcl_DStringFree(&patternBuf);
+    }
+    uniStrings[0] = (const Tcl_UniChar *) Tcl_DStringValue(&stringBuf);
+    for (i = 1; i < objc; i++) {
+	uniStrings[i] = uniStrings[i-1] + numChars[i-1];
+    }
+
+    regexpPtr = NewRegexp(flags | REGEXP_SET);
+    Tcl_GetTime(&before);
+    status = TclReCompSet(&regexpPtr->re, objc, uniStrings, numChars, flags);
+    Tcl_GetTime(&after);
+    tsdPtr->compileTime += ((Tcl_WideInt) after.sec - before.sec) * 1000000
+	    + (after.usec - before.usec);
+    Tcl_DStringFree(&stringBuf);
+    ckfree((char *) uniStrings);
+    ckfree((char *) numChars);
+    if (status != REG_OKAY) {
+	ckfree((char *) regexpPtr);
+	Tcl_DStringFree(&key);
+	return NULL;
+    }
+
+    /*
+     * Sets with backreferences are cached all the same, so that they are
+     * not compiled again each time only to be refused.
+     */
+
+    regexpPtr->matches = (regmatch_t *) ckalloc(sizeof(regmatch_t));
+    CacheRegexp(tsdPtr, Tcl_DStringValue(&key), regexpPtr);
+    Tcl_DStringFree(&key);
+
+  done:
+    if (regexpPtr->re.re_info & REG_UBACKREF) {
+	return NULL;
+    }
+    return (Tcl_RegExp) regexpPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegExpExecSet --
+ *
+ *	Find the first pattern of a set from TclGetRegExpSet that matches
+ *	anywhere in an object.
+ *
+ * Results:
+ *	If an error occurs during the matching operation then -1 is returned
+ *	and an error message is left in interp's result. Otherwise the return
+ *	value is 1 if a pattern matched, with its index in the set stored in
+ *	*armPtr, or 0 if none did.
+ *
+ * Side effects:
+ *	Converts the object to a Unicode object, unless it is a byte array or
+ *	its string representation is all ASCII.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegExpExecSet(
+    Tcl_Interp *interp,		/* Interpreter to use for error reporting. */
+    Tcl_RegExp re,		/* Set of patterns from TclGetRegExpSet. */
+    Tcl_Obj *textObj,		/* Text against which to match them. */
+    int *armPtr)		/* Where to store the index of the first
+				 * pattern that matches. */
+{
+    TclRegexp *regexpPtr = (TclRegexp *) re;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
+    const unsigned char *bytes;
+    const Tcl_UniChar *udata;
+    int length, status;
+
+    if (TclIsPureByteArray(textObj)) {
+	bytes = Tcl_GetByteArrayFromObj(textObj, &length);
+    } else {
+	length = Tcl_GetCharLength(textObj);
+	bytes = NULL;
+	if (textObj->bytes != NULL && textObj->length == length) {
+	    bytes = (unsigned char *) textObj->bytes;
+	}
+    }
+
+    PrepareExec(tsdPtr, regexpPtr);
+    if (bytes != NULL) {
+	status = TclReExecSetBytes(&regexpPtr->re, bytes, (size_t) length,
+		&regexpPtr->details, armPtr, 0);
+    } else {
+	udata = Tcl_GetUnicodeFromObj(textObj, &length);
+	status = TclReExecSet(&regexpPtr->re, udata, (size_t) length,
+		&regexpPtr->details, armPtr, 0);
+    }
+    TrackDfas(tsdPtr, regexpPtr);
+
+    if (status != REG_OKAY) {
+	if (status == REG_NOMATCH) {
+	    return 0;
+	}
+	if (interp != NULL) {
+	    TclRegError(interp, "error while matching regular expression: ",
+		    status);
+	}
+	return -1;
+    }
+    return 1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -854,14 +1270,10 @@ CompileRegexp(
 {
     TclRegexp *regexpPtr;
     const Tcl_UniChar *uniString;
-    int numChars, status, i, exact;
+    int numChars, status, exact;
     Tcl_DString stringBuf;
-    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
-
-    if (!tsdPtr->initialized) {
-	tsdPtr->initialized = 1;
-	Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
-    }
+    Tcl_Time before, after;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
 
     /*
      * This routine maintains a second-level regular expression cache in
@@ -875,43 +1287,16 @@ CompileRegexp(
      * if it has the same pattern and the same flags.
      */
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	if ((length == tsdPtr->patLengths[i])
-		&& (tsdPtr->regexps[i]->flags == flags)
-		&& (strcmp(string, tsdPtr->patterns[i]) == 0)) {
-	    /*
-	     * Move the matched pattern to the first slot in the cache and
-	     * shift the other patterns down one position.
-	     */
-
-	    if (i != 0) {
-		int j;
-		char *cachedString;
-
-		cachedString = tsdPtr->patterns[i];
-		regexpPtr = tsdPtr->regexps[i];
-		for (j = i-1; j >= 0; j--) {
-		    tsdPtr->patterns[j+1] = tsdPtr->patterns[j];
-		    tsdPtr->patLengths[j+1] = tsdPtr->patLengths[j];
-		    tsdPtr->regexps[j+1] = tsdPtr->regexps[j];
-		}
-		tsdPtr->patterns[0] = cachedString;
-		tsdPtr->patLengths[0] = length;
-		tsdPtr->regexps[0] = regexpPtr;
-	    }
-	    return tsdPtr->regexps[0];
-	}
+    regexpPtr = LookupRegexp(tsdPtr, string, flags);
+    if (regexpPtr != NULL) {
+	return regexpPtr;
     }
 
     /*
      * This is a new expression, so compile it and add it to the cache.
      */
 
-    regexpPtr = (TclRegexp *) ckalloc(sizeof(TclRegexp));
-    regexpPtr->objPtr = NULL;
-    regexpPtr->string = NULL;
-    regexpPtr->details.rm_extend.rm_so = -1;
-    regexpPtr->details.rm_extend.rm_eo = -1;
+    regexpPtr = NewRegexp(flags);
 
     /*
      * Get the up-to-date string representation and map to unicode.
@@ -925,8 +1310,11 @@ CompileRegexp(
      * Compile the string and check for errors.
      */
 
-    regexpPtr->flags = flags;
+    Tcl_GetTime(&before);
     status = TclReComp(&regexpPtr->re, uniString, (size_t) numChars, flags);
+    Tcl_GetTime(&after);
+    tsdPtr->compileTime += ((Tcl_WideInt) after.sec - before.sec) * 1000000
+	    + (after.usec - before.usec);
     Tcl_DStringFree(&stringBuf);
 
     if (status != REG_OKAY) {
@@ -965,38 +1353,395 @@ CompileRegexp(
     regexpPtr->matches = (regmatch_t *)
 	    ckalloc(sizeof(regmatch_t) * (regexpPtr->re.re_nsub + 1));
 
-    /*
-     * Initialize the refcount to one initially, since it is in the cache.
-     */
+    CacheRegexp(tsdPtr, string, regexpPtr);
+    return regexpPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewRegexp --
+ *
+ *	Allocate a TclRegexp, ready for its regex_t and its matches array to
+ *	be filled in.
+ *
+ * Results:
+ *	The new TclRegexp, with a reference count of 1 for the cache.
+ *
+ * Side effects:
+ *	Allocates memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TclRegexp *
+NewRegexp(
+    int flags)			/* Compilation flags. */
+{
+    TclRegexp *regexpPtr = (TclRegexp *) ckalloc(sizeof(TclRegexp));
 
+    regexpPtr->flags = flags;
+    regexpPtr->objPtr = NULL;
+    regexpPtr->string = NULL;
+    regexpPtr->globObjPtr = NULL;
+    regexpPtr->matches = NULL;
+    regexpPtr->details.rm_extend.rm_so = -1;
+    regexpPtr->details.rm_extend.rm_eo = -1;
+    regexpPtr->details.rm_dfabudget = 0;
+    regexpPtr->details.rm_dfagrowths = 0;
+    regexpPtr->details.rm_dfaflushes = 0;
+    regexpPtr->details.rm_dfakept = 0;
     regexpPtr->refCount = 1;
+    regexpPtr->dfaKept = 0;
+    regexpPtr->dfaPrevPtr = regexpPtr->dfaNextPtr = NULL;
+    return regexpPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LookupRegexp --
+ *
+ *	Look for a compiled regexp in the per-thread cache. We can only reuse
+ *	a regexp if it has the same key (pattern) and the same flags.
+ *
+ * Results:
+ *	The cached regexp, or NULL if there is none.
+ *
+ * Side effects:
+ *	Moves the entry found to the front of the use list, and counts the
+ *	lookup as a hit or a miss.
+ *
+ *----------------------------------------------------------------------
+ */
 
-    /*
-     * Free the last regexp, if necessary, and make room at the head of the
-     * list for the new regexp.
-     */
+static TclRegexp *
+LookupRegexp(
+    ThreadSpecificData *tsdPtr,	/* The cache to search. */
+    const char *key,		/* The pattern. */
+    int flags)			/* Its compilation flags. */
+{
+    Tcl_HashEntry *hPtr;
+    RegexpCacheEntry *entryPtr;
+
+    hPtr = Tcl_FindHashEntry(&tsdPtr->patternTable, key);
+    if (hPtr != NULL) {
+	entryPtr = Tcl_GetHashValue(hPtr);
+	while ((entryPtr != NULL) && (entryPtr->regexpPtr->flags != flags)) {
+	    entryPtr = entryPtr->nextFlagsPtr;
+	}
+	if (entryPtr != NULL) {
+	    /*
+	     * Move the matched entry to the front of the use list.
+	     */
 
-    if (tsdPtr->patterns[NUM_REGEXPS-1] != NULL) {
-	TclRegexp *oldRegexpPtr = tsdPtr->regexps[NUM_REGEXPS-1];
+	    tsdPtr->hits++;
+	    if (entryPtr->prevPtr != NULL) {
+		entryPtr->prevPtr->nextPtr = entryPtr->nextPtr;
+		if (entryPtr->nextPtr != NULL) {
+		    entryPtr->nextPtr->prevPtr = entryPtr->prevPtr;
+		} else {
+		    tsdPtr->lastPtr = entryPtr->prevPtr;
+		}
+		entryPtr->prevPtr = NULL;
+		entryPtr->nextPtr = tsdPtr->firstPtr;
+		tsdPtr->firstPtr->prevPtr = entryPtr;
+		tsdPtr->firstPtr = entryPtr;
+	    }
+	    return entryPtr->regexpPtr;
+	}
+    }
+    tsdPtr->misses++;
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheRegexp --
+ *
+ *	Add a newly compiled regexp to the per-thread cache, which takes over
+ *	the reference that NewRegexp gave it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Discards the least recently used regexp, if necessary, and puts the
+ *	new regexp at the head of the use list and of the chain for its key.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	if (--(oldRegexpPtr->refCount) <= 0) {
-	    FreeRegexp(oldRegexpPtr);
+static void
+CacheRegexp(
+    ThreadSpecificData *tsdPtr,	/* The cache to add to. */
+    const char *key,		/* The pattern. */
+    TclRegexp *regexpPtr)	/* Its compiled form. */
+{
+    Tcl_HashEntry *hPtr;
+    RegexpCacheEntry *entryPtr;
+    int isNew;
+
+    if (tsdPtr->numEntries >= tsdPtr->maxEntries) {
+	DiscardCacheEntry(tsdPtr, tsdPtr->lastPtr);
+    }
+
+    entryPtr = (RegexpCacheEntry *) ckalloc(sizeof(RegexpCacheEntry));
+    entryPtr->regexpPtr = regexpPtr;
+    hPtr = Tcl_CreateHashEntry(&tsdPtr->patternTable, key, &isNew);
+    entryPtr->hPtr = hPtr;
+    entryPtr->nextFlagsPtr = isNew ? NULL : Tcl_GetHashValue(hPtr);
+    Tcl_SetHashValue(hPtr, entryPtr);
+    entryPtr->prevPtr = NULL;
+    entryPtr->nextPtr = tsdPtr->firstPtr;
+    if (tsdPtr->firstPtr != NULL) {
+	tsdPtr->firstPtr->prevPtr = entryPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr;
+    }
+    tsdPtr->firstPtr = entryPtr;
+    tsdPtr->numEntries++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetRegexpCache --
+ *
+ *	Return the per-thread regexp cache, initializing it if this is the
+ *	first use in the current thread.
+ *
+ * Results:
+ *	The thread's cache.
+ *
+ * Side effects:
+ *	May initialize the cache and register its exit handler.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ThreadSpecificData *
+GetRegexpCache(void)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
+
+    if (!tsdPtr->initialized) {
+	tsdPtr->initialized = 1;
+	Tcl_InitHashTable(&tsdPtr->patternTable, TCL_STRING_KEYS);
+	tsdPtr->firstPtr = tsdPtr->lastPtr = NULL;
+	tsdPtr->numEntries = 0;
+	tsdPtr->maxEntries = TCL_REGEXP_CACHE_SIZE;
+	tsdPtr->hits = tsdPtr->misses = tsdPtr->compileTime = 0;
+	tsdPtr->dfaBudget = TCL_REGEXP_DFA_BUDGET;
+	tsdPtr->dfaKept = 0;
+	tsdPtr->firstDfaPtr = tsdPtr->lastDfaPtr = NULL;
+	tsdPtr->dfaGrowths = tsdPtr->dfaFlushes = 0;
+	Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
+    }
+    return tsdPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DiscardCacheEntry --
+ *
+ *	Remove an entry from the per-thread regexp cache, releasing the
+ *	cache's reference to its compiled regexp.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The regexp is freed if nothing else refers to it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DiscardCacheEntry(
+    ThreadSpecificData *tsdPtr,	/* The cache holding the entry. */
+    RegexpCacheEntry *entryPtr)	/* The entry to discard. */
+{
+    RegexpCacheEntry *chainPtr = Tcl_GetHashValue(entryPtr->hPtr);
+
+    if (chainPtr == entryPtr) {
+	if (entryPtr->nextFlagsPtr != NULL) {
+	    Tcl_SetHashValue(entryPtr->hPtr, entryPtr->nextFlagsPtr);
+	} else {
+	    Tcl_DeleteHashEntry(entryPtr->hPtr);
 	}
-	ckfree(tsdPtr->patterns[NUM_REGEXPS-1]);
+    } else {
+	while (chainPtr->nextFlagsPtr != entryPtr) {
+	    chainPtr = chainPtr->nextFlagsPtr;
+	}
+	chainPtr->nextFlagsPtr = entryPtr->nextFlagsPtr;
+    }
+
+    if (entryPtr->prevPtr != NULL) {
+	entryPtr->prevPtr->nextPtr = entryPtr->nextPtr;
+    } else {
+	tsdPtr->firstPtr = entryPtr->nextPtr;
     }
-    for (i = NUM_REGEXPS - 2; i >= 0; i--) {
-	tsdPtr->patterns[i+1] = tsdPtr->patterns[i];
-	tsdPtr->patLengths[i+1] = tsdPtr->patLengths[i];
-	tsdPtr->regexps[i+1] = tsdPtr->regexps[i];
+    if (entryPtr->nextPtr != NULL) {
+	entryPtr->nextPtr->prevPtr = entryPtr->prevPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr->prevPtr;
     }
-    tsdPtr->patterns[0] = ckalloc((unsigned) length+1);
-    memcpy(tsdPtr->patterns[0], string, (unsigned) length + 1);
-    tsdPtr->patLengths[0] = length;
-    tsdPtr->regexps[0] = regexpPtr;
+    tsdPtr->numEntries--;
 
-    return regexpPtr;
+    if (--(entryPtr->regexpPtr->refCount) <= 0) {
+	FreeRegexp(entryPtr->regexpPtr);
+    }
+    ckfree((char *) entryPtr);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * PrepareExec --
+ *
+ *	Tell the regexp engine how far the DFAs of a match may grow, before
+ *	running it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Sets the budget in the regexp's match details.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PrepareExec(
+    ThreadSpecificData *tsdPtr,	/* The current thread's cache. */
+    TclRegexp *regexpPtr)	/* The regexp about to be matched. */
+{
+    size_t budget = (size_t) tsdPtr->dfaBudget / 2;
+
+    if (budget > REG_DFA_BUDGET) {
+	budget = REG_DFA_BUDGET;
+    } else if (budget == 0) {
+	budget = 1;
+    }
+    regexpPtr->details.rm_dfabudget = budget;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TrackDfas --
+ *
+ *	Account for a match of a regexp: add up its DFA statistics and the
+ *	bytes of the DFAs it now keeps, and keep all the DFAs of the thread
+ *	within the budget.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Moves the regexp to the front of the list of regexps keeping DFAs, and
+ *	frees the DFAs of the least recently used ones, ending with its own,
+ *	until they fit the budget.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TrackDfas(
+    ThreadSpecificData *tsdPtr,	/* The current thread's cache. */
+    TclRegexp *regexpPtr)	/* The regexp just matched. */
+{
+    tsdPtr->dfaGrowths += regexpPtr->details.rm_dfagrowths;
+    tsdPtr->dfaFlushes += regexpPtr->details.rm_dfaflushes;
+
+    if (regexpPtr->dfaKept != 0) {
+	UnlinkDfas(tsdPtr, regexpPtr);
+    }
+    regexpPtr->dfaKept = regexpPtr->details.rm_dfakept;
+    if (regexpPtr->dfaKept != 0) {
+	regexpPtr->dfaPrevPtr = NULL;
+	regexpPtr->dfaNextPtr = tsdPtr->firstDfaPtr;
+	if (tsdPtr->firstDfaPtr != NULL) {
+	    tsdPtr->firstDfaPtr->dfaPrevPtr = regexpPtr;
+	} else {
+	    tsdPtr->lastDfaPtr = regexpPtr;
+	}
+	tsdPtr->firstDfaPtr = regexpPtr;
+	tsdPtr->dfaKept += regexpPtr->dfaKept;
+    }
+    while (tsdPtr->dfaKept > (size_t) tsdPtr->dfaBudget) {
+	DiscardDfas(tsdPtr, tsdPtr->lastDfaPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DiscardDfas --
+ *
+ *	Free the DFAs that the regexp engine keeps in a regexp, and take the
+ *	regexp off the list of those keeping DFAs.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The next match of the regexp builds its DFAs afresh.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DiscardDfas(
+    ThreadSpecificData *tsdPtr,	/* The current thread's cache. */
+    TclRegexp *regexpPtr)	/* A regexp on its list of those keeping
+				 * DFAs. */
+{
+    UnlinkDfas(tsdPtr, regexpPtr);
+    TclReFreeDfas(&regexpPtr->re);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UnlinkDfas --
+ *
+ *	Take a regexp off the list of those keeping DFAs, and its DFAs out of
+ *	the thread's total, without freeing them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UnlinkDfas(
+    ThreadSpecificData *tsdPtr,	/* The current thread's cache. */
+    TclRegexp *regexpPtr)	/* A regexp on its list of those keeping
+				 * DFAs. */
+{
+    if (regexpPtr->dfaPrevPtr != NULL) {
+	regexpPtr->dfaPrevPtr->dfaNextPtr = regexpPtr->dfaNextPtr;
+    } else {
+	tsdPtr->firstDfaPtr = regexpPtr->dfaNextPtr;
+    }
+    if (regexpPtr->dfaNextPtr != NULL) {
+	regexpPtr->dfaNextPtr->dfaPrevPtr = regexpPtr->dfaPrevPtr;
+    } else {
+	tsdPtr->lastDfaPtr = regexpPtr->dfaPrevPtr;
+    }
+    regexpPtr->dfaPrevPtr = regexpPtr->dfaNextPtr = NULL;
+    tsdPtr->dfaKept -= regexpPtr->dfaKept;
+    regexpPtr->dfaKept = 0;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1017,6 +1762,9 @@ static void
 FreeRegexp(
     TclRegexp *regexpPtr)	/* Compiled regular expression to free. */
 {
+    if (regexpPtr->dfaKept != 0) {
+	DiscardDfas(TCL_TSD_INIT(&dataKey), regexpPtr);
+    }
     TclReFree(&regexpPtr->re);
     if (regexpPtr->globObjPtr) {
 	TclDecrRefCount(regexpPtr->globObjPtr);
@@ -1047,17 +1795,22 @@ static void
 FinalizeRegexp(
     ClientData clientData)	/* Not used. */
 {
-    int i;
-    TclRegexp *regexpPtr;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	regexpPtr = tsdPtr->regexps[i];
-	if (--(regexpPtr->refCount) <= 0) {
-	    FreeRegexp(regexpPtr);
-	}
-	ckfree(tsdPtr->patterns[i]);
-	tsdPtr->patterns[i] = NULL;
+    if (!tsdPtr->initialized) {
+	return;
+    }
+    while (tsdPtr->firstPtr != NULL) {
+	DiscardCacheEntry(tsdPtr, tsdPtr->firstPtr);
+    }
+    Tcl_DeleteHashTable(&tsdPtr->patternTable);
+
+    /*
+     * Regexps that objects still refer to must not be left on the list.
+     */
+
+    while (tsdPtr->firstDfaPtr != NULL) {
+	DiscardDfas(tsdPtr, tsdPtr->firstDfaPtr);
     }
 
     /*
@@ -1068,6 +1821,145 @@ FinalizeRegexp(
     tsdPtr->initialized = 0;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegexpCacheObjCmd --
+ *
+ *	Implementation of the "tcl::unsupported::regexpcache" command, which
+ *	reports on the current thread's cache of compiled regexps and
+ *	optionally changes its capacity.
+ *
+ * Results:
+ *	A standard Tcl result. The interp's result is a dictionary with the
+ *	keys "size", "entries", "hits", "misses" and "compiletime" (total
+ *	microseconds spent compiling patterns).
+ *
+ * Side effects:
+ *	Shrinking the cache discards its least recently used entries.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegexpCacheObjCmd(
+    ClientData clientData,	/* Not used. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
+    Tcl_Obj *resultPtr;
+    int size;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?size?");
+	return TCL_ERROR;
+    }
+    if (objc == 2) {
+	if (TclGetIntFromObj(interp, objv[1], &size) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (size < 1) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "cache size must be at least 1", -1));
+	    return TCL_ERROR;
+	}
+	tsdPtr->maxEntries = size;
+	while (tsdPtr->numEntries > size) {
+	    DiscardCacheEntry(tsdPtr, tsdPtr->lastPtr);
+	}
+    }
+
+    TclNewObj(resultPtr);
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("size", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewIntObj(tsdPtr->maxEntries));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("entries",-1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewIntObj(tsdPtr->numEntries));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("hits", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewWideIntObj(tsdPtr->hits));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("misses", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewWideIntObj(tsdPtr->misses));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewStringObj("compiletime", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewWideIntObj(tsdPtr->compileTime));
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclRegexpDfaObjCmd --
+ *
+ *	Implementation of the "tcl::unsupported::regexpdfa" command, which
+ *	reports how the DFA state caches of the regexp engine have fared in
+ *	the current thread and optionally changes their memory budget.
+ *
+ * Results:
+ *	A standard Tcl result. The interp's result is a dictionary with the
+ *	keys "budget" (bytes the DFAs kept by all regexps of the thread may
+ *	take), "kept" (bytes they take now), "growths" and "flushes" (state
+ *	sets dropped from caches that were full).
+ *
+ * Side effects:
+ *	A smaller budget frees the DFAs of the least recently used regexps
+ *	until the rest fit it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclRegexpDfaObjCmd(
+    ClientData clientData,	/* Not used. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
+    Tcl_Obj *resultPtr;
+    int budget;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?budget?");
+	return TCL_ERROR;
+    }
+    if (objc == 2) {
+	if (TclGetIntFromObj(interp, objv[1], &budget) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (budget < 1) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "budget must be at least 1", -1));
+	    return TCL_ERROR;
+	}
+	tsdPtr->dfaBudget = budget;
+	while (tsdPtr->dfaKept > (size_t) budget) {
+	    DiscardDfas(tsdPtr, tsdPtr->lastDfaPtr);
+	}
+    }
+
+    TclNewObj(resultPtr);
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("budget", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewIntObj(tsdPtr->dfaBudget));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("kept", -1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->dfaKept));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("growths",-1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewWideIntObj(tsdPtr->dfaGrowths));
+    Tcl_ListObjAppendElement(NULL, resultPtr, Tcl_NewStringObj("flushes",-1));
+    Tcl_ListObjAppendElement(NULL, resultPtr,
+	    Tcl_NewWideIntObj(tsdPtr->dfaFlushes));
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
 /*
  * Local Variables:
  * mode: c
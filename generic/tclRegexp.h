@@ -41,6 +41,13 @@ typedef struct TclRegexp {
 				 * used only for REG_EXPECT). */
     int refCount;		/* Count of number of references to this
 				 * compiled regexp. */
+    size_t dfaKept;		/* Bytes of DFAs the regexp engine keeps in re
+				 * for the next match. */
+    struct TclRegexp *dfaPrevPtr;
+				/* Regexps keeping DFAs are on a per-thread
+				 * list, most recently used first; these link
+				 * it when dfaKept is not 0. */
+    struct TclRegexp *dfaNextPtr;
 } TclRegexp;
 
 #endif /* _TCLREGEXP */
@@ -39,8 +39,47 @@ typedef struct CharSet {
 	Tcl_UniChar start;
 	Tcl_UniChar end;
     } *ranges;
+    unsigned char latin1[32];	/* Bit map of the answers of CharInSet for
+				 * the characters below 256. */
 } CharSet;
 
+/*
+ * A format string that has been validated is compiled into a ScanProgram,
+ * which is kept in the internal rep of the format object so that a scan
+ * with a literal format string does not parse it again. Runs of white space
+ * in the format become a single SPEC_SPACE, other characters to be matched
+ * become SPEC_LITERAL, and each conversion a SPEC_CONVERSION with its
+ * fields parsed, including the character set of a %[ conversion.
+ */
+
+#define SPEC_END	0
+#define SPEC_SPACE	1
+#define SPEC_LITERAL	2
+#define SPEC_CONVERSION	3
+
+typedef struct ScanSpec {
+    int type;			/* One of the SPEC_* values above. */
+    Tcl_UniChar ch;		/* Character to match, or conversion. */
+    char op;			/* Scanning operation: 'n', 'i', 'f', 's', 'c'
+				 * or '['. */
+    int flags;			/* SCAN_* flags. */
+    int parseFlag;		/* Flags for TclParseNumber. */
+    int width;			/* Field width, or 0 if none. */
+    int position;		/* Variable index from "%n$", minus one, or
+				 * -1 if the conversion has none. */
+    CharSet cset;		/* The set of a %[ conversion. */
+} ScanSpec;
+
+typedef struct ScanProgram {
+    int refCount;		/* Users of the program, including the
+				 * internal reps that hold it. */
+    int numVars;		/* Number of variable names that the format
+				 * was last validated for, and the number of */
+    int totalVars;		/* results that it then needs. */
+    ScanSpec specs[1];		/* The specs, ending with SPEC_END. The actual
+				 * size depends on the format string. */
+} ScanProgram;
+
 /*
  * Declarations for functions used only in this file.
  */
@@ -50,6 +89,26 @@ static int		CharInSet(CharSet *cset, int ch);
 static void		ReleaseCharSet(CharSet *cset);
 static int		ValidateFormat(Tcl_Interp *interp, const char *format,
 			    int numVars, int *totalVars);
+static ScanProgram *	CompileScanFormat(const char *format);
+static void		DupScanInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreeScanInternalRep(Tcl_Obj *objPtr);
+static ScanProgram *	GetScanProgram(Tcl_Interp *interp, Tcl_Obj *formatObj,
+			    int numVars);
+static void		ReleaseScanProgram(ScanProgram *programPtr);
+
+/*
+ * The Tcl object type that keeps a compiled scan format in the format
+ * object.
+ */
+
+static const Tcl_ObjType scanFormatType = {
+    "scanformat",			/* name */
+    FreeScanInternalRep,		/* freeIntRepProc */
+    DupScanInternalRep,			/* dupIntRepProc */
+    NULL,				/* updateStringProc */
+    NULL				/* setFromAnyProc */
+};
 
 /*
  *----------------------------------------------------------------------
@@ -75,7 +134,7 @@ BuildCharSet(
     const char *format)		/* Points to first char of set. */
 {
     Tcl_UniChar ch, start;
-    int offset, nranges;
+    int offset, nranges, i;
     const char *end;
 
     memset(cset, 0, sizeof(CharSet));
@@ -161,6 +220,30 @@ BuildCharSet(
 	}
 	format += Tcl_UtfToUniChar(format, &ch);
     }
+
+    /*
+     * Answer for the Latin-1 characters up front, so that CharInSet need not
+     * search the set for them.
+     */
+
+    for (i = 0; i < cset->nchars; i++) {
+	if (cset->chars[i] < 256) {
+	    cset->latin1[cset->chars[i] >> 3] |= 1 << (cset->chars[i] & 7);
+	}
+    }
+    for (i = 0; i < cset->nranges; i++) {
+	int c;
+
+	for (c = cset->ranges[i].start; c <= cset->ranges[i].end && c < 256;
+		c++) {
+	    cset->latin1[c >> 3] |= 1 << (c & 7);
+	}
+    }
+    if (cset->exclude) {
+	for (i = 0; i < 32; i++) {
+	    cset->latin1[i] ^= 0xff;
+	}
+    }
     return format;
 }
 
@@ -189,6 +272,9 @@ CharInSet(
     Tcl_UniChar ch = (Tcl_UniChar) c;
     int i, match = 0;
 
+    if (ch < 256) {
+	return (cset->latin1[ch >> 3] >> (ch & 7)) & 1;
+    }
     for (i = 0; i < cset->nchars; i++) {
 	if (cset->chars[i] == ch) {
 	    match = 1;
@@ -530,6 +616,267 @@ ValidateFormat(
     return TCL_ERROR;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompileScanFormat --
+ *
+ *	Parse a format string that ValidateFormat has accepted into a
+ *	ScanProgram.
+ *
+ * Results:
+ *	A program with a reference count of zero.
+ *
+ * Side effects:
+ *	Allocates memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ScanProgram *
+CompileScanFormat(
+    const char *format)		/* The format string. */
+{
+    ScanProgram *programPtr;
+    ScanSpec *specPtr;
+    Tcl_UniChar ch;
+
+    /*
+     * Each spec takes at least one byte of the format.
+     */
+
+    programPtr = (ScanProgram *) ckalloc(sizeof(ScanProgram)
+	    + strlen(format) * sizeof(ScanSpec));
+    programPtr->refCount = 0;
+    programPtr->numVars = -1;
+    specPtr = programPtr->specs;
+
+    while (*format != '\0') {
+	int flags = 0, parseFlag = TCL_PARSE_NO_WHITESPACE;
+
+	format += Tcl_UtfToUniChar(format, &ch);
+	if (Tcl_UniCharIsSpace(ch)) {
+	    if ((specPtr == programPtr->specs)
+		    || (specPtr[-1].type != SPEC_SPACE)) {
+		specPtr->type = SPEC_SPACE;
+		specPtr++;
+	    }
+	    continue;
+	}
+	if (ch == '%') {
+	    format += Tcl_UtfToUniChar(format, &ch);
+	    if (ch != '%') {
+		goto conversion;
+	    }
+	}
+	specPtr->type = SPEC_LITERAL;
+	specPtr->ch = ch;
+	specPtr++;
+	continue;
+
+    conversion:
+	specPtr->type = SPEC_CONVERSION;
+	specPtr->position = -1;
+	if (ch == '*') {
+	    flags |= SCAN_SUPPRESS;
+	    format += Tcl_UtfToUniChar(format, &ch);
+	} else if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
+	    char *formatEnd;
+	    long value = strtoul(format-1, &formatEnd, 10);/* INTL: "C" locale. */
+
+	    if (*formatEnd == '$') {
+		format = formatEnd+1;
+		format += Tcl_UtfToUniChar(format, &ch);
+		specPtr->position = (int) value - 1;
+	    }
+	}
+
+	if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
+	    specPtr->width = (int) strtoul(format-1, (char **) &format, 10);/* INTL: "C" locale. */
+	    format += Tcl_UtfToUniChar(format, &ch);
+	} else {
+	    specPtr->width = 0;
+	}
+
+	switch (ch) {
+	case 'l':
+	    if (*format == 'l') {
+		flags |= SCAN_BIG;
+		format += 1;
+		format += Tcl_UtfToUniChar(format, &ch);
+		break;
+	    }
+	case 'L':
+	    flags |= SCAN_LONGER;
+	case 'h':
+	    format += Tcl_UtfToUniChar(format, &ch);
+	}
+
+	switch (ch) {
+	case 'n':
+	    specPtr->op = 'n';
+	    break;
+	case 'd':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_DECIMAL_ONLY;
+	    break;
+	case 'i':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_SCAN_PREFIXES;
+	    break;
+	case 'o':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_OCTAL_ONLY | TCL_PARSE_SCAN_PREFIXES;
+	    break;
+	case 'x':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_HEXADECIMAL_ONLY;
+	    break;
+	case 'b':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_BINARY_ONLY;
+	    break;
+	case 'u':
+	    specPtr->op = 'i';
+	    parseFlag |= TCL_PARSE_DECIMAL_ONLY;
+	    flags |= SCAN_UNSIGNED;
+	    break;
+	case 'f':
+	case 'e':
+	case 'g':
+	    specPtr->op = 'f';
+	    break;
+	case 's':
+	    specPtr->op = 's';
+	    break;
+	case 'c':
+	    specPtr->op = 'c';
+	    flags |= SCAN_NOSKIP;
+	    break;
+	case '[':
+	    specPtr->op = '[';
+	    flags |= SCAN_NOSKIP;
+	    format = BuildCharSet(&specPtr->cset, format);
+	    break;
+	}
+	specPtr->ch = ch;
+	specPtr->flags = flags;
+	specPtr->parseFlag = parseFlag;
+	specPtr++;
+    }
+    specPtr->type = SPEC_END;
+    return programPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetScanProgram --
+ *
+ *	Get the compiled form of a scan format, validating it for the given
+ *	number of variable names unless that was done before. The program is
+ *	kept in the internal rep of the format object.
+ *
+ * Results:
+ *	The program, which the caller must release with ReleaseScanProgram,
+ *	or NULL if the format is not valid, with an error message in the
+ *	interpreter.
+ *
+ * Side effects:
+ *	May set the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ScanProgram *
+GetScanProgram(
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Obj *formatObj,		/* The format string. */
+    int numVars)		/* The number of variables passed to the scan
+				 * command. */
+{
+    ScanProgram *programPtr = NULL;
+    const char *format = TclGetString(formatObj);
+    int totalVars = -1;
+
+    if (formatObj->typePtr == &scanFormatType) {
+	programPtr = formatObj->internalRep.otherValuePtr;
+	if (programPtr->numVars == numVars) {
+	    programPtr->refCount++;
+	    return programPtr;
+	}
+    }
+
+    if (ValidateFormat(interp, format, numVars, &totalVars) != TCL_OK) {
+	return NULL;
+    }
+    if (programPtr == NULL) {
+	programPtr = CompileScanFormat(format);
+	TclFreeIntRep(formatObj);
+	formatObj->internalRep.otherValuePtr = programPtr;
+	formatObj->typePtr = &scanFormatType;
+	programPtr->refCount++;
+    }
+    programPtr->numVars = numVars;
+    programPtr->totalVars = totalVars;
+    programPtr->refCount++;
+    return programPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseScanProgram, FreeScanInternalRep, DupScanInternalRep --
+ *
+ *	Manage the lifetime of compiled scan formats and of the internal reps
+ *	that hold them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A program is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ReleaseScanProgram(
+    ScanProgram *programPtr)
+{
+    ScanSpec *specPtr;
+
+    if (--programPtr->refCount > 0) {
+	return;
+    }
+    for (specPtr = programPtr->specs; specPtr->type != SPEC_END; specPtr++) {
+	if (specPtr->type == SPEC_CONVERSION && specPtr->op == '[') {
+	    ReleaseCharSet(&specPtr->cset);
+	}
+    }
+    ckfree((char *) programPtr);
+}
+
+static void
+FreeScanInternalRep(
+    Tcl_Obj *objPtr)
+{
+    ReleaseScanProgram(objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupScanInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    ScanProgram *programPtr = srcPtr->internalRep.otherValuePtr;
+
+    programPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = programPtr;
+    copyPtr->typePtr = &scanFormatType;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -555,15 +902,15 @@ Tcl_ScanObjCmd(
     int objc,			/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    const char *format;
-    int numVars, nconversions, totalVars = -1;
+    ScanProgram *programPtr;
+    ScanSpec *specPtr;
+    int numVars, nconversions, totalVars;
     int objIndex, offset, i, result, code;
     long value;
     const char *string, *end, *baseString;
-    char op = 0;
     int width, underflow = 0;
     Tcl_WideInt wideValue;
-    Tcl_UniChar ch, sch;
+    Tcl_UniChar sch;
     Tcl_Obj **objs = NULL, *objPtr = NULL;
     int flags;
     char buf[513];		/* Temporary buffer to hold scanned number
@@ -576,16 +923,17 @@ Tcl_ScanObjCmd(
 	return TCL_ERROR;
     }
 
-    format = Tcl_GetStringFromObj(objv[2], NULL);
     numVars = objc-3;
 
     /*
-     * Check for errors in the format string.
+     * Check for errors in the format string and get its compiled form.
      */
 
-    if (ValidateFormat(interp, format, numVars, &totalVars) == TCL_ERROR) {
+    programPtr = GetScanProgram(interp, objv[2], numVars);
+    if (programPtr == NULL) {
 	return TCL_ERROR;
     }
+    totalVars = programPtr->totalVars;
 
     /*
      * Allocate space for the result objects.
@@ -602,24 +950,19 @@ Tcl_ScanObjCmd(
     baseString = string;
 
     /*
-     * Iterate over the format string filling in the result objects until we
-     * reach the end of input, the end of the format string, or there is a
+     * Iterate over the format program filling in the result objects until
+     * we reach the end of input, the end of the format, or there is a
      * mismatch.
      */
 
     objIndex = 0;
     nconversions = 0;
-    while (*format != '\0') {
-	int parseFlag = TCL_PARSE_NO_WHITESPACE;
-	format += Tcl_UtfToUniChar(format, &ch);
-
-	flags = 0;
-
+    for (specPtr = programPtr->specs; specPtr->type != SPEC_END; specPtr++) {
 	/*
 	 * If we see whitespace in the format, skip whitespace in the string.
 	 */
 
-	if (Tcl_UniCharIsSpace(ch)) {
+	if (specPtr->type == SPEC_SPACE) {
 	    offset = Tcl_UtfToUniChar(string, &sch);
 	    while (Tcl_UniCharIsSpace(sch)) {
 		if (*string == '\0') {
@@ -631,80 +974,25 @@ Tcl_ScanObjCmd(
 	    continue;
 	}
 
-	if (ch != '%') {
-	literal:
+	if (specPtr->type == SPEC_LITERAL) {
 	    if (*string == '\0') {
 		underflow = 1;
 		goto done;
 	    }
 	    string += Tcl_UtfToUniChar(string, &sch);
-	    if (ch != sch) {
+	    if (specPtr->ch != sch) {
 		goto done;
 	    }
 	    continue;
 	}
 
-	format += Tcl_UtfToUniChar(format, &ch);
-	if (ch == '%') {
-	    goto literal;
-	}
-
-	/*
-	 * Check for assignment suppression ('*') or an XPG3-style assignment
-	 * ('%n$').
-	 */
-
-	if (ch == '*') {
-	    flags |= SCAN_SUPPRESS;
-	    format += Tcl_UtfToUniChar(format, &ch);
-	} else if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
-	    char *formatEnd;
-	    value = strtoul(format-1, &formatEnd, 10);/* INTL: "C" locale. */
-	    if (*formatEnd == '$') {
-		format = formatEnd+1;
-		format += Tcl_UtfToUniChar(format, &ch);
-		objIndex = (int) value - 1;
-	    }
+	flags = specPtr->flags;
+	width = specPtr->width;
+	if (specPtr->position >= 0) {
+	    objIndex = specPtr->position;
 	}
 
-	/*
-	 * Parse any width specifier.
-	 */
-
-	if ((ch < 0x80) && isdigit(UCHAR(ch))) {	/* INTL: "C" locale. */
-	    width = (int) strtoul(format-1, (char **) &format, 10);/* INTL: "C" locale. */
-	    format += Tcl_UtfToUniChar(format, &ch);
-	} else {
-	    width = 0;
-	}
-
-	/*
-	 * Handle any size specifier.
-	 */
-
-	switch (ch) {
-	case 'l':
-	    if (*format == 'l') {
-		flags |= SCAN_BIG;
-		format += 1;
-		format += Tcl_UtfToUniChar(format, &ch);
-		break;
-	    }
-	case 'L':
-	    flags |= SCAN_LONGER;
-	    /*
-	     * Fall through so we skip to the next character.
-	     */
-	case 'h':
-	    format += Tcl_UtfToUniChar(format, &ch);
-	}
-
-	/*
-	 * Handle the various field types.
-	 */
-
-	switch (ch) {
-	case 'n':
+	if (specPtr->op == 'n') {
 	    if (!(flags & SCAN_SUPPRESS)) {
 		objPtr = Tcl_NewIntObj(string - baseString);
 		Tcl_IncrRefCount(objPtr);
@@ -713,51 +1001,6 @@ Tcl_ScanObjCmd(
 	    }
 	    nconversions++;
 	    continue;
-
-	case 'd':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_DECIMAL_ONLY;
-	    break;
-	case 'i':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_SCAN_PREFIXES;
-	    break;
-	case 'o':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_OCTAL_ONLY | TCL_PARSE_SCAN_PREFIXES;
-	    break;
-	case 'x':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_HEXADECIMAL_ONLY;
-	    break;
-	case 'b':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_BINARY_ONLY;
-	    break;
-	case 'u':
-	    op = 'i';
-	    parseFlag |= TCL_PARSE_DECIMAL_ONLY;
-	    flags |= SCAN_UNSIGNED;
-	    break;
-
-	case 'f':
-	case 'e':
-	case 'g':
-	    op = 'f';
-	    break;
-
-	case 's':
-	    op = 's';
-	    break;
-
-	case 'c':
-	    op = 'c';
-	    flags |= SCAN_NOSKIP;
-	    break;
-	case '[':
-	    op = '[';
-	    flags |= SCAN_NOSKIP;
-	    break;
 	}
 
 	/*
@@ -793,7 +1036,7 @@ Tcl_ScanObjCmd(
 	 * Perform the requested scanning operation.
 	 */
 
-	switch (op) {
+	switch (specPtr->op) {
 	case 's':
 	    /*
 	     * Scan a string up to width characters or whitespace.
@@ -822,18 +1065,15 @@ Tcl_ScanObjCmd(
 	    string = end;
 	    break;
 
-	case '[': {
-	    CharSet cset;
-
+	case '[':
 	    if (width == 0) {
 		width = ~0;
 	    }
 	    end = string;
 
-	    format = BuildCharSet(&cset, format);
 	    while (*end != '\0') {
 		offset = Tcl_UtfToUniChar(end, &sch);
-		if (!CharInSet(&cset, (int)sch)) {
+		if (!CharInSet(&specPtr->cset, (int)sch)) {
 		    break;
 		}
 		end += offset;
@@ -841,7 +1081,6 @@ Tcl_ScanObjCmd(
 		    break;
 		}
 	    }
-	    ReleaseCharSet(&cset);
 
 	    if (string == end) {
 		/*
@@ -855,9 +1094,8 @@ Tcl_ScanObjCmd(
 		objs[objIndex++] = objPtr;
 	    }
 	    string = end;
-
 	    break;
-	}
+
 	case 'c':
 	    /*
 	     * Scan a single Unicode character.
@@ -882,7 +1120,7 @@ Tcl_ScanObjCmd(
 		width = ~0;
 	    }
 	    if (TCL_OK != TclParseNumber(NULL, objPtr, NULL, string, width,
-		    &end, TCL_PARSE_INTEGER_ONLY | parseFlag)) {
+		    &end, TCL_PARSE_INTEGER_ONLY | specPtr->parseFlag)) {
 		Tcl_DecrRefCount(objPtr);
 		if (width < 0) {
 		    if (*end == '\0') {
@@ -981,6 +1219,7 @@ Tcl_ScanObjCmd(
     }
 
   done:
+    ReleaseScanProgram(programPtr);
     result = 0;
     code = TCL_OK;
 
@@ -302,6 +302,791 @@ static const Tcl_WideUInt wuipow5[27] = {
     (Tcl_WideUInt) 3125*3125*3125*3125*3125*5 /* 5**26 */
 };
 
+/*
+ * Table of normalized 64-bit approximations to the powers of ten 10**-348,
+ * 10**-340, ..., 10**340, rounded to nearest, for the Grisu3 shortest
+ * conversion. Each entry holds the high and low 32 bits of the significand
+ * 'f', and the binary and decimal exponents, so that f * 2**binExp is
+ * approximately 10**decExp.
+ */
+
+typedef struct CachedPower {
+    unsigned int fHi;		/* High-order 32 bits of the significand. */
+    unsigned int fLo;		/* Low-order 32 bits of the significand. */
+    short binExp;		/* Binary exponent. */
+    short decExp;		/* Decimal exponent. */
+} CachedPower;
+
+static const CachedPower cachedPowers[] = {
+    {0xfa8fd5a0, 0x081c0288, -1220, -348},
+    {0xbaaee17f, 0xa23ebf76, -1193, -340},
+    {0x8b16fb20, 0x3055ac76, -1166, -332},
+    {0xcf42894a, 0x5dce35ea, -1140, -324},
+    {0x9a6bb0aa, 0x55653b2d, -1113, -316},
+    {0xe61acf03, 0x3d1a45df, -1087, -308},
+    {0xab70fe17, 0xc79ac6ca, -1060, -300},
+    {0xff77b1fc, 0xbebcdc4f, -1034, -292},
+    {0xbe5691ef, 0x416bd60c, -1007, -284},
+    {0x8dd01fad, 0x907ffc3c, -980, -276},
+    {0xd3515c28, 0x31559a83, -954, -268},
+    {0x9d71ac8f, 0xada6c9b5, -927, -260},
+    {0xea9c2277, 0x23ee8bcb, -901, -252},
+    {0xaecc4991, 0x4078536d, -874, -244},
+    {0x823c1279, 0x5db6ce57, -847, -236},
+    {0xc2109436, 0x4dfb5637, -821, -228},
+    {0x9096ea6f, 0x3848984f, -794, -220},
+    {0xd77485cb, 0x25823ac7, -768, -212},
+    {0xa086cfcd, 0x97bf97f4, -741, -204},
+    {0xef340a98, 0x172aace5, -715, -196},
+    {0xb23867fb, 0x2a35b28e, -688, -188},
+    {0x84c8d4df, 0xd2c63f3b, -661, -180},
+    {0xc5dd4427, 0x1ad3cdba, -635, -172},
+    {0x936b9fce, 0xbb25c996, -608, -164},
+    {0xdbac6c24, 0x7d62a584, -582, -156},
+    {0xa3ab6658, 0x0d5fdaf6, -555, -148},
+    {0xf3e2f893, 0xdec3f126, -529, -140},
+    {0xb5b5ada8, 0xaaff80b8, -502, -132},
+    {0x87625f05, 0x6c7c4a8b, -475, -124},
+    {0xc9bcff60, 0x34c13053, -449, -116},
+    {0x964e858c, 0x91ba2655, -422, -108},
+    {0xdff97724, 0x70297ebd, -396, -100},
+    {0xa6dfbd9f, 0xb8e5b88f, -369, -92},
+    {0xf8a95fcf, 0x88747d94, -343, -84},
+    {0xb9447093, 0x8fa89bcf, -316, -76},
+    {0x8a08f0f8, 0xbf0f156b, -289, -68},
+    {0xcdb02555, 0x653131b6, -263, -60},
+    {0x993fe2c6, 0xd07b7fac, -236, -52},
+    {0xe45c10c4, 0x2a2b3b06, -210, -44},
+    {0xaa242499, 0x697392d3, -183, -36},
+    {0xfd87b5f2, 0x8300ca0e, -157, -28},
+    {0xbce50864, 0x92111aeb, -130, -20},
+    {0x8cbccc09, 0x6f5088cc, -103, -12},
+    {0xd1b71758, 0xe219652c, -77, -4},
+    {0x9c400000, 0x00000000, -50, 4},
+    {0xe8d4a510, 0x00000000, -24, 12},
+    {0xad78ebc5, 0xac620000, 3, 20},
+    {0x813f3978, 0xf8940984, 30, 28},
+    {0xc097ce7b, 0xc90715b3, 56, 36},
+    {0x8f7e32ce, 0x7bea5c70, 83, 44},
+    {0xd5d238a4, 0xabe98068, 109, 52},
+    {0x9f4f2726, 0x179a2245, 136, 60},
+    {0xed63a231, 0xd4c4fb27, 162, 68},
+    {0xb0de6538, 0x8cc8ada8, 189, 76},
+    {0x83c7088e, 0x1aab65db, 216, 84},
+    {0xc45d1df9, 0x42711d9a, 242, 92},
+    {0x924d692c, 0xa61be758, 269, 100},
+    {0xda01ee64, 0x1a708dea, 295, 108},
+    {0xa26da399, 0x9aef774a, 322, 116},
+    {0xf209787b, 0xb47d6b85, 348, 124},
+    {0xb454e4a1, 0x79dd1877, 375, 132},
+    {0x865b8692, 0x5b9bc5c2, 402, 140},
+    {0xc83553c5, 0xc8965d3d, 428, 148},
+    {0x952ab45c, 0xfa97a0b3, 455, 156},
+    {0xde469fbd, 0x99a05fe3, 481, 164},
+    {0xa59bc234, 0xdb398c25, 508, 172},
+    {0xf6c69a72, 0xa3989f5c, 534, 180},
+    {0xb7dcbf53, 0x54e9bece, 561, 188},
+    {0x88fcf317, 0xf22241e2, 588, 196},
+    {0xcc20ce9b, 0xd35c78a5, 614, 204},
+    {0x98165af3, 0x7b2153df, 641, 212},
+    {0xe2a0b5dc, 0x971f303a, 667, 220},
+    {0xa8d9d153, 0x5ce3b396, 694, 228},
+    {0xfb9b7cd9, 0xa4a7443c, 720, 236},
+    {0xbb764c4c, 0xa7a44410, 747, 244},
+    {0x8bab8eef, 0xb6409c1a, 774, 252},
+    {0xd01fef10, 0xa657842c, 800, 260},
+    {0x9b10a4e5, 0xe9913129, 827, 268},
+    {0xe7109bfb, 0xa19c0c9d, 853, 276},
+    {0xac2820d9, 0x623bf429, 880, 284},
+    {0x80444b5e, 0x7aa7cf85, 907, 292},
+    {0xbf21e440, 0x03acdd2d, 933, 300},
+    {0x8e679c2f, 0x5e44ff8f, 960, 308},
+    {0xd433179d, 0x9c8cb841, 986, 316},
+    {0x9e19db92, 0xb4e31ba9, 1013, 324},
+    {0xeb96bf6e, 0xbadf77d9, 1039, 332},
+    {0xaf87023b, 0x9bf0ee6b, 1066, 340},
+};
+#define CACHED_POWERS_OFFSET	348	/* -decExp of cachedPowers[0] */
+#define CACHED_POWERS_STEP	8	/* Distance between decimal exponents */
+
+/*
+ * "Do-it-yourself floating point" numbers used by the Grisu3 conversion:
+ * the value is f * 2**e.
+ */
+
+typedef struct DiyFp {
+    Tcl_WideUInt f;		/* Significand. */
+    int e;			/* Binary exponent. */
+} DiyFp;
+
+/*
+ * Table of 128-bit approximations to the powers of ten 10**-342, ...,
+ * 10**308, rounded down, for the Eisel-Lemire decimal to binary conversion.
+ * Each entry holds the significand normalized so that its top bit is set,
+ * as four 32-bit words from the most significant down.
+ */
+
+typedef struct TruncatedPower {
+    unsigned int w3, w2;	/* High-order 64 bits of the significand. */
+    unsigned int w1, w0;	/* Low-order 64 bits of the significand. */
+} TruncatedPower;
+
+static const TruncatedPower powersOfTen128[] = {
+    {0xeef453d6, 0x923bd65a, 0x113faa29, 0x06a13b3f},
+    {0x9558b466, 0x1b6565f8, 0x4ac7ca59, 0xa424c507},
+    {0xbaaee17f, 0xa23ebf76, 0x5d79bcf0, 0x0d2df649},
+    {0xe95a99df, 0x8ace6f53, 0xf4d82c2c, 0x107973dc},
+    {0x91d8a02b, 0xb6c10594, 0x79071b9b, 0x8a4be869},
+    {0xb64ec836, 0xa47146f9, 0x9748e282, 0x6cdee284},
+    {0xe3e27a44, 0x4d8d98b7, 0xfd1b1b23, 0x08169b25},
+    {0x8e6d8c6a, 0xb0787f72, 0xfe30f0f5, 0xe50e20f7},
+    {0xb208ef85, 0x5c969f4f, 0xbdbd2d33, 0x5e51a935},
+    {0xde8b2b66, 0xb3bc4723, 0xad2c7880, 0x35e61382},
+    {0x8b16fb20, 0x3055ac76, 0x4c3bcb50, 0x21afcc31},
+    {0xaddcb9e8, 0x3c6b1793, 0xdf4abe24, 0x2a1bbf3d},
+    {0xd953e862, 0x4b85dd78, 0xd71d6dad, 0x34a2af0d},
+    {0x87d4713d, 0x6f33aa6b, 0x8672648c, 0x40e5ad68},
+    {0xa9c98d8c, 0xcb009506, 0x680efdaf, 0x511f18c2},
+    {0xd43bf0ef, 0xfdc0ba48, 0x0212bd1b, 0x2566def2},
+    {0x84a57695, 0xfe98746d, 0x014bb630, 0xf7604b57},
+    {0xa5ced43b, 0x7e3e9188, 0x419ea3bd, 0x35385e2d},
+    {0xcf42894a, 0x5dce35ea, 0x52064cac, 0x828675b9},
+    {0x818995ce, 0x7aa0e1b2, 0x7343efeb, 0xd1940993},
+    {0xa1ebfb42, 0x19491a1f, 0x1014ebe6, 0xc5f90bf8},
+    {0xca66fa12, 0x9f9b60a6, 0xd41a26e0, 0x77774ef6},
+    {0xfd00b897, 0x478238d0, 0x8920b098, 0x955522b4},
+    {0x9e20735e, 0x8cb16382, 0x55b46e5f, 0x5d5535b0},
+    {0xc5a89036, 0x2fddbc62, 0xeb2189f7, 0x34aa831d},
+    {0xf712b443, 0xbbd52b7b, 0xa5e9ec75, 0x01d523e4},
+    {0x9a6bb0aa, 0x55653b2d, 0x47b233c9, 0x2125366e},
+    {0xc1069cd4, 0xeabe89f8, 0x999ec0bb, 0x696e840a},
+    {0xf148440a, 0x256e2c76, 0xc00670ea, 0x43ca250d},
+    {0x96cd2a86, 0x5764dbca, 0x38040692, 0x6a5e5728},
+    {0xbc807527, 0xed3e12bc, 0xc6050837, 0x04f5ecf2},
+    {0xeba09271, 0xe88d976b, 0xf7864a44, 0xc633682e},
+    {0x93445b87, 0x31587ea3, 0x7ab3ee6a, 0xfbe0211d},
+    {0xb8157268, 0xfdae9e4c, 0x5960ea05, 0xbad82964},
+    {0xe61acf03, 0x3d1a45df, 0x6fb92487, 0x298e33bd},
+    {0x8fd0c162, 0x06306bab, 0xa5d3b6d4, 0x79f8e056},
+    {0xb3c4f1ba, 0x87bc8696, 0x8f48a489, 0x9877186c},
+    {0xe0b62e29, 0x29aba83c, 0x331acdab, 0xfe94de87},
+    {0x8c71dcd9, 0xba0b4925, 0x9ff0c08b, 0x7f1d0b14},
+    {0xaf8e5410, 0x288e1b6f, 0x07ecf0ae, 0x5ee44dd9},
+    {0xdb71e914, 0x32b1a24a, 0xc9e82cd9, 0xf69d6150},
+    {0x892731ac, 0x9faf056e, 0xbe311c08, 0x3a225cd2},
+    {0xab70fe17, 0xc79ac6ca, 0x6dbd630a, 0x48aaf406},
+    {0xd64d3d9d, 0xb981787d, 0x092cbbcc, 0xdad5b108},
+    {0x85f04682, 0x93f0eb4e, 0x25bbf560, 0x08c58ea5},
+    {0xa76c5823, 0x38ed2621, 0xaf2af2b8, 0x0af6f24e},
+    {0xd1476e2c, 0x07286faa, 0x1af5af66, 0x0db4aee1},
+    {0x82cca4db, 0x847945ca, 0x50d98d9f, 0xc890ed4d},
+    {0xa37fce12, 0x6597973c, 0xe50ff107, 0xbab528a0},
+    {0xcc5fc196, 0xfefd7d0c, 0x1e53ed49, 0xa96272c8},
+    {0xff77b1fc, 0xbebcdc4f, 0x25e8e89c, 0x13bb0f7a},
+    {0x9faacf3d, 0xf73609b1, 0x77b19161, 0x8c54e9ac},
+    {0xc795830d, 0x75038c1d, 0xd59df5b9, 0xef6a2417},
+    {0xf97ae3d0, 0xd2446f25, 0x4b057328, 0x6b44ad1d},
+    {0x9becce62, 0x836ac577, 0x4ee367f9, 0x430aec32},
+    {0xc2e801fb, 0x244576d5, 0x229c41f7, 0x93cda73f},
+    {0xf3a20279, 0xed56d48a, 0x6b435275, 0x78c1110f},
+    {0x9845418c, 0x345644d6, 0x830a1389, 0x6b78aaa9},
+    {0xbe5691ef, 0x416bd60c, 0x23cc986b, 0xc656d553},
+    {0xedec366b, 0x11c6cb8f, 0x2cbfbe86, 0xb7ec8aa8},
+    {0x94b3a202, 0xeb1c3f39, 0x7bf7d714, 0x32f3d6a9},
+    {0xb9e08a83, 0xa5e34f07, 0xdaf5ccd9, 0x3fb0cc53},
+    {0xe858ad24, 0x8f5c22c9, 0xd1b3400f, 0x8f9cff68},
+    {0x91376c36, 0xd99995be, 0x23100809, 0xb9c21fa1},
+    {0xb5854744, 0x8ffffb2d, 0xabd40a0c, 0x2832a78a},
+    {0xe2e69915, 0xb3fff9f9, 0x16c90c8f, 0x323f516c},
+    {0x8dd01fad, 0x907ffc3b, 0xae3da7d9, 0x7f6792e3},
+    {0xb1442798, 0xf49ffb4a, 0x99cd11cf, 0xdf41779c},
+    {0xdd95317f, 0x31c7fa1d, 0x40405643, 0xd711d583},
+    {0x8a7d3eef, 0x7f1cfc52, 0x482835ea, 0x666b2572},
+    {0xad1c8eab, 0x5ee43b66, 0xda324365, 0x0005eecf},
+    {0xd863b256, 0x369d4a40, 0x90bed43e, 0x40076a82},
+    {0x873e4f75, 0xe2224e68, 0x5a7744a6, 0xe804a291},
+    {0xa90de353, 0x5aaae202, 0x711515d0, 0xa205cb36},
+    {0xd3515c28, 0x31559a83, 0x0d5a5b44, 0xca873e03},
+    {0x8412d999, 0x1ed58091, 0xe858790a, 0xfe9486c2},
+    {0xa5178fff, 0x668ae0b6, 0x626e974d, 0xbe39a872},
+    {0xce5d73ff, 0x402d98e3, 0xfb0a3d21, 0x2dc8128f},
+    {0x80fa687f, 0x881c7f8e, 0x7ce66634, 0xbc9d0b99},
+    {0xa139029f, 0x6a239f72, 0x1c1fffc1, 0xebc44e80},
+    {0xc9874347, 0x44ac874e, 0xa327ffb2, 0x66b56220},
+    {0xfbe91419, 0x15d7a922, 0x4bf1ff9f, 0x0062baa8},
+    {0x9d71ac8f, 0xada6c9b5, 0x6f773fc3, 0x603db4a9},
+    {0xc4ce17b3, 0x99107c22, 0xcb550fb4, 0x384d21d3},
+    {0xf6019da0, 0x7f549b2b, 0x7e2a53a1, 0x46606a48},
+    {0x99c10284, 0x4f94e0fb, 0x2eda7444, 0xcbfc426d},
+    {0xc0314325, 0x637a1939, 0xfa911155, 0xfefb5308},
+    {0xf03d93ee, 0xbc589f88, 0x793555ab, 0x7eba27ca},
+    {0x96267c75, 0x35b763b5, 0x4bc1558b, 0x2f3458de},
+    {0xbbb01b92, 0x83253ca2, 0x9eb1aaed, 0xfb016f16},
+    {0xea9c2277, 0x23ee8bcb, 0x465e15a9, 0x79c1cadc},
+    {0x92a1958a, 0x7675175f, 0x0bfacd89, 0xec191ec9},
+    {0xb749faed, 0x14125d36, 0xcef980ec, 0x671f667b},
+    {0xe51c79a8, 0x5916f484, 0x82b7e127, 0x80e7401a},
+    {0x8f31cc09, 0x37ae58d2, 0xd1b2ecb8, 0xb0908810},
+    {0xb2fe3f0b, 0x8599ef07, 0x861fa7e6, 0xdcb4aa15},
+    {0xdfbdcece, 0x67006ac9, 0x67a791e0, 0x93e1d49a},
+    {0x8bd6a141, 0x006042bd, 0xe0c8bb2c, 0x5c6d24e0},
+    {0xaecc4991, 0x4078536d, 0x58fae9f7, 0x73886e18},
+    {0xda7f5bf5, 0x90966848, 0xaf39a475, 0x506a899e},
+    {0x888f9979, 0x7a5e012d, 0x6d8406c9, 0x52429603},
+    {0xaab37fd7, 0xd8f58178, 0xc8e5087b, 0xa6d33b83},
+    {0xd5605fcd, 0xcf32e1d6, 0xfb1e4a9a, 0x90880a64},
+    {0x855c3be0, 0xa17fcd26, 0x5cf2eea0, 0x9a55067f},
+    {0xa6b34ad8, 0xc9dfc06f, 0xf42faa48, 0xc0ea481e},
+    {0xd0601d8e, 0xfc57b08b, 0xf13b94da, 0xf124da26},
+    {0x823c1279, 0x5db6ce57, 0x76c53d08, 0xd6b70858},
+    {0xa2cb1717, 0xb52481ed, 0x54768c4b, 0x0c64ca6e},
+    {0xcb7ddcdd, 0xa26da268, 0xa9942f5d, 0xcf7dfd09},
+    {0xfe5d5415, 0x0b090b02, 0xd3f93b35, 0x435d7c4c},
+    {0x9efa548d, 0x26e5a6e1, 0xc47bc501, 0x4a1a6daf},
+    {0xc6b8e9b0, 0x709f109a, 0x359ab641, 0x9ca1091b},
+    {0xf867241c, 0x8cc6d4c0, 0xc30163d2, 0x03c94b62},
+    {0x9b407691, 0xd7fc44f8, 0x79e0de63, 0x425dcf1d},
+    {0xc2109436, 0x4dfb5636, 0x985915fc, 0x12f542e4},
+    {0xf294b943, 0xe17a2bc4, 0x3e6f5b7b, 0x17b2939d},
+    {0x979cf3ca, 0x6cec5b5a, 0xa705992c, 0xeecf9c42},
+    {0xbd8430bd, 0x08277231, 0x50c6ff78, 0x2a838353},
+    {0xece53cec, 0x4a314ebd, 0xa4f8bf56, 0x35246428},
+    {0x940f4613, 0xae5ed136, 0x871b7795, 0xe136be99},
+    {0xb9131798, 0x99f68584, 0x28e2557b, 0x59846e3f},
+    {0xe757dd7e, 0xc07426e5, 0x331aeada, 0x2fe589cf},
+    {0x9096ea6f, 0x3848984f, 0x3ff0d2c8, 0x5def7621},
+    {0xb4bca50b, 0x065abe63, 0x0fed077a, 0x756b53a9},
+    {0xe1ebce4d, 0xc7f16dfb, 0xd3e84959, 0x12c62894},
+    {0x8d3360f0, 0x9cf6e4bd, 0x64712dd7, 0xabbbd95c},
+    {0xb080392c, 0xc4349dec, 0xbd8d794d, 0x96aacfb3},
+    {0xdca04777, 0xf541c567, 0xecf0d7a0, 0xfc5583a0},
+    {0x89e42caa, 0xf9491b60, 0xf41686c4, 0x9db57244},
+    {0xac5d37d5, 0xb79b6239, 0x311c2875, 0xc522ced5},
+    {0xd77485cb, 0x25823ac7, 0x7d633293, 0x366b828b},
+    {0x86a8d39e, 0xf77164bc, 0xae5dff9c, 0x02033197},
+    {0xa8530886, 0xb54dbdeb, 0xd9f57f83, 0x0283fdfc},
+    {0xd267caa8, 0x62a12d66, 0xd072df63, 0xc324fd7b},
+    {0x8380dea9, 0x3da4bc60, 0x4247cb9e, 0x59f71e6d},
+    {0xa4611653, 0x8d0deb78, 0x52d9be85, 0xf074e608},
+    {0xcd795be8, 0x70516656, 0x67902e27, 0x6c921f8b},
+    {0x806bd971, 0x4632dff6, 0x00ba1cd8, 0xa3db53b6},
+    {0xa086cfcd, 0x97bf97f3, 0x80e8a40e, 0xccd228a4},
+    {0xc8a883c0, 0xfdaf7df0, 0x6122cd12, 0x8006b2cd},
+    {0xfad2a4b1, 0x3d1b5d6c, 0x796b8057, 0x20085f81},
+    {0x9cc3a6ee, 0xc6311a63, 0xcbe33036, 0x74053bb0},
+    {0xc3f490aa, 0x77bd60fc, 0xbedbfc44, 0x11068a9c},
+    {0xf4f1b4d5, 0x15acb93b, 0xee92fb55, 0x15482d44},
+    {0x99171105, 0x2d8bf3c5, 0x751bdd15, 0x2d4d1c4a},
+    {0xbf5cd546, 0x78eef0b6, 0xd262d45a, 0x78a0635d},
+    {0xef340a98, 0x172aace4, 0x86fb8971, 0x16c87c34},
+    {0x9580869f, 0x0e7aac0e, 0xd45d35e6, 0xae3d4da0},
+    {0xbae0a846, 0xd2195712, 0x89748360, 0x59cca109},
+    {0xe998d258, 0x869facd7, 0x2bd1a438, 0x703fc94b},
+    {0x91ff8377, 0x5423cc06, 0x7b6306a3, 0x4627ddcf},
+    {0xb67f6455, 0x292cbf08, 0x1a3bc84c, 0x17b1d542},
+    {0xe41f3d6a, 0x7377eeca, 0x20caba5f, 0x1d9e4a93},
+    {0x8e938662, 0x882af53e, 0x547eb47b, 0x7282ee9c},
+    {0xb23867fb, 0x2a35b28d, 0xe99e619a, 0x4f23aa43},
+    {0xdec681f9, 0xf4c31f31, 0x6405fa00, 0xe2ec94d4},
+    {0x8b3c113c, 0x38f9f37e, 0xde83bc40, 0x8dd3dd04},
+    {0xae0b158b, 0x4738705e, 0x9624ab50, 0xb148d445},
+    {0xd98ddaee, 0x19068c76, 0x3badd624, 0xdd9b0957},
+    {0x87f8a8d4, 0xcfa417c9, 0xe54ca5d7, 0x0a80e5d6},
+    {0xa9f6d30a, 0x038d1dbc, 0x5e9fcf4c, 0xcd211f4c},
+    {0xd47487cc, 0x8470652b, 0x7647c320, 0x0069671f},
+    {0x84c8d4df, 0xd2c63f3b, 0x29ecd9f4, 0x0041e073},
+    {0xa5fb0a17, 0xc777cf09, 0xf4681071, 0x00525890},
+    {0xcf79cc9d, 0xb955c2cc, 0x7182148d, 0x4066eeb4},
+    {0x81ac1fe2, 0x93d599bf, 0xc6f14cd8, 0x48405530},
+    {0xa21727db, 0x38cb002f, 0xb8ada00e, 0x5a506a7c},
+    {0xca9cf1d2, 0x06fdc03b, 0xa6d90811, 0xf0e4851c},
+    {0xfd442e46, 0x88bd304a, 0x908f4a16, 0x6d1da663},
+    {0x9e4a9cec, 0x15763e2e, 0x9a598e4e, 0x043287fe},
+    {0xc5dd4427, 0x1ad3cdba, 0x40eff1e1, 0x853f29fd},
+    {0xf7549530, 0xe188c128, 0xd12bee59, 0xe68ef47c},
+    {0x9a94dd3e, 0x8cf578b9, 0x82bb74f8, 0x301958ce},
+    {0xc13a148e, 0x3032d6e7, 0xe36a5236, 0x3c1faf01},
+    {0xf18899b1, 0xbc3f8ca1, 0xdc44e6c3, 0xcb279ac1},
+    {0x96f5600f, 0x15a7b7e5, 0x29ab103a, 0x5ef8c0b9},
+    {0xbcb2b812, 0xdb11a5de, 0x7415d448, 0xf6b6f0e7},
+    {0xebdf6617, 0x91d60f56, 0x111b495b, 0x3464ad21},
+    {0x936b9fce, 0xbb25c995, 0xcab10dd9, 0x00beec34},
+    {0xb84687c2, 0x69ef3bfb, 0x3d5d514f, 0x40eea742},
+    {0xe65829b3, 0x046b0afa, 0x0cb4a5a3, 0x112a5112},
+    {0x8ff71a0f, 0xe2c2e6dc, 0x47f0e785, 0xeaba72ab},
+    {0xb3f4e093, 0xdb73a093, 0x59ed2167, 0x65690f56},
+    {0xe0f218b8, 0xd25088b8, 0x306869c1, 0x3ec3532c},
+    {0x8c974f73, 0x83725573, 0x1e414218, 0xc73a13fb},
+    {0xafbd2350, 0x644eeacf, 0xe5d1929e, 0xf90898fa},
+    {0xdbac6c24, 0x7d62a583, 0xdf45f746, 0xb74abf39},
+    {0x894bc396, 0xce5da772, 0x6b8bba8c, 0x328eb783},
+    {0xab9eb47c, 0x81f5114f, 0x066ea92f, 0x3f326564},
+    {0xd686619b, 0xa27255a2, 0xc80a537b, 0x0efefebd},
+    {0x8613fd01, 0x45877585, 0xbd06742c, 0xe95f5f36},
+    {0xa798fc41, 0x96e952e7, 0x2c481138, 0x23b73704},
+    {0xd17f3b51, 0xfca3a7a0, 0xf75a1586, 0x2ca504c5},
+    {0x82ef8513, 0x3de648c4, 0x9a984d73, 0xdbe722fb},
+    {0xa3ab6658, 0x0d5fdaf5, 0xc13e60d0, 0xd2e0ebba},
+    {0xcc963fee, 0x10b7d1b3, 0x318df905, 0x079926a8},
+    {0xffbbcfe9, 0x94e5c61f, 0xfdf17746, 0x497f7052},
+    {0x9fd561f1, 0xfd0f9bd3, 0xfeb6ea8b, 0xedefa633},
+    {0xc7caba6e, 0x7c5382c8, 0xfe64a52e, 0xe96b8fc0},
+    {0xf9bd690a, 0x1b68637b, 0x3dfdce7a, 0xa3c673b0},
+    {0x9c1661a6, 0x51213e2d, 0x06bea10c, 0xa65c084e},
+    {0xc31bfa0f, 0xe5698db8, 0x486e494f, 0xcff30a62},
+    {0xf3e2f893, 0xdec3f126, 0x5a89dba3, 0xc3efccfa},
+    {0x986ddb5c, 0x6b3a76b7, 0xf8962946, 0x5a75e01c},
+    {0xbe895233, 0x86091465, 0xf6bbb397, 0xf1135823},
+    {0xee2ba6c0, 0x678b597f, 0x746aa07d, 0xed582e2c},
+    {0x94db4838, 0x40b717ef, 0xa8c2a44e, 0xb4571cdc},
+    {0xba121a46, 0x50e4ddeb, 0x92f34d62, 0x616ce413},
+    {0xe896a0d7, 0xe51e1566, 0x77b020ba, 0xf9c81d17},
+    {0x915e2486, 0xef32cd60, 0x0ace1474, 0xdc1d122e},
+    {0xb5b5ada8, 0xaaff80b8, 0x0d819992, 0x132456ba},
+    {0xe3231912, 0xd5bf60e6, 0x10e1fff6, 0x97ed6c69},
+    {0x8df5efab, 0xc5979c8f, 0xca8d3ffa, 0x1ef463c1},
+    {0xb1736b96, 0xb6fd83b3, 0xbd308ff8, 0xa6b17cb2},
+    {0xddd0467c, 0x64bce4a0, 0xac7cb3f6, 0xd05ddbde},
+    {0x8aa22c0d, 0xbef60ee4, 0x6bcdf07a, 0x423aa96b},
+    {0xad4ab711, 0x2eb3929d, 0x86c16c98, 0xd2c953c6},
+    {0xd89d64d5, 0x7a607744, 0xe871c7bf, 0x077ba8b7},
+    {0x87625f05, 0x6c7c4a8b, 0x11471cd7, 0x64ad4972},
+    {0xa93af6c6, 0xc79b5d2d, 0xd598e40d, 0x3dd89bcf},
+    {0xd389b478, 0x79823479, 0x4aff1d10, 0x8d4ec2c3},
+    {0x843610cb, 0x4bf160cb, 0xcedf722a, 0x585139ba},
+    {0xa54394fe, 0x1eedb8fe, 0xc2974eb4, 0xee658828},
+    {0xce947a3d, 0xa6a9273e, 0x733d2262, 0x29feea32},
+    {0x811ccc66, 0x8829b887, 0x0806357d, 0x5a3f525f},
+    {0xa163ff80, 0x2a3426a8, 0xca07c2dc, 0xb0cf26f7},
+    {0xc9bcff60, 0x34c13052, 0xfc89b393, 0xdd02f0b5},
+    {0xfc2c3f38, 0x41f17c67, 0xbbac2078, 0xd443ace2},
+    {0x9d9ba783, 0x2936edc0, 0xd54b944b, 0x84aa4c0d},
+    {0xc5029163, 0xf384a931, 0x0a9e795e, 0x65d4df11},
+    {0xf64335bc, 0xf065d37d, 0x4d4617b5, 0xff4a16d5},
+    {0x99ea0196, 0x163fa42e, 0x504bced1, 0xbf8e4e45},
+    {0xc06481fb, 0x9bcf8d39, 0xe45ec286, 0x2f71e1d6},
+    {0xf07da27a, 0x82c37088, 0x5d767327, 0xbb4e5a4c},
+    {0x964e858c, 0x91ba2655, 0x3a6a07f8, 0xd510f86f},
+    {0xbbe226ef, 0xb628afea, 0x890489f7, 0x0a55368b},
+    {0xeadab0ab, 0xa3b2dbe5, 0x2b45ac74, 0xccea842e},
+    {0x92c8ae6b, 0x464fc96f, 0x3b0b8bc9, 0x0012929d},
+    {0xb77ada06, 0x17e3bbcb, 0x09ce6ebb, 0x40173744},
+    {0xe5599087, 0x9ddcaabd, 0xcc420a6a, 0x101d0515},
+    {0x8f57fa54, 0xc2a9eab6, 0x9fa94682, 0x4a12232d},
+    {0xb32df8e9, 0xf3546564, 0x47939822, 0xdc96abf9},
+    {0xdff97724, 0x70297ebd, 0x59787e2b, 0x93bc56f7},
+    {0x8bfbea76, 0xc619ef36, 0x57eb4edb, 0x3c55b65a},
+    {0xaefae514, 0x77a06b03, 0xede62292, 0x0b6b23f1},
+    {0xdab99e59, 0x958885c4, 0xe95fab36, 0x8e45eced},
+    {0x88b402f7, 0xfd75539b, 0x11dbcb02, 0x18ebb414},
+    {0xaae103b5, 0xfcd2a881, 0xd652bdc2, 0x9f26a119},
+    {0xd59944a3, 0x7c0752a2, 0x4be76d33, 0x46f0495f},
+    {0x857fcae6, 0x2d8493a5, 0x6f70a440, 0x0c562ddb},
+    {0xa6dfbd9f, 0xb8e5b88e, 0xcb4ccd50, 0x0f6bb952},
+    {0xd097ad07, 0xa71f26b2, 0x7e2000a4, 0x1346a7a7},
+    {0x825ecc24, 0xc873782f, 0x8ed40066, 0x8c0c28c8},
+    {0xa2f67f2d, 0xfa90563b, 0x72890080, 0x2f0f32fa},
+    {0xcbb41ef9, 0x79346bca, 0x4f2b40a0, 0x3ad2ffb9},
+    {0xfea126b7, 0xd78186bc, 0xe2f610c8, 0x4987bfa8},
+    {0x9f24b832, 0xe6b0f436, 0x0dd9ca7d, 0x2df4d7c9},
+    {0xc6ede63f, 0xa05d3143, 0x91503d1c, 0x79720dbb},
+    {0xf8a95fcf, 0x88747d94, 0x75a44c63, 0x97ce912a},
+    {0x9b69dbe1, 0xb548ce7c, 0xc986afbe, 0x3ee11aba},
+    {0xc24452da, 0x229b021b, 0xfbe85bad, 0xce996168},
+    {0xf2d56790, 0xab41c2a2, 0xfae27299, 0x423fb9c3},
+    {0x97c560ba, 0x6b0919a5, 0xdccd879f, 0xc967d41a},
+    {0xbdb6b8e9, 0x05cb600f, 0x5400e987, 0xbbc1c920},
+    {0xed246723, 0x473e3813, 0x290123e9, 0xaab23b68},
+    {0x9436c076, 0x0c86e30b, 0xf9a0b672, 0x0aaf6521},
+    {0xb9447093, 0x8fa89bce, 0xf808e40e, 0x8d5b3e69},
+    {0xe7958cb8, 0x7392c2c2, 0xb60b1d12, 0x30b20e04},
+    {0x90bd77f3, 0x483bb9b9, 0xb1c6f22b, 0x5e6f48c2},
+    {0xb4ecd5f0, 0x1a4aa828, 0x1e38aeb6, 0x360b1af3},
+    {0xe2280b6c, 0x20dd5232, 0x25c6da63, 0xc38de1b0},
+    {0x8d590723, 0x948a535f, 0x579c487e, 0x5a38ad0e},
+    {0xb0af48ec, 0x79ace837, 0x2d835a9d, 0xf0c6d851},
+    {0xdcdb1b27, 0x98182244, 0xf8e43145, 0x6cf88e65},
+    {0x8a08f0f8, 0xbf0f156b, 0x1b8e9ecb, 0x641b58ff},
+    {0xac8b2d36, 0xeed2dac5, 0xe272467e, 0x3d222f3f},
+    {0xd7adf884, 0xaa879177, 0x5b0ed81d, 0xcc6abb0f},
+    {0x86ccbb52, 0xea94baea, 0x98e94712, 0x9fc2b4e9},
+    {0xa87fea27, 0xa539e9a5, 0x3f2398d7, 0x47b36224},
+    {0xd29fe4b1, 0x8e88640e, 0x8eec7f0d, 0x19a03aad},
+    {0x83a3eeee, 0xf9153e89, 0x1953cf68, 0x300424ac},
+    {0xa48ceaaa, 0xb75a8e2b, 0x5fa8c342, 0x3c052dd7},
+    {0xcdb02555, 0x653131b6, 0x3792f412, 0xcb06794d},
+    {0x808e1755, 0x5f3ebf11, 0xe2bbd88b, 0xbee40bd0},
+    {0xa0b19d2a, 0xb70e6ed6, 0x5b6aceae, 0xae9d0ec4},
+    {0xc8de0475, 0x64d20a8b, 0xf245825a, 0x5a445275},
+    {0xfb158592, 0xbe068d2e, 0xeed6e2f0, 0xf0d56712},
+    {0x9ced737b, 0xb6c4183d, 0x55464dd6, 0x9685606b},
+    {0xc428d05a, 0xa4751e4c, 0xaa97e14c, 0x3c26b886},
+    {0xf5330471, 0x4d9265df, 0xd53dd99f, 0x4b3066a8},
+    {0x993fe2c6, 0xd07b7fab, 0xe546a803, 0x8efe4029},
+    {0xbf8fdb78, 0x849a5f96, 0xde985204, 0x72bdd033},
+    {0xef73d256, 0xa5c0f77c, 0x963e6685, 0x8f6d4440},
+    {0x95a86376, 0x27989aad, 0xdde70013, 0x79a44aa8},
+    {0xbb127c53, 0xb17ec159, 0x5560c018, 0x580d5d52},
+    {0xe9d71b68, 0x9dde71af, 0xaab8f01e, 0x6e10b4a6},
+    {0x92267121, 0x62ab070d, 0xcab39613, 0x04ca70e8},
+    {0xb6b00d69, 0xbb55c8d1, 0x3d607b97, 0xc5fd0d22},
+    {0xe45c10c4, 0x2a2b3b05, 0x8cb89a7d, 0xb77c506a},
+    {0x8eb98a7a, 0x9a5b04e3, 0x77f3608e, 0x92adb242},
+    {0xb267ed19, 0x40f1c61c, 0x55f038b2, 0x37591ed3},
+    {0xdf01e85f, 0x912e37a3, 0x6b6c46de, 0xc52f6688},
+    {0x8b61313b, 0xbabce2c6, 0x2323ac4b, 0x3b3da015},
+    {0xae397d8a, 0xa96c1b77, 0xabec975e, 0x0a0d081a},
+    {0xd9c7dced, 0x53c72255, 0x96e7bd35, 0x8c904a21},
+    {0x881cea14, 0x545c7575, 0x7e50d641, 0x77da2e54},
+    {0xaa242499, 0x697392d2, 0xdde50bd1, 0xd5d0b9e9},
+    {0xd4ad2dbf, 0xc3d07787, 0x955e4ec6, 0x4b44e864},
+    {0x84ec3c97, 0xda624ab4, 0xbd5af13b, 0xef0b113e},
+    {0xa6274bbd, 0xd0fadd61, 0xecb1ad8a, 0xeacdd58e},
+    {0xcfb11ead, 0x453994ba, 0x67de18ed, 0xa5814af2},
+    {0x81ceb32c, 0x4b43fcf4, 0x80eacf94, 0x8770ced7},
+    {0xa2425ff7, 0x5e14fc31, 0xa1258379, 0xa94d028d},
+    {0xcad2f7f5, 0x359a3b3e, 0x096ee458, 0x13a04330},
+    {0xfd87b5f2, 0x8300ca0d, 0x8bca9d6e, 0x188853fc},
+    {0x9e74d1b7, 0x91e07e48, 0x775ea264, 0xcf55347d},
+    {0xc6120625, 0x76589dda, 0x95364afe, 0x032a819d},
+    {0xf79687ae, 0xd3eec551, 0x3a83ddbd, 0x83f52204},
+    {0x9abe14cd, 0x44753b52, 0xc4926a96, 0x72793542},
+    {0xc16d9a00, 0x95928a27, 0x75b7053c, 0x0f178293},
+    {0xf1c90080, 0xbaf72cb1, 0x5324c68b, 0x12dd6338},
+    {0x971da050, 0x74da7bee, 0xd3f6fc16, 0xebca5e03},
+    {0xbce50864, 0x92111aea, 0x88f4bb1c, 0xa6bcf584},
+    {0xec1e4a7d, 0xb69561a5, 0x2b31e9e3, 0xd06c32e5},
+    {0x9392ee8e, 0x921d5d07, 0x3aff322e, 0x62439fcf},
+    {0xb877aa32, 0x36a4b449, 0x09befeb9, 0xfad487c2},
+    {0xe69594be, 0xc44de15b, 0x4c2ebe68, 0x7989a9b3},
+    {0x901d7cf7, 0x3ab0acd9, 0x0f9d3701, 0x4bf60a10},
+    {0xb424dc35, 0x095cd80f, 0x538484c1, 0x9ef38c94},
+    {0xe12e1342, 0x4bb40e13, 0x2865a5f2, 0x06b06fb9},
+    {0x8cbccc09, 0x6f5088cb, 0xf93f87b7, 0x442e45d3},
+    {0xafebff0b, 0xcb24aafe, 0xf78f69a5, 0x1539d748},
+    {0xdbe6fece, 0xbdedd5be, 0xb573440e, 0x5a884d1b},
+    {0x89705f41, 0x36b4a597, 0x31680a88, 0xf8953030},
+    {0xabcc7711, 0x8461cefc, 0xfdc20d2b, 0x36ba7c3d},
+    {0xd6bf94d5, 0xe57a42bc, 0x3d329076, 0x04691b4c},
+    {0x8637bd05, 0xaf6c69b5, 0xa63f9a49, 0xc2c1b10f},
+    {0xa7c5ac47, 0x1b478423, 0x0fcf80dc, 0x33721d53},
+    {0xd1b71758, 0xe219652b, 0xd3c36113, 0x404ea4a8},
+    {0x83126e97, 0x8d4fdf3b, 0x645a1cac, 0x083126e9},
+    {0xa3d70a3d, 0x70a3d70a, 0x3d70a3d7, 0x0a3d70a3},
+    {0xcccccccc, 0xcccccccc, 0xcccccccc, 0xcccccccc},
+    {0x80000000, 0x00000000, 0x00000000, 0x00000000},
+    {0xa0000000, 0x00000000, 0x00000000, 0x00000000},
+    {0xc8000000, 0x00000000, 0x00000000, 0x00000000},
+    {0xfa000000, 0x00000000, 0x00000000, 0x00000000},
+    {0x9c400000, 0x00000000, 0x00000000, 0x00000000},
+    {0xc3500000, 0x00000000, 0x00000000, 0x00000000},
+    {0xf4240000, 0x00000000, 0x00000000, 0x00000000},
+    {0x98968000, 0x00000000, 0x00000000, 0x00000000},
+    {0xbebc2000, 0x00000000, 0x00000000, 0x00000000},
+    {0xee6b2800, 0x00000000, 0x00000000, 0x00000000},
+    {0x9502f900, 0x00000000, 0x00000000, 0x00000000},
+    {0xba43b740, 0x00000000, 0x00000000, 0x00000000},
+    {0xe8d4a510, 0x00000000, 0x00000000, 0x00000000},
+    {0x9184e72a, 0x00000000, 0x00000000, 0x00000000},
+    {0xb5e620f4, 0x80000000, 0x00000000, 0x00000000},
+    {0xe35fa931, 0xa0000000, 0x00000000, 0x00000000},
+    {0x8e1bc9bf, 0x04000000, 0x00000000, 0x00000000},
+    {0xb1a2bc2e, 0xc5000000, 0x00000000, 0x00000000},
+    {0xde0b6b3a, 0x76400000, 0x00000000, 0x00000000},
+    {0x8ac72304, 0x89e80000, 0x00000000, 0x00000000},
+    {0xad78ebc5, 0xac620000, 0x00000000, 0x00000000},
+    {0xd8d726b7, 0x177a8000, 0x00000000, 0x00000000},
+    {0x87867832, 0x6eac9000, 0x00000000, 0x00000000},
+    {0xa968163f, 0x0a57b400, 0x00000000, 0x00000000},
+    {0xd3c21bce, 0xcceda100, 0x00000000, 0x00000000},
+    {0x84595161, 0x401484a0, 0x00000000, 0x00000000},
+    {0xa56fa5b9, 0x9019a5c8, 0x00000000, 0x00000000},
+    {0xcecb8f27, 0xf4200f3a, 0x00000000, 0x00000000},
+    {0x813f3978, 0xf8940984, 0x40000000, 0x00000000},
+    {0xa18f07d7, 0x36b90be5, 0x50000000, 0x00000000},
+    {0xc9f2c9cd, 0x04674ede, 0xa4000000, 0x00000000},
+    {0xfc6f7c40, 0x45812296, 0x4d000000, 0x00000000},
+    {0x9dc5ada8, 0x2b70b59d, 0xf0200000, 0x00000000},
+    {0xc5371912, 0x364ce305, 0x6c280000, 0x00000000},
+    {0xf684df56, 0xc3e01bc6, 0xc7320000, 0x00000000},
+    {0x9a130b96, 0x3a6c115c, 0x3c7f4000, 0x00000000},
+    {0xc097ce7b, 0xc90715b3, 0x4b9f1000, 0x00000000},
+    {0xf0bdc21a, 0xbb48db20, 0x1e86d400, 0x00000000},
+    {0x96769950, 0xb50d88f4, 0x13144480, 0x00000000},
+    {0xbc143fa4, 0xe250eb31, 0x17d955a0, 0x00000000},
+    {0xeb194f8e, 0x1ae525fd, 0x5dcfab08, 0x00000000},
+    {0x92efd1b8, 0xd0cf37be, 0x5aa1cae5, 0x00000000},
+    {0xb7abc627, 0x050305ad, 0xf14a3d9e, 0x40000000},
+    {0xe596b7b0, 0xc643c719, 0x6d9ccd05, 0xd0000000},
+    {0x8f7e32ce, 0x7bea5c6f, 0xe4820023, 0xa2000000},
+    {0xb35dbf82, 0x1ae4f38b, 0xdda2802c, 0x8a800000},
+    {0xe0352f62, 0xa19e306e, 0xd50b2037, 0xad200000},
+    {0x8c213d9d, 0xa502de45, 0x4526f422, 0xcc340000},
+    {0xaf298d05, 0x0e4395d6, 0x9670b12b, 0x7f410000},
+    {0xdaf3f046, 0x51d47b4c, 0x3c0cdd76, 0x5f114000},
+    {0x88d8762b, 0xf324cd0f, 0xa5880a69, 0xfb6ac800},
+    {0xab0e93b6, 0xefee0053, 0x8eea0d04, 0x7a457a00},
+    {0xd5d238a4, 0xabe98068, 0x72a49045, 0x98d6d880},
+    {0x85a36366, 0xeb71f041, 0x47a6da2b, 0x7f864750},
+    {0xa70c3c40, 0xa64e6c51, 0x999090b6, 0x5f67d924},
+    {0xd0cf4b50, 0xcfe20765, 0xfff4b4e3, 0xf741cf6d},
+    {0x82818f12, 0x81ed449f, 0xbff8f10e, 0x7a8921a4},
+    {0xa321f2d7, 0x226895c7, 0xaff72d52, 0x192b6a0d},
+    {0xcbea6f8c, 0xeb02bb39, 0x9bf4f8a6, 0x9f764490},
+    {0xfee50b70, 0x25c36a08, 0x02f236d0, 0x4753d5b4},
+    {0x9f4f2726, 0x179a2245, 0x01d76242, 0x2c946590},
+    {0xc722f0ef, 0x9d80aad6, 0x424d3ad2, 0xb7b97ef5},
+    {0xf8ebad2b, 0x84e0d58b, 0xd2e08987, 0x65a7deb2},
+    {0x9b934c3b, 0x330c8577, 0x63cc55f4, 0x9f88eb2f},
+    {0xc2781f49, 0xffcfa6d5, 0x3cbf6b71, 0xc76b25fb},
+    {0xf316271c, 0x7fc3908a, 0x8bef464e, 0x3945ef7a},
+    {0x97edd871, 0xcfda3a56, 0x97758bf0, 0xe3cbb5ac},
+    {0xbde94e8e, 0x43d0c8ec, 0x3d52eeed, 0x1cbea317},
+    {0xed63a231, 0xd4c4fb27, 0x4ca7aaa8, 0x63ee4bdd},
+    {0x945e455f, 0x24fb1cf8, 0x8fe8caa9, 0x3e74ef6a},
+    {0xb975d6b6, 0xee39e436, 0xb3e2fd53, 0x8e122b44},
+    {0xe7d34c64, 0xa9c85d44, 0x60dbbca8, 0x7196b616},
+    {0x90e40fbe, 0xea1d3a4a, 0xbc8955e9, 0x46fe31cd},
+    {0xb51d13ae, 0xa4a488dd, 0x6babab63, 0x98bdbe41},
+    {0xe264589a, 0x4dcdab14, 0xc696963c, 0x7eed2dd1},
+    {0x8d7eb760, 0x70a08aec, 0xfc1e1de5, 0xcf543ca2},
+    {0xb0de6538, 0x8cc8ada8, 0x3b25a55f, 0x43294bcb},
+    {0xdd15fe86, 0xaffad912, 0x49ef0eb7, 0x13f39ebe},
+    {0x8a2dbf14, 0x2dfcc7ab, 0x6e356932, 0x6c784337},
+    {0xacb92ed9, 0x397bf996, 0x49c2c37f, 0x07965404},
+    {0xd7e77a8f, 0x87daf7fb, 0xdc33745e, 0xc97be906},
+    {0x86f0ac99, 0xb4e8dafd, 0x69a028bb, 0x3ded71a3},
+    {0xa8acd7c0, 0x222311bc, 0xc40832ea, 0x0d68ce0c},
+    {0xd2d80db0, 0x2aabd62b, 0xf50a3fa4, 0x90c30190},
+    {0x83c7088e, 0x1aab65db, 0x792667c6, 0xda79e0fa},
+    {0xa4b8cab1, 0xa1563f52, 0x577001b8, 0x91185938},
+    {0xcde6fd5e, 0x09abcf26, 0xed4c0226, 0xb55e6f86},
+    {0x80b05e5a, 0xc60b6178, 0x544f8158, 0x315b05b4},
+    {0xa0dc75f1, 0x778e39d6, 0x696361ae, 0x3db1c721},
+    {0xc913936d, 0xd571c84c, 0x03bc3a19, 0xcd1e38e9},
+    {0xfb587849, 0x4ace3a5f, 0x04ab48a0, 0x4065c723},
+    {0x9d174b2d, 0xcec0e47b, 0x62eb0d64, 0x283f9c76},
+    {0xc45d1df9, 0x42711d9a, 0x3ba5d0bd, 0x324f8394},
+    {0xf5746577, 0x930d6500, 0xca8f44ec, 0x7ee36479},
+    {0x9968bf6a, 0xbbe85f20, 0x7e998b13, 0xcf4e1ecb},
+    {0xbfc2ef45, 0x6ae276e8, 0x9e3fedd8, 0xc321a67e},
+    {0xefb3ab16, 0xc59b14a2, 0xc5cfe94e, 0xf3ea101e},
+    {0x95d04aee, 0x3b80ece5, 0xbba1f1d1, 0x58724a12},
+    {0xbb445da9, 0xca61281f, 0x2a8a6e45, 0xae8edc97},
+    {0xea157514, 0x3cf97226, 0xf52d09d7, 0x1a3293bd},
+    {0x924d692c, 0xa61be758, 0x593c2626, 0x705f9c56},
+    {0xb6e0c377, 0xcfa2e12e, 0x6f8b2fb0, 0x0c77836c},
+    {0xe498f455, 0xc38b997a, 0x0b6dfb9c, 0x0f956447},
+    {0x8edf98b5, 0x9a373fec, 0x4724bd41, 0x89bd5eac},
+    {0xb2977ee3, 0x00c50fe7, 0x58edec91, 0xec2cb657},
+    {0xdf3d5e9b, 0xc0f653e1, 0x2f2967b6, 0x6737e3ed},
+    {0x8b865b21, 0x5899f46c, 0xbd79e0d2, 0x0082ee74},
+    {0xae67f1e9, 0xaec07187, 0xecd85906, 0x80a3aa11},
+    {0xda01ee64, 0x1a708de9, 0xe80e6f48, 0x20cc9495},
+    {0x884134fe, 0x908658b2, 0x3109058d, 0x147fdcdd},
+    {0xaa51823e, 0x34a7eede, 0xbd4b46f0, 0x599fd415},
+    {0xd4e5e2cd, 0xc1d1ea96, 0x6c9e18ac, 0x7007c91a},
+    {0x850fadc0, 0x9923329e, 0x03e2cf6b, 0xc604ddb0},
+    {0xa6539930, 0xbf6bff45, 0x84db8346, 0xb786151c},
+    {0xcfe87f7c, 0xef46ff16, 0xe6126418, 0x65679a63},
+    {0x81f14fae, 0x158c5f6e, 0x4fcb7e8f, 0x3f60c07e},
+    {0xa26da399, 0x9aef7749, 0xe3be5e33, 0x0f38f09d},
+    {0xcb090c80, 0x01ab551c, 0x5cadf5bf, 0xd3072cc5},
+    {0xfdcb4fa0, 0x02162a63, 0x73d9732f, 0xc7c8f7f6},
+    {0x9e9f11c4, 0x014dda7e, 0x2867e7fd, 0xdcdd9afa},
+    {0xc646d635, 0x01a1511d, 0xb281e1fd, 0x541501b8},
+    {0xf7d88bc2, 0x4209a565, 0x1f225a7c, 0xa91a4226},
+    {0x9ae75759, 0x6946075f, 0x3375788d, 0xe9b06958},
+    {0xc1a12d2f, 0xc3978937, 0x0052d6b1, 0x641c83ae},
+    {0xf209787b, 0xb47d6b84, 0xc0678c5d, 0xbd23a49a},
+    {0x9745eb4d, 0x50ce6332, 0xf840b7ba, 0x963646e0},
+    {0xbd176620, 0xa501fbff, 0xb650e5a9, 0x3bc3d898},
+    {0xec5d3fa8, 0xce427aff, 0xa3e51f13, 0x8ab4cebe},
+    {0x93ba47c9, 0x80e98cdf, 0xc66f336c, 0x36b10137},
+    {0xb8a8d9bb, 0xe123f017, 0xb80b0047, 0x445d4184},
+    {0xe6d3102a, 0xd96cec1d, 0xa60dc059, 0x157491e5},
+    {0x9043ea1a, 0xc7e41392, 0x87c89837, 0xad68db2f},
+    {0xb454e4a1, 0x79dd1877, 0x29babe45, 0x98c311fb},
+    {0xe16a1dc9, 0xd8545e94, 0xf4296dd6, 0xfef3d67a},
+    {0x8ce2529e, 0x2734bb1d, 0x1899e4a6, 0x5f58660c},
+    {0xb01ae745, 0xb101e9e4, 0x5ec05dcf, 0xf72e7f8f},
+    {0xdc21a117, 0x1d42645d, 0x76707543, 0xf4fa1f73},
+    {0x899504ae, 0x72497eba, 0x6a06494a, 0x791c53a8},
+    {0xabfa45da, 0x0edbde69, 0x0487db9d, 0x17636892},
+    {0xd6f8d750, 0x9292d603, 0x45a9d284, 0x5d3c42b6},
+    {0x865b8692, 0x5b9bc5c2, 0x0b8a2392, 0xba45a9b2},
+    {0xa7f26836, 0xf282b732, 0x8e6cac77, 0x68d7141e},
+    {0xd1ef0244, 0xaf2364ff, 0x3207d795, 0x430cd926},
+    {0x8335616a, 0xed761f1f, 0x7f44e6bd, 0x49e807b8},
+    {0xa402b9c5, 0xa8d3a6e7, 0x5f16206c, 0x9c6209a6},
+    {0xcd036837, 0x130890a1, 0x36dba887, 0xc37a8c0f},
+    {0x80222122, 0x6be55a64, 0xc2494954, 0xda2c9789},
+    {0xa02aa96b, 0x06deb0fd, 0xf2db9baa, 0x10b7bd6c},
+    {0xc83553c5, 0xc8965d3d, 0x6f928294, 0x94e5acc7},
+    {0xfa42a8b7, 0x3abbf48c, 0xcb772339, 0xba1f17f9},
+    {0x9c69a972, 0x84b578d7, 0xff2a7604, 0x14536efb},
+    {0xc38413cf, 0x25e2d70d, 0xfef51385, 0x19684aba},
+    {0xf46518c2, 0xef5b8cd1, 0x7eb25866, 0x5fc25d69},
+    {0x98bf2f79, 0xd5993802, 0xef2f773f, 0xfbd97a61},
+    {0xbeeefb58, 0x4aff8603, 0xaafb550f, 0xfacfd8fa},
+    {0xeeaaba2e, 0x5dbf6784, 0x95ba2a53, 0xf983cf38},
+    {0x952ab45c, 0xfa97a0b2, 0xdd945a74, 0x7bf26183},
+    {0xba756174, 0x393d88df, 0x94f97111, 0x9aeef9e4},
+    {0xe912b9d1, 0x478ceb17, 0x7a37cd56, 0x01aab85d},
+    {0x91abb422, 0xccb812ee, 0xac62e055, 0xc10ab33a},
+    {0xb616a12b, 0x7fe617aa, 0x577b986b, 0x314d6009},
+    {0xe39c4976, 0x5fdf9d94, 0xed5a7e85, 0xfda0b80b},
+    {0x8e41ade9, 0xfbebc27d, 0x14588f13, 0xbe847307},
+    {0xb1d21964, 0x7ae6b31c, 0x596eb2d8, 0xae258fc8},
+    {0xde469fbd, 0x99a05fe3, 0x6fca5f8e, 0xd9aef3bb},
+    {0x8aec23d6, 0x80043bee, 0x25de7bb9, 0x480d5854},
+    {0xada72ccc, 0x20054ae9, 0xaf561aa7, 0x9a10ae6a},
+    {0xd910f7ff, 0x28069da4, 0x1b2ba151, 0x8094da04},
+    {0x87aa9aff, 0x79042286, 0x90fb44d2, 0xf05d0842},
+    {0xa99541bf, 0x57452b28, 0x353a1607, 0xac744a53},
+    {0xd3fa922f, 0x2d1675f2, 0x42889b89, 0x97915ce8},
+    {0x847c9b5d, 0x7c2e09b7, 0x69956135, 0xfebada11},
+    {0xa59bc234, 0xdb398c25, 0x43fab983, 0x7e699095},
+    {0xcf02b2c2, 0x1207ef2e, 0x94f967e4, 0x5e03f4bb},
+    {0x8161afb9, 0x4b44f57d, 0x1d1be0ee, 0xbac278f5},
+    {0xa1ba1ba7, 0x9e1632dc, 0x6462d92a, 0x69731732},
+    {0xca28a291, 0x859bbf93, 0x7d7b8f75, 0x03cfdcfe},
+    {0xfcb2cb35, 0xe702af78, 0x5cda7352, 0x44c3d43e},
+    {0x9defbf01, 0xb061adab, 0x3a088813, 0x6afa64a7},
+    {0xc56baec2, 0x1c7a1916, 0x088aaa18, 0x45b8fdd0},
+    {0xf6c69a72, 0xa3989f5b, 0x8aad549e, 0x57273d45},
+    {0x9a3c2087, 0xa63f6399, 0x36ac54e2, 0xf678864b},
+    {0xc0cb28a9, 0x8fcf3c7f, 0x84576a1b, 0xb416a7dd},
+    {0xf0fdf2d3, 0xf3c30b9f, 0x656d44a2, 0xa11c51d5},
+    {0x969eb7c4, 0x7859e743, 0x9f644ae5, 0xa4b1b325},
+    {0xbc4665b5, 0x96706114, 0x873d5d9f, 0x0dde1fee},
+    {0xeb57ff22, 0xfc0c7959, 0xa90cb506, 0xd155a7ea},
+    {0x9316ff75, 0xdd87cbd8, 0x09a7f124, 0x42d588f2},
+    {0xb7dcbf53, 0x54e9bece, 0x0c11ed6d, 0x538aeb2f},
+    {0xe5d3ef28, 0x2a242e81, 0x8f1668c8, 0xa86da5fa},
+    {0x8fa47579, 0x1a569d10, 0xf96e017d, 0x694487bc},
+    {0xb38d92d7, 0x60ec4455, 0x37c981dc, 0xc395a9ac},
+    {0xe070f78d, 0x3927556a, 0x85bbe253, 0xf47b1417},
+    {0x8c469ab8, 0x43b89562, 0x93956d74, 0x78ccec8e},
+    {0xaf584166, 0x54a6babb, 0x387ac8d1, 0x970027b2},
+    {0xdb2e51bf, 0xe9d0696a, 0x06997b05, 0xfcc0319e},
+    {0x88fcf317, 0xf22241e2, 0x441fece3, 0xbdf81f03},
+    {0xab3c2fdd, 0xeeaad25a, 0xd527e81c, 0xad7626c3},
+    {0xd60b3bd5, 0x6a5586f1, 0x8a71e223, 0xd8d3b074},
+    {0x85c70565, 0x62757456, 0xf6872d56, 0x67844e49},
+    {0xa738c6be, 0xbb12d16c, 0xb428f8ac, 0x016561db},
+    {0xd106f86e, 0x69d785c7, 0xe13336d7, 0x01beba52},
+    {0x82a45b45, 0x0226b39c, 0xecc00246, 0x61173473},
+    {0xa34d7216, 0x42b06084, 0x27f002d7, 0xf95d0190},
+    {0xcc20ce9b, 0xd35c78a5, 0x31ec038d, 0xf7b441f4},
+    {0xff290242, 0xc83396ce, 0x7e670471, 0x75a15271},
+    {0x9f79a169, 0xbd203e41, 0x0f0062c6, 0xe984d386},
+    {0xc75809c4, 0x2c684dd1, 0x52c07b78, 0xa3e60868},
+    {0xf92e0c35, 0x37826145, 0xa7709a56, 0xccdf8a82},
+    {0x9bbcc7a1, 0x42b17ccb, 0x88a66076, 0x400bb691},
+    {0xc2abf989, 0x935ddbfe, 0x6acff893, 0xd00ea435},
+    {0xf356f7eb, 0xf83552fe, 0x0583f6b8, 0xc4124d43},
+    {0x98165af3, 0x7b2153de, 0xc3727a33, 0x7a8b704a},
+    {0xbe1bf1b0, 0x59e9a8d6, 0x744f18c0, 0x592e4c5c},
+    {0xeda2ee1c, 0x7064130c, 0x1162def0, 0x6f79df73},
+    {0x9485d4d1, 0xc63e8be7, 0x8addcb56, 0x45ac2ba8},
+    {0xb9a74a06, 0x37ce2ee1, 0x6d953e2b, 0xd7173692},
+    {0xe8111c87, 0xc5c1ba99, 0xc8fa8db6, 0xccdd0437},
+    {0x910ab1d4, 0xdb9914a0, 0x1d9c9892, 0x400a22a2},
+    {0xb54d5e4a, 0x127f59c8, 0x2503beb6, 0xd00cab4b},
+    {0xe2a0b5dc, 0x971f303a, 0x2e44ae64, 0x840fd61d},
+    {0x8da471a9, 0xde737e24, 0x5ceaecfe, 0xd289e5d2},
+    {0xb10d8e14, 0x56105dad, 0x7425a83e, 0x872c5f47},
+    {0xdd50f199, 0x6b947518, 0xd12f124e, 0x28f77719},
+    {0x8a5296ff, 0xe33cc92f, 0x82bd6b70, 0xd99aaa6f},
+    {0xace73cbf, 0xdc0bfb7b, 0x636cc64d, 0x1001550b},
+    {0xd8210bef, 0xd30efa5a, 0x3c47f7e0, 0x5401aa4e},
+    {0x8714a775, 0xe3e95c78, 0x65acfaec, 0x34810a71},
+    {0xa8d9d153, 0x5ce3b396, 0x7f1839a7, 0x41a14d0d},
+    {0xd31045a8, 0x341ca07c, 0x1ede4811, 0x1209a050},
+    {0x83ea2b89, 0x2091e44d, 0x934aed0a, 0xab460432},
+    {0xa4e4b66b, 0x68b65d60, 0xf81da84d, 0x5617853f},
+    {0xce1de406, 0x42e3f4b9, 0x36251260, 0xab9d668e},
+    {0x80d2ae83, 0xe9ce78f3, 0xc1d72b7c, 0x6b426019},
+    {0xa1075a24, 0xe4421730, 0xb24cf65b, 0x8612f81f},
+    {0xc94930ae, 0x1d529cfc, 0xdee033f2, 0x6797b627},
+    {0xfb9b7cd9, 0xa4a7443c, 0x169840ef, 0x017da3b1},
+    {0x9d412e08, 0x06e88aa5, 0x8e1f2895, 0x60ee864e},
+    {0xc491798a, 0x08a2ad4e, 0xf1a6f2ba, 0xb92a27e2},
+    {0xf5b5d7ec, 0x8acb58a2, 0xae10af69, 0x6774b1db},
+    {0x9991a6f3, 0xd6bf1765, 0xacca6da1, 0xe0a8ef29},
+    {0xbff610b0, 0xcc6edd3f, 0x17fd090a, 0x58d32af3},
+    {0xeff394dc, 0xff8a948e, 0xddfc4b4c, 0xef07f5b0},
+    {0x95f83d0a, 0x1fb69cd9, 0x4abdaf10, 0x1564f98e},
+    {0xbb764c4c, 0xa7a4440f, 0x9d6d1ad4, 0x1abe37f1},
+    {0xea53df5f, 0xd18d5513, 0x84c86189, 0x216dc5ed},
+    {0x92746b9b, 0xe2f8552c, 0x32fd3cf5, 0xb4e49bb4},
+    {0xb7118682, 0xdbb66a77, 0x3fbc8c33, 0x221dc2a1},
+    {0xe4d5e823, 0x92a40515, 0x0fabaf3f, 0xeaa5334a},
+    {0x8f05b116, 0x3ba6832d, 0x29cb4d87, 0xf2a7400e},
+    {0xb2c71d5b, 0xca9023f8, 0x743e20e9, 0xef511012},
+    {0xdf78e4b2, 0xbd342cf6, 0x914da924, 0x6b255416},
+    {0x8bab8eef, 0xb6409c1a, 0x1ad089b6, 0xc2f7548e},
+    {0xae9672ab, 0xa3d0c320, 0xa184ac24, 0x73b529b1},
+    {0xda3c0f56, 0x8cc4f3e8, 0xc9e5d72d, 0x90a2741e},
+    {0x88658996, 0x17fb1871, 0x7e2fa67c, 0x7a658892},
+    {0xaa7eebfb, 0x9df9de8d, 0xddbb901b, 0x98feeab7},
+    {0xd51ea6fa, 0x85785631, 0x552a7422, 0x7f3ea565},
+    {0x8533285c, 0x936b35de, 0xd53a8895, 0x8f87275f},
+    {0xa67ff273, 0xb8460356, 0x8a892aba, 0xf368f137},
+    {0xd01fef10, 0xa657842c, 0x2d2b7569, 0xb0432d85},
+    {0x8213f56a, 0x67f6b29b, 0x9c3b2962, 0x0e29fc73},
+    {0xa298f2c5, 0x01f45f42, 0x8349f3ba, 0x91b47b8f},
+    {0xcb3f2f76, 0x42717713, 0x241c70a9, 0x36219a73},
+    {0xfe0efb53, 0xd30dd4d7, 0xed238cd3, 0x83aa0110},
+    {0x9ec95d14, 0x63e8a506, 0xf4363804, 0x324a40aa},
+    {0xc67bb459, 0x7ce2ce48, 0xb143c605, 0x3edcd0d5},
+    {0xf81aa16f, 0xdc1b81da, 0xdd94b786, 0x8e94050a},
+    {0x9b10a4e5, 0xe9913128, 0xca7cf2b4, 0x191c8326},
+    {0xc1d4ce1f, 0x63f57d72, 0xfd1c2f61, 0x1f63a3f0},
+    {0xf24a01a7, 0x3cf2dccf, 0xbc633b39, 0x673c8cec},
+    {0x976e4108, 0x8617ca01, 0xd5be0503, 0xe085d813},
+    {0xbd49d14a, 0xa79dbc82, 0x4b2d8644, 0xd8a74e18},
+    {0xec9c459d, 0x51852ba2, 0xddf8e7d6, 0x0ed1219e},
+    {0x93e1ab82, 0x52f33b45, 0xcabb90e5, 0xc942b503},
+    {0xb8da1662, 0xe7b00a17, 0x3d6a751f, 0x3b936243},
+    {0xe7109bfb, 0xa19c0c9d, 0x0cc51267, 0x0a783ad4},
+    {0x906a617d, 0x450187e2, 0x27fb2b80, 0x668b24c5},
+    {0xb484f9dc, 0x9641e9da, 0xb1f9f660, 0x802dedf6},
+    {0xe1a63853, 0xbbd26451, 0x5e7873f8, 0xa0396973},
+    {0x8d07e334, 0x55637eb2, 0xdb0b487b, 0x6423e1e8},
+    {0xb049dc01, 0x6abc5e5f, 0x91ce1a9a, 0x3d2cda62},
+    {0xdc5c5301, 0xc56b75f7, 0x7641a140, 0xcc7810fb},
+    {0x89b9b3e1, 0x1b6329ba, 0xa9e904c8, 0x7fcb0a9d},
+    {0xac2820d9, 0x623bf429, 0x546345fa, 0x9fbdcd44},
+    {0xd732290f, 0xbacaf133, 0xa97c1779, 0x47ad4095},
+    {0x867f59a9, 0xd4bed6c0, 0x49ed8eab, 0xcccc485d},
+    {0xa81f3014, 0x49ee8c70, 0x5c68f256, 0xbfff5a74},
+    {0xd226fc19, 0x5c6a2f8c, 0x73832eec, 0x6fff3111},
+    {0x83585d8f, 0xd9c25db7, 0xc831fd53, 0xc5ff7eab},
+    {0xa42e74f3, 0xd032f525, 0xba3e7ca8, 0xb77f5e55},
+    {0xcd3a1230, 0xc43fb26f, 0x28ce1bd2, 0xe55f35eb},
+    {0x80444b5e, 0x7aa7cf85, 0x7980d163, 0xcf5b81b3},
+    {0xa0555e36, 0x1951c366, 0xd7e105bc, 0xc332621f},
+    {0xc86ab5c3, 0x9fa63440, 0x8dd9472b, 0xf3fefaa7},
+    {0xfa856334, 0x878fc150, 0xb14f98f6, 0xf0feb951},
+    {0x9c935e00, 0xd4b9d8d2, 0x6ed1bf9a, 0x569f33d3},
+    {0xc3b83581, 0x09e84f07, 0x0a862f80, 0xec4700c8},
+    {0xf4a642e1, 0x4c6262c8, 0xcd27bb61, 0x2758c0fa},
+    {0x98e7e9cc, 0xcfbd7dbd, 0x8038d51c, 0xb897789c},
+    {0xbf21e440, 0x03acdd2c, 0xe0470a63, 0xe6bd56c3},
+    {0xeeea5d50, 0x04981478, 0x1858ccfc, 0xe06cac74},
+    {0x95527a52, 0x02df0ccb, 0x0f37801e, 0x0c43ebc8},
+    {0xbaa718e6, 0x8396cffd, 0xd3056025, 0x8f54e6ba},
+    {0xe950df20, 0x247c83fd, 0x47c6b82e, 0xf32a2069},
+    {0x91d28b74, 0x16cdd27e, 0x4cdc331d, 0x57fa5441},
+    {0xb6472e51, 0x1c81471d, 0xe0133fe4, 0xadf8e952},
+    {0xe3d8f9e5, 0x63a198e5, 0x58180fdd, 0xd97723a6},
+    {0x8e679c2f, 0x5e44ff8f, 0x570f09ea, 0xa7ea7648}
+};
+#define POWERS_128_MIN	(-342)	/* Decimal exponent of powersOfTen128[0] */
+#define POWERS_128_MAX	308	/* Decimal exponent of the last entry */
+
 /*
  * Static functions defined in this file.
  */
@@ -310,14 +1095,33 @@ static int		AccumulateDecimalDigit(unsigned, int,
 			    Tcl_WideUInt *, mp_int *, int);
 static double		MakeHighPrecisionDouble(int signum,
 			    mp_int *significand, int nSigDigs, int exponent);
+static unsigned long	ParseEightDigits(Tcl_WideUInt v);
+static const char *	AccumulateDigits(const char *p, const char *end,
+			    Tcl_WideUInt *significandPtr, int *numSigDigsPtr);
+static int		ParseDecimalFast(Tcl_Obj *objPtr, const char *bytes,
+			    const char *end, const char **endPtrPtr,
+			    int flags);
 static double		MakeLowPrecisionDouble(int signum,
 			    Tcl_WideUInt significand, int nSigDigs,
 			    int exponent);
 #ifdef IEEE_FLOATING_POINT
+static int		EiselLemire(Tcl_WideUInt significand, int exponent,
+			    double *resultPtr);
+static void		Multiply128(Tcl_WideUInt a, Tcl_WideUInt b,
+			    Tcl_WideUInt *hiPtr, Tcl_WideUInt *loPtr);
 static double		MakeNaN(int signum, Tcl_WideUInt tag);
 #endif
 static double		RefineApproximation(double approx,
 			    mp_int *exactSignificand, int exponent);
+static char *		ShorteningGrisuConversion(Double *dPtr, int *decpt,
+			    char **endPtr);
+static DiyFp		MultiplyDiyFp(DiyFp a, DiyFp b);
+static int		GrisuDigitGen(DiyFp low, DiyFp w, DiyFp high,
+			    char *buffer, int *lengthPtr, int *kappaPtr);
+static int		GrisuRoundWeed(char *buffer, int length,
+			    Tcl_WideUInt distanceTooHighW,
+			    Tcl_WideUInt unsafeInterval, Tcl_WideUInt rest,
+			    Tcl_WideUInt tenKappa, Tcl_WideUInt unit);
 static void		MulPow5(mp_int *, unsigned, mp_int *);
 static int 		NormalizeRightward(Tcl_WideUInt *);
 static int		RequiredPrecision(Tcl_WideUInt);
@@ -458,6 +1262,11 @@ static Tcl_WideUInt	Nokia770Twiddle(Tcl_WideUInt w);
  *		character following the parsed numeric string is written to
  *		*endPtrPtr.
  *
+ *	Plain decimal integers that fit in a wide integer and decimal
+ *	floating point values with at most 19 significant digits are handled
+ *	by a fast path; everything else, including all error cases, goes
+ *	through the full state machine.
+ *
  *	In some cases where the string being scanned is the string rep of
  *	objPtr, this routine can leave objPtr in an inconsistent state where
  *	its string rep and its internal rep do not agree. In these cases the
@@ -559,6 +1368,28 @@ TclParseNumber(
 	bytes = TclGetString(objPtr);
     }
 
+    /*
+     * Most numbers are plain decimal integers or simple decimal floating
+     * point values. Try those first without running the state machine,
+     * provided that the end of the string is known so that digits can be
+     * examined a word at a time.
+     */
+
+    if (!(flags & (TCL_PARSE_OCTAL_ONLY | TCL_PARSE_HEXADECIMAL_ONLY
+	    | TCL_PARSE_BINARY_ONLY))) {
+	if (numBytes >= 0) {
+	    if (ParseDecimalFast(objPtr, bytes, bytes + numBytes, endPtrPtr,
+		    flags)) {
+		return TCL_OK;
+	    }
+	} else if (objPtr != NULL && bytes == objPtr->bytes) {
+	    if (ParseDecimalFast(objPtr, bytes, bytes + objPtr->length,
+		    endPtrPtr, flags)) {
+		return TCL_OK;
+	    }
+	}
+    }
+
     p = bytes;
     len = numBytes;
     acceptPoint = p;
@@ -1413,6 +2244,286 @@ TclParseNumber(
     }
     return status;
 }
+
+/*
+ * Helpers to handle eight digits packed into a Tcl_WideUInt, the first
+ * digit in the least significant byte. EIGHT_BYTES(b) repeats the byte b
+ * in every byte of a word.
+ */
+
+#define EIGHT_BYTES(b)	((~(Tcl_WideUInt) 0 / 0xff) * (b))
+#define LOAD_EIGHT_BYTES(p) \
+    ((Tcl_WideUInt) UCHAR((p)[0]) | (Tcl_WideUInt) UCHAR((p)[1]) << 8 \
+    | (Tcl_WideUInt) UCHAR((p)[2]) << 16 | (Tcl_WideUInt) UCHAR((p)[3]) << 24 \
+    | (Tcl_WideUInt) UCHAR((p)[4]) << 32 | (Tcl_WideUInt) UCHAR((p)[5]) << 40 \
+    | (Tcl_WideUInt) UCHAR((p)[6]) << 48 | (Tcl_WideUInt) UCHAR((p)[7]) << 56)
+#define IS_EIGHT_DIGITS(v) \
+    (((((v) + EIGHT_BYTES(0x46)) | ((v) - EIGHT_BYTES(0x30))) \
+	    & EIGHT_BYTES(0x80)) == 0)
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParseEightDigits --
+ *
+ *	Converts eight ASCII digits, already checked with IS_EIGHT_DIGITS,
+ *	to their value.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static unsigned long
+ParseEightDigits(
+    Tcl_WideUInt v)		/* Eight ASCII digits, first digit in the
+				 * low-order byte. */
+{
+    Tcl_WideUInt mask = ((Tcl_WideUInt) 0xff << 32) | 0xff;
+
+    /*
+     * Combine adjacent digits into pairs, then pairs into groups of four,
+     * and finally the two groups into the result.
+     */
+
+    v -= EIGHT_BYTES('0');
+    v = (v * 10) + (v >> 8);
+    v = ((v & mask) * (((Tcl_WideUInt) 1000000 << 32) + 100)
+	    + ((v >> 16) & mask) * (((Tcl_WideUInt) 10000 << 32) + 1)) >> 32;
+    return (unsigned long) v;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AccumulateDigits --
+ *
+ *	Appends a run of decimal digits to a significand, eight at a time
+ *	while at least eight bytes are left.
+ *
+ * Results:
+ *	Returns a pointer to the first character that is not a digit, or
+ *	NULL if the significand would exceed 19 digits.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const char *
+AccumulateDigits(
+    const char *p,		/* First character to scan. */
+    const char *end,		/* End of the string. */
+    Tcl_WideUInt *significandPtr,
+				/* Significand to add the digits to. */
+    int *numSigDigsPtr)		/* Count of digits in the significand. */
+{
+    Tcl_WideUInt significand = *significandPtr;
+    int numSigDigs = *numSigDigsPtr;
+    Tcl_WideUInt v;
+
+    while (end - p >= 8 && numSigDigs <= 11) {
+	v = LOAD_EIGHT_BYTES(p);
+	if (!IS_EIGHT_DIGITS(v)) {
+	    break;
+	}
+	significand = significand * 100000000 + ParseEightDigits(v);
+	numSigDigs += 8;
+	p += 8;
+    }
+    while (p < end && isdigit(UCHAR(*p))) {
+	if (++numSigDigs > 19) {
+	    return NULL;
+	}
+	significand = significand * 10 + (*p++ - '0');
+    }
+    *significandPtr = significand;
+    *numSigDigsPtr = numSigDigs;
+    return p;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ParseDecimalFast --
+ *
+ *	Fast path of TclParseNumber for the common forms of numbers: an
+ *	optional sign, decimal digits, and for floating point values an
+ *	optional fraction and exponent, with at most 19 significant digits in
+ *	all. Runs of eight digits are validated and converted a word at a
+ *	time.
+ *
+ * Results:
+ *	Returns 1 if the string was recognized, with the same effects that
+ *	TclParseNumber has when it returns TCL_OK. Returns 0 without any side
+ *	effect if the string needs the full parser: other bases, numbers that
+ *	do not fit in a wide integer, too many digits, Inf and NaN, strings
+ *	with a leading zero that could be octal, and anything malformed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ParseDecimalFast(
+    Tcl_Obj *objPtr,		/* Object to receive the internal rep, or
+				 * NULL. */
+    const char *bytes,		/* Start of the string to scan. */
+    const char *end,		/* End of the string to scan. */
+    const char **endPtrPtr,	/* Place to store pointer to the character
+				 * that terminated the scan, or NULL. */
+    int flags)			/* Flags governing the parse. */
+{
+    const char *p = bytes;
+    const char *start;
+    int signum = 0;		/* 1 if the number is negative. */
+    Tcl_WideUInt significand = 0;
+    int numSigDigs = 0;		/* Digits in significand after the leading
+				 * zeroes. */
+    int numDigits;		/* Digits scanned, including leading zeroes. */
+    int numDigitsAfterDp = 0;
+    int isFloat = 0;
+    long exponent = 0;
+
+    if (!(flags & TCL_PARSE_NO_WHITESPACE)) {
+	while (p < end && isspace(UCHAR(*p))) {
+	    p++;
+	}
+    }
+    if (p < end && (*p == '+' || *p == '-')) {
+	signum = (*p == '-');
+	p++;
+    }
+
+    /*
+     * A leading zero may start an octal, hexadecimal or binary number
+     * unless only decimal is wanted. A lone zero is still fine.
+     */
+
+    start = p;
+    if (p < end && *p == '0') {
+	if (!(flags & TCL_PARSE_DECIMAL_ONLY)) {
+	    if (flags & TCL_PARSE_SCAN_PREFIXES) {
+		return 0;
+	    }
+	    if (p + 1 < end && isalnum(UCHAR(p[1]))
+		    && p[1] != 'e' && p[1] != 'E') {
+		return 0;
+	    }
+	}
+	while (p < end && *p == '0') {
+	    p++;
+	}
+    }
+    p = AccumulateDigits(p, end, &significand, &numSigDigs);
+    if (p == NULL) {
+	return 0;
+    }
+    numDigits = p - start;
+
+    if (!(flags & TCL_PARSE_INTEGER_ONLY)) {
+	if (p < end && *p == '.') {
+	    start = ++p;
+	    if (significand == 0) {
+		while (p < end && *p == '0') {
+		    p++;
+		}
+	    }
+	    p = AccumulateDigits(p, end, &significand, &numSigDigs);
+	    if (p == NULL) {
+		return 0;
+	    }
+	    numDigitsAfterDp = p - start;
+	    numDigits += numDigitsAfterDp;
+	    isFloat = 1;
+	}
+	if (numDigits > 0 && p < end && (*p == 'e' || *p == 'E')) {
+	    int exponentSignum = 0;
+
+	    p++;
+	    if (p < end && (*p == '+' || *p == '-')) {
+		exponentSignum = (*p == '-');
+		p++;
+	    }
+	    if (p == end || !isdigit(UCHAR(*p))) {
+		return 0;
+	    }
+	    while (p < end && isdigit(UCHAR(*p))) {
+		exponent = 10 * exponent + (*p++ - '0');
+		if (exponent > 99999) {
+		    return 0;
+		}
+	    }
+	    if (exponentSignum) {
+		exponent = -exponent;
+	    }
+	    isFloat = 1;
+	}
+    }
+    if (numDigits == 0) {
+	return 0;
+    }
+
+    if (!(flags & TCL_PARSE_NO_WHITESPACE)) {
+	while (p < end && isspace(UCHAR(*p))) {
+	    p++;
+	}
+    }
+    if (endPtrPtr == NULL) {
+	if (p != end) {
+	    return 0;
+	}
+    } else if (p < end && (isalnum(UCHAR(*p)) || *p == '.')) {
+	/*
+	 * Let the full parser decide where a number such as 1e or 12.5.6
+	 * ends.
+	 */
+
+	return 0;
+    }
+
+    if (!isFloat && significand > MOST_BITS + signum) {
+	return 0;
+    }
+#ifdef NO_WIDE_TYPE
+    if (!isFloat && significand >
+	    (Tcl_WideUInt)(((~(unsigned long)0) >> 1) + signum)) {
+	return 0;
+    }
+#endif
+
+    if (endPtrPtr != NULL) {
+	*endPtrPtr = p;
+    }
+    if (objPtr == NULL) {
+	return 1;
+    }
+
+    TclFreeIntRep(objPtr);
+    if (isFloat) {
+	double d = 0.0;
+
+	if (significand != 0) {
+	    d = MakeLowPrecisionDouble(0, significand, numSigDigs,
+		    (int) (exponent - numDigitsAfterDp));
+	}
+	objPtr->typePtr = &tclDoubleType;
+	objPtr->internalRep.doubleValue = (signum ? -d : d);
+#ifndef NO_WIDE_TYPE
+    } else if (significand >
+	    (Tcl_WideUInt)(((~(unsigned long)0) >> 1) + signum)) {
+	objPtr->typePtr = &tclWideIntType;
+	if (signum) {
+	    objPtr->internalRep.wideValue = - (Tcl_WideInt) significand;
+	} else {
+	    objPtr->internalRep.wideValue = (Tcl_WideInt) significand;
+	}
+#endif
+    } else {
+	objPtr->typePtr = &tclIntType;
+	if (signum) {
+	    objPtr->internalRep.longValue = - (long) significand;
+	} else {
+	    objPtr->internalRep.longValue = (long) significand;
+	}
+    }
+    return 1;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -1604,6 +2715,18 @@ MakeLowPrecisionDouble(
 	}
     }
 
+#ifdef IEEE_FLOATING_POINT
+    /*
+     * Next try the Eisel-Lemire algorithm, which gets the correctly rounded
+     * result from a 128-bit approximation of the power of ten for nearly
+     * all numbers, and detects the few where that is not enough.
+     */
+
+    if (significand != 0 && EiselLemire(significand, exponent, &retval)) {
+	goto returnValue;
+    }
+#endif
+
     /*
      * All the easy cases have failed. Promote ths significand to bignum and
      * call MakeHighPrecisionDouble to do it the hard way.
@@ -1632,6 +2755,146 @@ MakeLowPrecisionDouble(
     return retval;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * EiselLemire --
+ *
+ *	Computes the double closest to significand * 10**exponent with the
+ *	algorithm of Michael Eisel and Daniel Lemire ("Number Parsing at a
+ *	Gigabyte per Second", 2021): the significand is multiplied by a
+ *	truncated 128-bit approximation of the power of ten, and the result
+ *	is correctly rounded unless the bits dropped by the approximation
+ *	could change it.
+ *
+ * Results:
+ *	Returns 1 and stores the value in *resultPtr on success. Returns 0 if
+ *	the exponent is out of the range of the table, if the result would
+ *	be subnormal, infinite or a halfway case, or if the approximation is
+ *	too coarse; the caller must then use exact arithmetic.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#ifdef IEEE_FLOATING_POINT
+static int
+EiselLemire(
+    Tcl_WideUInt significand,	/* Significand of the number, nonzero. */
+    int exponent,		/* Power of ten. */
+    double *resultPtr)		/* Place to store the result. */
+{
+    const TruncatedPower *powerPtr;
+    Tcl_WideUInt powHi, powLo;	/* Approximation of 10**exponent. */
+    Tcl_WideUInt xHi, xLo, yHi, yLo, mantissa;
+    long exp2;			/* Biased binary exponent of the result. */
+    int shift, msb;
+    Double d;
+
+    if (exponent < POWERS_128_MIN || exponent > POWERS_128_MAX) {
+	return 0;
+    }
+    powerPtr = powersOfTen128 + (exponent - POWERS_128_MIN);
+    powHi = ((Tcl_WideUInt) powerPtr->w3 << 32) | powerPtr->w2;
+    powLo = ((Tcl_WideUInt) powerPtr->w1 << 32) | powerPtr->w0;
+
+    /*
+     * Normalize the significand. floor(exponent * log2(10)) is computed
+     * as (exponent * 217706) / 2**16, rounding towards minus infinity.
+     */
+
+    shift = 64 - RequiredPrecision(significand);
+    significand <<= shift;
+    if (exponent >= 0) {
+	exp2 = (217706L * exponent) >> 16;
+    } else {
+	exp2 = -((-217706L * exponent + 0xffff) >> 16);
+    }
+    exp2 += 64 + EXPONENT_BIAS - shift;
+
+    /*
+     * Multiply by the high half of the power of ten. The low half matters
+     * only when the bits below the 54 that are kept are all ones and a
+     * carry out of them is possible.
+     */
+
+    Multiply128(significand, powHi, &xHi, &xLo);
+    if ((xHi & 0x1ff) == 0x1ff && xLo + significand < xLo) {
+	Tcl_WideUInt mergedLo;
+
+	Multiply128(significand, powLo, &yHi, &yLo);
+	mergedLo = xLo + yHi;
+	if (mergedLo < xLo) {
+	    xHi++;
+	}
+	if ((xHi & 0x1ff) == 0x1ff && mergedLo == ALL_BITS
+		&& yLo + significand < yLo) {
+	    return 0;
+	}
+	xLo = mergedLo;
+    }
+
+    /*
+     * Keep 54 bits, then round to 53 with ties to even. A product that is
+     * exactly halfway cannot be told from one slightly above it.
+     */
+
+    msb = (int) (xHi >> 63);
+    mantissa = xHi >> (msb + 9);
+    exp2 -= 1 ^ msb;
+    if (xLo == 0 && (xHi & 0x1ff) == 0 && (mantissa & 3) == 1) {
+	return 0;
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >> FP_PRECISION) {
+	mantissa >>= 1;
+	exp2++;
+    }
+    if (exp2 <= 0 || exp2 >= 0x7ff) {
+	return 0;
+    }
+
+    d.q = ((Tcl_WideUInt) exp2 << (EXP_SHIFT + 32)) | (mantissa & SIG_MASK);
+    if (n770_fp) {
+	d.q = Nokia770Twiddle(d.q);
+    }
+    *resultPtr = d.d;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Multiply128 --
+ *
+ *	Computes the full 128-bit product of two 64-bit numbers.
+ *
+ * Results:
+ *	Stores the high and low halves of the product.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+Multiply128(
+    Tcl_WideUInt a,		/* First factor. */
+    Tcl_WideUInt b,		/* Second factor. */
+    Tcl_WideUInt *hiPtr,	/* Place to store the high half. */
+    Tcl_WideUInt *loPtr)	/* Place to store the low half. */
+{
+    Tcl_WideUInt aHi = a >> 32, aLo = a & 0xffffffff;
+    Tcl_WideUInt bHi = b >> 32, bLo = b & 0xffffffff;
+    Tcl_WideUInt ll = aLo * bLo;
+    Tcl_WideUInt lh = aLo * bHi;
+    Tcl_WideUInt hl = aHi * bLo;
+    Tcl_WideUInt mid;
+
+    mid = (ll >> 32) + (lh & 0xffffffff) + (hl & 0xffffffff);
+    *hiPtr = aHi * bHi + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    *loPtr = (mid << 32) | (ll & 0xffffffff);
+}
+#endif
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1927,7 +3190,17 @@ RefineApproximation(
     quot = SafeLdExp(num/den, scale);
     minincr = SafeLdExp(1.0, binExponent-mantBits);
 
-    if (quot<0. && quot>-minincr) {
+    if (mp_cmp_mag(&twoMd, &twoMv) == MP_EQ) {
+	/*
+	 * The decimal number is exactly halfway between two doubles. The
+	 * correction is exactly half a unit in the last place, and adding it
+	 * rounds to even. Dividing the converted numerator and denominator
+	 * need not give exactly that when they have more bits than a double,
+	 * so use the power of two itself.
+	 */
+
+	quot = SafeLdExp((twoMd.sign == MP_NEG) ? -1.0 : 1.0, scale);
+    } else if (quot<0. && quot>-minincr) {
 	quot = -minincr;
     } else if (quot>0. && quot<minincr) {
 	quot = minincr;
@@ -2801,6 +4074,333 @@ QuickConversion(
     return retval;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MultiplyDiyFp --
+ *
+ *	Multiplies two "do-it-yourself floating point" numbers, keeping the
+ *	high-order 64 bits of the product rounded to nearest.
+ *
+ * Results:
+ *	Returns the product, whose error is at most 1/2 ulp.
+ *
+ *----------------------------------------------------------------------
+ */
+
+inline static DiyFp
+MultiplyDiyFp(
+    DiyFp a,			/* First factor. */
+    DiyFp b)			/* Second factor. */
+{
+    Tcl_WideUInt aHi = a.f >> 32, aLo = a.f & 0xffffffff;
+    Tcl_WideUInt bHi = b.f >> 32, bLo = b.f & 0xffffffff;
+    Tcl_WideUInt hh = aHi * bHi;
+    Tcl_WideUInt lh = aLo * bHi;
+    Tcl_WideUInt hl = aHi * bLo;
+    Tcl_WideUInt ll = aLo * bLo;
+    Tcl_WideUInt mid;
+    DiyFp result;
+
+    mid = (ll >> 32) + (hl & 0xffffffff) + (lh & 0xffffffff);
+    mid += ((Tcl_WideUInt) 1) << 31;	/* Round to nearest. */
+    result.f = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+    result.e = a.e + b.e + 64;
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GrisuRoundWeed --
+ *
+ *	Final step of Grisu3: moves the last digit of the generated string
+ *	down towards the exact value as long as that stays within the
+ *	rounding interval, and checks that the result is certainly the
+ *	closest shortest string despite the imprecision of the scaled
+ *	numbers.
+ *
+ * Results:
+ *	Returns 1 if the digit string is correct, or 0 if the exact algorithm
+ *	must be used instead.
+ *
+ * Side effects:
+ *	May decrement the last digit in 'buffer'.
+ *
+ *----------------------------------------------------------------------
+ */
+
+inline static int
+GrisuRoundWeed(
+    char *buffer,		/* Digits generated so far. */
+    int length,			/* Number of digits in 'buffer'. */
+    Tcl_WideUInt distanceTooHighW,
+				/* Distance from the scaled number to the
+				 * (widened) upper bound of its interval. */
+    Tcl_WideUInt unsafeInterval,/* Width of the widened interval. */
+    Tcl_WideUInt rest,		/* Distance from the digit string to the
+				 * widened upper bound. */
+    Tcl_WideUInt tenKappa,	/* Weight of the last digit. */
+    Tcl_WideUInt unit)		/* Imprecision of the scaled numbers. */
+{
+    Tcl_WideUInt smallDistance = distanceTooHighW - unit;
+    Tcl_WideUInt bigDistance = distanceTooHighW + unit;
+
+    /*
+     * Move the digit string down while that brings it closer to the scaled
+     * number, even if the scaled number is off by 'unit' to the high side.
+     */
+
+    while (rest < smallDistance && unsafeInterval - rest >= tenKappa
+	    && (rest + tenKappa < smallDistance
+	    || smallDistance - rest >= rest + tenKappa - smallDistance)) {
+	buffer[length - 1]--;
+	rest += tenKappa;
+    }
+
+    /*
+     * If moving it once more could still bring it closer when the scaled
+     * number is off by 'unit' to the low side, we cannot decide.
+     */
+
+    if (rest < bigDistance && unsafeInterval - rest >= tenKappa
+	    && (rest + tenKappa < bigDistance
+	    || bigDistance - rest > rest + tenKappa - bigDistance)) {
+	return 0;
+    }
+
+    /*
+     * The digit string must also be safely inside the real interval, not
+     * just the widened one.
+     */
+
+    return (2 * unit <= rest) && (rest <= unsafeInterval - 4 * unit);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GrisuDigitGen --
+ *
+ *	Generates the shortest digit string that lies within the interval
+ *	(low, high) around the scaled number 'w'. The three numbers share
+ *	the binary exponent, which must be in the range [-60, -32].
+ *
+ * Results:
+ *	Returns 1 if the digit string is correct, or 0 if the exact algorithm
+ *	must be used instead.
+ *
+ * Side effects:
+ *	Stores the digits (without a terminating null) in 'buffer', their
+ *	number in '*lengthPtr', and the power of ten that the last digit is
+ *	weighted by, relative to the scaling, in '*kappaPtr'.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+GrisuDigitGen(
+    DiyFp low,			/* Scaled lower bound of the interval. */
+    DiyFp w,			/* Scaled number to convert. */
+    DiyFp high,			/* Scaled upper bound of the interval. */
+    char *buffer,		/* OUTPUT: Digits; room for at least 18. */
+    int *lengthPtr,		/* OUTPUT: Number of digits. */
+    int *kappaPtr)		/* OUTPUT: Decimal exponent of the last
+				 * digit. */
+{
+    Tcl_WideUInt unit = 1;	/* Imprecision of the scaled numbers. */
+    Tcl_WideUInt tooLow = low.f - unit;
+    Tcl_WideUInt tooHigh = high.f + unit;
+    Tcl_WideUInt unsafeInterval = tooHigh - tooLow;
+    int shift = -w.e;
+    Tcl_WideUInt one = ((Tcl_WideUInt) 1) << shift;
+    unsigned int integrals = (unsigned int) (tooHigh >> shift);
+    Tcl_WideUInt fractionals = tooHigh & (one - 1);
+    unsigned int divisor;
+    int kappa, length = 0;
+
+    /*
+     * Find the number of digits in the integral part, and the weight of the
+     * first one. The integral part fits in 32 bits because 'shift' is at
+     * least 32.
+     */
+
+    kappa = 0;
+    divisor = 1;
+    if (integrals != 0) {
+	kappa = 1;
+	while (integrals / divisor >= 10) {
+	    divisor *= 10;
+	    kappa++;
+	}
+    }
+
+    /*
+     * Generate the digits of the integral part, stopping as soon as the
+     * remainder is within the interval.
+     */
+
+    while (kappa > 0) {
+	Tcl_WideUInt rest;
+
+	buffer[length++] = (char) ('0' + integrals / divisor);
+	integrals %= divisor;
+	kappa--;
+	rest = (((Tcl_WideUInt) integrals) << shift) + fractionals;
+	if (rest < unsafeInterval) {
+	    *lengthPtr = length;
+	    *kappaPtr = kappa;
+	    return GrisuRoundWeed(buffer, length, tooHigh - w.f,
+		    unsafeInterval, rest, ((Tcl_WideUInt) divisor) << shift,
+		    unit);
+	}
+	divisor /= 10;
+    }
+
+    /*
+     * Generate the digits of the fractional part. The imprecision grows
+     * with each digit, so the loop always ends before it overwhelms the
+     * number.
+     */
+
+    for (;;) {
+	fractionals *= 10;
+	unit *= 10;
+	unsafeInterval *= 10;
+	buffer[length++] = (char) ('0' + (int) (fractionals >> shift));
+	fractionals &= one - 1;
+	kappa--;
+	if (fractionals < unsafeInterval) {
+	    *lengthPtr = length;
+	    *kappaPtr = kappa;
+	    return GrisuRoundWeed(buffer, length, (tooHigh - w.f) * unit,
+		    unsafeInterval, fractionals, one, unit);
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShorteningGrisuConversion --
+ *
+ *	Converts a positive, finite, nonzero double to the shortest string of
+ *	digits that reconverts to it, using the Grisu3 algorithm of Florian
+ *	Loitsch ("Printing Floating-Point Numbers Quickly and Accurately with
+ *	Integers", PLDI 2010). Grisu3 works entirely in 64-bit integer
+ *	arithmetic and detects the few inputs (about 0.5%) for which that is
+ *	not precise enough to be sure of the result; in that case, or when a
+ *	digit string lies on the boundary of the rounding interval (where the
+ *	exact code applies round-half-even), it gives up so that the caller
+ *	falls back on the exact methods. When it succeeds, its result is the
+ *	same as theirs: the shortest string in the interval, and of those the
+ *	closest to the input.
+ *
+ * Results:
+ *	Returns a newly-allocated digit string, or NULL if the exact
+ *	conversion must be used.
+ *
+ * Side effects:
+ *	Sets *decpt and *endPtr as TclDoubleDigits does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static char *
+ShorteningGrisuConversion(
+    Double *dPtr,		/* Number to convert; must be positive,
+				 * finite and nonzero. */
+    int *decpt,			/* OUTPUT: Position of the decimal point. */
+    char **endPtr)		/* OUTPUT: If not NULL, receives a pointer to
+				 *	   the terminal null byte. */
+{
+    int de = (int) ((dPtr->q >> 52) & 0x7ff);
+    Tcl_WideUInt sig = dPtr->q & SIG_MASK;
+    DiyFp w, mPlus, mMinus, cached;
+    int minExp, k, index, length, kappa, mk;
+    const CachedPower *powerPtr;
+    char buffer[20];
+    char *retval;
+
+    /*
+     * Unpack the number as w = sig * 2**e.
+     */
+
+    if (de != 0) {
+	w.f = sig | HIDDEN_BIT;
+	w.e = de - EXPONENT_BIAS - (FP_PRECISION-1);
+    } else {
+	w.f = sig;
+	w.e = 1 - EXPONENT_BIAS - (FP_PRECISION-1);
+    }
+
+    /*
+     * The rounding interval is bounded by the midpoints to the neighbouring
+     * doubles; the lower neighbour is closer when w is a power of 2 (other
+     * than the smallest normal number). Normalize the upper bound and
+     * express the lower one and w with the same exponent.
+     */
+
+    mPlus.f = (w.f << 1) + 1;
+    mPlus.e = w.e - 1;
+    while (!(mPlus.f & (HIDDEN_BIT << 1))) {
+	mPlus.f <<= 1;
+	mPlus.e--;
+    }
+    mPlus.f <<= 64 - FP_PRECISION - 1;
+    mPlus.e -= 64 - FP_PRECISION - 1;
+    if (sig == 0 && de > 1) {
+	mMinus.f = (w.f << 2) - 1;
+	mMinus.e = w.e - 2;
+    } else {
+	mMinus.f = (w.f << 1) - 1;
+	mMinus.e = w.e - 1;
+    }
+    mMinus.f <<= mMinus.e - mPlus.e;
+    mMinus.e = mPlus.e;
+    w.f <<= (w.e - mPlus.e);
+    w.e = mPlus.e;
+
+    /*
+     * Choose the cached power of ten 10**mk that brings the binary exponent
+     * of the scaled numbers into [-60, -32], and scale them.
+     */
+
+    minExp = -60 - (w.e + 64);
+    k = (int) ceil((minExp + 63) * LOG10_2);
+    index = (CACHED_POWERS_OFFSET + k - 1) / CACHED_POWERS_STEP + 1;
+    powerPtr = cachedPowers + index;
+    cached.f = ((Tcl_WideUInt) powerPtr->fHi << 32) | powerPtr->fLo;
+    cached.e = powerPtr->binExp;
+    mk = powerPtr->decExp;
+
+    w = MultiplyDiyFp(w, cached);
+    mPlus = MultiplyDiyFp(mPlus, cached);
+    mMinus = MultiplyDiyFp(mMinus, cached);
+
+    if (!GrisuDigitGen(mMinus, w, mPlus, buffer, &length, &kappa)) {
+	return NULL;
+    }
+
+    /*
+     * The digits are worth buffer * 10**(kappa - mk). Drop any trailing
+     * zeroes, as the exact methods do.
+     */
+
+    while (length > 1 && buffer[length-1] == '0') {
+	length--;
+	kappa++;
+    }
+    *decpt = length + kappa - mk - 1;
+    retval = ckalloc(length + 1);
+    memcpy(retval, buffer, (size_t) length);
+    retval[length] = '\0';
+    if (endPtr != NULL) {
+	*endPtr = retval + length;
+    }
+    return retval;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2927,7 +4527,7 @@ ShorteningInt64Conversion(
 	 * but within within roundoff of being exact?
 	 */
 
-	if (b < mplus || (b == mplus
+	if (b < mminus || (b == mminus
 		&& convType != TCL_DD_STEELE0 && (dPtr->w.word1 & 1) == 0)) {
 	    /*
 	     * Make sure we shouldn't be rounding *up* instead, in case the
@@ -2953,10 +4553,10 @@ ShorteningInt64Conversion(
 
 	/*
 	 * Does one plus the current digit put us within roundoff of the
-	 * number?
+	 * number? It is S-b above it, which cannot underflow.
 	 */
 
-	if (b > S - mminus || (b == S - mminus
+	if (mplus > S - b || (mplus == S - b
 		&& convType != TCL_DD_STEELE0 && (dPtr->w.word1 & 1) == 0)) {
 	    if (digit == 9) {
 		*s++ = '9';
@@ -3321,7 +4921,7 @@ ShorteningBignumConversionPowD(
 	 * but within within roundoff of being exact?
 	 */
 
-	r1 = mp_cmp_mag(&b, (m2plus > m2minus)? &mplus : &mminus);
+	r1 = mp_cmp_mag(&b, &mminus);
 	if (r1 == MP_LT || (r1 == MP_EQ
 		&& convType != TCL_DD_STEELE0 && (dPtr->w.word1 & 1) == 0)) {
 	    /*
@@ -3351,7 +4951,8 @@ ShorteningBignumConversionPowD(
 	 * number?
 	 */
 
-	if (ShouldBankerRoundUpToNextPowD(&b, &mminus, sd, convType,
+	if (ShouldBankerRoundUpToNextPowD(&b,
+		(m2plus > m2minus)? &mplus : &mminus, sd, convType,
 		dPtr->w.word1 & 1, &temp)) {
 	    if (digit == 9) {
 		*s++ = '9';
@@ -3711,7 +5312,7 @@ ShorteningBignumConversion(
 	 * round to it?
 	 */
 
-	r1 = mp_cmp_mag(&b, (m2plus > m2minus)? &mplus : &mminus);
+	r1 = mp_cmp_mag(&b, &mminus);
 	if (r1 == MP_LT || (r1 == MP_EQ
 		&& convType != TCL_DD_STEELE0 && (dPtr->w.word1 & 1) == 0)) {
 	    mp_mul_2d(&b, 1, &b);
@@ -3732,7 +5333,8 @@ ShorteningBignumConversion(
 	 * commit to rounding up to the next higher digit?
 	 */
 
-	if (ShouldBankerRoundUpToNext(&b, &mminus, &S, convType,
+	if (ShouldBankerRoundUpToNext(&b,
+		(m2plus > m2minus)? &mplus : &mminus, &S, convType,
 		dPtr->w.word1 & 1, &temp)) {
 	    ++digit;
 	    if (digit == 10) {
@@ -4059,6 +5661,9 @@ StrictBignumConversion(
  *	only if the input number is close enough to the midpoint between two
  *	decimal strings that more precision is needed to resolve which string
  *	is correct.
+ *	Likewise, TCL_DD_SHORTEST is normally done with the Grisu3 algorithm in
+ *	64-bit integer arithmetic, falling back on exact arithmetic only for
+ *	the rare numbers where Grisu3 cannot be sure of its result.
  *
  * The value stored in the 'decpt' argument on return may be negative
  * (indicating that the decimal point falls to the left of the string) or
@@ -4120,6 +5725,20 @@ TclDoubleDigits(
 	return FormatZero(decpt, endPtr);
     }
 
+    /*
+     * The shortest conversion is nearly always done exactly by Grisu3 in
+     * 64-bit integer arithmetic; it only fails for the few numbers that need
+     * more precision.
+     */
+
+    if (convType == TCL_DD_SHORTEST0 && (flags & TCL_DD_SHORTEN_FLAG)
+	    && !(flags & TCL_DD_NO_QUICK)) {
+	retval = ShorteningGrisuConversion(&d, decpt, endPtr);
+	if (retval != NULL) {
+	    return retval;
+	}
+    }
+
     /*
      * Unpack the floating point into a wide integer and an exponent.
      * Determine the number of bits that the big integer requires, and compute
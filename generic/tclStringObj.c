@@ -62,20 +62,32 @@ static void		AppendUtfToUtfRep(Tcl_Obj *objPtr,
 			    const char *bytes, int numBytes);
 static void		DupStringInternalRep(Tcl_Obj *objPtr,
 			    Tcl_Obj *copyPtr);
+static void		DupFormatInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
 static int		ExtendStringRepWithUnicode(Tcl_Obj *objPtr,
 			    const Tcl_UniChar *unicode, int numChars);
 static void		ExtendUnicodeRepWithString(Tcl_Obj *objPtr,
 			    const char *bytes, int numBytes,
 			    int numAppendChars);
 static void		FillUnicodeRep(Tcl_Obj *objPtr);
+static void		FreeFormatInternalRep(Tcl_Obj *objPtr);
 static void		FreeStringInternalRep(Tcl_Obj *objPtr);
 static void		GrowStringBuffer(Tcl_Obj *objPtr, int needed, int flag);
 static void		GrowUnicodeBuffer(Tcl_Obj *objPtr, int needed);
+static int		SearchBytes(const unsigned char *haystack,
+			    int haystackLen, const unsigned char *needle,
+			    int needleLen, int last);
+static int		SearchUniChars(const Tcl_UniChar *haystack,
+			    int haystackLen, const Tcl_UniChar *needle,
+			    int needleLen, int last);
 static int		SetStringFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 static void		SetUnicodeObj(Tcl_Obj *objPtr,
 			    const Tcl_UniChar *unicode, int numChars);
 static int		UnicodeLength(const Tcl_UniChar *unicode);
 static void		UpdateStringOfString(Tcl_Obj *objPtr);
+static const char *	UtfAtCharIndex(Tcl_Obj *objPtr, int index);
+static int		UtfCharIndexOfByte(Tcl_Obj *objPtr, int offset);
+static int		UtfSearchable(Tcl_Obj *needle, Tcl_Obj *haystack);
 
 /*
  * The structure below defines the string Tcl object type by means of
@@ -117,11 +129,57 @@ typedef struct String {
 				 * space allocated for the unicode array. */
     int hasUnicode;		/* Boolean determining whether the string has
 				 * a Unicode representation. */
+    int hashValid;		/* Boolean determining whether hash holds the
+				 * hash value of the current UTF string. */
+    unsigned int hash;		/* Cached result of TclHashObjKey, so that
+				 * objects used as keys over and over again
+				 * are only hashed once. */
+    struct CharIndex *charIndex;
+				/* Sparse map from character indices to byte
+				 * offsets in the UTF string, built on demand
+				 * by UtfAtCharIndex. NULL if none. */
     Tcl_UniChar unicode[1];	/* The array of Unicode chars. The actual size
 				 * of this field depends on the 'maxChars'
 				 * field above. */
 } String;
 
+/*
+ * Indexing into the UTF string of a value that holds multi-byte characters
+ * does not require a Unicode rep, which takes two bytes per character and a
+ * full conversion pass. Instead the String intrep may keep a CharIndex, in
+ * which entry k holds the byte offset of character k * CHAR_INDEX_STRIDE;
+ * reaching any character then takes a walk over fewer than CHAR_INDEX_STRIDE
+ * characters. The entries are filled in lazily, only as far as the highest
+ * index asked for, and remain valid when the string is appended to. The
+ * position of the last character looked up is also remembered, so that
+ * scanning a string character by character does not walk from the last
+ * entry each time.
+ *
+ * Strings of single-byte characters (numChars == length), which includes
+ * all pure ASCII strings, are indexed directly and never get a CharIndex.
+ */
+
+#define CHAR_INDEX_STRIDE 32
+
+typedef struct CharIndex {
+    int numEntries;		/* Number of valid entries in offsets. Always
+				 * at least 1. */
+    int maxEntries;		/* Number of entries allocated. */
+    int lastChar;		/* Index of the last character looked up, */
+    int lastByte;		/* ... and its byte offset. */
+    int offsets[1];		/* offsets[k] is the byte offset of character
+				 * k * CHAR_INDEX_STRIDE. The actual size
+				 * depends on maxEntries. */
+} CharIndex;
+
+#define CHAR_INDEX_SIZE(numEntries) \
+	(sizeof(CharIndex) + ((numEntries) - 1) * sizeof(int))
+#define stringFreeIndex(stringPtr) \
+    if ((stringPtr)->charIndex != NULL) { \
+	ckfree((char *) (stringPtr)->charIndex); \
+	(stringPtr)->charIndex = NULL; \
+    }
+
 #define STRING_MAXCHARS \
 	(int)(((size_t)UINT_MAX - sizeof(String))/sizeof(Tcl_UniChar))
 #define STRING_SIZE(numChars) \
@@ -544,10 +602,13 @@ Tcl_GetUniChar(
 	    TclNumUtfChars(stringPtr->numChars, objPtr->bytes, objPtr->length);
 	}
 	if (stringPtr->numChars == objPtr->length) {
-	    return (Tcl_UniChar) objPtr->bytes[index];
+	    return (Tcl_UniChar) UCHAR(objPtr->bytes[index]);
+	} else {
+	    Tcl_UniChar ch;
+
+	    TclUtfToUniChar(UtfAtCharIndex(objPtr, index), &ch);
+	    return ch;
 	}
-	FillUnicodeRep(objPtr);
-	stringPtr = GET_STRING(objPtr);
     }
     return stringPtr->unicode[index];
 }
@@ -683,8 +744,18 @@ Tcl_GetRange(
 	    stringPtr->numChars = newObjPtr->length;
 	    return newObjPtr;
 	}
-	FillUnicodeRep(objPtr);
-	stringPtr = GET_STRING(objPtr);
+	if (first <= last) {
+	    const char *start = UtfAtCharIndex(objPtr, first);
+	    const char *end = UtfAtCharIndex(objPtr, last);
+	    Tcl_UniChar ch;
+
+	    end += TclUtfToUniChar(end, &ch);
+	    newObjPtr = Tcl_NewStringObj(start, end - start);
+	    SetStringFromAny(NULL, newObjPtr);
+	    GET_STRING(newObjPtr)->numChars = last - first + 1;
+	    return newObjPtr;
+	}
+	return Tcl_NewObj();
     }
 
     return Tcl_NewUnicodeObj(stringPtr->unicode + first, last-first+1);
@@ -790,6 +861,16 @@ Tcl_SetObjLength(
     }
 
     if (objPtr->bytes && objPtr->length == length) {
+	/*
+	 * Callers that edit the bytes in place end up here, so forget any
+	 * hash or character index of the old contents.
+	 */
+
+	if (objPtr->typePtr == &tclStringType) {
+	    stringPtr = GET_STRING(objPtr);
+	    stringPtr->hashValid = 0;
+	    stringFreeIndex(stringPtr);
+	}
 	return;
     }
 
@@ -821,6 +902,8 @@ Tcl_SetObjLength(
 
 	stringPtr->numChars = -1;
 	stringPtr->hasUnicode = 0;
+	stringPtr->hashValid = 0;
+	stringFreeIndex(stringPtr);
     } else {
 	/*
 	 * Changing length of pure unicode string.
@@ -837,6 +920,8 @@ Tcl_SetObjLength(
 	stringPtr->numChars = length;
 	stringPtr->unicode[length] = 0;
 	stringPtr->hasUnicode = 1;
+	stringPtr->hashValid = 0;
+	stringFreeIndex(stringPtr);
 
 	/*
 	 * Can only get here when objPtr->bytes == NULL.
@@ -889,6 +974,11 @@ Tcl_AttemptSetObjLength(
 	Tcl_Panic("%s called with shared object", "Tcl_AttemptSetObjLength");
     }
     if (objPtr->bytes && objPtr->length == length) {
+	if (objPtr->typePtr == &tclStringType) {
+	    stringPtr = GET_STRING(objPtr);
+	    stringPtr->hashValid = 0;
+	    stringFreeIndex(stringPtr);
+	}
 	return 1;
     }
 
@@ -926,6 +1016,8 @@ Tcl_AttemptSetObjLength(
 
 	stringPtr->numChars = -1;
 	stringPtr->hasUnicode = 0;
+	stringPtr->hashValid = 0;
+	stringFreeIndex(stringPtr);
     } else {
 	/*
 	 * Changing length of pure unicode string.
@@ -947,6 +1039,8 @@ Tcl_AttemptSetObjLength(
 	stringPtr->unicode[length] = 0;
 	stringPtr->numChars = length;
 	stringPtr->hasUnicode = 1;
+	stringPtr->hashValid = 0;
+	stringFreeIndex(stringPtr);
 
 	/*
 	 * Can only get here when objPtr->bytes == NULL.
@@ -1030,6 +1124,8 @@ SetUnicodeObj(
     stringPtr->unicode[numChars] = 0;
     stringPtr->numChars = numChars;
     stringPtr->hasUnicode = 1;
+    stringPtr->hashValid = 0;
+    stringPtr->charIndex = NULL;
 
     TclInvalidateStringRep(objPtr);
     stringPtr->allocated = 0;
@@ -1401,6 +1497,8 @@ AppendUnicodeToUnicodeRep(
     stringPtr->unicode[numChars] = 0;
     stringPtr->numChars = numChars;
     stringPtr->allocated = 0;
+    stringPtr->hashValid = 0;
+    stringFreeIndex(stringPtr);
 
     TclInvalidateStringRep(objPtr);
 }
@@ -1435,6 +1533,7 @@ AppendUnicodeToUtfRep(
     if (stringPtr->numChars != -1) {
 	stringPtr->numChars += numChars;
     }
+    stringPtr->hashValid = 0;
 
 #if COMPAT
     /* Invalidate the unicode rep */
@@ -1476,6 +1575,8 @@ AppendUtfToUnicodeRep(
     TclInvalidateStringRep(objPtr);
     stringPtr = GET_STRING(objPtr);
     stringPtr->allocated = 0;
+    stringPtr->hashValid = 0;
+    stringFreeIndex(stringPtr);
 }
 
 /*
@@ -1552,6 +1653,7 @@ AppendUtfToUtfRep(
 
     stringPtr->numChars = -1;
     stringPtr->hasUnicode = 0;
+    stringPtr->hashValid = 0;
 
     memcpy(objPtr->bytes + oldLength, bytes, numBytes);
     objPtr->bytes[newLength] = 0;
@@ -1625,195 +1727,214 @@ Tcl_AppendStringsToObj(
     va_end(argList);
 }
 
+/*
+ * A format string is compiled once into a FormatProgram: an array of
+ * FormatSpec, one for each conversion, ending with one of type FORMAT_END.
+ * Each spec carries the literal text that precedes it, with "%%" already
+ * reduced to "%", and the fields parsed out of its conversion specifier.
+ * Specifiers whose output can be produced without the general machinery
+ * are tagged with an emitter. The program is kept in the internal rep of
+ * the format object, so that "format" with a literal format string parses
+ * it only once.
+ */
+
+#define FORMAT_END		0
+#define FORMAT_MIXED_XPG	1	/* "%" and "%n$" mixed; report it. */
+#define FORMAT_CONVERSION	2
+
+#define EMIT_GENERAL	0
+#define EMIT_STRING	1	/* Plain %s. */
+#define EMIT_LONG	2	/* %d of a value that fits in a long. */
+#define EMIT_DOUBLE	3	/* %e, %f, %g with constant width/precision. */
+
+/*
+ * Flags for FormatSpec.
+ */
+
+#define FMT_MINUS	0x001
+#define FMT_HASH	0x002
+#define FMT_ZERO	0x004
+#define FMT_SPACE	0x008
+#define FMT_PLUS	0x010
+#define FMT_XPG		0x020	/* Has a "%n$" position. */
+#define FMT_WIDTH_ARG	0x040	/* Width is "*". */
+#define FMT_PRECISION	0x080	/* Has a "." precision. */
+#define FMT_PRECISION_ARG 0x100	/* Precision is "*". */
+#define FMT_SHORT	0x200
+#define FMT_WIDE	0x400
+#define FMT_BIG		0x800
+
+/*
+ * Widths and precisions up to this size are handled by the emitters, which
+ * produce their output in a buffer on the C stack.
+ */
+
+#define FORMAT_FAST_FIELD	64
+#define MAX_FLOAT_SIZE		320
+
+typedef struct FormatSpec {
+    int type;			/* FORMAT_END, FORMAT_MIXED_XPG or
+				 * FORMAT_CONVERSION. */
+    int literalStart;		/* Offset in the program's literals of the
+				 * text before the conversion. */
+    int literalLength;		/* Its length in bytes. */
+    int flags;			/* FMT_* bits. */
+    int position;		/* Argument index from "%n$", minus one. */
+    int width, precision;	/* Unless given as "*". */
+    Tcl_UniChar ch;		/* Conversion character; "i" becomes "d", and
+				 * '\0' means the format ended early. */
+    int emitter;		/* EMIT_* for the conversion. */
+    char printfSpec[2*TCL_INTEGER_SPACE + 9];
+				/* For EMIT_DOUBLE, the sprintf() spec. */
+} FormatSpec;
+
+typedef struct FormatProgram {
+    int refCount;		/* Users of the program, including the
+				 * internal reps that hold it. */
+    char *literals;		/* Literal text, in the same block. */
+    FormatSpec specs[1];	/* The specs; the actual size depends on the
+				 * format string. */
+} FormatProgram;
+
+/*
+ * The Tcl object type that keeps a compiled format string in the format
+ * object, for TclFormatFromObj.
+ */
+
+static const Tcl_ObjType formatType = {
+    "format",				/* name */
+    FreeFormatInternalRep,		/* freeIntRepProc */
+    DupFormatInternalRep,		/* dupIntRepProc */
+    NULL,				/* updateStringProc */
+    NULL				/* setFromAnyProc */
+};
+
 /*
  *----------------------------------------------------------------------
  *
- * Tcl_AppendFormatToObj --
+ * CompileFormat --
  *
- *	This function appends a list of Tcl_Obj's to a Tcl_Obj according to
- *	the formatting instructions embedded in the format string. The
- *	formatting instructions are inspired by sprintf(). Returns TCL_OK when
- *	successful. If there's an error in the arguments, TCL_ERROR is
- *	returned, and an error message is written to the interp, if non-NULL.
+ *	Parse a format string for Tcl_AppendFormatToObj into a FormatProgram.
+ *	Errors that depend only on the format string stop the compilation at
+ *	the offending spec; they are reported when the program gets that far,
+ *	so that they come in the same order as the argument errors.
  *
  * Results:
- *	A standard Tcl result.
+ *	A program with a reference count of zero.
  *
  * Side effects:
- *	None.
+ *	Allocates memory.
  *
  *----------------------------------------------------------------------
  */
 
-int
-Tcl_AppendFormatToObj(
-    Tcl_Interp *interp,
-    Tcl_Obj *appendObj,
-    const char *format,
-    int objc,
-    Tcl_Obj *const objv[])
+static FormatProgram *
+CompileFormat(
+    const char *format)		/* The format string, NUL-terminated. */
 {
-    const char *span = format, *msg;
-    int numBytes = 0, objIndex = 0, gotXpg = 0, gotSequential = 0;
-    int originalLength, limit;
-    static const char *mixedXPG =
-	    "cannot mix \"%\" and \"%n$\" conversion specifiers";
-    static const char *const badIndex[2] = {
-	"not enough arguments for all format specifiers",
-	"\"%n$\" argument index out of range"
-    };
-    static const char *overflow = "max size for a Tcl value exceeded";
+    FormatProgram *programPtr;
+    FormatSpec *specPtr;
+    const char *p;
+    char *literals, *end;
+    int numSpecs = 1, numBytes = 0, gotXpg = 0, gotSequential = 0;
 
-    if (Tcl_IsShared(appendObj)) {
-	Tcl_Panic("%s called with shared object", "Tcl_AppendFormatToObj");
+    for (p = format; *p != '\0'; p++) {
+	if (*p == '%') {
+	    numSpecs++;
+	}
     }
-    TclGetStringFromObj(appendObj, &originalLength);
-    limit = INT_MAX - originalLength;
-
-    /*
-     * Format string is NUL-terminated.
-     */
+    programPtr = (FormatProgram *) ckalloc(sizeof(FormatProgram)
+	    + (numSpecs - 1) * sizeof(FormatSpec) + (p - format) + 1);
+    programPtr->refCount = 0;
+    literals = programPtr->literals = (char *) (programPtr->specs + numSpecs);
+    specPtr = programPtr->specs;
+    specPtr->literalStart = 0;
 
     while (*format != '\0') {
-	char *end;
-	int gotMinus, gotHash, gotZero, gotSpace, gotPlus, sawFlag;
-	int width, gotPrecision, precision, useShort, useWide, useBig;
-	int newXpg, numChars, allocSegment = 0, segmentLimit, segmentNumBytes;
-	Tcl_Obj *segment;
+	int flags = 0, width = 0, precision = 0, newXpg = 0;
 	Tcl_UniChar ch;
-	int step = Tcl_UtfToUniChar(format, &ch);
+	int step;
 
-	format += step;
-	if (ch != '%') {
-	    numBytes += step;
+	if (*format != '%') {
+	    literals[numBytes++] = *format++;
 	    continue;
 	}
-	if (numBytes) {
-	    if (numBytes > limit) {
-		msg = overflow;
-		goto errorMsg;
-	    }
-	    Tcl_AppendToObj(appendObj, span, numBytes);
-	    limit -= numBytes;
-	    numBytes = 0;
-	}
-
-	/*
-	 * Saw a % : process the format specifier.
-	 *
-	 * Step 0. Handle special case of escaped format marker (i.e., %%).
-	 */
-
-	step = Tcl_UtfToUniChar(format, &ch);
-	if (ch == '%') {
-	    span = format;
-	    numBytes = step;
-	    format += step;
+	format++;
+	if (*format == '%') {
+	    literals[numBytes++] = *format++;
 	    continue;
 	}
+	specPtr->type = FORMAT_CONVERSION;
+	specPtr->literalLength = numBytes - specPtr->literalStart;
+	step = Tcl_UtfToUniChar(format, &ch);
 
 	/*
-	 * Step 1. XPG3 position specifier
+	 * XPG3 position specifier.
 	 */
 
-	newXpg = 0;
 	if (isdigit(UCHAR(ch))) {
 	    int position = strtoul(format, &end, 10);
 
 	    if (*end == '$') {
 		newXpg = 1;
-		objIndex = position - 1;
+		specPtr->position = position - 1;
 		format = end + 1;
 		step = Tcl_UtfToUniChar(format, &ch);
 	    }
 	}
+	if (newXpg ? gotSequential : gotXpg) {
+	    specPtr->type = FORMAT_MIXED_XPG;
+	    return programPtr;
+	}
 	if (newXpg) {
-	    if (gotSequential) {
-		msg = mixedXPG;
-		goto errorMsg;
-	    }
 	    gotXpg = 1;
+	    flags |= FMT_XPG;
 	} else {
-	    if (gotXpg) {
-		msg = mixedXPG;
-		goto errorMsg;
-	    }
 	    gotSequential = 1;
 	}
-	if ((objIndex < 0) || (objIndex >= objc)) {
-	    msg = badIndex[gotXpg];
-	    goto errorMsg;
-	}
 
 	/*
-	 * Step 2. Set of flags.
+	 * Set of flags.
 	 */
 
-	gotMinus = gotHash = gotZero = gotSpace = gotPlus = 0;
-	sawFlag = 1;
-	do {
-	    switch (ch) {
-	    case '-':
-		gotMinus = 1;
-		break;
-	    case '#':
-		gotHash = 1;
-		break;
-	    case '0':
-		gotZero = 1;
-		break;
-	    case ' ':
-		gotSpace = 1;
-		break;
-	    case '+':
-		gotPlus = 1;
+	while (1) {
+	    if (ch == '-') {
+		flags |= FMT_MINUS;
+	    } else if (ch == '#') {
+		flags |= FMT_HASH;
+	    } else if (ch == '0') {
+		flags |= FMT_ZERO;
+	    } else if (ch == ' ') {
+		flags |= FMT_SPACE;
+	    } else if (ch == '+') {
+		flags |= FMT_PLUS;
+	    } else {
 		break;
-	    default:
-		sawFlag = 0;
-	    }
-	    if (sawFlag) {
-		format += step;
-		step = Tcl_UtfToUniChar(format, &ch);
 	    }
-	} while (sawFlag);
+	    format += step;
+	    step = Tcl_UtfToUniChar(format, &ch);
+	}
 
 	/*
-	 * Step 3. Minimum field width.
+	 * Minimum field width.
 	 */
 
-	width = 0;
 	if (isdigit(UCHAR(ch))) {
 	    width = strtoul(format, &end, 10);
 	    format = end;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	} else if (ch == '*') {
-	    if (objIndex >= objc - 1) {
-		msg = badIndex[gotXpg];
-		goto errorMsg;
-	    }
-	    if (TclGetIntFromObj(interp, objv[objIndex], &width) != TCL_OK) {
-		goto error;
-	    }
-	    if (width < 0) {
-		width = -width;
-		gotMinus = 1;
-	    }
-	    objIndex++;
+	    flags |= FMT_WIDTH_ARG;
 	    format += step;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	}
-	if (width > limit) {
-	    msg = overflow;
-	    goto errorMsg;
-	}
 
 	/*
-	 * Step 4. Precision.
+	 * Precision.
 	 */
 
-	gotPrecision = precision = 0;
 	if (ch == '.') {
-	    gotPrecision = 1;
+	    flags |= FMT_PRECISION;
 	    format += step;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	}
@@ -1822,147 +1943,511 @@ Tcl_AppendFormatToObj(
 	    format = end;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	} else if (ch == '*') {
-	    if (objIndex >= objc - 1) {
-		msg = badIndex[gotXpg];
-		goto errorMsg;
-	    }
-	    if (TclGetIntFromObj(interp, objv[objIndex], &precision)
-		    != TCL_OK) {
-		goto error;
-	    }
-
-	    /*
-	     * TODO: Check this truncation logic.
-	     */
-
-	    if (precision < 0) {
-		precision = 0;
-	    }
-	    objIndex++;
+	    flags |= FMT_PRECISION_ARG;
 	    format += step;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	}
 
 	/*
-	 * Step 5. Length modifier.
+	 * Length modifier.
 	 */
 
-	useShort = useWide = useBig = 0;
 	if (ch == 'h') {
-	    useShort = 1;
+	    flags |= FMT_SHORT;
 	    format += step;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	} else if (ch == 'l') {
 	    format += step;
 	    step = Tcl_UtfToUniChar(format, &ch);
 	    if (ch == 'l') {
-		useBig = 1;
+		flags |= FMT_BIG;
 		format += step;
 		step = Tcl_UtfToUniChar(format, &ch);
 #ifndef TCL_WIDE_INT_IS_LONG
 	    } else {
-		useWide = 1;
+		flags |= FMT_WIDE;
 #endif
 	    }
 	}
 
-	format += step;
-	span = format;
-
 	/*
-	 * Step 6. The actual conversion character.
+	 * The conversion character, and the emitter that can handle it.
 	 */
 
-	segment = objv[objIndex];
-	numChars = -1;
 	if (ch == 'i') {
 	    ch = 'd';
 	}
-	switch (ch) {
-	case '\0':
-	    msg = "format string ended in middle of field specifier";
-	    goto errorMsg;
-	case 's':
-	    if (gotPrecision) {
-		numChars = Tcl_GetCharLength(segment);
-		if (precision < numChars) {
-		    segment = Tcl_GetRange(segment, 0, precision - 1);
-		    numChars = precision;
-		    Tcl_IncrRefCount(segment);
-		    allocSegment = 1;
-		}
+	specPtr->flags = flags;
+	specPtr->width = width;
+	specPtr->precision = precision;
+	specPtr->ch = ch;
+	specPtr->emitter = EMIT_GENERAL;
+	if (ch == '\0') {
+	    return programPtr;
+	}
+	format += step;
+
+	if ((flags & (FMT_WIDTH_ARG|FMT_PRECISION_ARG)) || width < 0
+		|| width > FORMAT_FAST_FIELD || precision < 0
+		|| precision > FORMAT_FAST_FIELD) {
+	    /* Leave it to the general code. */
+	} else if (ch == 's') {
+	    if (width == 0 && !(flags & FMT_PRECISION)) {
+		specPtr->emitter = EMIT_STRING;
 	    }
-	    break;
-	case 'c': {
-	    char buf[TCL_UTF_MAX];
-	    int code, length;
+	} else if (ch == 'd') {
+	    if (!(flags & (FMT_SHORT|FMT_WIDE|FMT_BIG))) {
+		specPtr->emitter = EMIT_LONG;
+	    }
+	} else if (ch=='e' || ch=='E' || ch=='f' || ch=='g' || ch=='G') {
+	    char *q = specPtr->printfSpec;
 
-	    if (TclGetIntFromObj(interp, segment, &code) != TCL_OK) {
-		goto error;
+	    *q++ = '%';
+	    if (flags & FMT_MINUS) {
+		*q++ = '-';
 	    }
-	    length = Tcl_UniCharToUtf(code, buf);
-	    segment = Tcl_NewStringObj(buf, length);
-	    Tcl_IncrRefCount(segment);
-	    allocSegment = 1;
-	    break;
+	    if (flags & FMT_HASH) {
+		*q++ = '#';
+	    }
+	    if (flags & FMT_ZERO) {
+		*q++ = '0';
+	    }
+	    if (flags & FMT_SPACE) {
+		*q++ = ' ';
+	    }
+	    if (flags & FMT_PLUS) {
+		*q++ = '+';
+	    }
+	    if (width) {
+		q += sprintf(q, "%d", width);
+	    }
+	    if (flags & FMT_PRECISION) {
+		q += sprintf(q, ".%d", precision);
+	    }
+	    *q++ = (char) ch;
+	    *q = '\0';
+	    specPtr->emitter = EMIT_DOUBLE;
 	}
 
-	case 'u':
-	    if (useBig) {
-		msg = "unsigned bignum format is invalid";
-		goto errorMsg;
-	    }
-	case 'd':
-	case 'o':
-	case 'x':
-	case 'X':
-	case 'b': {
-	    short s = 0;	/* Silence compiler warning; only defined and
-				 * used when useShort is true. */
-	    long l;
-	    Tcl_WideInt w;
-	    mp_int big;
-	    int toAppend, isNegative = 0;
+	specPtr++;
+	specPtr->literalStart = numBytes;
+    }
 
-	    if (useBig) {
-		if (Tcl_GetBignumFromObj(interp, segment, &big) != TCL_OK) {
-		    goto error;
-		}
-		isNegative = (mp_cmp_d(&big, 0) == MP_LT);
-	    } else if (useWide) {
-		if (Tcl_GetWideIntFromObj(NULL, segment, &w) != TCL_OK) {
-		    Tcl_Obj *objPtr;
+    specPtr->type = FORMAT_END;
+    specPtr->literalLength = numBytes - specPtr->literalStart;
+    return programPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReleaseFormatProgram, FreeFormatInternalRep, DupFormatInternalRep --
+ *
+ *	Manage the lifetime of compiled format strings and of the internal
+ *	reps that hold them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A program is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
 
-		    if (Tcl_GetBignumFromObj(interp,segment,&big) != TCL_OK) {
-			goto error;
-		    }
-		    mp_mod_2d(&big, (int) CHAR_BIT*sizeof(Tcl_WideInt), &big);
-		    objPtr = Tcl_NewBignumObj(&big);
-		    Tcl_IncrRefCount(objPtr);
-		    Tcl_GetWideIntFromObj(NULL, objPtr, &w);
-		    Tcl_DecrRefCount(objPtr);
-		}
-		isNegative = (w < (Tcl_WideInt) 0);
-	    } else if (TclGetLongFromObj(NULL, segment, &l) != TCL_OK) {
-		if (Tcl_GetWideIntFromObj(NULL, segment, &w) != TCL_OK) {
-		    Tcl_Obj *objPtr;
+static void
+ReleaseFormatProgram(
+    FormatProgram *programPtr)
+{
+    if (--programPtr->refCount <= 0) {
+	ckfree((char *) programPtr);
+    }
+}
 
-		    if (Tcl_GetBignumFromObj(interp,segment,&big) != TCL_OK) {
-			goto error;
-		    }
-		    mp_mod_2d(&big, (int) CHAR_BIT * sizeof(long), &big);
-		    objPtr = Tcl_NewBignumObj(&big);
-		    Tcl_IncrRefCount(objPtr);
-		    TclGetLongFromObj(NULL, objPtr, &l);
-		    Tcl_DecrRefCount(objPtr);
-		} else {
-		    l = Tcl_WideAsLong(w);
-		}
-		if (useShort) {
-		    s = (short) l;
-		    isNegative = (s < (short) 0);
-		} else {
-		    isNegative = (l < (long) 0);
+static void
+FreeFormatInternalRep(
+    Tcl_Obj *objPtr)
+{
+    ReleaseFormatProgram(objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupFormatInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    FormatProgram *programPtr = srcPtr->internalRep.otherValuePtr;
+
+    programPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = programPtr;
+    copyPtr->typePtr = &formatType;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * EmitLong --
+ *
+ *	Produce the field for a %d conversion of a long, with its flags,
+ *	precision and width, the same way as the general code in
+ *	AppendFormatProgram does.
+ *
+ * Results:
+ *	The number of bytes written to buf, which needs room for
+ *	2*FORMAT_FAST_FIELD + TCL_INTEGER_SPACE bytes.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+EmitLong(
+    char *buf,
+    long l,
+    const FormatSpec *specPtr)
+{
+    char digits[TCL_INTEGER_SPACE];
+    unsigned long ul = (l < 0) ? -(unsigned long) l : (unsigned long) l;
+    int flags = specPtr->flags, width = specPtr->width;
+    int numDigits = 0, numZeros = 0, numPad, length;
+    char *p = buf;
+
+    do {
+	digits[numDigits++] = (char) ('0' + ul % 10);
+	ul /= 10;
+    } while (ul);
+
+    length = numDigits;
+    if ((l < 0) || (flags & (FMT_PLUS|FMT_SPACE))) {
+	length++;
+    }
+    if (flags & FMT_PRECISION) {
+	if (numDigits < specPtr->precision) {
+	    numZeros = specPtr->precision - numDigits;
+	}
+    } else if ((flags & FMT_ZERO) && (length < width)) {
+	numZeros = width - length;
+    }
+    length += numZeros;
+    numPad = (length < width) ? width - length : 0;
+
+    if (!(flags & FMT_MINUS)) {
+	memset(p, ' ', (size_t) numPad);
+	p += numPad;
+    }
+    if (l < 0) {
+	*p++ = '-';
+    } else if (flags & FMT_PLUS) {
+	*p++ = '+';
+    } else if (flags & FMT_SPACE) {
+	*p++ = ' ';
+    }
+    memset(p, '0', (size_t) numZeros);
+    p += numZeros;
+    while (numDigits > 0) {
+	*p++ = digits[--numDigits];
+    }
+    if (flags & FMT_MINUS) {
+	memset(p, ' ', (size_t) numPad);
+	p += numPad;
+    }
+    return p - buf;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AppendFormatProgram --
+ *
+ *	Run a compiled format string over a list of arguments, appending the
+ *	result to appendObj. This does the work of Tcl_AppendFormatToObj.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+AppendFormatProgram(
+    Tcl_Interp *interp,
+    Tcl_Obj *appendObj,
+    FormatProgram *programPtr,
+    int objc,
+    Tcl_Obj *const objv[])
+{
+    const FormatSpec *specPtr;
+    const char *msg;
+    int objIndex = 0, gotXpg = 0;
+    int originalLength, limit;
+    static const char *mixedXPG =
+	    "cannot mix \"%\" and \"%n$\" conversion specifiers";
+    static const char *const badIndex[2] = {
+	"not enough arguments for all format specifiers",
+	"\"%n$\" argument index out of range"
+    };
+    static const char *overflow = "max size for a Tcl value exceeded";
+
+    if (Tcl_IsShared(appendObj)) {
+	Tcl_Panic("%s called with shared object", "Tcl_AppendFormatToObj");
+    }
+    TclGetStringFromObj(appendObj, &originalLength);
+    limit = INT_MAX - originalLength;
+
+    for (specPtr = programPtr->specs; ; specPtr++) {
+	int gotMinus, gotHash, gotZero, gotSpace, gotPlus;
+	int width, gotPrecision, precision, useShort, useWide, useBig;
+	int numChars, allocSegment = 0, segmentLimit, segmentNumBytes;
+	Tcl_Obj *segment;
+	Tcl_UniChar ch;
+
+	if (specPtr->literalLength) {
+	    if (specPtr->literalLength > limit) {
+		msg = overflow;
+		goto errorMsg;
+	    }
+	    Tcl_AppendToObj(appendObj,
+		    programPtr->literals + specPtr->literalStart,
+		    specPtr->literalLength);
+	    limit -= specPtr->literalLength;
+	}
+	if (specPtr->type == FORMAT_END) {
+	    break;
+	} else if (specPtr->type == FORMAT_MIXED_XPG) {
+	    msg = mixedXPG;
+	    goto errorMsg;
+	}
+
+	/*
+	 * Step 1. XPG3 position specifier
+	 */
+
+	gotXpg = (specPtr->flags & FMT_XPG);
+	if (gotXpg) {
+	    objIndex = specPtr->position;
+	}
+	if ((objIndex < 0) || (objIndex >= objc)) {
+	    msg = badIndex[gotXpg != 0];
+	    goto errorMsg;
+	}
+
+	/*
+	 * Step 2. Set of flags.
+	 */
+
+	gotMinus = (specPtr->flags & FMT_MINUS);
+	gotHash = (specPtr->flags & FMT_HASH);
+	gotZero = (specPtr->flags & FMT_ZERO);
+	gotSpace = (specPtr->flags & FMT_SPACE);
+	gotPlus = (specPtr->flags & FMT_PLUS);
+
+	/*
+	 * Step 3. Minimum field width.
+	 */
+
+	width = specPtr->width;
+	if (specPtr->flags & FMT_WIDTH_ARG) {
+	    if (objIndex >= objc - 1) {
+		msg = badIndex[gotXpg != 0];
+		goto errorMsg;
+	    }
+	    if (TclGetIntFromObj(interp, objv[objIndex], &width) != TCL_OK) {
+		goto error;
+	    }
+	    if (width < 0) {
+		width = -width;
+		gotMinus = 1;
+	    }
+	    objIndex++;
+	}
+	if (width > limit) {
+	    msg = overflow;
+	    goto errorMsg;
+	}
+
+	/*
+	 * Step 4. Precision.
+	 */
+
+	gotPrecision = (specPtr->flags & FMT_PRECISION);
+	precision = specPtr->precision;
+	if (specPtr->flags & FMT_PRECISION_ARG) {
+	    if (objIndex >= objc - 1) {
+		msg = badIndex[gotXpg != 0];
+		goto errorMsg;
+	    }
+	    if (TclGetIntFromObj(interp, objv[objIndex], &precision)
+		    != TCL_OK) {
+		goto error;
+	    }
+
+	    /*
+	     * TODO: Check this truncation logic.
+	     */
+
+	    if (precision < 0) {
+		precision = 0;
+	    }
+	    objIndex++;
+	}
+
+	/*
+	 * Step 5. Length modifier.
+	 */
+
+	useShort = (specPtr->flags & FMT_SHORT);
+	useWide = (specPtr->flags & FMT_WIDE);
+	useBig = (specPtr->flags & FMT_BIG);
+	ch = specPtr->ch;
+
+	/*
+	 * Step 6. The conversion. The common cases have emitters that do it
+	 * without building intermediate objects.
+	 */
+
+	segment = objv[objIndex];
+	switch (specPtr->emitter) {
+	case EMIT_STRING:
+	    Tcl_GetStringFromObj(segment, &segmentNumBytes);
+	    if (segmentNumBytes > limit) {
+		msg = overflow;
+		goto errorMsg;
+	    }
+	    Tcl_AppendObjToObj(appendObj, segment);
+	    limit -= segmentNumBytes;
+	    goto nextSpec;
+	case EMIT_LONG: {
+	    char buf[2*FORMAT_FAST_FIELD + TCL_INTEGER_SPACE];
+	    long l;
+
+	    if (TclGetLongFromObj(NULL, segment, &l) != TCL_OK) {
+		break;
+	    }
+	    segmentNumBytes = EmitLong(buf, l, specPtr);
+	    if (segmentNumBytes > limit) {
+		msg = overflow;
+		goto errorMsg;
+	    }
+	    Tcl_AppendToObj(appendObj, buf, segmentNumBytes);
+	    limit -= segmentNumBytes;
+	    goto nextSpec;
+	}
+	case EMIT_DOUBLE: {
+	    char buf[MAX_FLOAT_SIZE + 2*FORMAT_FAST_FIELD];
+	    double d;
+	    int i;
+
+	    if (Tcl_GetDoubleFromObj(interp, segment, &d) != TCL_OK) {
+		goto error;
+	    }
+	    segmentNumBytes = sprintf(buf, specPtr->printfSpec, d);
+	    if (ch == 'E' || ch == 'G') {
+		for (i = 0; i < segmentNumBytes; i++) {
+		    buf[i] = (char) toupper(UCHAR(buf[i]));
+		}
+	    }
+	    if (segmentNumBytes > limit) {
+		msg = overflow;
+		goto errorMsg;
+	    }
+	    Tcl_AppendToObj(appendObj, buf, segmentNumBytes);
+	    limit -= segmentNumBytes;
+	    goto nextSpec;
+	}
+	}
+
+	numChars = -1;
+	switch (ch) {
+	case '\0':
+	    msg = "format string ended in middle of field specifier";
+	    goto errorMsg;
+	case 's':
+	    if (gotPrecision) {
+		numChars = Tcl_GetCharLength(segment);
+		if (precision < numChars) {
+		    segment = Tcl_GetRange(segment, 0, precision - 1);
+		    numChars = precision;
+		    Tcl_IncrRefCount(segment);
+		    allocSegment = 1;
+		}
+	    }
+	    break;
+	case 'c': {
+	    char buf[TCL_UTF_MAX];
+	    int code, length;
+
+	    if (TclGetIntFromObj(interp, segment, &code) != TCL_OK) {
+		goto error;
+	    }
+	    length = Tcl_UniCharToUtf(code, buf);
+	    segment = Tcl_NewStringObj(buf, length);
+	    Tcl_IncrRefCount(segment);
+	    allocSegment = 1;
+	    break;
+	}
+
+	case 'u':
+	    if (useBig) {
+		msg = "unsigned bignum format is invalid";
+		goto errorMsg;
+	    }
+	case 'd':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'b': {
+	    short s = 0;	/* Silence compiler warning; only defined and
+				 * used when useShort is true. */
+	    long l;
+	    Tcl_WideInt w;
+	    mp_int big;
+	    int toAppend, isNegative = 0;
+
+	    if (useBig) {
+		if (Tcl_GetBignumFromObj(interp, segment, &big) != TCL_OK) {
+		    goto error;
+		}
+		isNegative = (mp_cmp_d(&big, 0) == MP_LT);
+	    } else if (useWide) {
+		if (Tcl_GetWideIntFromObj(NULL, segment, &w) != TCL_OK) {
+		    Tcl_Obj *objPtr;
+
+		    if (Tcl_GetBignumFromObj(interp,segment,&big) != TCL_OK) {
+			goto error;
+		    }
+		    mp_mod_2d(&big, (int) CHAR_BIT*sizeof(Tcl_WideInt), &big);
+		    objPtr = Tcl_NewBignumObj(&big);
+		    Tcl_IncrRefCount(objPtr);
+		    Tcl_GetWideIntFromObj(NULL, objPtr, &w);
+		    Tcl_DecrRefCount(objPtr);
+		}
+		isNegative = (w < (Tcl_WideInt) 0);
+	    } else if (TclGetLongFromObj(NULL, segment, &l) != TCL_OK) {
+		if (Tcl_GetWideIntFromObj(NULL, segment, &w) != TCL_OK) {
+		    Tcl_Obj *objPtr;
+
+		    if (Tcl_GetBignumFromObj(interp,segment,&big) != TCL_OK) {
+			goto error;
+		    }
+		    mp_mod_2d(&big, (int) CHAR_BIT * sizeof(long), &big);
+		    objPtr = Tcl_NewBignumObj(&big);
+		    Tcl_IncrRefCount(objPtr);
+		    TclGetLongFromObj(NULL, objPtr, &l);
+		    Tcl_DecrRefCount(objPtr);
+		} else {
+		    l = Tcl_WideAsLong(w);
+		}
+		if (useShort) {
+		    s = (short) l;
+		    isNegative = (s < (short) 0);
+		} else {
+		    isNegative = (l < (long) 0);
 		}
 	    } else if (useShort) {
 		s = (short) l;
@@ -2196,7 +2681,6 @@ Tcl_AppendFormatToObj(
 	case 'f':
 	case 'g':
 	case 'G': {
-#define MAX_FLOAT_SIZE 320
 	    char spec[2*TCL_INTEGER_SPACE + 9], *p = spec;
 	    double d;
 	    int length = MAX_FLOAT_SIZE;
@@ -2310,16 +2794,10 @@ Tcl_AppendFormatToObj(
 	    }
 	}
 
-	objIndex += gotSequential;
-    }
-    if (numBytes) {
-	if (numBytes > limit) {
-	    msg = overflow;
-	    goto errorMsg;
+    nextSpec:
+	if (!gotXpg) {
+	    objIndex++;
 	}
-	Tcl_AppendToObj(appendObj, span, numBytes);
-	limit -= numBytes;
-	numBytes = 0;
     }
 
     return TCL_OK;
@@ -2333,6 +2811,99 @@ Tcl_AppendFormatToObj(
     return TCL_ERROR;
 }
 
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_AppendFormatToObj --
+ *
+ *	This function appends a list of Tcl_Obj's to a Tcl_Obj according to
+ *	the formatting instructions embedded in the format string. The
+ *	formatting instructions are inspired by sprintf(). Returns TCL_OK when
+ *	successful. If there's an error in the arguments, TCL_ERROR is
+ *	returned, and an error message is written to the interp, if non-NULL.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_AppendFormatToObj(
+    Tcl_Interp *interp,
+    Tcl_Obj *appendObj,
+    const char *format,
+    int objc,
+    Tcl_Obj *const objv[])
+{
+    FormatProgram *programPtr = CompileFormat(format);
+    int result;
+
+    programPtr->refCount++;
+    result = AppendFormatProgram(interp, appendObj, programPtr, objc, objv);
+    ReleaseFormatProgram(programPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclFormatFromObj --
+ *
+ *	Like Tcl_Format, but takes the format string as an object and keeps
+ *	its compiled form in the internal rep of that object, so that it is
+ *	parsed only once however often it is used.
+ *
+ * Results:
+ *	A refcount zero Tcl_Obj, or NULL on error, with a message in the
+ *	interp result.
+ *
+ * Side effects:
+ *	May set the internal rep of formatObj.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclFormatFromObj(
+    Tcl_Interp *interp,
+    Tcl_Obj *formatObj,
+    int objc,
+    Tcl_Obj *const objv[])
+{
+    FormatProgram *programPtr;
+    Tcl_Obj *objPtr;
+
+    if (formatObj->typePtr == &formatType) {
+	programPtr = formatObj->internalRep.otherValuePtr;
+    } else {
+	programPtr = CompileFormat(TclGetString(formatObj));
+	TclFreeIntRep(formatObj);
+	formatObj->internalRep.otherValuePtr = programPtr;
+	formatObj->typePtr = &formatType;
+	programPtr->refCount++;
+    }
+
+    /*
+     * Hold on to the program, as the arguments may include the format
+     * object itself and converting it would free the internal rep.
+     */
+
+    programPtr->refCount++;
+    objPtr = Tcl_NewObj();
+    if (AppendFormatProgram(interp, objPtr, programPtr, objc,
+	    objv) != TCL_OK) {
+	Tcl_DecrRefCount(objPtr);
+	objPtr = NULL;
+    }
+    ReleaseFormatProgram(programPtr);
+    return objPtr;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -2480,70 +3051,315 @@ AppendPrintfToObjVA(
 	    case '5': case '6': case '7': case '8': case '9': {
 		char *end;
 
-		lastNum = (int) strtoul(p, &end, 10);
-		p = end;
-		break;
-	    }
-	    case '.':
-		gotPrecision = 1;
-		p++;
-		break;
-	    /* TODO: support for wide (and bignum?) arguments */
-	    case 'l':
-		size = 1;
-		p++;
-		break;
-	    case 'h':
-		size = -1;
-	    default:
-		p++;
-	    }
-	} while (seekingConversion);
+		lastNum = (int) strtoul(p, &end, 10);
+		p = end;
+		break;
+	    }
+	    case '.':
+		gotPrecision = 1;
+		p++;
+		break;
+	    /* TODO: support for wide (and bignum?) arguments */
+	    case 'l':
+		size = 1;
+		p++;
+		break;
+	    case 'h':
+		size = -1;
+	    default:
+		p++;
+	    }
+	} while (seekingConversion);
+    }
+    TclListObjGetElements(NULL, list, &objc, &objv);
+    code = Tcl_AppendFormatToObj(NULL, objPtr, format, objc, objv);
+    if (code != TCL_OK) {
+	Tcl_AppendPrintfToObj(objPtr,
+		"Unable to format \"%s\" with supplied arguments: %s",
+		format, Tcl_GetString(list));
+    }
+    Tcl_DecrRefCount(list);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * Tcl_AppendPrintfToObj --
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+void
+Tcl_AppendPrintfToObj(
+    Tcl_Obj *objPtr,
+    const char *format,
+    ...)
+{
+    va_list argList;
+
+    va_start(argList, format);
+    AppendPrintfToObjVA(objPtr, format, argList);
+    va_end(argList);
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * Tcl_ObjPrintf --
+ *
+ * Results:
+ *	A refcount zero Tcl_Obj.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+Tcl_ObjPrintf(
+    const char *format,
+    ...)
+{
+    va_list argList;
+    Tcl_Obj *objPtr = Tcl_NewObj();
+
+    va_start(argList, format);
+    AppendPrintfToObjVA(objPtr, format, argList);
+    va_end(argList);
+    return objPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclStringFirst, TclStringLast --
+ *
+ *	Implement [string first] and [string last]: find the first occurrence
+ *	of needle in haystack that starts at or after the character index
+ *	"start", or the last occurrence that ends at or before the character
+ *	index "last". The search is done on the bytes of the values when both
+ *	are pure byte arrays, on their UTF-8 strings when the haystack has no
+ *	Unicode rep, and on their Unicode reps otherwise.
+ *
+ * Results:
+ *	The character index in haystack of the start of the occurrence, or -1
+ *	if there is none. An empty needle never matches.
+ *
+ * Side effects:
+ *	May convert needle and haystack to the String type.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+int
+TclStringFirst(
+    Tcl_Obj *needle,		/* The string to look for. */
+    Tcl_Obj *haystack,		/* The string to look in. */
+    int start)			/* Index of the first character at which the
+				 * needle may start. */
+{
+    int needleLen, haystackLen, pos;
+
+    if (start < 0) {
+	start = 0;
+    }
+
+    if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
+	unsigned char *n = Tcl_GetByteArrayFromObj(needle, &needleLen);
+	unsigned char *h = Tcl_GetByteArrayFromObj(haystack, &haystackLen);
+
+	if (needleLen == 0 || start >= haystackLen) {
+	    return -1;
+	}
+	pos = SearchBytes(h + start, haystackLen - start, n, needleLen, 0);
+	return (pos < 0 ? -1 : start + pos);
+    }
+
+    if (UtfSearchable(needle, haystack)) {
+	const char *n = TclGetStringFromObj(needle, &needleLen);
+	const char *h = haystack->bytes;
+	int numChars = GET_STRING(haystack)->numChars, offset;
+
+	haystackLen = haystack->length;
+	if (needleLen == 0 || start >= numChars) {
+	    return -1;
+	}
+	if (numChars == haystackLen) {
+	    offset = start;
+	} else {
+	    offset = UtfAtCharIndex(haystack, start) - h;
+	}
+	pos = SearchBytes((const unsigned char *) h + offset,
+		haystackLen - offset, (const unsigned char *) n, needleLen, 0);
+	if (pos < 0) {
+	    return -1;
+	} else if (numChars == haystackLen) {
+	    return offset + pos;
+	}
+	return UtfCharIndexOfByte(haystack, offset + pos);
+    } else {
+	const Tcl_UniChar *n = Tcl_GetUnicodeFromObj(needle, &needleLen);
+	const Tcl_UniChar *h = Tcl_GetUnicodeFromObj(haystack, &haystackLen);
+
+	if (needleLen == 0 || start >= haystackLen) {
+	    return -1;
+	}
+	pos = SearchUniChars(h + start, haystackLen - start, n, needleLen, 0);
+	return (pos < 0 ? -1 : start + pos);
     }
-    TclListObjGetElements(NULL, list, &objc, &objv);
-    code = Tcl_AppendFormatToObj(NULL, objPtr, format, objc, objv);
-    if (code != TCL_OK) {
-	Tcl_AppendPrintfToObj(objPtr,
-		"Unable to format \"%s\" with supplied arguments: %s",
-		format, Tcl_GetString(list));
+}
+
+int
+TclStringLast(
+    Tcl_Obj *needle,		/* The string to look for. */
+    Tcl_Obj *haystack,		/* The string to look in. */
+    int last)			/* Index of the last character at which the
+				 * needle may end. */
+{
+    int needleLen, haystackLen, pos;
+
+    if (last < 0) {
+	return -1;
+    }
+
+    if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
+	unsigned char *n = Tcl_GetByteArrayFromObj(needle, &needleLen);
+	unsigned char *h = Tcl_GetByteArrayFromObj(haystack, &haystackLen);
+
+	if (last >= haystackLen) {
+	    last = haystackLen - 1;
+	}
+	if (needleLen == 0) {
+	    return -1;
+	}
+	return SearchBytes(h, last + 1, n, needleLen, 1);
+    }
+
+    if (UtfSearchable(needle, haystack)) {
+	const char *n = TclGetStringFromObj(needle, &needleLen);
+	const char *h = haystack->bytes;
+	int numChars = GET_STRING(haystack)->numChars, end;
+
+	haystackLen = haystack->length;
+	if (last >= numChars) {
+	    last = numChars - 1;
+	}
+	if (needleLen == 0) {
+	    return -1;
+	}
+	if (numChars == haystackLen) {
+	    end = last + 1;
+	} else if (last + 1 == numChars) {
+	    end = haystackLen;
+	} else {
+	    end = UtfAtCharIndex(haystack, last + 1) - h;
+	}
+	pos = SearchBytes((const unsigned char *) h, end,
+		(const unsigned char *) n, needleLen, 1);
+	if (pos < 0 || numChars == haystackLen) {
+	    return pos;
+	}
+	return UtfCharIndexOfByte(haystack, pos);
+    } else {
+	const Tcl_UniChar *n = Tcl_GetUnicodeFromObj(needle, &needleLen);
+	const Tcl_UniChar *h = Tcl_GetUnicodeFromObj(haystack, &haystackLen);
+
+	if (last >= haystackLen) {
+	    last = haystackLen - 1;
+	}
+	if (needleLen == 0) {
+	    return -1;
+	}
+	return SearchUniChars(h, last + 1, n, needleLen, 1);
     }
-    Tcl_DecrRefCount(list);
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * Tcl_AppendPrintfToObj --
+ * UtfSearchable --
+ *
+ *	Decide whether TclStringFirst and TclStringLast may look for needle in
+ *	the UTF-8 string of haystack instead of in its Unicode rep. That is
+ *	only worth it when haystack has no Unicode rep yet, and only right
+ *	when a byte for byte match is a match of whole characters: the needle
+ *	must not start with a trail byte, which could match inside a
+ *	character, nor contain a lead byte that is not followed by its trail
+ *	bytes, which could match the start of a complete character.
  *
  * Results:
- *	A standard Tcl result.
+ *	1 if the UTF-8 strings can be searched, 0 otherwise.
  *
  * Side effects:
- *	None.
+ *	Converts haystack to the String type and counts its characters.
  *
  *---------------------------------------------------------------------------
  */
 
-void
-Tcl_AppendPrintfToObj(
-    Tcl_Obj *objPtr,
-    const char *format,
-    ...)
+static int
+UtfSearchable(
+    Tcl_Obj *needle,
+    Tcl_Obj *haystack)
 {
-    va_list argList;
+    String *stringPtr;
+    const char *p, *end;
+    int length;
+    Tcl_UniChar ch;
 
-    va_start(argList, format);
-    AppendPrintfToObjVA(objPtr, format, argList);
-    va_end(argList);
+    SetStringFromAny(NULL, haystack);
+    stringPtr = GET_STRING(haystack);
+    if (stringPtr->hasUnicode) {
+	return 0;
+    }
+    if (stringPtr->numChars == -1) {
+	TclNumUtfChars(stringPtr->numChars, haystack->bytes,
+		haystack->length);
+    }
+
+    p = TclGetStringFromObj(needle, &length);
+    end = p + length;
+    if (length > 0 && (UCHAR(*p) & 0xC0) == 0x80) {
+	return 0;
+    }
+    while (p < end) {
+	int run = TclUtfSingleByteLength(p, end - p);
+
+	p += run;
+	if (p < end) {
+	    int bytes = TclUtfToUniChar(p, &ch);
+
+	    if (bytes == 1) {
+		return 0;
+	    }
+	    p += bytes;
+	}
+    }
+    return 1;
 }
 
 /*
  *---------------------------------------------------------------------------
  *
- * Tcl_ObjPrintf --
+ * SearchBytes, SearchUniChars --
+ *
+ *	Find the first (or last) occurrence of needle in haystack, for arrays
+ *	of bytes or of Tcl_UniChar. Short needles are found by looking for
+ *	their first element and comparing the rest. Longer ones are found with
+ *	the Boyer-Moore-Horspool algorithm, which moves the window by up to
+ *	the length of the needle at each step, depending on the element at
+ *	its far end. For Tcl_UniChar the shifts are indexed by the low byte of
+ *	the element, which keeps them safe with a table of 256 entries.
  *
  * Results:
- *	A refcount zero Tcl_Obj.
+ *	The offset of the occurrence in haystack, or -1 if there is none.
+ *	needleLen must be at least 1.
  *
  * Side effects:
  *	None.
@@ -2551,18 +3367,133 @@ Tcl_AppendPrintfToObj(
  *---------------------------------------------------------------------------
  */
 
-Tcl_Obj *
-Tcl_ObjPrintf(
-    const char *format,
-    ...)
+#define SEARCH_SKIP_MIN 4
+
+static int
+SearchBytes(
+    const unsigned char *haystack,
+    int haystackLen,
+    const unsigned char *needle,
+    int needleLen,
+    int last)			/* Whether to find the last occurrence. */
 {
-    va_list argList;
-    Tcl_Obj *objPtr = Tcl_NewObj();
+    int skip[256], i, pos;
 
-    va_start(argList, format);
-    AppendPrintfToObjVA(objPtr, format, argList);
-    va_end(argList);
-    return objPtr;
+    if (needleLen > haystackLen) {
+	return -1;
+    }
+    if (needleLen < SEARCH_SKIP_MIN) {
+	if (!last) {
+	    const unsigned char *p = haystack;
+	    const unsigned char *end = haystack + haystackLen - needleLen + 1;
+
+	    while ((p = memchr(p, needle[0], (size_t) (end - p))) != NULL) {
+		if (memcmp(p + 1, needle + 1, (size_t) needleLen - 1) == 0) {
+		    return p - haystack;
+		}
+		p++;
+	    }
+	} else {
+	    for (pos = haystackLen - needleLen; pos >= 0; pos--) {
+		if (haystack[pos] == needle[0] && memcmp(haystack + pos + 1,
+			needle + 1, (size_t) needleLen - 1) == 0) {
+		    return pos;
+		}
+	    }
+	}
+	return -1;
+    }
+
+    for (i = 0; i < 256; i++) {
+	skip[i] = needleLen;
+    }
+    if (!last) {
+	for (i = 0; i < needleLen - 1; i++) {
+	    skip[needle[i]] = needleLen - 1 - i;
+	}
+	for (pos = 0; pos <= haystackLen - needleLen;
+		pos += skip[haystack[pos + needleLen - 1]]) {
+	    if (haystack[pos + needleLen - 1] == needle[needleLen - 1]
+		    && memcmp(haystack + pos, needle,
+			    (size_t) needleLen - 1) == 0) {
+		return pos;
+	    }
+	}
+    } else {
+	for (i = needleLen - 1; i > 0; i--) {
+	    skip[needle[i]] = i;
+	}
+	for (pos = haystackLen - needleLen; pos >= 0;
+		pos -= skip[haystack[pos]]) {
+	    if (haystack[pos] == needle[0] && memcmp(haystack + pos + 1,
+		    needle + 1, (size_t) needleLen - 1) == 0) {
+		return pos;
+	    }
+	}
+    }
+    return -1;
+}
+
+static int
+SearchUniChars(
+    const Tcl_UniChar *haystack,
+    int haystackLen,
+    const Tcl_UniChar *needle,
+    int needleLen,
+    int last)			/* Whether to find the last occurrence. */
+{
+    int skip[256], i, pos;
+    size_t restSize = (needleLen - 1) * sizeof(Tcl_UniChar);
+
+    if (needleLen > haystackLen) {
+	return -1;
+    }
+    if (needleLen < SEARCH_SKIP_MIN) {
+	if (!last) {
+	    for (pos = 0; pos <= haystackLen - needleLen; pos++) {
+		if (haystack[pos] == needle[0] && memcmp(haystack + pos + 1,
+			needle + 1, restSize) == 0) {
+		    return pos;
+		}
+	    }
+	} else {
+	    for (pos = haystackLen - needleLen; pos >= 0; pos--) {
+		if (haystack[pos] == needle[0] && memcmp(haystack + pos + 1,
+			needle + 1, restSize) == 0) {
+		    return pos;
+		}
+	    }
+	}
+	return -1;
+    }
+
+    for (i = 0; i < 256; i++) {
+	skip[i] = needleLen;
+    }
+    if (!last) {
+	for (i = 0; i < needleLen - 1; i++) {
+	    skip[needle[i] & 0xFF] = needleLen - 1 - i;
+	}
+	for (pos = 0; pos <= haystackLen - needleLen;
+		pos += skip[haystack[pos + needleLen - 1] & 0xFF]) {
+	    if (haystack[pos + needleLen - 1] == needle[needleLen - 1]
+		    && memcmp(haystack + pos, needle, restSize) == 0) {
+		return pos;
+	    }
+	}
+    } else {
+	for (i = needleLen - 1; i > 0; i--) {
+	    skip[needle[i] & 0xFF] = i;
+	}
+	for (pos = haystackLen - needleLen; pos >= 0;
+		pos -= skip[haystack[pos] & 0xFF]) {
+	    if (haystack[pos] == needle[0] && memcmp(haystack + pos + 1,
+		    needle + 1, restSize) == 0) {
+		return pos;
+	    }
+	}
+    }
+    return -1;
 }
 
 /*
@@ -2615,6 +3546,8 @@ TclStringObjReverse(
 		return resultPtr;
 	    }
 	    /* Unshared.  Reverse objPtr->bytes in place. */
+	    stringPtr->hashValid = 0;
+	    stringFreeIndex(stringPtr);
 	    dest = objPtr->bytes;
 	    src = dest + objPtr->length - 1;
 	    while (dest < src) {
@@ -2661,9 +3594,86 @@ TclStringObjReverse(
 
     TclInvalidateStringRep(objPtr);
     stringPtr->allocated = 0;
+    stringPtr->hashValid = 0;
+    stringFreeIndex(stringPtr);
     return objPtr;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclFetchStringHash, TclStoreStringHash, TclPrepareStringHash --
+ *
+ *	Access the hash value of the string rep of a value that is cached in
+ *	its "String" internal rep by TclHashObjKey. The cache is forgotten
+ *	whenever the string changes.
+ *
+ * Results:
+ *	TclFetchStringHash returns 1 and stores the hash value in *hashPtr
+ *	if a valid hash is cached, and 0 otherwise.
+ *
+ * Side effects:
+ *	TclStoreStringHash only records the hash in values that already have
+ *	a "String" internal rep; hashing must never change a value's internal
+ *	rep, since callers may be in the middle of setting one up (variable
+ *	name lookup does exactly that). TclPrepareStringHash converts shared
+ *	pure strings to the "String" type so that a hash can be kept; it is
+ *	for callers that know the key's internal rep is theirs to change.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+int
+TclFetchStringHash(
+    Tcl_Obj *objPtr,		/* Value whose string rep was hashed. */
+    unsigned int *hashPtr)	/* Where to write the hash value. */
+{
+    String *stringPtr;
+
+    if (objPtr->typePtr != &tclStringType || objPtr->bytes == NULL) {
+	return 0;
+    }
+    stringPtr = GET_STRING(objPtr);
+    if (!stringPtr->hashValid) {
+	return 0;
+    }
+    *hashPtr = stringPtr->hash;
+    return 1;
+}
+
+void
+TclStoreStringHash(
+    Tcl_Obj *objPtr,		/* Value whose string rep was hashed. */
+    unsigned int hash)		/* Hash value of the string rep. */
+{
+    String *stringPtr;
+
+    if (objPtr->typePtr != &tclStringType || objPtr->bytes == NULL) {
+	return;
+    }
+    stringPtr = GET_STRING(objPtr);
+    stringPtr->hash = hash;
+    stringPtr->hashValid = 1;
+}
+
+void
+TclPrepareStringHash(
+    Tcl_Obj *objPtr)		/* Value about to be used as a hash key. */
+{
+    if (objPtr->typePtr == NULL && objPtr->bytes != NULL
+	    && objPtr->refCount > 1) {
+	/*
+	 * A pure string that is referred to from several places (literals
+	 * and values held in variables are typical) is very likely to be
+	 * used as a key again, so it is worth giving it somewhere to keep
+	 * the hash. Unshared values, such as most freshly parsed dict keys,
+	 * are not converted to avoid the memory cost.
+	 */
+
+	SetStringFromAny(NULL, objPtr);
+    }
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -2718,12 +3728,173 @@ ExtendUnicodeRepWithString(
 
     stringPtr->hasUnicode = 1;
     stringPtr->numChars = needed;
-    for (dst=stringPtr->unicode + numOrigChars; numAppendChars-- > 0; dst++) {
-	bytes += TclUtfToUniChar(bytes, dst);
+    dst = stringPtr->unicode + numOrigChars;
+    while (numAppendChars > 0) {
+	/*
+	 * Copy runs of single-byte characters without decoding them.
+	 */
+
+	int run = TclUtfSingleByteLength(bytes, numAppendChars);
+
+	numAppendChars -= run;
+	while (run-- > 0) {
+	    *dst++ = (Tcl_UniChar) UCHAR(*bytes++);
+	}
+	if (numAppendChars > 0) {
+	    bytes += TclUtfToUniChar(bytes, dst);
+	    dst++;
+	    numAppendChars--;
+	}
     }
     *dst = 0;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * UtfAtCharIndex --
+ *
+ *	Locate a character in the UTF string of a String object that has no
+ *	Unicode rep, using and extending the object's CharIndex. The object
+ *	must hold multi-byte characters and the index must be in range.
+ *
+ * Results:
+ *	Returns a pointer to the first byte of the index'th character.
+ *
+ * Side effects:
+ *	May allocate or grow the CharIndex of the object.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static const char *
+UtfAtCharIndex(
+    Tcl_Obj *objPtr,		/* String object to index into. */
+    int index)			/* Index of the character to find. */
+{
+    String *stringPtr = GET_STRING(objPtr);
+    CharIndex *indexPtr = stringPtr->charIndex;
+    int entry = index / CHAR_INDEX_STRIDE;
+    const char *p;
+
+    if (indexPtr == NULL) {
+	int maxEntries = stringPtr->numChars / CHAR_INDEX_STRIDE + 1;
+
+	indexPtr = (CharIndex *) ckalloc(CHAR_INDEX_SIZE(maxEntries));
+	indexPtr->numEntries = 1;
+	indexPtr->maxEntries = maxEntries;
+	indexPtr->lastChar = 0;
+	indexPtr->lastByte = 0;
+	indexPtr->offsets[0] = 0;
+	stringPtr->charIndex = indexPtr;
+    }
+
+    if (index >= indexPtr->lastChar
+	    && index - indexPtr->lastChar <= index % CHAR_INDEX_STRIDE) {
+	/*
+	 * The last character looked up is at least as close as the nearest
+	 * entry; start from there.
+	 */
+
+	p = Tcl_UtfAtIndex(objPtr->bytes + indexPtr->lastByte,
+		index - indexPtr->lastChar);
+    } else {
+	if (entry >= indexPtr->numEntries) {
+	    /*
+	     * Fill in the entries up to the one needed. The string may have
+	     * been appended to since the index was allocated.
+	     */
+
+	    if (entry >= indexPtr->maxEntries) {
+		int maxEntries = stringPtr->numChars / CHAR_INDEX_STRIDE + 1;
+
+		indexPtr = (CharIndex *) ckrealloc((char *) indexPtr,
+			CHAR_INDEX_SIZE(maxEntries));
+		indexPtr->maxEntries = maxEntries;
+		stringPtr->charIndex = indexPtr;
+	    }
+	    p = objPtr->bytes + indexPtr->offsets[indexPtr->numEntries - 1];
+	    while (indexPtr->numEntries <= entry) {
+		p = Tcl_UtfAtIndex(p, CHAR_INDEX_STRIDE);
+		indexPtr->offsets[indexPtr->numEntries++] = p - objPtr->bytes;
+	    }
+	}
+	p = Tcl_UtfAtIndex(objPtr->bytes + indexPtr->offsets[entry],
+		index % CHAR_INDEX_STRIDE);
+    }
+
+    indexPtr->lastChar = index;
+    indexPtr->lastByte = p - objPtr->bytes;
+    return p;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * UtfCharIndexOfByte --
+ *
+ *	The reverse of UtfAtCharIndex: find the index of the character that
+ *	starts at a byte offset in the UTF string of a String object that has
+ *	no Unicode rep, using and extending the object's CharIndex. The object
+ *	must hold multi-byte characters and the offset must be that of the
+ *	first byte of a character.
+ *
+ * Results:
+ *	Returns the index of the character.
+ *
+ * Side effects:
+ *	May allocate or grow the CharIndex of the object.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+UtfCharIndexOfByte(
+    Tcl_Obj *objPtr,		/* String object to index into. */
+    int offset)			/* Byte offset of the character. */
+{
+    String *stringPtr = GET_STRING(objPtr);
+    CharIndex *indexPtr;
+    int lo, hi;
+
+    /*
+     * Make sure the CharIndex has its entries up to one past the offset, or
+     * up to the end of the string, by looking up the character there.
+     */
+
+    UtfAtCharIndex(objPtr, 0);
+    indexPtr = stringPtr->charIndex;
+    if (indexPtr->offsets[indexPtr->numEntries - 1] <= offset) {
+	int entry = (stringPtr->numChars - 1) / CHAR_INDEX_STRIDE;
+
+	while (indexPtr->numEntries <= entry
+		&& indexPtr->offsets[indexPtr->numEntries - 1] <= offset) {
+	    UtfAtCharIndex(objPtr, indexPtr->numEntries * CHAR_INDEX_STRIDE);
+	    indexPtr = stringPtr->charIndex;
+	}
+    }
+
+    /*
+     * Find the last entry at or before the offset, and count the characters
+     * from there.
+     */
+
+    lo = 0;
+    hi = indexPtr->numEntries - 1;
+    while (lo < hi) {
+	int mid = (lo + hi + 1) / 2;
+
+	if (indexPtr->offsets[mid] <= offset) {
+	    lo = mid;
+	} else {
+	    hi = mid - 1;
+	}
+    }
+    return lo * CHAR_INDEX_STRIDE + Tcl_NumUtfChars(
+	    objPtr->bytes + indexPtr->offsets[lo],
+	    offset - indexPtr->offsets[lo]);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2781,6 +3952,8 @@ DupStringInternalRep(
     }
     copyStringPtr->hasUnicode = srcStringPtr->hasUnicode;
     copyStringPtr->numChars = srcStringPtr->numChars;
+    copyStringPtr->hashValid = 0;
+    copyStringPtr->charIndex = NULL;
 
     /*
      * Tricky point: the string value was copied by generic object
@@ -2817,6 +3990,8 @@ DupStringInternalRep(
     }
     copyStringPtr->numChars = srcStringPtr->numChars;
     copyStringPtr->hasUnicode = srcStringPtr->hasUnicode;
+    copyStringPtr->hashValid = 0;
+    copyStringPtr->charIndex = NULL;
 #endif
 
     SET_STRING(copyPtr, copyStringPtr);
@@ -2864,6 +4039,8 @@ SetStringFromAny(
 	stringPtr->allocated = objPtr->length;
 	stringPtr->maxChars = 0;
 	stringPtr->hasUnicode = 0;
+	stringPtr->hashValid = 0;
+	stringPtr->charIndex = NULL;
 	SET_STRING(objPtr, stringPtr);
 	objPtr->typePtr = &tclStringType;
     }
@@ -2893,6 +4070,8 @@ UpdateStringOfString(
     Tcl_Obj *objPtr)		/* Object with string rep to update. */
 {
     String *stringPtr = GET_STRING(objPtr);
+
+    stringFreeIndex(stringPtr);
     if (stringPtr->numChars == 0) {
 	TclInitStringRep(objPtr, tclEmptyStringRep, 0);
     } else {
@@ -2975,7 +4154,10 @@ static void
 FreeStringInternalRep(
     Tcl_Obj *objPtr)		/* Object with internal rep to free. */
 {
-    ckfree((char *) GET_STRING(objPtr));
+    String *stringPtr = GET_STRING(objPtr);
+
+    stringFreeIndex(stringPtr);
+    ckfree((char *) stringPtr);
     objPtr->typePtr = NULL;
 }
 
@@ -403,6 +403,9 @@ static Tcl_FSMatchInDirectoryProc SimpleMatchInDirectory;
 static int		TestNumUtfCharsCmd(ClientData clientData,
 			    Tcl_Interp *interp, int objc,
 			    Tcl_Obj *const objv[]);
+static int		TestHashIncrementalCmd(ClientData clientData,
+			    Tcl_Interp *interp, int objc,
+			    Tcl_Obj *const objv[]);
 static int		TestHashSystemHashCmd(ClientData clientData,
 			    Tcl_Interp *interp, int objc,
 			    Tcl_Obj *const objv[]);
@@ -607,6 +610,8 @@ Tcltest_Init(
 	    NULL, NULL);
     Tcl_CreateObjCommand(interp, "testfile", TestfileCmd,
 	    NULL, NULL);
+    Tcl_CreateObjCommand(interp, "testhashincremental",
+	    TestHashIncrementalCmd, NULL, NULL);
     Tcl_CreateObjCommand(interp, "testhashsystemhash",
 	    TestHashSystemHashCmd, NULL, NULL);
     Tcl_CreateCommand(interp, "testgetassocdata", TestgetassocdataCmd,
@@ -1651,14 +1656,16 @@ TestdoubledigitsObjCmd(ClientData unused,
     int ndigits;
     int type;
     int decpt;
+    int i;
     int signum;
     char* str;
     char* endPtr;
     Tcl_Obj* strObj;
     Tcl_Obj* retval;
 
-    if (objc < 4 || objc > 5) {
-	Tcl_WrongNumArgs(interp, 1, objv, "fpval ndigits type ?shorten?");
+    if (objc < 4 || objc > 6) {
+	Tcl_WrongNumArgs(interp, 1, objv,
+		"fpval ndigits type ?shorten? ?noquick?");
 	return TCL_ERROR;
     }
     status = Tcl_GetDoubleFromObj(interp, objv[1], &d);
@@ -1678,12 +1685,15 @@ TestdoubledigitsObjCmd(ClientData unused,
 	return TCL_ERROR;
     }
     type = types[type];
-    if (objc > 4) {
-	if (strcmp(Tcl_GetString(objv[4]), "shorten")) {
+    for (i = 4; i < objc; i++) {
+	if (!strcmp(Tcl_GetString(objv[i]), "shorten")) {
+	    type |= TCL_DD_SHORTEN_FLAG;
+	} else if (!strcmp(Tcl_GetString(objv[i]), "noquick")) {
+	    type |= TCL_DD_NO_QUICK;
+	} else {
 	    Tcl_SetObjResult(interp, Tcl_NewStringObj("bad flag", -1));
 	    return TCL_ERROR;
 	}
-	type |= TCL_DD_SHORTEN_FLAG;
     }
     str = TclDoubleDigits(d, ndigits, type, &decpt, &signum, &endPtr);
     strObj = Tcl_NewStringObj(str, endPtr-str);
@@ -6686,6 +6696,139 @@ TestHashSystemHashCmd(
     return TCL_OK;
 }
 
+/*
+ * Used to check that hash tables with the TCL_HASH_KEY_INCREMENTAL_RESIZE flag
+ * keep working while they are part-way through a resize.
+ */
+
+static int
+TestHashIncrementalCmd(
+    ClientData clientData,
+    Tcl_Interp *interp,
+    int objc,
+    Tcl_Obj *const objv[])
+{
+    static const Tcl_HashKeyType hkType = {
+	TCL_HASH_KEY_TYPE_VERSION, TCL_HASH_KEY_INCREMENTAL_RESIZE,
+	NULL, NULL, NULL, NULL
+    };
+    Tcl_HashTable hash;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    int i, isNew, count, total, buckets, last, limit = 100;
+
+    if (objc>1 && Tcl_GetIntFromObj(interp, objv[1], &limit)!=TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    Tcl_InitCustomHashTable(&hash, TCL_CUSTOM_TYPE_KEYS, &hkType);
+
+    /*
+     * Interleave insertions, lookups of older entries and deletions so that
+     * all of them happen while old buckets are still being migrated.
+     */
+
+    for (i=0 ; i<limit ; i++) {
+	hPtr = Tcl_CreateHashEntry(&hash, INT2PTR(i), &isNew);
+	if (!isNew) {
+	    Tcl_SetObjResult(interp, Tcl_NewIntObj(i));
+	    Tcl_AppendToObj(Tcl_GetObjResult(interp)," creation problem",-1);
+	    Tcl_DeleteHashTable(&hash);
+	    return TCL_ERROR;
+	}
+	Tcl_SetHashValue(hPtr, INT2PTR(i+42));
+
+	hPtr = Tcl_FindHashEntry(&hash, (char *) INT2PTR(i/2));
+	if (hPtr == NULL || PTR2INT(Tcl_GetHashValue(hPtr)) != i/2+42) {
+	    Tcl_SetObjResult(interp, Tcl_NewIntObj(i/2));
+	    Tcl_AppendToObj(Tcl_GetObjResult(interp)," lookup problem",-1);
+	    Tcl_DeleteHashTable(&hash);
+	    return TCL_ERROR;
+	}
+	if (i%3 == 2) {
+	    hPtr = Tcl_FindHashEntry(&hash, (char *) INT2PTR(i/3));
+	    if (hPtr == NULL) {
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(i/3));
+		Tcl_AppendToObj(Tcl_GetObjResult(interp)," deletion problem",-1);
+		Tcl_DeleteHashTable(&hash);
+		return TCL_ERROR;
+	    }
+	    Tcl_DeleteHashEntry(hPtr);
+	}
+    }
+
+    if (hash.numEntries != limit - limit/3) {
+	Tcl_AppendResult(interp, "unexpected maximal size", NULL);
+	Tcl_DeleteHashTable(&hash);
+	return TCL_ERROR;
+    }
+
+    for (i=0 ; i<limit/3 ; i++) {
+	if (Tcl_FindHashEntry(&hash, (char *) INT2PTR(i)) != NULL) {
+	    Tcl_SetObjResult(interp, Tcl_NewIntObj(i));
+	    Tcl_AppendToObj(Tcl_GetObjResult(interp)," not deleted",-1);
+	    Tcl_DeleteHashTable(&hash);
+	    return TCL_ERROR;
+	}
+    }
+
+    /*
+     * Add entries until the table grows, then only read from it: a large
+     * table must still find all of its entries, and those lookups alone must
+     * finish off the resize.
+     */
+
+    buckets = hash.numBuckets;
+    for (last=limit ; hash.numBuckets == buckets ; last++) {
+	hPtr = Tcl_CreateHashEntry(&hash, INT2PTR(last), &isNew);
+	Tcl_SetHashValue(hPtr, INT2PTR(last+42));
+    }
+    for (i=limit/3 ; i<last ; i++) {
+	hPtr = Tcl_FindHashEntry(&hash, (char *) INT2PTR(i));
+	if (hPtr == NULL || PTR2INT(Tcl_GetHashValue(hPtr)) != i+42) {
+	    Tcl_SetObjResult(interp, Tcl_NewIntObj(i));
+	    Tcl_AppendToObj(Tcl_GetObjResult(interp)," lookup problem",-1);
+	    Tcl_DeleteHashTable(&hash);
+	    return TCL_ERROR;
+	}
+    }
+    if (hash.buckets != hash.staticBuckets && hash.staticBuckets[0] != NULL) {
+	Tcl_AppendResult(interp, "resize not finished by lookups", NULL);
+	Tcl_DeleteHashTable(&hash);
+	return TCL_ERROR;
+    }
+
+    /*
+     * Check that a search sees every entry once, even with lookups and
+     * deletions of the entries it returns going on.
+     */
+
+    total = hash.numEntries;
+    count = 0;
+    for (hPtr = Tcl_FirstHashEntry(&hash, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	if (PTR2INT(Tcl_GetHashValue(hPtr)) < 0) {
+	    Tcl_AppendResult(interp, "search returned an entry twice", NULL);
+	    Tcl_DeleteHashTable(&hash);
+	    return TCL_ERROR;
+	}
+	Tcl_SetHashValue(hPtr, INT2PTR(-1));
+	Tcl_FindHashEntry(&hash, (char *) INT2PTR(count));
+	if (count++ % 5 == 0) {
+	    Tcl_DeleteHashEntry(hPtr);
+	}
+    }
+    if (count != total || hash.numEntries != total - (total + 4) / 5) {
+	Tcl_AppendResult(interp, "search problem", NULL);
+	Tcl_DeleteHashTable(&hash);
+	return TCL_ERROR;
+    }
+
+    Tcl_DeleteHashTable(&hash);
+    Tcl_AppendResult(interp, "OK", NULL);
+    return TCL_OK;
+}
+
 /*
  * Used for testing Tcl_GetInt which is no longer used directly by the
  * core very much.
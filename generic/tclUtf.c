@@ -88,6 +88,19 @@ static const unsigned char totalBytes[256] = {
 #endif
 };
 
+/*
+ * Macros for scanning UTF-8 strings a machine word at a time. WORD_ONES has a
+ * 1 in the low bit of every byte and WORD_HIGH_BITS the high bit of every
+ * byte. HAS_NON_ASCII is nonzero if any byte of the word is 0x80 or above and
+ * HAS_LEAD_BYTE is nonzero if any byte is 0xC0 or above, i.e. could start a
+ * multi-byte character.
+ */
+
+#define WORD_ONES		(~(size_t) 0 / 0xff)
+#define WORD_HIGH_BITS		(WORD_ONES * 0x80)
+#define HAS_NON_ASCII(w)	((w) & WORD_HIGH_BITS)
+#define HAS_LEAD_BYTE(w)	((w) & ((w) << 1) & WORD_HIGH_BITS)
+
 /*
  * Functions used only in this module.
  */
@@ -425,8 +438,15 @@ Tcl_UtfToUniCharDString(
     w = wString;
     end = src + length;
     for (p = src; p < end; ) {
-	p += TclUtfToUniChar(p, w);
-	w++;
+	int run = TclUtfSingleByteLength(p, end - p);
+
+	while (run-- > 0) {
+	    *w++ = (Tcl_UniChar) UCHAR(*p++);
+	}
+	if (p < end) {
+	    p += TclUtfToUniChar(p, w);
+	    w++;
+	}
     }
     *w = '\0';
     Tcl_DStringSetLength(dsPtr,
@@ -491,38 +511,106 @@ Tcl_NumUtfChars(
 				 * for strlen(string). */
 {
     Tcl_UniChar ch;
-    register Tcl_UniChar *chPtr = &ch;
-    register int i;
+    register int i = 0, n;
 
     /*
-     * The separate implementations are faster.
-     *
-     * Since this is a time-sensitive function, we also do the check for the
-     * single-byte char case specially.
+     * Runs of single-byte characters are skipped a word at a time; only the
+     * multi-byte characters between them are decoded.
      */
 
-    i = 0;
     if (length < 0) {
-	while (*src != '\0') {
-	    src += TclUtfToUniChar(src, chPtr);
+	length = strlen(src);
+    }
+    while (length > 0) {
+	n = TclUtfSingleByteLength(src, length);
+	i += n;
+	src += n;
+	length -= n;
+	if (length > 0) {
+	    n = Tcl_UtfToUniChar(src, &ch);
+	    length -= n;
+	    src += n;
 	    i++;
 	}
-    } else {
-	register int n;
+    }
+    return i;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclUtfAsciiLength, TclUtfSingleByteLength --
+ *
+ *	Measure the leading run of ASCII bytes (TclUtfAsciiLength), or of
+ *	bytes below 0xC0, each of which is a character by itself
+ *	(TclUtfSingleByteLength), in a UTF-8 string. The bytes are examined a
+ *	machine word at a time.
+ *
+ * Results:
+ *	The number of bytes in the run; equal to length if the whole string
+ *	qualifies.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
 
-	while (length > 0) {
-	    if (UCHAR(*src) < 0xC0) {
-		length--;
-		src++;
-	    } else {
-		n = Tcl_UtfToUniChar(src, chPtr);
-		length -= n;
-		src += n;
-	    }
-	    i++;
+int
+TclUtfAsciiLength(
+    const char *src,		/* The UTF-8 string to scan. */
+    int length)			/* The length of the string in bytes. */
+{
+    const char *p = src, *end = src + length;
+    size_t w[4];
+
+    while (end - p >= (int) sizeof(w)) {
+	memcpy(w, p, sizeof(w));
+	if (HAS_NON_ASCII(w[0] | w[1] | w[2] | w[3])) {
+	    break;
 	}
+	p += sizeof(w);
     }
-    return i;
+    while (end - p >= (int) sizeof(size_t)) {
+	memcpy(w, p, sizeof(size_t));
+	if (HAS_NON_ASCII(w[0])) {
+	    break;
+	}
+	p += sizeof(size_t);
+    }
+    while (p < end && UCHAR(*p) < 0x80) {
+	p++;
+    }
+    return p - src;
+}
+
+int
+TclUtfSingleByteLength(
+    const char *src,		/* The UTF-8 string to scan. */
+    int length)			/* The length of the string in bytes. */
+{
+    const char *p = src, *end = src + length;
+    size_t w[4];
+
+    while (end - p >= (int) sizeof(w)) {
+	memcpy(w, p, sizeof(w));
+	if (HAS_LEAD_BYTE(w[0]) | HAS_LEAD_BYTE(w[1])
+		| HAS_LEAD_BYTE(w[2]) | HAS_LEAD_BYTE(w[3])) {
+	    break;
+	}
+	p += sizeof(w);
+    }
+    while (end - p >= (int) sizeof(size_t)) {
+	memcpy(w, p, sizeof(size_t));
+	if (HAS_LEAD_BYTE(w[0])) {
+	    break;
+	}
+	p += sizeof(size_t);
+    }
+    while (p < end && UCHAR(*p) < 0xC0) {
+	p++;
+    }
+    return p - src;
 }
 
 /*
@@ -739,10 +827,40 @@ Tcl_UtfAtIndex(
     register int index)		/* The position of the desired character. */
 {
     Tcl_UniChar ch;
+    size_t w;
+
+    /*
+     * The caller guarantees that the string holds at least index more
+     * characters, so a whole word can be examined whenever index is at
+     * least the word size.
+     */
 
     while (index > 0) {
+	if (index >= (int) sizeof(size_t)) {
+	    memcpy(&w, src, sizeof(size_t));
+	    if (!HAS_LEAD_BYTE(w)) {
+		src += sizeof(size_t);
+		index -= sizeof(size_t);
+		continue;
+	    }
+	}
 	index--;
-	src += TclUtfToUniChar(src, &ch);
+
+	/*
+	 * Step over the character without decoding it, following the rules
+	 * of Tcl_UtfToUniChar for malformed sequences.
+	 */
+
+	if (UCHAR(*src) < 0xC0) {
+	    src++;
+	} else if (UCHAR(*src) < 0xE0) {
+	    src += ((src[1] & 0xC0) == 0x80) ? 2 : 1;
+	} else if (UCHAR(*src) < 0xF0) {
+	    src += (((src[1] & 0xC0) == 0x80) && ((src[2] & 0xC0) == 0x80))
+		    ? 3 : 1;
+	} else {
+	    src += Tcl_UtfToUniChar(src, &ch);
+	}
     }
     return src;
 }
@@ -60,14 +60,91 @@ static ProcessGlobalValue executableName = {
 
 static Tcl_ThreadDataKey precisionKey;
 
+/*
+ * A glob pattern compiled by TclNewGlobPattern is split at its stars into
+ * segments. Each segment matches a fixed number of characters, and is a
+ * sequence of atoms: runs of literal characters, runs of "?" and bracketed
+ * classes of characters. Literal characters are compared as UTF-8 bytes, or
+ * one character at a time when case is ignored; their ASCII letters are then
+ * kept in lower case.
+ */
+
+typedef enum GlobAtomType {
+    GLOB_LITERAL,		/* Characters that must be there. */
+    GLOB_ANY,			/* A run of "?". */
+    GLOB_CLASS			/* A bracketed class of characters. */
+} GlobAtomType;
+
+typedef struct GlobAtom {
+    GlobAtomType type;
+    int offset;			/* GLOB_LITERAL: offset of the characters in
+				 * the text of the pattern. GLOB_CLASS: index
+				 * of the class. */
+    int length;			/* GLOB_LITERAL: number of bytes. GLOB_ANY:
+				 * number of characters. */
+} GlobAtom;
+
+typedef struct GlobClass {
+    unsigned char ascii[16];	/* Bit map of the ASCII characters that are
+				 * in the class. */
+    int firstRange;		/* Index of the first range of the class. */
+    int numRanges;		/* Number of ranges of the class. */
+} GlobClass;
+
+typedef struct GlobSegment {
+    int firstAtom;		/* Index of the first atom of the segment. */
+    int numAtoms;		/* Number of atoms in the segment. */
+    int numChars;		/* Number of characters it matches. */
+    int minBytes;		/* Least number of bytes it matches. */
+} GlobSegment;
+
+struct GlobPattern {
+    int refCount;		/* Number of references to the pattern. */
+    int flags;			/* TCL_MATCH_NOCASE or 0. */
+    int fallback;		/* 1 if the pattern is matched by
+				 * Tcl_StringCaseMatch or TclUniCharMatch
+				 * instead. */
+    int numSegments;		/* Number of segments; one more than the
+				 * number of runs of stars. */
+    int numAtoms, numClasses, numRanges, textLength;
+				/* Number of entries used in the arrays
+				 * below. */
+    GlobSegment *segments;	/* The segments, in order. */
+    GlobAtom *atoms;		/* The atoms of all the segments. */
+    GlobClass *classes;		/* The classes of all the atoms. */
+    Tcl_UniChar *ranges;	/* Pairs of first and last characters of the
+				 * ranges of all the classes. For a fallback
+				 * pattern, its numRanges characters. */
+    char *text;			/* The literal characters of all the atoms.
+				 * For a fallback pattern, the whole pattern,
+				 * null-terminated. */
+};
+
+#define GLOB_LOWER(c) \
+    ((char) ((((c) >= 'A') && ((c) <= 'Z')) ? ((c) + ('a' - 'A')) : (c)))
+
 /*
  * Prototypes for functions defined later in this file.
  */
 
 static void		ClearHash(Tcl_HashTable *tablePtr);
+static void		DupGlobInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static const char *	FindGlobSegment(GlobPattern *globPtr,
+			    GlobSegment *segPtr, const char *str,
+			    const char *end);
+static void		FreeGlobInternalRep(Tcl_Obj *objPtr);
 static void		FreeProcessGlobalValue(ClientData clientData);
 static void		FreeThreadHash(ClientData clientData);
 static Tcl_HashTable *	GetThreadHash(Tcl_ThreadDataKey *keyPtr);
+static int		GlobPatternChar(const char *p, const char *end,
+			    Tcl_UniChar *chPtr);
+static int		MatchGlobSegment(GlobPattern *globPtr,
+			    GlobSegment *segPtr, const char *str,
+			    const char *end, const char **endPtr);
+static int		MatchGlobTail(GlobPattern *globPtr,
+			    GlobSegment *segPtr, const char *str,
+			    const char *end);
 static int		SetEndOffsetFromAny(Tcl_Interp *interp,
 			    Tcl_Obj *objPtr);
 static void		UpdateStringOfEndOffset(Tcl_Obj *objPtr);
@@ -86,6 +163,19 @@ const Tcl_ObjType tclEndOffsetType = {
     UpdateStringOfEndOffset,		/* updateStringProc */
     SetEndOffsetFromAny
 };
+
+/*
+ * The Tcl object type that keeps a compiled glob pattern in the pattern
+ * object, for TclGetGlobPatternFromObj.
+ */
+
+static const Tcl_ObjType globType = {
+    "glob",				/* name */
+    FreeGlobInternalRep,		/* freeIntRepProc */
+    DupGlobInternalRep,			/* dupIntRepProc */
+    NULL,				/* updateStringProc */
+    NULL				/* setFromAnyProc */
+};
 
 /*
  *----------------------------------------------------------------------
@@ -1754,31 +1844,737 @@ TclStringMatchObj(
     int match, length, plen;
 
     /*
-     * Promote based on the type of incoming object.
-     * XXX: Currently doesn't take advantage of exact-ness that
-     * XXX: TclReToGlob tells us about
-    trivial = nocase ? 0 : TclMatchIsTrivial(TclGetString(ptnObj));
+     * Promote based on the type of incoming object. Byte arrays are matched
+     * as bytes, everything else as UTF-8 with the compiled pattern that is
+     * kept in the pattern object.
      */
 
-    if ((strObj->typePtr == &tclStringType) || (strObj->typePtr == NULL)) {
-	Tcl_UniChar *udata, *uptn;
-
-	udata = Tcl_GetUnicodeFromObj(strObj, &length);
-	uptn  = Tcl_GetUnicodeFromObj(ptnObj, &plen);
-	match = TclUniCharMatch(udata, length, uptn, plen, flags);
-    } else if (TclIsPureByteArray(strObj) && !flags) {
+    if (TclIsPureByteArray(strObj) && !flags) {
 	unsigned char *data, *ptn;
 
 	data = Tcl_GetByteArrayFromObj(strObj, &length);
 	ptn  = Tcl_GetByteArrayFromObj(ptnObj, &plen);
 	match = TclByteArrayMatch(data, length, ptn, plen, 0);
     } else {
-	match = Tcl_StringCaseMatch(TclGetString(strObj),
-		TclGetString(ptnObj), flags);
+	GlobPattern *globPtr = TclGetGlobPatternFromObj(ptnObj, flags);
+
+	if (globPtr->fallback && ((strObj->typePtr == &tclStringType)
+		|| (strObj->typePtr == NULL))) {
+	    /*
+	     * An ill-formed pattern is read by TclUniCharMatch, as it always
+	     * was for strings that are not byte arrays.
+	     */
+
+	    Tcl_UniChar *udata = Tcl_GetUnicodeFromObj(strObj, &length);
+
+	    match = TclUniCharMatch(udata, length, globPtr->ranges,
+		    globPtr->numRanges, flags);
+	} else {
+	    const char *str = TclGetStringFromObj(strObj, &length);
+
+	    match = TclGlobPatternMatch(globPtr, str, length);
+	}
+	TclReleaseGlobPattern(globPtr);
     }
     return match;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclNewGlobPattern --
+ *
+ *	Compile a glob pattern for matching many strings with
+ *	TclGlobPatternMatch. The pattern must be followed by a null byte.
+ *
+ *	Patterns that leave a bracketed class unterminated, end a range with
+ *	"]", end with a backslash or are not well-formed UTF-8 are not
+ *	compiled; TclGlobPatternMatch hands them to Tcl_StringCaseMatch,
+ *	whose reading of them is the definition, and TclStringMatchObj hands
+ *	them to TclUniCharMatch for strings that are not byte arrays.
+ *
+ * Results:
+ *	The compiled pattern, with a reference count of one, to be released
+ *	with TclReleaseGlobPattern.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+GlobPattern *
+TclNewGlobPattern(
+    const char *pattern,	/* Pattern, which may contain special
+				 * characters. */
+    int length,			/* Number of bytes in pattern, or -1 to use
+				 * all bytes up to the first null. */
+    int flags)			/* TCL_MATCH_NOCASE or 0. */
+{
+    GlobPattern *globPtr;
+    GlobSegment *segPtr;
+    GlobAtom *atomPtr = NULL;
+    const char *p, *end;
+    char *block;
+    int nocase = flags & TCL_MATCH_NOCASE;
+
+    if (length < 0) {
+	length = strlen(pattern);
+    }
+
+    /*
+     * Allocate everything in one block, with room for the most segments,
+     * atoms, classes and ranges a pattern of this length can have.
+     */
+
+    block = ckalloc(sizeof(GlobPattern)
+	    + (length + 1) * sizeof(GlobSegment)
+	    + length * sizeof(GlobAtom)
+	    + (length / 3 + 1) * sizeof(GlobClass)
+	    + length * 2 * sizeof(Tcl_UniChar)
+	    + length + 1);
+    globPtr = (GlobPattern *) block;
+    globPtr->segments = (GlobSegment *) (globPtr + 1);
+    globPtr->atoms = (GlobAtom *) (globPtr->segments + length + 1);
+    globPtr->classes = (GlobClass *) (globPtr->atoms + length);
+    globPtr->ranges = (Tcl_UniChar *) (globPtr->classes + length / 3 + 1);
+    globPtr->text = (char *) (globPtr->ranges + length * 2);
+    globPtr->refCount = 1;
+    globPtr->flags = flags;
+    globPtr->fallback = 0;
+    globPtr->numSegments = 1;
+    globPtr->numAtoms = 0;
+    globPtr->numClasses = 0;
+    globPtr->numRanges = 0;
+    globPtr->textLength = 0;
+
+    segPtr = globPtr->segments;
+    segPtr->firstAtom = 0;
+    segPtr->numAtoms = 0;
+    segPtr->numChars = 0;
+    segPtr->minBytes = 0;
+
+    p = pattern;
+    end = pattern + length;
+    while (p < end) {
+	int bytes;
+
+	if (*p == '*') {
+	    /*
+	     * Successive stars are one, and close the current segment.
+	     */
+
+	    while ((p < end) && (*p == '*')) {
+		p++;
+	    }
+	    segPtr++;
+	    globPtr->numSegments++;
+	    segPtr->firstAtom = globPtr->numAtoms;
+	    segPtr->numAtoms = 0;
+	    segPtr->numChars = 0;
+	    segPtr->minBytes = 0;
+	    atomPtr = NULL;
+	    continue;
+	}
+
+	if (*p == '?') {
+	    p++;
+	    if ((atomPtr == NULL) || (atomPtr->type != GLOB_ANY)) {
+		atomPtr = &globPtr->atoms[globPtr->numAtoms++];
+		atomPtr->type = GLOB_ANY;
+		atomPtr->length = 0;
+		segPtr->numAtoms++;
+	    }
+	    atomPtr->length++;
+	    segPtr->numChars++;
+	    segPtr->minBytes++;
+	    continue;
+	}
+
+	if (*p == '[') {
+	    GlobClass *classPtr = &globPtr->classes[globPtr->numClasses];
+	    Tcl_UniChar *rangePtr;
+	    int c, r;
+
+	    classPtr->firstRange = globPtr->numRanges;
+	    classPtr->numRanges = 0;
+	    p++;
+	    while (1) {
+		Tcl_UniChar first, last;
+
+		if ((p == end) || ((*p == ']') && (classPtr->numRanges == 0))) {
+		    goto fallback;
+		}
+		if (*p == ']') {
+		    p++;
+		    break;
+		}
+		bytes = GlobPatternChar(p, end, &first);
+		if (bytes == 0) {
+		    goto fallback;
+		}
+		p += bytes;
+		last = first;
+		if ((p < end) && (*p == '-')) {
+		    p++;
+		    if ((p == end) || (*p == ']')) {
+			goto fallback;
+		    }
+		    bytes = GlobPatternChar(p, end, &last);
+		    if (bytes == 0) {
+			goto fallback;
+		    }
+		    p += bytes;
+		}
+		if (nocase) {
+		    first = Tcl_UniCharToLower(first);
+		    last = Tcl_UniCharToLower(last);
+		}
+		rangePtr = &globPtr->ranges[2 * globPtr->numRanges++];
+		rangePtr[0] = (first < last ? first : last);
+		rangePtr[1] = (first < last ? last : first);
+		classPtr->numRanges++;
+	    }
+
+	    /*
+	     * Look up the ASCII characters once and for all.
+	     */
+
+	    rangePtr = &globPtr->ranges[2 * classPtr->firstRange];
+	    memset(classPtr->ascii, 0, sizeof(classPtr->ascii));
+	    for (c = 0; c < 0x80; c++) {
+		Tcl_UniChar ch = (Tcl_UniChar)
+			(nocase ? Tcl_UniCharToLower(c) : c);
+
+		for (r = 0; r < classPtr->numRanges; r++) {
+		    if ((rangePtr[2*r] <= ch) && (ch <= rangePtr[2*r + 1])) {
+			classPtr->ascii[c >> 3] |= 1 << (c & 7);
+			break;
+		    }
+		}
+	    }
+
+	    atomPtr = &globPtr->atoms[globPtr->numAtoms++];
+	    atomPtr->type = GLOB_CLASS;
+	    atomPtr->offset = globPtr->numClasses++;
+	    segPtr->numAtoms++;
+	    segPtr->numChars++;
+	    segPtr->minBytes++;
+	    continue;
+	}
+
+	/*
+	 * A literal character, possibly escaped with a backslash.
+	 */
+
+	if (*p == '\\') {
+	    p++;
+	}
+	bytes = (p < end ? GlobPatternChar(p, end, NULL) : 0);
+	if (bytes == 0) {
+	    goto fallback;
+	}
+	if ((atomPtr == NULL) || (atomPtr->type != GLOB_LITERAL)) {
+	    atomPtr = &globPtr->atoms[globPtr->numAtoms++];
+	    atomPtr->type = GLOB_LITERAL;
+	    atomPtr->offset = globPtr->textLength;
+	    atomPtr->length = 0;
+	    segPtr->numAtoms++;
+	}
+	memcpy(globPtr->text + globPtr->textLength, p, (size_t) bytes);
+	if (nocase && (bytes == 1)) {
+	    globPtr->text[globPtr->textLength] = GLOB_LOWER(*p);
+	}
+	globPtr->textLength += bytes;
+	atomPtr->length += bytes;
+	segPtr->numChars++;
+	segPtr->minBytes += (nocase ? 1 : bytes);
+	p += bytes;
+    }
+    return globPtr;
+
+    /*
+     * Keep the whole pattern for Tcl_StringCaseMatch, and its characters for
+     * TclUniCharMatch. There are never more characters than bytes.
+     */
+
+  fallback:
+    globPtr->fallback = 1;
+    memcpy(globPtr->text, pattern, (size_t) length);
+    globPtr->text[length] = '\0';
+    globPtr->numRanges = 0;
+    for (p = pattern; p < end; ) {
+	p += Tcl_UtfToUniChar(p, &globPtr->ranges[globPtr->numRanges++]);
+    }
+    return globPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GlobPatternChar --
+ *
+ *	Decode one character of a glob pattern, checking that it is in the
+ *	shortest UTF-8 form, so that comparing its bytes with those of a
+ *	string is the same as comparing characters.
+ *
+ * Results:
+ *	The number of bytes of the character, or 0 if it is not well-formed.
+ *	Stores the character in *chPtr if chPtr is not NULL.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+GlobPatternChar(
+    const char *p,		/* The character. */
+    const char *end,		/* End of the pattern. */
+    Tcl_UniChar *chPtr)		/* Where to store the character, or NULL. */
+{
+    char buf[TCL_UTF_MAX];
+    Tcl_UniChar ch;
+    int bytes;
+
+    if (UCHAR(*p) < 0x80) {
+	ch = (Tcl_UniChar) UCHAR(*p);
+	bytes = (ch ? 1 : 0);
+    } else {
+	bytes = Tcl_UtfToUniChar(p, &ch);
+	if ((bytes > end - p) || (Tcl_UniCharToUtf(ch, buf) != bytes)
+		|| (memcmp(buf, p, (size_t) bytes) != 0)) {
+	    bytes = 0;
+	}
+    }
+    if (chPtr != NULL) {
+	*chPtr = ch;
+    }
+    return bytes;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGlobPatternMatch --
+ *
+ *	See if a string matches a pattern compiled by TclNewGlobPattern or
+ *	TclGetGlobPatternFromObj. The string must be followed by a null byte.
+ *
+ *	The first segment of the pattern is matched at the start of the
+ *	string, and the last one, when the pattern has a star, at its end.
+ *	The segments in between are each matched at the leftmost place they
+ *	can be found after the previous one. Since a segment always matches
+ *	the same number of characters, no later place could leave more of the
+ *	string for the segments that follow, so there is no backtracking and
+ *	the work is at most the length of the string times that of the
+ *	pattern.
+ *
+ * Results:
+ *	The return value is 1 if string matches pattern, and 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclGlobPatternMatch(
+    GlobPattern *globPtr,	/* The compiled pattern. */
+    const char *str,		/* String. */
+    int length)			/* Number of bytes in the string. */
+{
+    GlobSegment *segPtr = globPtr->segments;
+    GlobSegment *lastSegPtr = segPtr + globPtr->numSegments - 1;
+    const char *end = str + length;
+
+    if (globPtr->fallback) {
+	return Tcl_StringCaseMatch(str, globPtr->text,
+		globPtr->flags & TCL_MATCH_NOCASE);
+    }
+
+    if (!MatchGlobSegment(globPtr, segPtr, str, end, &str)) {
+	return 0;
+    }
+    if (segPtr == lastSegPtr) {
+	return (str == end);
+    }
+
+    for (segPtr++ ; segPtr < lastSegPtr ; segPtr++) {
+	str = FindGlobSegment(globPtr, segPtr, str, end);
+	if (str == NULL) {
+	    return 0;
+	}
+    }
+
+    return MatchGlobTail(globPtr, lastSegPtr, str, end);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MatchGlobSegment --
+ *
+ *	See if a segment of a compiled glob pattern matches at the start of a
+ *	string.
+ *
+ * Results:
+ *	1 if it does, with the end of the match stored in *endPtr, 0 if not.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MatchGlobSegment(
+    GlobPattern *globPtr,	/* The compiled pattern. */
+    GlobSegment *segPtr,	/* The segment to match. */
+    const char *str,		/* Where to match it. */
+    const char *end,		/* End of the string. */
+    const char **endPtr)	/* Where to store the end of the match. */
+{
+    GlobAtom *atomPtr = globPtr->atoms + segPtr->firstAtom;
+    GlobAtom *lastAtomPtr = atomPtr + segPtr->numAtoms;
+    int nocase = globPtr->flags & TCL_MATCH_NOCASE;
+    Tcl_UniChar ch, ch2;
+
+    for ( ; atomPtr < lastAtomPtr ; atomPtr++) {
+	switch (atomPtr->type) {
+	case GLOB_LITERAL: {
+	    const char *lit = globPtr->text + atomPtr->offset;
+	    const char *litEnd = lit + atomPtr->length;
+
+	    if (!nocase) {
+		if ((end - str < atomPtr->length)
+			|| memcmp(str, lit, (size_t) atomPtr->length) != 0) {
+		    return 0;
+		}
+		str += atomPtr->length;
+		break;
+	    }
+	    while (lit < litEnd) {
+		if (str == end) {
+		    return 0;
+		}
+		if ((UCHAR(*str) < 0x80) && (UCHAR(*lit) < 0x80)) {
+		    if (GLOB_LOWER(*str) != *lit) {
+			return 0;
+		    }
+		    str++;
+		    lit++;
+		} else {
+		    str += Tcl_UtfToUniChar(str, &ch);
+		    lit += Tcl_UtfToUniChar(lit, &ch2);
+		    if (Tcl_UniCharToLower(ch) != Tcl_UniCharToLower(ch2)) {
+			return 0;
+		    }
+		}
+	    }
+	    break;
+	}
+	case GLOB_ANY: {
+	    int n;
+
+	    for (n = atomPtr->length ; n > 0 ; n--) {
+		if (str == end) {
+		    return 0;
+		}
+		str += TclUtfToUniChar(str, &ch);
+	    }
+	    break;
+	}
+	case GLOB_CLASS: {
+	    GlobClass *classPtr = &globPtr->classes[atomPtr->offset];
+
+	    if (str == end) {
+		return 0;
+	    }
+	    if (UCHAR(*str) < 0x80) {
+		int c = UCHAR(*str++);
+
+		if (!(classPtr->ascii[c >> 3] & (1 << (c & 7)))) {
+		    return 0;
+		}
+	    } else {
+		Tcl_UniChar *rangePtr =
+			&globPtr->ranges[2 * classPtr->firstRange];
+		int r;
+
+		str += Tcl_UtfToUniChar(str, &ch);
+		if (nocase) {
+		    ch = Tcl_UniCharToLower(ch);
+		}
+		for (r = 0 ; r < classPtr->numRanges ; r++) {
+		    if ((rangePtr[2*r] <= ch) && (ch <= rangePtr[2*r + 1])) {
+			break;
+		    }
+		}
+		if (r == classPtr->numRanges) {
+		    return 0;
+		}
+	    }
+	    break;
+	}
+	}
+    }
+    *endPtr = str;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FindGlobSegment --
+ *
+ *	Find the leftmost match of a segment of a compiled glob pattern in a
+ *	string. When the segment starts with a literal character, the places
+ *	to try are found with memchr, or when ignoring case, by comparing the
+ *	ASCII bytes of the string with it.
+ *
+ * Results:
+ *	The end of the match, or NULL if there is none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const char *
+FindGlobSegment(
+    GlobPattern *globPtr,	/* The compiled pattern. */
+    GlobSegment *segPtr,	/* The segment to find. */
+    const char *str,		/* Where to start looking. */
+    const char *end)		/* End of the string. */
+{
+    GlobAtom *atomPtr = globPtr->atoms + segPtr->firstAtom;
+    const char *matchEnd;
+    Tcl_UniChar ch;
+
+    if (!(globPtr->flags & TCL_MATCH_NOCASE)
+	    && (atomPtr->type == GLOB_LITERAL)) {
+	/*
+	 * The first byte of a literal is never a UTF-8 trail byte, so every
+	 * place memchr finds is the start of a character.
+	 */
+
+	char first = globPtr->text[atomPtr->offset];
+
+	while (end - str >= segPtr->minBytes) {
+	    str = memchr(str, first,
+		    (size_t) (end - str - segPtr->minBytes + 1));
+	    if (str == NULL) {
+		return NULL;
+	    }
+	    if (MatchGlobSegment(globPtr, segPtr, str, end, &matchEnd)) {
+		return matchEnd;
+	    }
+	    str++;
+	}
+	return NULL;
+    }
+
+    if ((atomPtr->type == GLOB_LITERAL)
+	    && (UCHAR(globPtr->text[atomPtr->offset]) < 0x80)) {
+	/*
+	 * Ignoring case, with a literal starting with an ASCII character:
+	 * other ASCII characters can be passed over without trying a match.
+	 * Other characters are tried, as they might fold to that one.
+	 */
+
+	char first = globPtr->text[atomPtr->offset];
+
+	while (end - str >= segPtr->minBytes) {
+	    if (UCHAR(*str) < 0x80) {
+		if ((GLOB_LOWER(*str) == first) && MatchGlobSegment(globPtr,
+			segPtr, str, end, &matchEnd)) {
+		    return matchEnd;
+		}
+		str++;
+		continue;
+	    }
+	    if (MatchGlobSegment(globPtr, segPtr, str, end, &matchEnd)) {
+		return matchEnd;
+	    }
+	    str += TclUtfToUniChar(str, &ch);
+	}
+	return NULL;
+    }
+
+    while (end - str >= segPtr->minBytes) {
+	if (MatchGlobSegment(globPtr, segPtr, str, end, &matchEnd)) {
+	    return matchEnd;
+	}
+	str += TclUtfToUniChar(str, &ch);
+    }
+    return NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MatchGlobTail --
+ *
+ *	See if the last segment of a compiled glob pattern, the one after its
+ *	last star, matches at the end of a string.
+ *
+ * Results:
+ *	1 if it does, 0 if not.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MatchGlobTail(
+    GlobPattern *globPtr,	/* The compiled pattern. */
+    GlobSegment *segPtr,	/* The last segment. */
+    const char *str,		/* Where the star before it starts. */
+    const char *end)		/* End of the string. */
+{
+    GlobAtom *atomPtr = globPtr->atoms + segPtr->firstAtom;
+    const char *p, *matchEnd;
+    Tcl_UniChar ch;
+    int n;
+
+    if (segPtr->numAtoms == 0) {
+	return 1;
+    }
+    if (end - str < segPtr->minBytes) {
+	return 0;
+    }
+    if (!(globPtr->flags & TCL_MATCH_NOCASE) && (segPtr->numAtoms == 1)
+	    && (atomPtr->type == GLOB_LITERAL)) {
+	return (memcmp(end - atomPtr->length, globPtr->text + atomPtr->offset,
+		(size_t) atomPtr->length) == 0);
+    }
+
+    /*
+     * The segment matches a fixed number of characters, so it can only
+     * match where that many characters are left. Step back to there; if
+     * that lands on the start of a character with the right count after
+     * it, the string is well-formed there and that is the only place to
+     * try. Otherwise try everywhere.
+     */
+
+    p = end;
+    for (n = segPtr->numChars ; (n > 0) && (p > str) ; n--) {
+	p = Tcl_UtfPrev(p, str);
+    }
+    if ((n == 0) && ((UCHAR(*p) & 0xC0) != 0x80)
+	    && (Tcl_NumUtfChars(p, end - p) == segPtr->numChars)) {
+	return (MatchGlobSegment(globPtr, segPtr, p, end, &matchEnd)
+		&& (matchEnd == end));
+    }
+
+    while (end - str >= segPtr->minBytes) {
+	if (MatchGlobSegment(globPtr, segPtr, str, end, &matchEnd)
+		&& (matchEnd == end)) {
+	    return 1;
+	}
+	str += TclUtfToUniChar(str, &ch);
+    }
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetGlobPatternFromObj --
+ *
+ *	Get the compiled form of a glob pattern, keeping it in the internal
+ *	rep of the pattern object so that later matches with the same pattern
+ *	can use it.
+ *
+ * Results:
+ *	The compiled pattern. The caller holds a reference to it, and must
+ *	release it with TclReleaseGlobPattern; this keeps it alive even if the
+ *	pattern object is shimmered meanwhile.
+ *
+ * Side effects:
+ *	May set the internal rep of objPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+GlobPattern *
+TclGetGlobPatternFromObj(
+    Tcl_Obj *objPtr,		/* The pattern. */
+    int flags)			/* TCL_MATCH_NOCASE or 0. */
+{
+    GlobPattern *globPtr;
+    const char *bytes;
+    int length;
+
+    if (objPtr->typePtr == &globType) {
+	globPtr = objPtr->internalRep.otherValuePtr;
+	if (globPtr->flags == flags) {
+	    globPtr->refCount++;
+	    return globPtr;
+	}
+    }
+
+    bytes = TclGetStringFromObj(objPtr, &length);
+    globPtr = TclNewGlobPattern(bytes, length, flags);
+    TclFreeIntRep(objPtr);
+    objPtr->internalRep.otherValuePtr = globPtr;
+    objPtr->typePtr = &globType;
+    globPtr->refCount++;
+    return globPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclReleaseGlobPattern, FreeGlobInternalRep, DupGlobInternalRep --
+ *
+ *	Manage the lifetime of compiled glob patterns and of the internal
+ *	reps that hold them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A compiled pattern is freed when its last reference goes.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclReleaseGlobPattern(
+    GlobPattern *globPtr)
+{
+    if (--globPtr->refCount <= 0) {
+	ckfree((char *) globPtr);
+    }
+}
+
+static void
+FreeGlobInternalRep(
+    Tcl_Obj *objPtr)
+{
+    TclReleaseGlobPattern(objPtr->internalRep.otherValuePtr);
+    objPtr->typePtr = NULL;
+}
+
+static void
+DupGlobInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    GlobPattern *globPtr = srcPtr->internalRep.otherValuePtr;
+
+    globPtr->refCount++;
+    copyPtr->internalRep.otherValuePtr = globPtr;
+    copyPtr->typePtr = &globType;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2572,7 +3368,7 @@ TclFormatInt(buffer, n)
 				 * formatted characters are written. */
     long n;			/* The integer to format. */
 {
-    long intVal;
+    unsigned long intVal;
     int i;
     int numFormatted, j;
     const char *digits = "0123456789";
@@ -2588,20 +3384,12 @@ TclFormatInt(buffer, n)
     }
 
     /*
-     * Check whether "n" is the maximum negative value. This is
-     * -2^(m-1) for an m-bit word, and has no positive equivalent;
-     * negating it produces the same value.
-     */
-
-    if (n == -n) {
-	return sprintf(buffer, "%ld", n);
-    }
-
-    /*
-     * Generate the characters of the result backwards in the buffer.
+     * Generate the characters of the result backwards in the buffer. The
+     * magnitude is taken as unsigned, since the maximum negative value,
+     * -2^(m-1) for an m-bit word, has no positive equivalent.
      */
 
-    intVal = (n < 0? -n : n);
+    intVal = (n < 0 ? -(unsigned long) n : (unsigned long) n);
     i = 0;
     buffer[0] = '\0';
     do {
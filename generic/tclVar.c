@@ -31,7 +31,8 @@ static int		CompareVarKeys(void *keyPtr, Tcl_HashEntry *hPtr);
 
 static const Tcl_HashKeyType tclVarHashKeyType = {
     TCL_HASH_KEY_TYPE_VERSION,	/* version */
-    0,				/* flags */
+    TCL_HASH_KEY_INCREMENTAL_RESIZE,
+				/* flags */
     TclHashObjKey,		/* hashKeyProc */
     CompareVarKeys,		/* compareKeysProc */
     AllocVarEntry,		/* allocEntryProc */
@@ -1917,8 +1918,7 @@ TclPtrSetVar(
 		oldValuePtr = varPtr->value.objPtr;
 		Tcl_IncrRefCount(oldValuePtr);	/* Since var is referenced. */
 	    }
-	    result = Tcl_ListObjAppendElement(interp, oldValuePtr,
-		    newValuePtr);
+	    result = TclLappendListElement(interp, oldValuePtr, newValuePtr);
 	    if (result != TCL_OK) {
 		goto earlyError;
 	    }
@@ -2797,8 +2797,12 @@ Tcl_LappendObjCmd(
 
 	result = TclListObjLength(interp, varValuePtr, &numElems);
 	if (result == TCL_OK) {
-	    result = Tcl_ListObjReplace(interp, varValuePtr, numElems, 0,
-		    (objc-2), (objv+2));
+	    if (objc == 3) {
+		result = TclLappendListElement(interp, varValuePtr, objv[2]);
+	    } else {
+		result = Tcl_ListObjReplace(interp, varValuePtr, numElems, 0,
+			(objc-2), (objv+2));
+	    }
 	}
 	if (result != TCL_OK) {
 	    if (createdNewObj) {
@@ -3521,7 +3525,8 @@ ArrayGetCmd(
     Tcl_Obj **nameObjPtr, *patternObj;
     Tcl_HashSearch search;
     const char *pattern;
-    int i, count, result;
+    GlobPattern *globPtr = NULL;
+    int i, count, result, length;
 
     switch (objc) {
     case 2:
@@ -3594,22 +3599,35 @@ ArrayGetCmd(
 	goto searchDone;
     }
 
+    if (patternObj != NULL) {
+	globPtr = TclGetGlobPatternFromObj(patternObj, 0);
+    }
     for (varPtr2 = VarHashFirstVar(varPtr->value.tablePtr, &search);
 	    varPtr2; varPtr2 = VarHashNextVar(&search)) {
 	if (TclIsVarUndefined(varPtr2)) {
 	    continue;
 	}
 	nameObj = VarHashGetKey(varPtr2);
-	if (patternObj && !Tcl_StringMatch(TclGetString(nameObj), pattern)) {
-	    continue;		/* Element name doesn't match pattern. */
+	if (globPtr != NULL) {
+	    const char *name = TclGetStringFromObj(nameObj, &length);
+
+	    if (!TclGlobPatternMatch(globPtr, name, length)) {
+		continue;	/* Element name doesn't match pattern. */
+	    }
 	}
 
 	result = Tcl_ListObjAppendElement(interp, nameLstObj, nameObj);
 	if (result != TCL_OK) {
 	    TclDecrRefCount(nameLstObj);
+	    if (globPtr != NULL) {
+		TclReleaseGlobPattern(globPtr);
+	    }
 	    return result;
 	}
     }
+    if (globPtr != NULL) {
+	TclReleaseGlobPattern(globPtr);
+    }
 
     /*
      * Make sure the Var structure of the array is not removed by a trace
@@ -3708,7 +3726,8 @@ ArrayNamesCmd(
     Tcl_Obj *varNameObj, *nameObj, *resultObj, *patternObj;
     Tcl_HashSearch search;
     const char *pattern = NULL;
-    int mode = OPT_GLOB;
+    GlobPattern *globPtr = NULL;
+    int mode = OPT_GLOB, length;
 
     if ((objc < 2) || (objc > 4)) {
 	Tcl_WrongNumArgs(interp, 1, objv, "arrayName ?mode? ?pattern?");
@@ -3784,6 +3803,9 @@ ArrayNamesCmd(
      * Must scan the array to select the elements.
      */
 
+    if (patternObj && (mode == OPT_GLOB)) {
+	globPtr = TclGetGlobPatternFromObj(patternObj, 0);
+    }
     for (varPtr2=VarHashFirstVar(varPtr->value.tablePtr, &search);
 	    varPtr2!=NULL ; varPtr2=VarHashNextVar(&search)) {
 	if (TclIsVarUndefined(varPtr2)) {
@@ -3791,14 +3813,14 @@ ArrayNamesCmd(
 	}
 	nameObj = VarHashGetKey(varPtr2);
 	if (patternObj) {
-	    const char *name = TclGetString(nameObj);
+	    const char *name = TclGetStringFromObj(nameObj, &length);
 	    int matched = 0;
 
 	    switch ((enum options) mode) {
 	    case OPT_EXACT:
 		Tcl_Panic("exact matching shouldn't get here");
 	    case OPT_GLOB:
-		matched = Tcl_StringMatch(name, pattern);
+		matched = TclGlobPatternMatch(globPtr, name, length);
 		break;
 	    case OPT_REGEXP:
 		matched = Tcl_RegExpMatchObj(interp, nameObj, patternObj);
@@ -3815,6 +3837,9 @@ ArrayNamesCmd(
 
 	Tcl_ListObjAppendElement(NULL, resultObj, nameObj);
     }
+    if (globPtr != NULL) {
+	TclReleaseGlobPattern(globPtr);
+    }
     Tcl_SetObjResult(interp, resultObj);
     return TCL_OK;
 }
@@ -0,0 +1,350 @@
+# encodingPerf.tcl --
+#
+#	Measures the throughput of the encodings, converting ASCII-heavy, mixed
+#	and CJK-heavy text to and from each of them, both directly with
+#	[encoding convertto/convertfrom] (Tcl_UtfToExternal/Tcl_ExternalToUtf)
+#	and through a file channel with that -encoding:
+#
+#	    tclsh encodingPerf.tcl ?-size kilobytes? ?-runs count?
+#		    ?-encodings patterns? ?-inputs kinds? ?-output file?
+#	    tclsh encodingPerf.tcl -compare old.csv new.csv ?-threshold percent?
+#
+#	The first form writes one CSV line per measurement, with a header line:
+#
+#	    encoding,input,direction,interface,bytes,microseconds,mbps
+#
+#	where direction is "to" (from UTF-8 to the encoding) or "from",
+#	interface is "direct" or "channel", bytes is the size of the input to
+#	the conversion and mbps its throughput in 10^6 bytes per second, for
+#	the best of the runs. The text for each encoding is built only of
+#	characters it can represent, and inputs it has too few characters for
+#	(CJK text in iso8859-1, any text in symbol) are left out.
+#
+#	The second form compares the output of two runs, for instance of two
+#	builds, listing the measurements that changed by more than the
+#	threshold (default 10%) and the geometric mean of the changes.
+#
+# See the file "license.terms" for information on usage and redistribution of
+# this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+namespace eval encodingPerf {
+    variable ascii \
+	    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+
+    # Letters of Western, Central European, Greek and Cyrillic text, and
+    # punctuation from outside ASCII, for the mixed text.
+
+    variable other [join [list \
+	"\u00e0\u00e1\u00e2\u00e4\u00e5\u00e6\u00e7\u00e8\u00e9\u00ea\u00eb" \
+	"\u00ed\u00ee\u00ef\u00f1\u00f3\u00f4\u00f6\u00f8\u00fa\u00fb\u00fc" \
+	"\u00df\u00c9\u00d6\u00dc\u0105\u0107\u0119\u0142\u0144\u015b\u017c" \
+	"\u010d\u0159\u0161\u017e\u03b1\u03b2\u03b3\u03b4\u03b5\u03bb\u03bc" \
+	"\u03c0\u03c1\u03c3\u03c4\u03c9\u0430\u0431\u0432\u0433\u0434\u0435" \
+	"\u0438\u043a\u043b\u043c\u043d\u043e\u043f\u0440\u0441\u0442\u044f" \
+	"\u20ac\u2013\u2019\u201c\u201d"] {}]
+
+    # Kana and the ideographs common to Chinese and Japanese text.
+
+    variable cjk [join [list \
+	"\u3042\u3044\u3046\u3048\u304a\u304b\u304d\u304f\u3051\u3053\u3055" \
+	"\u3057\u3059\u305b\u305d\u305f\u3061\u3064\u3066\u3068\u306e\u306b" \
+	"\u30a2\u30a4\u30a6\u30a8\u30aa\u30ab\u30ad\u30af\u30b1\u30b3\u30c8" \
+	"\u65e5\u672c\u4e2d\u56fd\u4eba\u5927\u5b66\u751f\u5e74\u6708\u6642" \
+	"\u5206\u4e0a\u4e0b\u5c71\u5ddd\u6c34\u706b\u6728\u91d1\u571f\u5929" \
+	"\u6771\u897f\u5357\u5317\u8a9e\u6587\u5b57\u4f1a\u793e\u3001\u3002"] {}]
+}
+
+# encodingPerf::representable --
+#
+#	Returns the characters of a string that survive a round trip through
+#	an encoding.
+
+proc encodingPerf::representable {encoding chars} {
+    set result {}
+    foreach c [split $chars {}] {
+	if {![catch {encoding convertto $encoding $c} bytes]
+		&& ![catch {encoding convertfrom $encoding $bytes} back]
+		&& $back eq $c} {
+	    append result $c
+	}
+    }
+    return $result
+}
+
+# encodingPerf::pick --
+#
+#	Returns a random character of a string.
+
+proc encodingPerf::pick {chars} {
+    string index $chars [expr {int(rand() * [string length $chars])}]
+}
+
+# encodingPerf::text --
+#
+#	Builds about size bytes of UTF-8 text of one kind:
+#
+#	ascii	words of ASCII letters, one in 30 with a letter from elsewhere
+#	mixed	words of which every other has one or two letters from elsewhere
+#	cjk	runs of kana and ideographs between short ASCII words
+
+proc encodingPerf::text {kind size} {
+    variable ascii
+    variable other
+    variable cjk
+
+    expr {srand(1)}
+    set rate [expr {$kind eq "ascii" ? 0.03 : 0.5}]
+    set text {}
+    set line 0
+    while {[string bytelength $text] < $size} {
+	set word {}
+	if {$kind eq "cjk"} {
+	    for {set i [expr {5 + int(rand() * 15)}]} {$i > 0} {incr i -1} {
+		append word [pick $cjk]
+	    }
+	    append word " " [pick $ascii] [pick $ascii]
+	} else {
+	    for {set i [expr {2 + int(rand() * 8)}]} {$i > 0} {incr i -1} {
+		append word [pick $ascii]
+	    }
+	    if {rand() < $rate} {
+		set i [expr {int(rand() * [string length $word])}]
+		set word [string replace $word $i $i [pick $other]]
+		if {rand() < 0.5} {
+		    append word [pick $other]
+		}
+	    }
+	}
+	append text $word
+	if {[incr line [string length $word]] > 70} {
+	    append text .\n
+	    set line 0
+	} else {
+	    append text " "
+	}
+    }
+    return $text
+}
+
+# encodingPerf::textFor --
+#
+#	Returns the text of one kind for an encoding, with the characters it
+#	lacks replaced by others of the same sort it has, or an empty string if
+#	it has too few of them to make that kind of text.
+
+proc encodingPerf::textFor {encoding kind text} {
+    variable ascii
+    variable other
+    variable cjk
+
+    if {[representable $encoding $ascii] ne $ascii
+	    || [representable $encoding " .\n"] ne " .\n"} {
+	return {}
+    }
+    set pool [expr {$kind eq "cjk" ? $cjk : $other}]
+    set have [representable $encoding $pool]
+    switch -- $kind {
+	ascii {
+	    if {$have eq ""} {
+		set have $ascii
+	    }
+	}
+	mixed {
+	    if {[string length $have] < 8} {
+		return {}
+	    }
+	}
+	cjk {
+	    if {[string length $have] < [string length $pool] / 2} {
+		return {}
+	    }
+	}
+    }
+    set map {}
+    set i 0
+    foreach c [split $pool {}] {
+	if {[string first $c $have] < 0} {
+	    lappend map $c [string index $have $i]
+	    set i [expr {($i + 1) % [string length $have]}]
+	}
+    }
+    return [string map $map $text]
+}
+
+# encodingPerf::best --
+#
+#	Runs a script a number of times in the caller and returns the shortest
+#	time in microseconds.
+
+proc encodingPerf::best {runs script} {
+    set best {}
+    for {set run 0} {$run < $runs} {incr run} {
+	set t [lindex [uplevel 1 [list time $script]] 0]
+	if {$best eq {} || $t < $best} {
+	    set best $t
+	}
+    }
+    return [expr {max($best, 1)}]
+}
+
+# encodingPerf::measure --
+#
+#	Measures the conversions of one text for one encoding, returning a
+#	list of {direction interface bytes microseconds} lists.
+
+proc encodingPerf::measure {encoding text runs file} {
+    set bytes [encoding convertto $encoding $text]
+    set size [string bytelength $text]
+    set result {}
+
+    lappend result [list to direct $size \
+	    [best $runs {encoding convertto $encoding $text}]]
+    lappend result [list from direct [string length $bytes] \
+	    [best $runs {encoding convertfrom $encoding $bytes}]]
+
+    lappend result [list to channel $size [best $runs {
+	set f [open $file w]
+	fconfigure $f -encoding $encoding -translation lf
+	puts -nonewline $f $text
+	close $f
+    }]]
+    set f [open $file w]
+    fconfigure $f -translation binary
+    puts -nonewline $f $bytes
+    close $f
+    lappend result [list from channel [string length $bytes] [best $runs {
+	set f [open $file]
+	fconfigure $f -encoding $encoding -translation lf
+	read $f
+	close $f
+    }]]
+    return $result
+}
+
+proc encodingPerf::run {size runs patterns kinds out} {
+    global env
+
+    set tmp [expr {[info exists env(TMPDIR)] ? $env(TMPDIR) : "/tmp"}]
+    set file [file join $tmp encodingPerf[pid].dat]
+    set texts {}
+    foreach kind $kinds {
+	dict set texts $kind [text $kind [expr {$size * 1024}]]
+    }
+    puts $out "encoding,input,direction,interface,bytes,microseconds,mbps"
+    foreach encoding [lsort [encoding names]] {
+	set wanted 0
+	foreach pattern $patterns {
+	    if {[string match $pattern $encoding]} {
+		set wanted 1
+	    }
+	}
+	if {!$wanted} {
+	    continue
+	}
+	foreach kind $kinds {
+	    set text [textFor $encoding $kind [dict get $texts $kind]]
+	    if {$text eq ""} {
+		continue
+	    }
+	    foreach m [measure $encoding $text $runs $file] {
+		lassign $m direction interface bytes us
+		puts $out [format "%s,%s,%s,%s,%d,%d,%.1f" $encoding $kind \
+			$direction $interface $bytes $us \
+			[expr {double($bytes) / $us}]]
+	    }
+	    flush $out
+	}
+    }
+    file delete $file
+}
+
+# encodingPerf::readResults --
+#
+#	Reads the output of a run into a dictionary from the first four fields
+#	to the throughput.
+
+proc encodingPerf::readResults {file} {
+    set f [open $file]
+    set result {}
+    foreach line [lrange [split [read $f] \n] 1 end] {
+	set fields [split $line ,]
+	if {[llength $fields] == 7} {
+	    dict set result [lrange $fields 0 3] [lindex $fields 6]
+	}
+    }
+    close $f
+    return $result
+}
+
+proc encodingPerf::compare {oldFile newFile threshold} {
+    set old [readResults $oldFile]
+    set new [readResults $newFile]
+    set changes {}
+    set sums {}
+    dict for {key mbps} $new {
+	if {![dict exists $old $key] || [dict get $old $key] <= 0
+		|| $mbps <= 0} {
+	    continue
+	}
+	set ratio [expr {$mbps / [dict get $old $key]}]
+	lassign $key encoding input direction interface
+	dict lappend sums "$input $direction $interface" [expr {log($ratio)}]
+	if {abs($ratio - 1) * 100 > $threshold} {
+	    lappend changes [list $ratio $key [dict get $old $key] $mbps]
+	}
+    }
+    puts [format "%-16s %-6s %-5s %-8s %10s %10s %8s" \
+	    encoding input dir iface old new change]
+    foreach change [lsort -real -index 0 $changes] {
+	lassign $change ratio key oldMbps newMbps
+	puts [format "%-16s %-6s %-5s %-8s %10.1f %10.1f %+7.0f%%" {*}$key \
+		$oldMbps $newMbps [expr {($ratio - 1) * 100}]]
+    }
+    puts ""
+    puts "geometric mean of changes"
+    foreach key [lsort [dict keys $sums]] {
+	set logs [dict get $sums $key]
+	puts [format "%-22s %+7.1f%% over %d" $key \
+		[expr {(exp([tcl::mathop::+ {*}$logs] / [llength $logs]) - 1)
+		* 100}] [llength $logs]]
+    }
+}
+
+set size 256
+set runs 10
+set patterns *
+set kinds {ascii mixed cjk}
+set output {}
+set compare {}
+set threshold 10
+for {set i 0} {$i < [llength $argv]} {incr i} {
+    switch -- [lindex $argv $i] {
+	-size		{set size [lindex $argv [incr i]]}
+	-runs		{set runs [lindex $argv [incr i]]}
+	-encodings	{set patterns [lindex $argv [incr i]]}
+	-inputs		{set kinds [lindex $argv [incr i]]}
+	-output		{set output [lindex $argv [incr i]]}
+	-threshold	{set threshold [lindex $argv [incr i]]}
+	-compare {
+	    set compare [lrange $argv [expr {$i + 1}] [expr {$i + 2}]]
+	    incr i 2
+	}
+	default {
+	    puts stderr "usage: [file tail [info script]] ?-size kilobytes?\
+		    ?-runs count? ?-encodings patterns? ?-inputs kinds?\
+		    ?-output file?"
+	    puts stderr "       [file tail [info script]] -compare old.csv\
+		    new.csv ?-threshold percent?"
+	    exit 1
+	}
+    }
+}
+if {[llength $compare] == 2} {
+    encodingPerf::compare {*}$compare $threshold
+} elseif {$output ne ""} {
+    set out [open $output w]
+    encodingPerf::run $size $runs $patterns $kinds $out
+    close $out
+} else {
+    encodingPerf::run $size $runs $patterns $kinds stdout
+}
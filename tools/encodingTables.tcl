@@ -0,0 +1,181 @@
+# encodingTables.tcl --
+#
+#	Compiles the table-driven *.enc files in a directory into the binary
+#	*.tbl form that LoadEncodingFile in generic/tclEncoding.c maps into
+#	memory instead of parsing the text on every first use:
+#
+#	    tclsh encodingTables.tcl srcDir destDir
+#
+#	The tables are written in the byte order of the tclsh running this
+#	script, so it must be run by the tclsh being built; the makefiles skip
+#	it when that tclsh cannot run on the build host. A table whose .enc
+#	file has changed since, going by its size and CRC-32, or whose byte
+#	order does not match, is ignored and the .enc file is read instead.
+#	Escape-driven encodings have no table and are skipped.
+#
+#	Layout, all in native byte order:
+#
+#	    4-byte words: magic "TclE", version, size and CRC-32 of the .enc
+#		file, type ('S', 'D' or 'M'), fallback character, number of
+#		pages
+#	    2 x 256 shorts: page numbers (1-based, 0 for none) of the toUnicode
+#		and fromUnicode tables
+#	    the pages, 256 shorts each
+#
+#	The tables are exactly what LoadTableEncoding builds from the text,
+#	including the symbol and backslash fixups and the 'R'everse entries.
+#
+# See the file "license.terms" for information on usage and redistribution of
+# this file, and for a DISCLAIMER OF ALL WARRANTIES.
+
+namespace eval encodingTables {
+    variable magic 0x54636c45
+    variable version 2
+}
+
+# encodingTables::parse --
+#
+#	Reads an .enc file and returns a dictionary with the type, fallback,
+#	and toUnicode/fromUnicode tables (dictionaries from the high byte to a
+#	list of 256 values), or an empty list for escape-driven encodings.
+
+proc encodingTables::parse {file} {
+    set f [open $file]
+    fconfigure $f -encoding utf-8
+    while {[string index [set line [gets $f]] 0] eq "#"} {}
+    set type [string index $line 0]
+    if {$type ni {S D M}} {
+	close $f
+	return {}
+    }
+    scan [gets $f] "%x %d %d" fallback symbol numPages
+    set numPages [expr {max(0, min(256, $numPages))}]
+
+    set to {}
+    for {set i 0} {$i < $numPages} {incr i} {
+	set chunk [read $f [expr {3 + 16 * (16 * 4 + 1)}]]
+	scan [string range $chunk 0 1] %x hi
+	binary scan [binary format H* [string map {\n {}} \
+		[string range $chunk 2 end]]] Su* page
+	dict set to $hi $page
+    }
+
+    # Invert toUnicode, as LoadTableEncoding does, with the same fixups.
+    # The fromUnicode table is kept flat while it is built.
+
+    set from [lrepeat 65536 0]
+    set used {}
+    foreach hi [lsort -integer [dict keys $to]] {
+	set lo 0
+	foreach ch [dict get $to $hi] {
+	    if {$ch != 0} {
+		lset from $ch [expr {($hi << 8) + $lo}]
+		dict set used [expr {$ch >> 8}] {}
+	    }
+	    incr lo
+	}
+    }
+    if {$type eq "M" && [dict exists $used 0] && [lindex $from 0x5c] == 0} {
+	lset from 0x5c 0x5c
+    }
+    if {$symbol} {
+	dict set used 0 {}
+	if {[dict exists $to 0]} {
+	    set lo 0
+	    foreach ch [dict get $to 0] {
+		if {$ch != 0} {
+		    lset from $lo $lo
+		}
+		incr lo
+	    }
+	}
+    }
+
+    while {[set len [gets $f line]] == 0} {}
+    if {$len > 0 && [string index $line 0] eq "R"} {
+	while {[gets $f line] >= 0} {
+	    if {[string length $line] < 5} {
+		continue
+	    }
+	    set line [string map {" " ""} $line]
+	    binary scan [binary format H* $line] Su* values
+	    set values [lassign $values target]
+	    if {$target == 0} {
+		continue
+	    }
+	    foreach ch $values {
+		if {$ch != 0} {
+		    lset from $ch $target
+		    dict set used [expr {$ch >> 8}] {}
+		}
+	    }
+	}
+    }
+    close $f
+
+    set fromPages {}
+    foreach hi [lsort -integer [dict keys $used]] {
+	dict set fromPages $hi [lrange $from [expr {$hi << 8}] \
+		[expr {($hi << 8) + 255}]]
+    }
+    return [list type $type fallback $fallback to $to from $fromPages]
+}
+
+# encodingTables::compile --
+#
+#	Writes the binary table for one parsed encoding, made from the .enc
+#	file src. Identical pages are stored once.
+
+proc encodingTables::compile {info src file} {
+    variable magic
+    variable version
+
+    set pages {}
+    set data {}
+    foreach table {to from} {
+	set index [lrepeat 256 0]
+	dict for {hi page} [dict get $info $table] {
+	    set bytes [binary format t* $page]
+	    if {![dict exists $pages $bytes]} {
+		dict set pages $bytes [expr {[dict size $pages] + 1}]
+		append data $bytes
+	    }
+	    lset index $hi [dict get $pages $bytes]
+	}
+	append indices [binary format t* $index]
+    }
+    set f [open $src]
+    fconfigure $f -translation binary
+    set source [read $f]
+    close $f
+    set f [open $file w]
+    fconfigure $f -translation binary
+    puts -nonewline $f [binary format n7 [list $magic $version \
+	    [string length $source] [zlib crc32 $source] \
+	    [scan [dict get $info type] %c] [dict get $info fallback] \
+	    [dict size $pages]]]
+    puts -nonewline $f $indices$data
+    close $f
+}
+
+proc encodingTables::main {srcDir destDir} {
+    set tool [file mtime [info script]]
+    file mkdir $destDir
+    foreach src [lsort [glob -directory $srcDir *.enc]] {
+	set dest [file join $destDir [file rootname [file tail $src]].tbl]
+	if {[file exists $dest] && [file mtime $dest] >= [file mtime $src]
+		&& [file mtime $dest] >= $tool} {
+	    continue
+	}
+	set info [parse $src]
+	if {[llength $info]} {
+	    compile $info $src $dest
+	}
+    }
+}
+
+if {[llength $argv] != 2} {
+    puts stderr "usage: [file tail [info script]] srcDir destDir"
+    exit 1
+}
+encodingTables::main {*}$argv
@@ -13,9 +13,17 @@
  * RCS: @(#) $Id$
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE	/* For splice(). */
+#endif
+
 #include "tclInt.h"	/* Internal definitions for Tcl. */
 #include "tclIO.h"	/* To get Channel type declaration. */
 
+#ifdef __linux__
+#   include <sys/sendfile.h>
+#endif
+
 #define SUPPORTS_TTY
 
 #undef DIRECT_BAUD
@@ -163,6 +171,10 @@ static int		FileTruncateProc(ClientData instanceData,
 static Tcl_WideInt	FileWideSeekProc(ClientData instanceData,
 			    Tcl_WideInt offset, int mode, int *errorCode);
 static void		FileWatchProc(ClientData instanceData, int mask);
+#ifdef __linux__
+static int		GetNativeFd(Tcl_Channel chan, int direction,
+			    int *fdPtr);
+#endif
 #ifdef SUPPORTS_TTY
 static void		TtyGetAttributes(int fd, TtyAttrs *ttyPtr);
 static int		TtyGetOptionProc(ClientData instanceData,
@@ -1880,6 +1892,122 @@ Tcl_GetOpenFile(
     return TCL_ERROR;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclpCopyDirect --
+ *
+ *	Moves up to toCopy bytes from one channel to another inside the
+ *	kernel, for fcopy between channels that pass bytes through unchanged.
+ *	On Linux, between file, pipe and socket channels, this uses sendfile()
+ *	when reading a regular file and splice() when either side is a pipe.
+ *	Everything else is left to the buffered copy.
+ *
+ * Results:
+ *	The number of bytes moved, 0 at the end of the input, or -1 with an
+ *	error code in *errorCodePtr: EAGAIN when a nonblocking channel is not
+ *	ready, anything else when the caller should copy through its buffers
+ *	instead.
+ *
+ * Side effects:
+ *	Advances the positions of the channels.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclpCopyDirect(
+    Tcl_Channel inChan,		/* Channel to read from. */
+    Tcl_Channel outChan,	/* Channel to write to. */
+    int toCopy,			/* Most bytes to move. */
+    int *errorCodePtr)		/* Where to store the error code. */
+{
+#ifdef __linux__
+    int inFd, outFd, flags;
+    ssize_t moved;
+    Tcl_StatBuf inStat, outStat;
+
+    if (!GetNativeFd(inChan, TCL_READABLE, &inFd)
+	    || !GetNativeFd(outChan, TCL_WRITABLE, &outFd)
+	    || (TclOSfstat(inFd, &inStat) != 0)
+	    || (TclOSfstat(outFd, &outStat) != 0)) {
+	*errorCodePtr = EINVAL;
+	return -1;
+    }
+
+    do {
+	if (S_ISREG(inStat.st_mode)) {
+	    moved = sendfile(outFd, inFd, NULL, (size_t) toCopy);
+	} else if (S_ISFIFO(inStat.st_mode) || S_ISFIFO(outStat.st_mode)) {
+	    /*
+	     * Nonblocking channels have nonblocking descriptors, but splice()
+	     * only treats the pipe side so with SPLICE_F_NONBLOCK.
+	     */
+
+	    flags = SPLICE_F_MOVE;
+	    if ((fcntl(inFd, F_GETFL) | fcntl(outFd, F_GETFL)) & O_NONBLOCK) {
+		flags |= SPLICE_F_NONBLOCK;
+	    }
+	    moved = splice(inFd, NULL, outFd, NULL, (size_t) toCopy, flags);
+	} else {
+	    errno = EINVAL;
+	    moved = -1;
+	}
+    } while ((moved < 0) && (errno == EINTR));
+
+    if (moved < 0) {
+	*errorCodePtr = (errno == EWOULDBLOCK) ? EAGAIN : errno;
+	return -1;
+    }
+    return (int) moved;
+#else
+    *errorCodePtr = EINVAL;
+    return -1;
+#endif /* __linux__ */
+}
+
+#ifdef __linux__
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetNativeFd --
+ *
+ *	Gets the descriptor of a file, serial, pipe or socket channel, the
+ *	channel types that Tcl_GetOpenFile also trusts to read and write
+ *	their descriptor as it is.
+ *
+ * Results:
+ *	1 and the descriptor in *fdPtr, or 0 for other channels.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+GetNativeFd(
+    Tcl_Channel chan,		/* Channel to get the descriptor of. */
+    int direction,		/* TCL_READABLE or TCL_WRITABLE. */
+    int *fdPtr)			/* Where to store the descriptor. */
+{
+    const Tcl_ChannelType *chanTypePtr = Tcl_GetChannelType(chan);
+    ClientData data;
+
+    if (((chanTypePtr == &fileChannelType)
+#ifdef SUPPORTS_TTY
+	    || (chanTypePtr == &ttyChannelType)
+#endif /* SUPPORTS_TTY */
+	    || (strcmp(chanTypePtr->typeName, "tcp") == 0)
+	    || (strcmp(chanTypePtr->typeName, "pipe") == 0))
+	    && (Tcl_GetChannelHandle(chan, direction, &data) == TCL_OK)) {
+	*fdPtr = PTR2INT(data);
+	return 1;
+    }
+    return 0;
+}
+#endif /* __linux__ */
+
 #ifndef HAVE_COREFOUNDATION	/* Darwin/Mac OS X CoreFoundation notifier is
 				 * in tclMacOSXNotify.c */
 /*
@@ -14,6 +14,7 @@
 
 #include "tclInt.h"
 #include "tclFileSystem.h"
+#include <sys/mman.h>
 
 static int NativeMatchType(Tcl_Interp *interp, const char* nativeEntry,
 	const char* nativeName, Tcl_GlobTypeData *types);
@@ -250,6 +251,7 @@ TclpMatchInDirectory(
 	Tcl_StatBuf statBuf;
 	Tcl_DString ds;		/* native encoding of dir */
 	Tcl_DString dsOrig;	/* utf-8 encoding of dir */
+	GlobPattern *globPtr;	/* the pattern, compiled for the entries */
 
 	Tcl_DStringInit(&dsOrig);
 	dirName = Tcl_GetStringFromObj(fileNamePtr, &dirLength);
@@ -316,6 +318,7 @@ TclpMatchInDirectory(
 		|| ((pattern[0] == '\\') && (pattern[1] == '.'));
 	matchHidden = matchHiddenPat
 		|| (types && (types->perm & TCL_GLOB_PERM_HIDDEN));
+	globPtr = TclNewGlobPattern(pattern, -1, 0);
 	while ((entryPtr = TclOSreaddir(d)) != NULL) {	/* INTL: Native. */
 	    Tcl_DString utfDs;
 	    const char *utfname;
@@ -349,7 +352,8 @@ TclpMatchInDirectory(
 
 	    utfname = Tcl_ExternalToUtfDString(NULL, entryPtr->d_name, -1,
 		    &utfDs);
-	    if (Tcl_StringCaseMatch(utfname, pattern, 0)) {
+	    if (TclGlobPatternMatch(globPtr, utfname,
+		    Tcl_DStringLength(&utfDs))) {
 		int typeOk = 1;
 
 		if (types != NULL) {
@@ -371,6 +375,7 @@ TclpMatchInDirectory(
 	    }
 	}
 
+	TclReleaseGlobPattern(globPtr);
 	closedir(d);
 	Tcl_DStringFree(&ds);
 	Tcl_DStringFree(&dsOrig);
@@ -842,6 +847,63 @@ TclpObjStat(
     return TclOSstat(path, bufPtr);
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclpMapFile, TclpUnmapFile --
+ *
+ *	Map a native file into memory, read-only and shared with every other
+ *	process mapping it, and unmap it again.
+ *
+ * Results:
+ *	TclpMapFile returns the address of the mapping and stores its size in
+ *	*sizePtr, or returns NULL if the path is not in the native filesystem,
+ *	the file is empty, or it cannot be opened or mapped.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+char *
+TclpMapFile(
+    Tcl_Obj *pathPtr,		/* Path of file to map. */
+    size_t *sizePtr)		/* Filled with the size of the mapping. */
+{
+    const char *path = Tcl_FSGetNativePath(pathPtr);
+    Tcl_StatBuf buf;
+    void *mapPtr = MAP_FAILED;
+    int fd;
+
+    if (path == NULL) {
+	return NULL;
+    }
+    fd = TclOSopen(path, O_RDONLY, 0);
+    if (fd < 0) {
+	return NULL;
+    }
+    if (TclOSfstat(fd, &buf) == 0 && buf.st_size > 0
+	    && (Tcl_WideInt) (size_t) buf.st_size == buf.st_size) {
+	mapPtr = mmap(NULL, (size_t) buf.st_size, PROT_READ, MAP_SHARED, fd,
+		0);
+    }
+    close(fd);
+    if (mapPtr == MAP_FAILED) {
+	return NULL;
+    }
+    *sizePtr = (size_t) buf.st_size;
+    return mapPtr;
+}
+
+void
+TclpUnmapFile(
+    char *mapPtr,		/* Address returned by TclpMapFile. */
+    size_t size)		/* Size it returned. */
+{
+    munmap(mapPtr, size);
+}
+
 #ifdef S_IFLNK
 
 Tcl_Obj*
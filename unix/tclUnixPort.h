@@ -78,9 +78,11 @@ typedef off_t		Tcl_SeekOffset;
 #ifdef HAVE_STRUCT_STAT64
 #   define TclOSstat		stat64
 #   define TclOSlstat		lstat64
+#   define TclOSfstat		fstat64
 #else
 #   define TclOSstat		stat
 #   define TclOSlstat		lstat
+#   define TclOSfstat		fstat
 #endif
 
 #include <sys/file.h>
@@ -198,6 +198,36 @@ TclpThreadExit(
 {
     pthread_exit(INT2PTR(status));
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclpNumProcessors --
+ *
+ *	This procedure returns the number of processors that are online, to
+ *	decide how many threads to split work over.
+ *
+ * Results:
+ *	The number of processors, or 1 if it cannot be found.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclpNumProcessors(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+    long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (numProcessors > 0) {
+	return (int) numProcessors;
+    }
+#endif
+    return 1;
+}
 #endif /* TCL_THREADS */
 
 /*
@@ -1494,6 +1494,35 @@ FileGetType(
     return type;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclpCopyDirect --
+ *
+ *	Moves bytes between two channels without passing them through the
+ *	channel buffers. Not supported on Windows, where fcopy always uses
+ *	the buffers.
+ *
+ * Results:
+ *	Always -1, with EINVAL in *errorCodePtr.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclpCopyDirect(
+    Tcl_Channel inChan,		/* Channel to read from. */
+    Tcl_Channel outChan,	/* Channel to write to. */
+    int toCopy,			/* Most bytes to move. */
+    int *errorCodePtr)		/* Where to store the error code. */
+{
+    *errorCodePtr = EINVAL;
+    return -1;
+}
+
 /*
  * Local Variables:
  * mode: c
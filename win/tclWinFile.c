@@ -959,6 +959,7 @@ TclpMatchInDirectory(
 				 * appended. */
 	int dirLength;
 	int matchSpecialDots;
+	GlobPattern *globPtr;	/* The pattern, compiled for the entries. */
 	Tcl_DString ds;		/* Native encoding of dir, also used
 				 * temporarily for other things. */
 	Tcl_DString dsOrig;	/* UTF-8 encoding of dir. */
@@ -1091,6 +1092,7 @@ TclpMatchInDirectory(
 	 * the first one we found.
 	 */
 
+	globPtr = TclNewGlobPattern(pattern, -1, TCL_MATCH_NOCASE);
 	do {
 	    const char *utfname;
 	    int checkDrive = 0, isDrive;
@@ -1131,7 +1133,8 @@ TclpMatchInDirectory(
 	     * the system.
 	     */
 
-	    if (Tcl_StringCaseMatch(utfname, pattern, 1)) {
+	    if (TclGlobPatternMatch(globPtr, utfname,
+		    Tcl_DStringLength(&ds))) {
 		/*
 		 * If the file matches, then we need to process the remainder
 		 * of the path.
@@ -1159,6 +1162,7 @@ TclpMatchInDirectory(
 	    Tcl_DStringFree(&ds);
 	} while (FindNextFile(handle, &data) == TRUE);
 
+	TclReleaseGlobPattern(globPtr);
 	FindClose(handle);
 	Tcl_DStringFree(&dsOrig);
 	return TCL_OK;
@@ -3246,6 +3250,68 @@ TclpUtime(
     return res;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TclpMapFile, TclpUnmapFile --
+ *
+ *	Map a native file into memory, read-only and shared with every other
+ *	process mapping it, and unmap it again.
+ *
+ * Results:
+ *	TclpMapFile returns the address of the view and stores its size in
+ *	*sizePtr, or returns NULL if the path is not in the native filesystem,
+ *	the file is empty, or it cannot be opened or mapped.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+char *
+TclpMapFile(
+    Tcl_Obj *pathPtr,		/* Path of file to map. */
+    size_t *sizePtr)		/* Filled with the size of the view. */
+{
+    const TCHAR *native = Tcl_FSGetNativePath(pathPtr);
+    HANDLE fileHandle, mapHandle;
+    DWORD sizeLow, sizeHigh;
+    void *mapPtr = NULL;
+
+    if (native == NULL) {
+	return NULL;
+    }
+    fileHandle = CreateFile(native, GENERIC_READ, FILE_SHARE_READ, NULL,
+	    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+	return NULL;
+    }
+    sizeLow = GetFileSize(fileHandle, &sizeHigh);
+    if (sizeLow != INVALID_FILE_SIZE && sizeLow != 0 && sizeHigh == 0) {
+	mapHandle = CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0,
+		NULL);
+	if (mapHandle != NULL) {
+	    mapPtr = MapViewOfFile(mapHandle, FILE_MAP_READ, 0, 0, 0);
+	    CloseHandle(mapHandle);
+	}
+    }
+    CloseHandle(fileHandle);
+    if (mapPtr == NULL) {
+	return NULL;
+    }
+    *sizePtr = sizeLow;
+    return mapPtr;
+}
+
+void
+TclpUnmapFile(
+    char *mapPtr,		/* Address returned by TclpMapFile. */
+    size_t size)		/* Size it returned. */
+{
+    UnmapViewOfFile(mapPtr);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -244,6 +244,32 @@ TclpThreadExit(
 #endif
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclpNumProcessors --
+ *
+ *	This procedure returns the number of processors, to decide how many
+ *	threads to split work over.
+ *
+ * Results:
+ *	The number of processors.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclpNumProcessors(void)
+{
+    SYSTEM_INFO systemInfo;
+
+    GetSystemInfo(&systemInfo);
+    return (int) systemInfo.dwNumberOfProcessors;
+}
+
 /*
  *----------------------------------------------------------------------
  *